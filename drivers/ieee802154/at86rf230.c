@@ -25,8 +25,11 @@
 #include <linux/gpio.h>
 #include <linux/delay.h>
 #include <linux/mutex.h>
-#include <linux/workqueue.h>
+#include <linux/wait.h>
+#include <linux/sched.h>
 #include <linux/spinlock.h>
+#include <linux/skbuff.h>
+#include <linux/random.h>
 #include <linux/spi/spi.h>
 #include <linux/spi/at86rf230.h>
 
@@ -38,6 +41,8 @@
 #include <net/mac802154.h>
 #include <net/wpan-phy.h>
 
+#include "spi_radio.h"
+
 struct at86rf230_local {
 	struct spi_device *spi;
 	int rstn, slp_tr, dig2;
@@ -48,14 +53,47 @@ struct at86rf230_local {
 	u8 buf[2];
 	struct mutex bmux;
 
-	struct work_struct irqwork;
-	struct completion tx_complete;
+	/*
+	 * Messages for the interrupt driven state machine, see
+	 * at86rf230_isr(). They are set up once and only used while the
+	 * IRQ is disabled, or for tx_msg, with is_tx set.
+	 */
+	struct spi_message irq_msg;
+	struct spi_transfer irq_xfer[2];
+	u8 irq_buf[2][2];
+
+	struct spi_radio radio;
+
+	struct spi_message rx_msg;
+	struct spi_transfer rx_xfer;
+	struct sk_buff *rx_skb;
+	u8 rx_len;
+
+	struct spi_message tx_msg;
+	struct spi_transfer tx_xfer[4];
+	u8 tx_buf[3][2];
+	struct sk_buff *tx_skb;
+
+	struct spi_message trac_msg;
+	struct spi_transfer trac_xfer[2];
+	u8 trac_buf[2][2];
+
+	struct spi_message rx_on_msg;
+	struct spi_transfer rx_on_xfer[2];
+	u8 rx_on_buf[2][2];
+	int tx_result;
+	/* RX_AACK_ON, promiscuous mode is a flag of that state */
+	u8 rx_state;
+	unsigned started:1; /* between start and stop */
 
 	struct ieee802154_dev *dev;
 
 	spinlock_t lock;
+	wait_queue_head_t idle_wq;
 	unsigned irq_disabled:1; /* P: lock */
 	unsigned is_tx:1; /* P: lock */
+	unsigned tx_deferred:1; /* P: lock */
+	unsigned shutdown:1; /* P: lock */
 };
 
 #define	RG_TRX_STATUS	(0x01)
@@ -243,12 +281,25 @@ struct at86rf230_local {
 #define STATE_BUSY_RX_AACK_NOCLK 0x1E
 #define STATE_TRANSITION_IN_PROGRESS 0x1F
 
+#define TRAC_SUCCESS			0
+#define TRAC_SUCCESS_DATA_PENDING	1
+#define TRAC_CHANNEL_ACCESS_FAILURE	3
+#define TRAC_NO_ACK			5
+#define TRAC_INVALID			7
+
+/* Frame buffer command and PHR, followed by PSDU and LQI */
+#define AT86RF230_FB_HDR_LEN	2
+#define AT86RF230_RX_BUF_SIZE	(127 + 1)
+#define AT86RF230_RX_POOL_SIZE	4
+
+#define AT86RF230_MAX_FRAME_RETRIES	3
+#define AT86RF230_MAX_CSMA_RETRIES	4
+
 static int
 __at86rf230_write(struct at86rf230_local *lp, u8 addr, u8 data)
 {
 	u8 *buf = lp->buf;
 	int status;
-	struct spi_message msg;
 	struct spi_transfer xfer = {
 		.len		= 2,
 		.tx_buf		= buf,
@@ -256,18 +307,21 @@ __at86rf230_write(struct at86rf230_local *lp, u8 addr, u8 data)
 
 	buf[0] = (addr & CMD_REG_MASK) | CMD_REG | CMD_WRITE;
 	buf[1] = data;
-	dev_vdbg(&lp->spi->dev, "buf[0] = %02x\n", buf[0]);
-	dev_vdbg(&lp->spi->dev, "buf[1] = %02x\n", buf[1]);
-	spi_message_init(&msg);
-	spi_message_add_tail(&xfer, &msg);
-
-	status = spi_sync(lp->spi, &msg);
-	dev_vdbg(&lp->spi->dev, "status = %d\n", status);
-	if (msg.status)
-		status = msg.status;
-	dev_vdbg(&lp->spi->dev, "status = %d\n", status);
-	dev_vdbg(&lp->spi->dev, "buf[0] = %02x\n", buf[0]);
-	dev_vdbg(&lp->spi->dev, "buf[1] = %02x\n", buf[1]);
+
+	status = spi_radio_sync(lp->spi, &xfer);
+	dev_vdbg(&lp->spi->dev, "write %02x = %02x: %d\n", addr, data, status);
+
+	return status;
+}
+
+static int
+at86rf230_write(struct at86rf230_local *lp, u8 addr, u8 data)
+{
+	int status;
+
+	mutex_lock(&lp->bmux);
+	status = __at86rf230_write(lp, addr, data);
+	mutex_unlock(&lp->bmux);
 
 	return status;
 }
@@ -278,7 +332,6 @@ __at86rf230_read_subreg(struct at86rf230_local *lp,
 {
 	u8 *buf = lp->buf;
 	int status;
-	struct spi_message msg;
 	struct spi_transfer xfer = {
 		.len		= 2,
 		.tx_buf		= buf,
@@ -287,17 +340,9 @@ __at86rf230_read_subreg(struct at86rf230_local *lp,
 
 	buf[0] = (addr & CMD_REG_MASK) | CMD_REG;
 	buf[1] = 0xff;
-	dev_vdbg(&lp->spi->dev, "buf[0] = %02x\n", buf[0]);
-	spi_message_init(&msg);
-	spi_message_add_tail(&xfer, &msg);
-
-	status = spi_sync(lp->spi, &msg);
-	dev_vdbg(&lp->spi->dev, "status = %d\n", status);
-	if (msg.status)
-		status = msg.status;
-	dev_vdbg(&lp->spi->dev, "status = %d\n", status);
-	dev_vdbg(&lp->spi->dev, "buf[0] = %02x\n", buf[0]);
-	dev_vdbg(&lp->spi->dev, "buf[1] = %02x\n", buf[1]);
+
+	status = spi_radio_sync(lp->spi, &xfer);
+	dev_vdbg(&lp->spi->dev, "read %02x = %02x: %d\n", addr, buf[1], status);
 
 	if (status == 0)
 		*data = buf[1];
@@ -340,93 +385,6 @@ out:
 	return status;
 }
 
-static int
-at86rf230_write_fbuf(struct at86rf230_local *lp, u8 *data, u8 len)
-{
-	u8 *buf = lp->buf;
-	int status;
-	struct spi_message msg;
-	struct spi_transfer xfer_head = {
-		.len		= 2,
-		.tx_buf		= buf,
-
-	};
-	struct spi_transfer xfer_buf = {
-		.len		= len,
-		.tx_buf		= data,
-	};
-
-	mutex_lock(&lp->bmux);
-	buf[0] = CMD_WRITE | CMD_FB;
-	buf[1] = len + 2; /* 2 bytes for CRC that isn't written */
-
-	dev_vdbg(&lp->spi->dev, "buf[0] = %02x\n", buf[0]);
-	dev_vdbg(&lp->spi->dev, "buf[1] = %02x\n", buf[1]);
-
-	spi_message_init(&msg);
-	spi_message_add_tail(&xfer_head, &msg);
-	spi_message_add_tail(&xfer_buf, &msg);
-
-	status = spi_sync(lp->spi, &msg);
-	dev_vdbg(&lp->spi->dev, "status = %d\n", status);
-	if (msg.status)
-		status = msg.status;
-	dev_vdbg(&lp->spi->dev, "status = %d\n", status);
-	dev_vdbg(&lp->spi->dev, "buf[0] = %02x\n", buf[0]);
-	dev_vdbg(&lp->spi->dev, "buf[1] = %02x\n", buf[1]);
-
-	mutex_unlock(&lp->bmux);
-	return status;
-}
-
-static int
-at86rf230_read_fbuf(struct at86rf230_local *lp, u8 *data, u8 *len, u8 *lqi)
-{
-	u8 *buf = lp->buf;
-	int status;
-	struct spi_message msg;
-	struct spi_transfer xfer_head = {
-		.len		= 2,
-		.tx_buf		= buf,
-		.rx_buf		= buf,
-
-	};
-	struct spi_transfer xfer_buf = {
-		.len		= *len,
-		.rx_buf		= data,
-	};
-
-	mutex_lock(&lp->bmux);
-	buf[0] = CMD_FB;
-	buf[1] = 0x00;
-
-	dev_vdbg(&lp->spi->dev, "buf[0] = %02x\n", buf[0]);
-	dev_vdbg(&lp->spi->dev, "buf[1] = %02x\n", buf[1]);
-
-	spi_message_init(&msg);
-	spi_message_add_tail(&xfer_head, &msg);
-	spi_message_add_tail(&xfer_buf, &msg);
-
-	status = spi_sync(lp->spi, &msg);
-	dev_vdbg(&lp->spi->dev, "status = %d\n", status);
-	if (msg.status)
-		status = msg.status;
-	dev_vdbg(&lp->spi->dev, "status = %d\n", status);
-	dev_vdbg(&lp->spi->dev, "buf[0] = %02x\n", buf[0]);
-	dev_vdbg(&lp->spi->dev, "buf[1] = %02x\n", buf[1]);
-
-	if (!status) {
-		if (lqi && *len > lp->buf[1])
-			*lqi = data[lp->buf[1]];
-
-		*len = lp->buf[1];
-	}
-
-	mutex_unlock(&lp->bmux);
-
-	return status;
-}
-
 static int
 at86rf230_ed(struct ieee802154_dev *dev, u8 *level)
 {
@@ -479,15 +437,98 @@ err:
 	return rc;
 }
 
+/*
+ * Frames are received in RX_AACK mode, where the radio drops frames not
+ * addressed to us and acknowledges the others itself. In promiscuous mode
+ * it passes everything up, but still only acknowledges frames for us.
+ */
+static int
+at86rf230_set_hw_addr_filt(struct ieee802154_dev *dev,
+		struct ieee802154_hw_addr_filt *filt, unsigned long changed)
+{
+	struct at86rf230_local *lp = dev->priv;
+	int rc = 0;
+	int i;
+
+	might_sleep();
+
+	if (changed & IEEE802515_SADDR_CHANGED) {
+		dev_vdbg(&lp->spi->dev, "short address %04x\n",
+				filt->short_addr);
+		rc = at86rf230_write(lp, RG_SHORT_ADDR_0, filt->short_addr);
+		if (!rc)
+			rc = at86rf230_write(lp, RG_SHORT_ADDR_1,
+					filt->short_addr >> 8);
+		if (rc)
+			goto out;
+	}
+
+	if (changed & IEEE802515_PANID_CHANGED) {
+		dev_vdbg(&lp->spi->dev, "PAN ID %04x\n", filt->pan_id);
+		rc = at86rf230_write(lp, RG_PAN_ID_0, filt->pan_id);
+		if (!rc)
+			rc = at86rf230_write(lp, RG_PAN_ID_1,
+					filt->pan_id >> 8);
+		if (rc)
+			goto out;
+	}
+
+	if (changed & IEEE802515_IEEEADDR_CHANGED) {
+		/* IEEE_ADDR_0 is the least significant octet */
+		for (i = 0; i < IEEE802154_ADDR_LEN; i++) {
+			rc = at86rf230_write(lp, RG_IEEE_ADDR_0 + i,
+				filt->ieee_addr[IEEE802154_ADDR_LEN - 1 - i]);
+			if (rc)
+				goto out;
+		}
+	}
+
+	if (changed & IEEE802515_PANC_CHANGED) {
+		rc = at86rf230_write_subreg(lp, SR_AACK_I_AM_COORD,
+				filt->pan_coord);
+		if (rc)
+			goto out;
+	}
+
+	if (changed & IEEE802515_PROMISC_CHANGED) {
+		dev_dbg(&lp->spi->dev, "promiscuous mode %s\n",
+				filt->promisc ? "on" : "off");
+
+		rc = at86rf230_write_subreg(lp, SR_AACK_PROM_MODE,
+				filt->promisc);
+	}
+
+out:
+	if (rc)
+		dev_err(&lp->spi->dev, "failed to set address filter: %d\n",
+				rc);
+	return rc;
+}
+
 static int
 at86rf230_start(struct ieee802154_dev *dev)
 {
-	return at86rf230_state(dev, STATE_RX_ON);
+	struct at86rf230_local *lp = dev->priv;
+	int rc;
+
+	rc = at86rf230_set_hw_addr_filt(dev, &dev->hw_filt,
+			IEEE802515_AFILT_CHANGED);
+	if (rc)
+		return rc;
+
+	rc = at86rf230_state(dev, lp->rx_state);
+	if (!rc)
+		lp->started = 1;
+
+	return rc;
 }
 
 static void
 at86rf230_stop(struct ieee802154_dev *dev)
 {
+	struct at86rf230_local *lp = dev->priv;
+
+	lp->started = 0;
 	at86rf230_state(dev, STATE_FORCE_TRX_OFF);
 }
 
@@ -510,161 +551,411 @@ at86rf230_channel(struct ieee802154_dev *dev, int channel)
 	return 0;
 }
 
-static int
-at86rf230_xmit(struct ieee802154_dev *dev, struct sk_buff *skb)
+/*
+ * Frame reception and transmission are driven from the IRQ by chains of
+ * asynchronous SPI messages, nothing sleeps:
+ *
+ *  - the ISR disables the IRQ and reads IRQ_STATUS together with the
+ *    length of the frame in the frame buffer;
+ *  - for a received frame the frame buffer is read straight into a
+ *    preallocated skb;
+ *  - at the end of a transmission TRAC_STATUS is read and the radio is
+ *    switched back to RX_ON, then mac802154 is told about the result.
+ *
+ * The IRQ is enabled again when a chain finishes. Transmissions run in
+ * TX_ARET mode, so the radio does CSMA-CA and retransmissions itself.
+ */
+static void
+at86rf230_msg_init(struct spi_message *msg, struct spi_transfer *xfer,
+		int n, void (*complete)(void *), void *context)
 {
-	struct at86rf230_local *lp = dev->priv;
-	int rc;
+	int i;
+
+	spi_message_init(msg);
+	for (i = 0; i < n; i++)
+		spi_message_add_tail(&xfer[i], msg);
+	msg->complete = complete;
+	msg->context = context;
+}
+
+static void
+at86rf230_xfer_init(struct spi_transfer *xfer, u8 *buf, u8 cmd, u8 val)
+{
+	buf[0] = cmd;
+	buf[1] = val;
+	xfer->tx_buf = buf;
+	xfer->rx_buf = buf;
+	xfer->len = 2;
+}
+
+static void
+at86rf230_xfer_write(struct spi_transfer *xfer, u8 *buf, u8 addr, u8 val)
+{
+	at86rf230_xfer_init(xfer, buf,
+			(addr & CMD_REG_MASK) | CMD_REG | CMD_WRITE, val);
+	/* The message is sent again, keep the command intact */
+	xfer->rx_buf = NULL;
+}
+
+static void
+at86rf230_xfer_read(struct spi_transfer *xfer, u8 *buf, u8 addr)
+{
+	at86rf230_xfer_init(xfer, buf, (addr & CMD_REG_MASK) | CMD_REG, 0);
+}
+
+static int at86rf230_start_tx(struct at86rf230_local *lp);
+
+/* Detach the frame being sent, called with lp->lock held */
+static struct sk_buff *at86rf230_tx_finish(struct at86rf230_local *lp)
+{
+	struct sk_buff *skb = lp->tx_skb;
+
+	lp->tx_skb = NULL;
+	lp->is_tx = 0;
+
+	return skb;
+}
+
+/* End of an IRQ chain. Called with nothing in flight */
+static void at86rf230_irq_done(struct at86rf230_local *lp)
+{
+	struct sk_buff *skb = NULL;
 	unsigned long flags;
+	int rc = 0;
 
-	pr_debug("%s\n", __func__);
+	spin_lock_irqsave(&lp->lock, flags);
+	if (lp->tx_deferred) {
+		lp->tx_deferred = 0;
+		rc = at86rf230_start_tx(lp);
+		if (rc)
+			skb = at86rf230_tx_finish(lp);
+	}
+	lp->irq_disabled = 0;
+	enable_irq(lp->spi->irq);
+	spin_unlock_irqrestore(&lp->lock, flags);
 
-	might_sleep();
+	wake_up(&lp->idle_wq);
+
+	if (skb)
+		ieee802154_xmit_complete(lp->dev, skb, rc);
+}
+
+static void at86rf230_tx_done(struct at86rf230_local *lp, int result)
+{
+	struct sk_buff *skb;
+	unsigned long flags;
 
 	spin_lock_irqsave(&lp->lock, flags);
-	BUG_ON(lp->is_tx);
-	lp->is_tx = 1;
-	INIT_COMPLETION(lp->tx_complete);
+	skb = at86rf230_tx_finish(lp);
 	spin_unlock_irqrestore(&lp->lock, flags);
 
-	rc = at86rf230_state(dev, STATE_FORCE_TX_ON);
-	if (rc)
-		goto err;
+	ieee802154_xmit_complete(lp->dev, skb, result);
+}
 
-	rc = at86rf230_write_fbuf(lp, skb->data, skb->len);
-	if (rc)
-		goto err_rx;
+static void at86rf230_tx_complete(void *context)
+{
+	struct at86rf230_local *lp = context;
+
+	dev_vdbg(&lp->spi->dev, "tx started: %d\n", lp->tx_msg.status);
+
+	if (lp->tx_msg.status) {
+		at86rf230_tx_done(lp, lp->tx_msg.status);
+		return;
+	}
 
 	if (gpio_is_valid(lp->slp_tr)) {
 		gpio_set_value(lp->slp_tr, 1);
-	} else {
-		rc = at86rf230_write_subreg(lp, SR_TRX_CMD, STATE_BUSY_TX);
-		if (rc)
-			goto err_rx;
+		gpio_set_value(lp->slp_tr, 0);
 	}
+}
 
-	gpio_set_value(lp->slp_tr, 0);
+/* Called with lp->lock held and the IRQ chain idle */
+static int at86rf230_start_tx(struct at86rf230_local *lp)
+{
+	struct sk_buff *skb = lp->tx_skb;
+	/* 2 bytes for CRC that isn't written */
+	u8 hdr[AT86RF230_FB_HDR_LEN] = { CMD_WRITE | CMD_FB, skb->len + 2 };
+	int n = 3;
 
-	rc = wait_for_completion_interruptible(&lp->tx_complete);
-	if (rc < 0)
-		goto err_rx;
+	lp->is_tx = 1;
 
-	rc = at86rf230_state(dev, STATE_RX_ON);
+	spi_radio_write_xfer(&lp->radio, &lp->tx_xfer[2], skb, hdr);
+	lp->tx_xfer[2].cs_change = 0;
 
-	return rc;
+	/* Without SLP_TR transmission is started with a command */
+	if (!gpio_is_valid(lp->slp_tr)) {
+		lp->tx_xfer[2].cs_change = 1;
+		n = 4;
+	}
+
+	at86rf230_msg_init(&lp->tx_msg, lp->tx_xfer, n,
+			at86rf230_tx_complete, lp);
+	return spi_async(lp->spi, &lp->tx_msg);
+}
+
+static int
+at86rf230_xmit(struct ieee802154_dev *dev, struct sk_buff *skb)
+{
+	struct at86rf230_local *lp = dev->priv;
+	unsigned long flags;
+	int rc = 0;
+
+	pr_debug("%s\n", __func__);
 
-err_rx:
-	at86rf230_state(dev, STATE_RX_ON);
-err:
 	spin_lock_irqsave(&lp->lock, flags);
-	lp->is_tx = 0;
+	BUG_ON(lp->is_tx || lp->tx_skb);
+	lp->tx_skb = skb;
+	/* The frame buffer is in use by a reception, start afterwards */
+	if (lp->irq_disabled)
+		lp->tx_deferred = 1;
+	else
+		rc = at86rf230_start_tx(lp);
+
+	if (rc)
+		at86rf230_tx_finish(lp);
 	spin_unlock_irqrestore(&lp->lock, flags);
 
 	return rc;
 }
 
-static int at86rf230_rx(struct at86rf230_local *lp)
+static void at86rf230_rx_on_complete(void *context)
 {
-	u8 len = 128;
-	u8 lqi = 0;
-	int rc;
+	struct at86rf230_local *lp = context;
 	struct sk_buff *skb;
+	unsigned long flags;
 
-	skb = alloc_skb(len, GFP_KERNEL);
-	if (!skb)
-		return -ENOMEM;
+	if (lp->rx_on_msg.status)
+		dev_err(&lp->spi->dev, "failed to enable receiver: %d\n",
+				lp->rx_on_msg.status);
 
-	rc = at86rf230_read_fbuf(lp, skb_put(skb, len), &len, &lqi);
-	if (len < 2) {
-		kfree_skb(skb);
-		return -EINVAL;
+	/* Later TRX_END interrupts belong to received frames */
+	spin_lock_irqsave(&lp->lock, flags);
+	skb = at86rf230_tx_finish(lp);
+	spin_unlock_irqrestore(&lp->lock, flags);
+
+	at86rf230_irq_done(lp);
+	ieee802154_xmit_complete(lp->dev, skb, lp->tx_result);
+}
+
+static void at86rf230_trac_complete(void *context)
+{
+	struct at86rf230_local *lp = context;
+	u8 trx_status = lp->trac_buf[0][1] & 0x1f;
+	u8 trac = lp->trac_buf[1][1] >> 5;
+	int rc;
+
+	if (lp->trac_msg.status) {
+		lp->tx_result = lp->trac_msg.status;
+	} else if (trx_status == STATE_BUSY_TX_ARET) {
+		/* TRX_END of a reception aborted by this transmission */
+		at86rf230_irq_done(lp);
+		return;
+	} else {
+		switch (trac) {
+		case TRAC_SUCCESS:
+		case TRAC_SUCCESS_DATA_PENDING:
+			lp->tx_result = 0;
+			break;
+		case TRAC_CHANNEL_ACCESS_FAILURE:
+			lp->tx_result = -EBUSY;
+			break;
+		case TRAC_NO_ACK:
+			lp->tx_result = -ETIMEDOUT;
+			break;
+		default:
+			lp->tx_result = -EIO;
+			break;
+		}
 	}
 
-	skb_trim(skb, len-2); /* We do not put CRC into the frame */
+	dev_dbg(&lp->spi->dev, "tx done, trac %d, result %d\n",
+			trac, lp->tx_result);
 
-	if (len < 2) {
-		kfree_skb(skb);
-		return -EINVAL;
+	lp->rx_on_buf[1][1] = lp->rx_state;
+	rc = spi_async(lp->spi, &lp->rx_on_msg);
+	if (rc) {
+		lp->rx_on_msg.status = rc;
+		at86rf230_rx_on_complete(lp);
 	}
+}
 
-	ieee802154_rx_irqsafe(lp->dev, skb, lqi);
+static void at86rf230_rx_complete(void *context)
+{
+	struct at86rf230_local *lp = context;
+	struct sk_buff *skb = lp->rx_skb;
+	u8 len = lp->rx_len;
+	u8 lqi;
 
-	dev_dbg(&lp->spi->dev, "READ_FBUF: %d %d %x\n", rc, len, lqi);
+	lp->rx_skb = NULL;
 
-	return 0;
-}
+	if (lp->rx_msg.status) {
+		dev_dbg(&lp->spi->dev, "READ_FBUF failed: %d\n",
+				lp->rx_msg.status);
+		spi_radio_put_skb(&lp->radio, skb);
+		goto out;
+	}
 
-static struct ieee802154_ops at86rf230_ops = {
-	.owner = THIS_MODULE,
-	.xmit = at86rf230_xmit,
-	.ed = at86rf230_ed,
-	.set_channel = at86rf230_channel,
-	.start = at86rf230_start,
-	.stop = at86rf230_stop,
-};
+	lqi = skb->data[len];
+	skb_put(skb, len - 2); /* We do not put CRC into the frame */
+
+	dev_dbg(&lp->spi->dev, "READ_FBUF: %d %x\n", len, lqi);
+
+	ieee802154_rx_irqsafe(lp->dev, skb, lqi);
+
+out:
+	at86rf230_irq_done(lp);
+}
 
-static void at86rf230_irqwork(struct work_struct *work)
+static void at86rf230_rx(struct at86rf230_local *lp, u8 len)
 {
-	struct at86rf230_local *lp =
-		container_of(work, struct at86rf230_local, irqwork);
-	u8 status = 0, val;
 	int rc;
-	unsigned long flags;
 
-	dev_dbg(&lp->spi->dev, "IRQ Worker\n");
+	if (len < 2 || len > 127) {
+		dev_dbg(&lp->spi->dev, "bad frame length %d\n", len);
+		goto out;
+	}
 
-	do {
-		rc = at86rf230_read_subreg(lp, RG_IRQ_STATUS, 0xff, 0, &val);
-		status |= val;
-		dev_dbg(&lp->spi->dev, "IRQ Status: %02x\n", status);
-
-		status &= ~IRQ_PLL_LOCK; /* ignore */
-		status &= ~IRQ_RX_START; /* ignore */
-		status &= ~IRQ_AMI; /* ignore */
-		status &= ~IRQ_TRX_UR; /* FIXME: possibly handle ???*/
-
-		if (status & IRQ_TRX_END) {
-			status &= ~IRQ_TRX_END;
-			spin_lock_irqsave(&lp->lock, flags);
-			if (lp->is_tx) {
-				lp->is_tx = 0;
-				spin_unlock_irqrestore(&lp->lock, flags);
-				complete(&lp->tx_complete);
-			} else {
-				spin_unlock_irqrestore(&lp->lock, flags);
-				at86rf230_rx(lp);
-			}
-		}
+	lp->rx_skb = spi_radio_get_skb(&lp->radio);
+	if (!lp->rx_skb) {
+		dev_dbg(&lp->spi->dev, "no memory, dropping frame\n");
+		goto out;
+	}
 
-	} while (status != 0);
+	/* The PSDU is followed by the LQI */
+	lp->rx_len = len;
+	spi_radio_read_xfer(&lp->radio, &lp->rx_xfer, lp->rx_skb, len + 1);
 
-	spin_lock_irqsave(&lp->lock, flags);
-	if (lp->irq_disabled) {
-		lp->irq_disabled = 0;
-		enable_irq(lp->spi->irq);
+	rc = spi_async(lp->spi, &lp->rx_msg);
+	if (!rc)
+		return;
+
+	spi_radio_put_skb(&lp->radio, lp->rx_skb);
+	lp->rx_skb = NULL;
+
+out:
+	at86rf230_irq_done(lp);
+}
+
+static void at86rf230_irq_complete(void *context)
+{
+	struct at86rf230_local *lp = context;
+	u8 status = lp->irq_buf[0][1];
+	unsigned long flags;
+	int is_tx;
+	int rc;
+
+	dev_dbg(&lp->spi->dev, "IRQ Status: %02x\n", status);
+
+	if (lp->irq_msg.status || !(status & IRQ_TRX_END)) {
+		at86rf230_irq_done(lp);
+		return;
 	}
+
+	spin_lock_irqsave(&lp->lock, flags);
+	is_tx = lp->is_tx;
 	spin_unlock_irqrestore(&lp->lock, flags);
+
+	if (!is_tx) {
+		/* PHR was read along with the status */
+		at86rf230_rx(lp, lp->irq_buf[1][1] & 0x7f);
+		return;
+	}
+
+	rc = spi_async(lp->spi, &lp->trac_msg);
+	if (rc) {
+		lp->trac_msg.status = rc;
+		at86rf230_trac_complete(lp);
+	}
 }
 
+static void at86rf230_async_init(struct at86rf230_local *lp)
+{
+	/* IRQ status and, speculatively, the received frame length */
+	at86rf230_xfer_read(&lp->irq_xfer[0], lp->irq_buf[0], RG_IRQ_STATUS);
+	lp->irq_xfer[0].cs_change = 1;
+	at86rf230_xfer_init(&lp->irq_xfer[1], lp->irq_buf[1], CMD_FB, 0);
+	at86rf230_msg_init(&lp->irq_msg, lp->irq_xfer, 2,
+			at86rf230_irq_complete, lp);
+
+	/* Frame buffer read, set up by spi_radio_read_xfer() */
+	at86rf230_msg_init(&lp->rx_msg, &lp->rx_xfer, 1,
+			at86rf230_rx_complete, lp);
+
+	/* PLL_ON, TX_ARET_ON, frame buffer upload, TX_START */
+	at86rf230_xfer_write(&lp->tx_xfer[0], lp->tx_buf[0],
+			RG_TRX_STATE, STATE_FORCE_TX_ON);
+	lp->tx_xfer[0].cs_change = 1;
+	lp->tx_xfer[0].delay_usecs = 1;
+	at86rf230_xfer_write(&lp->tx_xfer[1], lp->tx_buf[1],
+			RG_TRX_STATE, STATE_BUSY_TX_ARET_ON);
+	lp->tx_xfer[1].cs_change = 1;
+	lp->tx_xfer[1].delay_usecs = 1;
+	at86rf230_xfer_write(&lp->tx_xfer[3], lp->tx_buf[2],
+			RG_TRX_STATE, STATE_BUSY_TX);
+
+	/* TRX_STATUS and TRAC_STATUS */
+	at86rf230_xfer_read(&lp->trac_xfer[0], lp->trac_buf[0], RG_TRX_STATUS);
+	lp->trac_xfer[0].cs_change = 1;
+	at86rf230_xfer_read(&lp->trac_xfer[1], lp->trac_buf[1], RG_TRX_STATE);
+	at86rf230_msg_init(&lp->trac_msg, lp->trac_xfer, 2,
+			at86rf230_trac_complete, lp);
+
+	/* Back to reception through PLL_ON, see at86rf230_trac_complete() */
+	at86rf230_xfer_write(&lp->rx_on_xfer[0], lp->rx_on_buf[0],
+			RG_TRX_STATE, STATE_TX_ON);
+	lp->rx_on_xfer[0].cs_change = 1;
+	lp->rx_on_xfer[0].delay_usecs = 1;
+	at86rf230_xfer_write(&lp->rx_on_xfer[1], lp->rx_on_buf[1],
+			RG_TRX_STATE, lp->rx_state);
+	at86rf230_msg_init(&lp->rx_on_msg, lp->rx_on_xfer, 2,
+			at86rf230_rx_on_complete, lp);
+}
+
+/* Wait for the IRQ chain to finish and keep it from starting again */
+static void at86rf230_async_stop(struct at86rf230_local *lp)
+{
+	spin_lock_irq(&lp->lock);
+	lp->shutdown = 1;
+	spin_unlock_irq(&lp->lock);
+
+	wait_event(lp->idle_wq, !lp->irq_disabled);
+}
+
+static struct ieee802154_ops at86rf230_ops = {
+	.owner = THIS_MODULE,
+	.xmit_async = at86rf230_xmit,
+	.ed = at86rf230_ed,
+	.set_channel = at86rf230_channel,
+	.set_hw_addr_filt = at86rf230_set_hw_addr_filt,
+	.start = at86rf230_start,
+	.stop = at86rf230_stop,
+};
+
 static irqreturn_t at86rf230_isr(int irq, void *data)
 {
 	struct at86rf230_local *lp = data;
+	int rc;
 
 	dev_dbg(&lp->spi->dev, "IRQ!\n");
 
 	spin_lock(&lp->lock);
-	if (!lp->irq_disabled) {
-		disable_irq_nosync(irq);
-		lp->irq_disabled = 1;
+	if (lp->irq_disabled || lp->shutdown) {
+		spin_unlock(&lp->lock);
+		return IRQ_NONE;
 	}
+	disable_irq_nosync(irq);
+	lp->irq_disabled = 1;
 	spin_unlock(&lp->lock);
 
-	schedule_work(&lp->irqwork);
+	rc = spi_async(lp->spi, &lp->irq_msg);
+	if (rc) {
+		lp->irq_msg.status = rc;
+		at86rf230_irq_complete(lp);
+	}
 
 	return IRQ_HANDLED;
 }
 
-
 static int at86rf230_hw_init(struct at86rf230_local *lp)
 {
 	u8 status;
@@ -686,8 +977,27 @@ static int at86rf230_hw_init(struct at86rf230_local *lp)
 		dev_info(&lp->spi->dev, "Status: %02x\n", status);
 	}
 
-	rc = at86rf230_write_subreg(lp, SR_IRQ_MASK,
-			/*IRQ_TRX_UR | IRQ_CCA_ED | IRQ_TRX_END | IRQ_PLL_UNL | IRQ_PLL_LOCK*/ 0xff);
+	/* Only the end of a frame is of interest, see at86rf230_isr() */
+	rc = at86rf230_write_subreg(lp, SR_IRQ_MASK, IRQ_TRX_END);
+	if (rc)
+		return rc;
+
+	/* Channel access and retransmissions in TX_ARET mode */
+	rc = at86rf230_write_subreg(lp, SR_MAX_FRAME_RETRIES,
+			AT86RF230_MAX_FRAME_RETRIES);
+	if (rc)
+		return rc;
+
+	rc = at86rf230_write_subreg(lp, SR_MAX_CSMA_RETRIES,
+			AT86RF230_MAX_CSMA_RETRIES);
+	if (rc)
+		return rc;
+
+	rc = at86rf230_write_subreg(lp, SR_CSMA_SEED_0, random32() & 0xff);
+	if (rc)
+		return rc;
+
+	rc = at86rf230_write_subreg(lp, SR_CSMA_SEED_1, random32() & 0x07);
 	if (rc)
 		return rc;
 
@@ -802,6 +1112,7 @@ static int __devinit at86rf230_probe(struct spi_device *spi)
 	int rc;
 	const char *chip;
 	int supported = 0;
+	static const u8 fb_read[AT86RF230_FB_HDR_LEN] = { CMD_FB, 0 };
 
 	if (!spi->irq) {
 		dev_err(&spi->dev, "no IRQ specified\n");
@@ -819,15 +1130,23 @@ static int __devinit at86rf230_probe(struct spi_device *spi)
 
 	dev->priv = lp;
 	dev->parent = &spi->dev;
-	dev->extra_tx_headroom = 0;
+	/* Room for the frame buffer write command, see spi_radio.h */
+	dev->extra_tx_headroom = AT86RF230_FB_HDR_LEN;
 	/* We do support only 2.4 Ghz */
 	dev->phy->channels_supported[0] = 0x7FFF800;
-	dev->flags = IEEE802154_HW_OMIT_CKSUM;
+	dev->flags = IEEE802154_HW_OMIT_CKSUM | IEEE802154_HW_CSMA |
+		IEEE802154_HW_AACK;
 
 	mutex_init(&lp->bmux);
-	INIT_WORK(&lp->irqwork, at86rf230_irqwork);
 	spin_lock_init(&lp->lock);
-	init_completion(&lp->tx_complete);
+	init_waitqueue_head(&lp->idle_wq);
+	lp->rx_state = STATE_BUSY_RX_AACK_ON;
+	at86rf230_async_init(lp);
+
+	rc = spi_radio_init(&lp->radio, spi, fb_read, AT86RF230_FB_HDR_LEN,
+			AT86RF230_RX_BUF_SIZE, AT86RF230_RX_POOL_SIZE);
+	if (rc)
+		goto err_radio;
 
 	spi_set_drvdata(spi, lp);
 
@@ -923,8 +1242,8 @@ static int __devinit at86rf230_probe(struct spi_device *spi)
 
 	ieee802154_unregister_device(lp->dev);
 err_irq:
+	at86rf230_async_stop(lp);
 	free_irq(spi->irq, lp);
-	flush_work(&lp->irqwork);
 err_gpio_dir:
 	if (gpio_is_valid(lp->slp_tr))
 		gpio_free(lp->slp_tr);
@@ -932,6 +1251,8 @@ err_slp_tr:
 	gpio_free(lp->rstn);
 err_rstn:
 err_fill:
+	spi_radio_fini(&lp->radio);
+err_radio:
 	spi_set_drvdata(spi, NULL);
 	mutex_destroy(&lp->bmux);
 	ieee802154_free_device(lp->dev);
@@ -944,8 +1265,9 @@ static int __devexit at86rf230_remove(struct spi_device *spi)
 
 	ieee802154_unregister_device(lp->dev);
 
+	at86rf230_async_stop(lp);
 	free_irq(spi->irq, lp);
-	flush_work(&lp->irqwork);
+	spi_radio_fini(&lp->radio);
 
 	if (gpio_is_valid(lp->slp_tr))
 		gpio_free(lp->slp_tr);
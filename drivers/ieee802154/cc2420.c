@@ -32,6 +32,8 @@
 #include <net/mac802154.h>
 #include <net/wpan-phy.h>
 
+#include "spi_radio.h"
+
 #define CC2420_WRITEREG(x) (x)
 #define CC2420_READREG(x) (0x40 | x)
 
@@ -51,15 +53,20 @@
 #define STATE_RX_SFD_SEARCH_MIN 3
 #define STATE_RX_SFD_SEARCH_MAX 6
 
+/* FIFO access command and length octet */
+#define CC2420_FIFO_HDR_LEN	2
+#define CC2420_RX_BUF_SIZE	127
+#define CC2420_RX_POOL_SIZE	4
+
 struct cc2420_local {
 	struct cc2420_platform_data *pdata;
 	struct spi_device *spi;
 	struct ieee802154_dev *dev;
 	u8 *buf;
 	struct mutex bmux;
+	struct spi_radio radio;
 	int fifop_irq;
 	int sfd_irq;
-	struct work_struct fifop_irqwork;
 	struct work_struct sfd_irqwork;
 	spinlock_t lock;
 	unsigned irq_disabled:1;/* P:lock */
@@ -209,80 +216,116 @@ cc2420_channel(struct ieee802154_dev *dev, int channel)
 	return ret;
 }
 
+/* RAM is addressed with 9 bits, split over the two command octets */
 static int
-cc2420_write_txfifo(struct cc2420_local *lp, u8 *data, u8 len)
+cc2420_write_ram(struct cc2420_local *lp, u16 addr, const u8 *data, int len)
 {
-	int status;
-	struct spi_message msg;
-	struct spi_transfer xfer_head = {
-		.len		= 1,
-		.tx_buf		= lp->buf,
-		.rx_buf		= lp->buf,
-	};
-	struct spi_transfer xfer_buf = {
-		.len		= len,
-		.tx_buf		= data,
-	};
+	u8 *buf;
+	int ret;
 
-	mutex_lock(&lp->bmux);
-	lp->buf[0] = CC2420_WRITEREG(CC2420_TXFIFO);
-	dev_vdbg(&lp->spi->dev, "TX_FIFO addr buf[0] = %02x\n", lp->buf[0]);
+	buf = kmalloc(len + 2, GFP_KERNEL);
+	if (!buf)
+		return -ENOMEM;
 
-	spi_message_init(&msg);
-	spi_message_add_tail(&xfer_head, &msg);
-	spi_message_add_tail(&xfer_buf, &msg);
-
-	status = spi_sync(lp->spi, &msg);
-	dev_vdbg(&lp->spi->dev, "status = %d\n", status);
-	if (msg.status)
-		status = msg.status;
-	dev_vdbg(&lp->spi->dev, "status = %d\n", status);
-	dev_vdbg(&lp->spi->dev, "buf[0] = %02x\n", lp->buf[0]);
+	buf[0] = 0x80 | (addr & 0x7f);
+	buf[1] = (addr >> 1) & 0xc0;
+	memcpy(buf + 2, data, len);
 
+	mutex_lock(&lp->bmux);
+	ret = spi_write(lp->spi, buf, len + 2);
 	mutex_unlock(&lp->bmux);
-	return status;
+	dev_vdbg(&lp->spi->dev, "write RAM %03x, %d bytes: %d\n",
+			addr, len, ret);
+
+	kfree(buf);
+	return ret;
 }
 
+/*
+ * With address recognition the radio drops frames not addressed to us
+ * and acknowledges the others itself. Promiscuous mode turns both off.
+ */
 static int
-cc2420_read_rxfifo(struct cc2420_local *lp, u8 *data, u8 *len, u8 *lqi)
+cc2420_set_hw_addr_filt(struct ieee802154_dev *dev,
+		struct ieee802154_hw_addr_filt *filt, unsigned long changed)
 {
-	int status;
-	struct spi_message msg;
-	struct spi_transfer xfer_head = {
-		.len		= 2,
-		.tx_buf		= lp->buf,
-		.rx_buf		= lp->buf,
-	};
-	struct spi_transfer xfer_buf = {
-		.len		= *len,
-		.rx_buf		= data,
-	};
+	struct cc2420_local *lp = dev->priv;
+	u8 addr[IEEE802154_ADDR_LEN];
+	u16 mdmctrl0;
+	int ret = 0;
+	int i;
 
-	mutex_lock(&lp->bmux);
-	lp->buf[0] = CC2420_READREG(CC2420_RXFIFO);
-	lp->buf[1] = 0x00;
-	dev_vdbg(&lp->spi->dev, "read rxfifo buf[0] = %02x\n", lp->buf[0]);
-	dev_vdbg(&lp->spi->dev, "buf[1] = %02x\n", lp->buf[1]);
-	spi_message_init(&msg);
-	spi_message_add_tail(&xfer_head, &msg);
-	spi_message_add_tail(&xfer_buf, &msg);
+	might_sleep();
+
+	if (changed & IEEE802515_SADDR_CHANGED) {
+		addr[0] = filt->short_addr & 0xff;
+		addr[1] = filt->short_addr >> 8;
+		ret = cc2420_write_ram(lp, CC2420_RAM_SHORTADR, addr, 2);
+		if (ret)
+			goto out;
+	}
 
-	status = spi_sync(lp->spi, &msg);
-	dev_vdbg(&lp->spi->dev, "status = %d\n", status);
-	if (msg.status)
-		status = msg.status;
-	dev_vdbg(&lp->spi->dev, "status = %d\n", status);
-	dev_vdbg(&lp->spi->dev, "return status buf[0] = %02x\n", lp->buf[0]);
-	dev_vdbg(&lp->spi->dev, "length buf[1] = %02x\n", lp->buf[1]);
+	if (changed & IEEE802515_PANID_CHANGED) {
+		addr[0] = filt->pan_id & 0xff;
+		addr[1] = filt->pan_id >> 8;
+		ret = cc2420_write_ram(lp, CC2420_RAM_PANID, addr, 2);
+		if (ret)
+			goto out;
+	}
 
-	*lqi = data[lp->buf[1] - 1] & 0x7f;
-	*len = lp->buf[1]; /* it should be less than 130 */
+	if (changed & IEEE802515_IEEEADDR_CHANGED) {
+		/* Least significant octet first */
+		for (i = 0; i < IEEE802154_ADDR_LEN; i++)
+			addr[i] = filt->ieee_addr[IEEE802154_ADDR_LEN - 1 - i];
+		ret = cc2420_write_ram(lp, CC2420_RAM_IEEEADR, addr,
+				IEEE802154_ADDR_LEN);
+		if (ret)
+			goto out;
+	}
 
-	mutex_unlock(&lp->bmux);
+	/*
+	 * AUTOACK only acknowledges frames accepted by ADR_DECODE, so
+	 * frames for us go unacknowledged while promiscuous.
+	 */
+	if (changed & (IEEE802515_PANC_CHANGED | IEEE802515_PROMISC_CHANGED)) {
+		mdmctrl0 = 0;
+		if (filt->pan_coord)
+			mdmctrl0 |= 1 << CC2420_MDMCTRL0_PANCRD;
+		if (!filt->promisc)
+			mdmctrl0 |= (1 << CC2420_MDMCTRL0_ADRDECODE) |
+				(1 << CC2420_MDMCTRL0_AUTOACK);
+
+		ret = cc2420_write_16_bit_reg_partial(lp, CC2420_MDMCTRL0,
+				mdmctrl0, (1 << CC2420_MDMCTRL0_PANCRD) |
+				(1 << CC2420_MDMCTRL0_ADRDECODE) |
+				(1 << CC2420_MDMCTRL0_AUTOACK));
+	}
 
-	return status;
+out:
+	if (ret)
+		dev_err(&lp->spi->dev, "failed to set address filter: %d\n",
+				ret);
+	return ret;
 }
 
+static int
+cc2420_write_txfifo(struct cc2420_local *lp, struct sk_buff *skb)
+{
+	/* The length octet includes the FCS added by the radio */
+	u8 hdr[CC2420_FIFO_HDR_LEN] = {
+		CC2420_WRITEREG(CC2420_TXFIFO), skb->len + 2
+	};
+	struct spi_transfer xfer;
+	int status;
+
+	memset(&xfer, 0, sizeof(xfer));
+	spi_radio_write_xfer(&lp->radio, &xfer, skb, hdr);
+
+	status = spi_radio_sync(lp->spi, &xfer);
+	dev_vdbg(&lp->spi->dev, "TXFIFO %d: %d\n", skb->len, status);
+
+	return status;
+}
 
 static int
 cc2420_tx(struct ieee802154_dev *dev, struct sk_buff *skb)
@@ -299,7 +342,7 @@ cc2420_tx(struct ieee802154_dev *dev, struct sk_buff *skb)
 	rc = cc2420_cmd_strobe(lp, CC2420_SFLUSHTX);
 	if (rc)
 		goto err_rx;
-	rc = cc2420_write_txfifo(lp, skb->data, skb->len);
+	rc = cc2420_write_txfifo(lp, skb);
 	if (rc)
 		goto err_rx;
 
@@ -343,25 +386,70 @@ err_rx:
 	return rc;
 }
 
+/*
+ * Every octet read from RXFIFO is consumed, so a frame is read in two
+ * bursts: the length octet, then exactly that many octets. Anything
+ * else would eat into the frame behind it.
+ */
+static int cc2420_read_rxfifo_len(struct cc2420_local *lp, u8 *len)
+{
+	struct spi_transfer xfer = {
+		.len = 2,
+		.tx_buf = lp->buf,
+		.rx_buf = lp->buf,
+	};
+	int ret;
+
+	mutex_lock(&lp->bmux);
+	lp->buf[0] = CC2420_READREG(CC2420_RXFIFO);
+	lp->buf[1] = 0;
+	ret = spi_radio_sync(lp->spi, &xfer);
+	if (!ret)
+		*len = lp->buf[1] & 0x7f;
+	mutex_unlock(&lp->bmux);
+
+	return ret;
+}
+
 static int cc2420_rx(struct cc2420_local *lp)
 {
-	u8 len = 128;
+	u8 len;
 	u8 lqi = 0; /* link quality */
 	int rc;
 	struct sk_buff *skb;
+	struct spi_transfer xfer;
 
-	skb = alloc_skb(len, GFP_KERNEL);
+	rc = cc2420_read_rxfifo_len(lp, &len);
+	if (rc)
+		return rc;
+	if (len < 2 || len > CC2420_RX_BUF_SIZE)
+		return -EINVAL;
+
+	skb = spi_radio_get_skb(&lp->radio);
 	if (!skb)
 		return -ENOMEM;
 
-	rc = cc2420_read_rxfifo(lp, skb_put(skb, len), &len, &lqi);
-	if (len < 2) {
-		kfree_skb(skb);
-		return -EINVAL;
+	/* The status octet clocked out with the command lands in headroom */
+	memset(&xfer, 0, sizeof(xfer));
+	xfer.tx_buf = lp->radio.read_cmd;
+	xfer.rx_buf = skb->data - 1;
+	xfer.len = 1 + len;
+
+	rc = spi_radio_sync(lp->spi, &xfer);
+	if (rc) {
+		spi_radio_put_skb(&lp->radio, skb);
+		return rc;
 	}
 
-	skb_trim(skb, len-1); /* We do not put CRC and Corr into
-							the frame, but remain rssi value */
+	/* With AUTOCRC the FCS is replaced by RSSI and CRC_OK | correlation */
+	lqi = skb->data[len - 1] & 0x7f;
+	if (!(skb->data[len - 1] & CC2420_CRC_MASK)) {
+		dev_dbg(&lp->spi->dev, "RXFIFO: bad CRC\n");
+		wpan_phy_stats_inc(lp->dev->phy, rx_crc_errors);
+		spi_radio_put_skb(&lp->radio, skb);
+		return 0;
+	}
+	skb_put(skb, len - 2);
 
 	ieee802154_rx_irqsafe(lp->dev, skb, lqi);
 
@@ -370,6 +458,13 @@ static int cc2420_rx(struct cc2420_local *lp)
 	return 0;
 }
 
+static void cc2420_flush_rx(struct cc2420_local *lp)
+{
+	/* The datasheet asks for two strobes */
+	cc2420_cmd_strobe(lp, CC2420_SFLUSHRX);
+	cc2420_cmd_strobe(lp, CC2420_SFLUSHRX);
+}
+
 static int
 cc2420_ed(struct ieee802154_dev *dev, u8 *level)
 {
@@ -382,6 +477,13 @@ cc2420_ed(struct ieee802154_dev *dev, u8 *level)
 static int
 cc2420_start(struct ieee802154_dev *dev)
 {
+	int ret;
+
+	ret = cc2420_set_hw_addr_filt(dev, &dev->hw_filt,
+			IEEE802515_AFILT_CHANGED);
+	if (ret)
+		return ret;
+
 	return cc2420_cmd_strobe(dev->priv, CC2420_SRXON);
 }
 
@@ -398,6 +500,7 @@ static struct ieee802154_ops cc2420_ops = {
 	.start 		= cc2420_start,
 	.stop 		= cc2420_stop,
 	.set_channel = cc2420_channel,
+	.set_hw_addr_filt = cc2420_set_hw_addr_filt,
 };
 
 static int cc2420_register(struct cc2420_local *lp)
@@ -409,15 +512,15 @@ static int cc2420_register(struct cc2420_local *lp)
 
 	lp->dev->priv = lp;
 	lp->dev->parent = &lp->spi->dev;
-	//look this up.
-	lp->dev->extra_tx_headroom = 0;
+	/* Room for the TXFIFO command, see spi_radio.h */
+	lp->dev->extra_tx_headroom = CC2420_FIFO_HDR_LEN;
 	//and this
 	//lp->dev->channel_mask = 0x7ff;
 	//and more.
 
 	/* We do support only 2.4 Ghz */
 	lp->dev->phy->channels_supported[0] = 0x7FFF800;
-	lp->dev->flags = IEEE802154_HW_OMIT_CKSUM;
+	lp->dev->flags = IEEE802154_HW_OMIT_CKSUM | IEEE802154_HW_AACK;
 
 	dev_dbg(&lp->spi->dev, "registered cc2420\n");
 	ret = ieee802154_register_device(lp->dev);
@@ -448,38 +551,61 @@ static irqreturn_t cc2420_isr(int irq, void *data)
 	}
 	spin_unlock(&lp->lock);
 
-	/* pin or value? */
-	if (irq == lp->sfd_irq)
-		schedule_work(&lp->sfd_irqwork);
-
-	if (irq == lp->fifop_irq)
-		schedule_work(&lp->fifop_irqwork);
+	schedule_work(&lp->sfd_irqwork);
 
 	return IRQ_HANDLED;
 }
 
-static void cc2420_fifop_irqwork(struct work_struct *work)
+/*
+ * FIFOP is shared, so only wake the thread when it is asserted. The line
+ * stays masked (IRQF_ONESHOT) until cc2420_fifop_thread() returns.
+ */
+static irqreturn_t cc2420_fifop_isr(int irq, void *data)
 {
-	struct cc2420_local *lp
-		= container_of(work, struct cc2420_local, fifop_irqwork);
-	unsigned long flags;
+	struct cc2420_local *lp = data;
 
-	dev_dbg(&lp->spi->dev, "fifop interrupt received\n");
+	if (!gpio_get_value(lp->pdata->fifop))
+		return IRQ_NONE;
 
-	if (gpio_get_value(lp->pdata->fifo))
-		cc2420_rx(lp);
-	else
-		dev_err(&lp->spi->dev, "rxfifo overflow\n");
+	return IRQ_WAKE_THREAD;
+}
 
-	cc2420_cmd_strobe(lp, CC2420_SFLUSHRX);
-	cc2420_cmd_strobe(lp, CC2420_SFLUSHRX);
+/*
+ * With the threshold above the largest frame FIFOP stays asserted while
+ * RXFIFO holds a complete frame, so read frames until it goes low.
+ * FIFOP without FIFO means the FIFO overflowed, it has to be flushed.
+ */
+static irqreturn_t cc2420_fifop_thread(int irq, void *data)
+{
+	struct cc2420_local *lp = data;
+	int frames = 0;
+	int rc;
 
-	spin_lock_irqsave(&lp->lock, flags);
-	if (lp->irq_disabled) {
-		lp->irq_disabled = 0;
-		enable_irq(lp->fifop_irq);
+	while (gpio_get_value(lp->pdata->fifop)) {
+		if (!gpio_get_value(lp->pdata->fifo)) {
+			dev_dbg(&lp->spi->dev, "rxfifo overflow\n");
+			wpan_phy_stats_inc(lp->dev->phy, rx_overflows);
+			cc2420_flush_rx(lp);
+			break;
+		}
+
+		rc = cc2420_rx(lp);
+		if (rc) {
+			/*
+			 * The rest of the frame is still in the FIFO. Not an
+			 * overflow, so not counted as one.
+			 */
+			dev_dbg(&lp->spi->dev, "rxfifo read failed: %d\n", rc);
+			cc2420_flush_rx(lp);
+			break;
+		}
+
+		frames++;
 	}
-	spin_unlock_irqrestore(&lp->lock, flags);
+
+	dev_dbg(&lp->spi->dev, "fifop: %d frames\n", frames);
+
+	return IRQ_HANDLED;
 }
 
 static void cc2420_sfd_irqwork(struct work_struct *work)
@@ -547,6 +673,9 @@ static int __devinit cc2420_probe(struct spi_device *spi)
 {
 	int ret;
 	u16 manidl, manidh;
+	static const u8 rxfifo_read[CC2420_FIFO_HDR_LEN] = {
+		CC2420_READREG(CC2420_RXFIFO), 0
+	};
 	struct cc2420_local *lp = kzalloc(sizeof *lp, GFP_KERNEL);
 	if (!lp) {
 		ret = -ENOMEM;
@@ -561,7 +690,6 @@ static int __devinit cc2420_probe(struct spi_device *spi)
 	}
 	spi_set_drvdata(spi, lp);
 	mutex_init(&lp->bmux);
-	INIT_WORK(&lp->fifop_irqwork, cc2420_fifop_irqwork);
 	INIT_WORK(&lp->sfd_irqwork, cc2420_sfd_irqwork);
 	spin_lock_init(&lp->lock);
 	init_completion(&lp->tx_complete);
@@ -573,10 +701,15 @@ static int __devinit cc2420_probe(struct spi_device *spi)
 		goto err_free_local;
 	}
 
+	ret = spi_radio_init(&lp->radio, spi, rxfifo_read, CC2420_FIFO_HDR_LEN,
+			CC2420_RX_BUF_SIZE, CC2420_RX_POOL_SIZE);
+	if (ret)
+		goto err_free_buf;
+
 	/* Request all the gpio's */
 	ret = gpio_request(lp->pdata->fifo, "fifo");
 	if (ret)
-		goto err_free_buf;
+		goto err_free_radio;
 	ret = gpio_request(lp->pdata->cca, "cca");
 	if (ret)
 		goto err_free_gpio_fifo;
@@ -648,9 +781,11 @@ static int __devinit cc2420_probe(struct spi_device *spi)
 	lp->fifop_irq = gpio_to_irq(lp->pdata->fifop);
 	lp->sfd_irq = gpio_to_irq(lp->pdata->sfd);
 
-	ret = request_irq(lp->fifop_irq,
-					  cc2420_isr,
-					  IRQF_TRIGGER_RISING | IRQF_SHARED,
+	ret = request_threaded_irq(lp->fifop_irq,
+					  cc2420_fifop_isr,
+					  cc2420_fifop_thread,
+					  IRQF_TRIGGER_RISING | IRQF_SHARED |
+					  IRQF_ONESHOT,
 					  dev_name(&spi->dev),
 					  lp);
 	if (ret) {
@@ -695,6 +830,8 @@ err_free_gpio_cca:
 	gpio_free(lp->pdata->cca);
 err_free_gpio_fifo:
 	gpio_free(lp->pdata->fifo);
+err_free_radio:
+	spi_radio_fini(&lp->radio);
 err_free_buf:
 	kfree(lp->buf);
 err_free_local:
@@ -716,6 +853,7 @@ static int __devexit cc2420_remove(struct spi_device *spi)
 	gpio_free(lp->pdata->fifop);
 	gpio_free(lp->pdata->cca);
 	gpio_free(lp->pdata->fifo);
+	spi_radio_fini(&lp->radio);
 	kfree(lp->buf);
 	kfree(lp);
 
@@ -26,9 +26,41 @@
 #include <linux/platform_device.h>
 #include <linux/netdevice.h>
 #include <linux/spinlock.h>
+#include <linux/hrtimer.h>
+#include <linux/random.h>
+#include <linux/sched.h>
+#include <linux/crc-ccitt.h>
+#include <net/af_ieee802154.h>
 #include <net/mac802154.h>
+#include <net/ieee802154.h>
 #include <net/wpan-phy.h>
 
+/*
+ * The devices share a simulated radio channel. A frame occupies the air
+ * for its duration at 250 kbit/s; it reaches the devices on the same
+ * channel the sender has links to, each link with its own LQI and loss
+ * rate. A device without links reaches everyone on its channel, as do
+ * all of them until links are set up through the "link" attribute.
+ * Frames overlapping at a receiver are both lost, and CCA and ED report
+ * energy while a frame is on the air there. Acknowledgements are sent
+ * back for frames which reached the device they are addressed to, so
+ * mac802154 runs its CSMA-CA and retransmissions against the simulated
+ * channel.
+ */
+
+/* 250 kbit/s */
+#define FAKE_OCTET_NS		32000
+/* Preamble, SFD and PHR */
+#define FAKE_PHY_OVERHEAD	6
+#define FAKE_DEFAULT_LQI	0xcc
+
+struct fake_link {
+	struct list_head list;
+	struct fake_dev_priv *to;
+	u8 lqi;
+	u8 loss; /* percent */
+};
+
 struct fake_dev_priv {
 	struct ieee802154_dev *dev;
 
@@ -36,23 +68,118 @@ struct fake_dev_priv {
 	struct fake_priv *fake;
 
 	unsigned int working:1;
+
+	/* Outgoing links, protected by fake->lock */
+	struct list_head links;
+	unsigned int n_links;
+
+	/* Recipients of the frame being sent, only used by hw_xmit() */
+	struct fake_rcpt *rcpt;
+	unsigned int rcpt_max;
+
+	/* The frames on the air at this device */
+	spinlock_t rx_lock;
+	ktime_t rx_end;		/* until the air is free again */
+	ktime_t rx_frame_end;	/* end of the frame being received */
+	u32 rx_seq;		/* number of the frame being received */
+	u64 rx_lost;		/* collided frames, bit rx_seq % 64 */
+	u8 rx_lqi;
 };
 
 struct fake_priv {
 	struct list_head list;
+	unsigned int count;
 	rwlock_t lock;
 };
 
+/* A device a frame being sent may reach */
+struct fake_rcpt {
+	struct fake_dev_priv *dp;
+	u32 seq;
+	u8 lqi;
+	u8 loss;
+};
+
+static bool fake_rx_busy(struct fake_dev_priv *dp, ktime_t now)
+{
+	return ktime_to_ns(ktime_sub(dp->rx_end, now)) > 0;
+}
+
+/*
+ * A frame starts to arrive at dp. If another one is on the air there,
+ * both are lost. Returns true if the frame may be received, *seq then
+ * numbers it for fake_rx_end().
+ */
+static bool fake_rx_start(struct fake_dev_priv *dp, ktime_t now, ktime_t end,
+		u8 lqi, u32 *seq)
+{
+	bool ok = false;
+
+	spin_lock(&dp->rx_lock);
+	if (fake_rx_busy(dp, now)) {
+		/* Only the tail of an earlier collision may be left */
+		if (ktime_to_ns(ktime_sub(dp->rx_frame_end, now)) > 0)
+			dp->rx_lost |= 1ULL << (dp->rx_seq % 64);
+		if (ktime_to_ns(ktime_sub(end, dp->rx_end)) > 0)
+			dp->rx_end = end;
+	} else {
+		dp->rx_end = end;
+		dp->rx_frame_end = end;
+		dp->rx_lqi = lqi;
+		*seq = ++dp->rx_seq;
+		dp->rx_lost &= ~(1ULL << (*seq % 64));
+		ok = true;
+	}
+	spin_unlock(&dp->rx_lock);
+
+	return ok;
+}
+
+/* Was frame seq received without collision? Later frames may follow it */
+static bool fake_rx_end(struct fake_dev_priv *dp, u32 seq)
+{
+	bool ok;
+
+	spin_lock_bh(&dp->rx_lock);
+	ok = dp->rx_seq - seq < 64 && !(dp->rx_lost & (1ULL << (seq % 64)));
+	spin_unlock_bh(&dp->rx_lock);
+
+	return ok;
+}
+
 static int
 hw_ed(struct ieee802154_dev *dev, u8 *level)
 {
+	struct fake_dev_priv *priv = dev->priv;
+
 	pr_debug("%s\n", __func__);
 	might_sleep();
 	BUG_ON(!level);
-	*level = 0xbe;
+
+	spin_lock_bh(&priv->rx_lock);
+	if (fake_rx_busy(priv, ktime_get()))
+		*level = priv->rx_lqi;
+	else
+		*level = random32() & 0x0f; /* noise floor */
+	spin_unlock_bh(&priv->rx_lock);
+
 	return 0;
 }
 
+static int
+hw_cca(struct ieee802154_dev *dev)
+{
+	struct fake_dev_priv *priv = dev->priv;
+	int ret = 0;
+
+	spin_lock_bh(&priv->rx_lock);
+	if (fake_rx_busy(priv, ktime_get()))
+		ret = -EBUSY;
+	spin_unlock_bh(&priv->rx_lock);
+
+	return ret;
+}
+
 static int
 hw_channel(struct ieee802154_dev *dev, int channel)
 {
@@ -63,7 +190,7 @@ hw_channel(struct ieee802154_dev *dev, int channel)
 }
 
 static void
-hw_deliver(struct fake_dev_priv *priv, struct sk_buff *skb)
+hw_deliver(struct fake_dev_priv *priv, struct sk_buff *skb, u8 lqi)
 {
 	struct sk_buff *newskb;
 
@@ -71,8 +198,93 @@ hw_deliver(struct fake_dev_priv *priv, struct sk_buff *skb)
 		return;
 
 	newskb = pskb_copy(skb, GFP_ATOMIC);
+	if (!newskb)
+		return;
+
+	ieee802154_rx_irqsafe(priv->dev, newskb, lqi);
+}
+
+static void
+hw_ack(struct fake_dev_priv *priv, u8 seq)
+{
+	struct sk_buff *skb;
+	u16 crc;
+	u8 *data;
+
+	skb = alloc_skb(5, GFP_ATOMIC);
+	if (!skb)
+		return;
+
+	data = skb_put(skb, 5);
+	data[0] = IEEE802154_FC_TYPE_ACK;
+	data[1] = 0;
+	data[2] = seq;
+	crc = crc_ccitt(0, data, 3);
+	data[3] = crc & 0xff;
+	data[4] = crc >> 8;
+
+	hw_deliver(priv, skb, FAKE_DEFAULT_LQI);
+	kfree_skb(skb);
+}
+
+/* Does the frame carry the address dp listens on? */
+static bool fake_addressed(struct fake_dev_priv *dp, struct sk_buff *skb)
+{
+	struct ieee802154_hw_addr_filt *filt = &dp->dev->hw_filt;
+	u16 fc, pan_id;
+	int i;
+
+	if (skb->len < 3)
+		return false;
+
+	fc = skb->data[0] | (skb->data[1] << 8);
+
+	switch (IEEE802154_FC_DAMODE(fc)) {
+	case IEEE802154_ADDR_NONE:
+		/* Frames without destination go to the PAN coordinator */
+		return filt->pan_coord;
+	case IEEE802154_ADDR_SHORT:
+		if (skb->len < 7)
+			return false;
+		pan_id = skb->data[3] | (skb->data[4] << 8);
+		if (pan_id != filt->pan_id &&
+		    pan_id != IEEE802154_PANID_BROADCAST)
+			return false;
+		return (skb->data[5] | (skb->data[6] << 8)) ==
+			filt->short_addr;
+	case IEEE802154_ADDR_LONG:
+		if (skb->len < 5 + IEEE802154_ADDR_LEN)
+			return false;
+		pan_id = skb->data[3] | (skb->data[4] << 8);
+		if (pan_id != filt->pan_id &&
+		    pan_id != IEEE802154_PANID_BROADCAST)
+			return false;
+		/* Sent in reverse order */
+		for (i = 0; i < IEEE802154_ADDR_LEN; i++)
+			if (skb->data[5 + i] !=
+			    filt->ieee_addr[IEEE802154_ADDR_LEN - 1 - i])
+				return false;
+		return true;
+	default:
+		return false;
+	}
+}
+
+static int fake_rcpt_add(struct fake_dev_priv *priv, struct fake_dev_priv *dp,
+		ktime_t now, ktime_t end, u8 lqi, u8 loss,
+		struct fake_rcpt *rcpt)
+{
+	if (dp->dev->phy->current_channel != priv->dev->phy->current_channel)
+		return 0;
+
+	if (!fake_rx_start(dp, now, end, lqi, &rcpt->seq))
+		return 0;
 
-	ieee802154_rx_irqsafe(priv->dev, newskb, 0xcc);
+	rcpt->dp = dp;
+	rcpt->lqi = lqi;
+	rcpt->loss = loss;
+
+	return 1;
 }
 
 static int
@@ -80,23 +292,86 @@ hw_xmit(struct ieee802154_dev *dev, struct sk_buff *skb)
 {
 	struct fake_dev_priv *priv = dev->priv;
 	struct fake_priv *fake = priv->fake;
+	struct fake_rcpt *rcpt;
+	ktime_t now, end;
+	unsigned int max;
+	u32 seq;
+	int i, n = 0;
+	bool acked = false;
 
 	might_sleep();
 
+	/*
+	 * Only as many as the links, or the devices while there are none.
+	 * Counts read without the lock only size the buffer, the loops
+	 * below stop at max.
+	 */
+	max = list_empty(&priv->links) ? fake->count : priv->n_links;
+	if (max > priv->rcpt_max) {
+		rcpt = kmalloc(max * sizeof(*rcpt), GFP_KERNEL);
+		if (!rcpt)
+			return -ENOMEM;
+		kfree(priv->rcpt);
+		priv->rcpt = rcpt;
+		priv->rcpt_max = max;
+	}
+	rcpt = priv->rcpt;
+	max = priv->rcpt_max;
+
 	read_lock_bh(&fake->lock);
+	now = ktime_get();
+	end = ktime_add_ns(now,
+		(u64)(skb->len + FAKE_PHY_OVERHEAD) * FAKE_OCTET_NS);
+
 	if (priv->list.next == priv->list.prev) {
 		/* we are the only one device */
-		hw_deliver(priv, skb);
-	} else {
+		n += fake_rcpt_add(priv, priv, now, end,
+				FAKE_DEFAULT_LQI, 0, &rcpt[n]);
+	} else if (list_empty(&priv->links)) {
 		struct fake_dev_priv *dp;
 		list_for_each_entry(dp, &priv->fake->list, list)
-			if (dp != priv &&
-			    dp->dev->phy->current_channel ==
-					priv->dev->phy->current_channel)
-				hw_deliver(dp, skb);
+			if (dp != priv && n < max)
+				n += fake_rcpt_add(priv, dp, now, end,
+						FAKE_DEFAULT_LQI, 0, &rcpt[n]);
+	} else {
+		struct fake_link *link;
+		list_for_each_entry(link, &priv->links, list)
+			if (n < max)
+				n += fake_rcpt_add(priv, link->to, now, end,
+						link->lqi, link->loss, &rcpt[n]);
+	}
+
+	/* We can't receive while sending */
+	if (priv->list.next != priv->list.prev)
+		fake_rx_start(priv, now, end, 0, &seq);
+	read_unlock_bh(&fake->lock);
+
+	set_current_state(TASK_UNINTERRUPTIBLE);
+	schedule_hrtimeout(&end, HRTIMER_MODE_ABS);
+
+	read_lock_bh(&fake->lock);
+	for (i = 0; i < n; i++) {
+		if (!fake_rx_end(rcpt[i].dp, rcpt[i].seq))
+			continue;
+		if (rcpt[i].loss && random32() % 100 < rcpt[i].loss)
+			continue;
+		hw_deliver(rcpt[i].dp, skb, rcpt[i].lqi);
+		if (rcpt[i].dp->working && fake_addressed(rcpt[i].dp, skb))
+			acked = true;
 	}
 	read_unlock_bh(&fake->lock);
 
+	if (acked && (skb->data[0] & IEEE802154_FC_ACK_REQ))
+		hw_ack(priv, skb->data[2]);
+
+	return 0;
+}
+
+/* The stack keeps dev->hw_filt up to date, fake_addressed() reads it */
+static int
+hw_addr_filt(struct ieee802154_dev *dev, struct ieee802154_hw_addr_filt *filt,
+		unsigned long changed)
+{
 	return 0;
 }
 
@@ -123,7 +398,10 @@ static struct ieee802154_ops fake_ops = {
 	.owner = THIS_MODULE,
 	.xmit = hw_xmit,
 	.ed = hw_ed,
+	.cca = hw_cca,
+	.xmit_raw = hw_xmit,
 	.set_channel = hw_channel,
+	.set_hw_addr_filt = hw_addr_filt,
 	.start = hw_start,
 	.stop = hw_stop,
 };
@@ -174,6 +452,8 @@ static int ieee802154fake_add_priv(struct device *dev, struct fake_priv *fake)
 
 
 	INIT_LIST_HEAD(&priv->list);
+	INIT_LIST_HEAD(&priv->links);
+	spin_lock_init(&priv->rx_lock);
 	priv->fake = fake;
 
 	ieee->parent = dev;
@@ -184,6 +464,7 @@ static int ieee802154fake_add_priv(struct device *dev, struct fake_priv *fake)
 
 	write_lock_bh(&fake->lock);
 	list_add_tail(&priv->list, &fake->list);
+	fake->count++;
 	write_unlock_bh(&fake->lock);
 
 	return 0;
@@ -194,14 +475,56 @@ err_alloc_dev:
 	return err;
 }
 
-static void ieee802154fake_del_priv(struct fake_dev_priv *priv)
+/* Called with fake->lock held for writing */
+static void ieee802154fake_unlink(struct fake_dev_priv *priv)
 {
-	write_lock_bh(&priv->fake->lock);
+	struct fake_dev_priv *dp;
+	struct fake_link *link, *tmp;
+
+	list_for_each_entry(dp, &priv->fake->list, list)
+		list_for_each_entry_safe(link, tmp, &dp->links, list)
+			if (dp == priv || link->to == priv) {
+				list_del(&link->list);
+				dp->n_links--;
+				kfree(link);
+			}
+
 	list_del(&priv->list);
-	write_unlock_bh(&priv->fake->lock);
+	priv->fake->count--;
+}
 
-	ieee802154_unregister_device(priv->dev);
-	ieee802154_free_device(priv->dev);
+/*
+ * Frames in flight point to the receiving devices, so stop all of them
+ * before anything is freed.
+ */
+static void ieee802154fake_del_all(struct fake_priv *fake)
+{
+	struct fake_dev_priv *dp, *temp;
+
+	list_for_each_entry(dp, &fake->list, list)
+		ieee802154_unregister_device(dp->dev);
+
+	list_for_each_entry_safe(dp, temp, &fake->list, list) {
+		write_lock_bh(&fake->lock);
+		ieee802154fake_unlink(dp);
+		write_unlock_bh(&fake->lock);
+
+		kfree(dp->rcpt);
+		ieee802154_free_device(dp->dev);
+	}
+}
+
+/* Called with fake->lock held */
+static struct fake_dev_priv *
+ieee802154fake_find(struct fake_priv *fake, const char *name)
+{
+	struct fake_dev_priv *dp;
+
+	list_for_each_entry(dp, &fake->list, list)
+		if (!strcmp(wpan_phy_name(dp->dev->phy), name))
+			return dp;
+
+	return NULL;
 }
 
 static ssize_t
@@ -210,18 +533,126 @@ adddev_store(struct device *dev, struct device_attribute *attr,
 {
 	struct platform_device *pdev = to_platform_device(dev);
 	struct fake_priv *priv = platform_get_drvdata(pdev);
+	unsigned long count;
 	int err;
 
-	err = ieee802154fake_add_priv(dev, priv);
-	if (err)
-		return err;
+	/* Optionally the number of devices to add */
+	if (strict_strtoul(buf, 0, &count) || !count)
+		count = 1;
+
+	while (count--) {
+		err = ieee802154fake_add_priv(dev, priv);
+		if (err)
+			return err;
+	}
 	return n;
 }
 
 static DEVICE_ATTR(adddev, 0200, NULL, adddev_store);
 
+static ssize_t
+link_show(struct device *dev, struct device_attribute *attr, char *buf)
+{
+	struct platform_device *pdev = to_platform_device(dev);
+	struct fake_priv *fake = platform_get_drvdata(pdev);
+	struct fake_dev_priv *dp;
+	struct fake_link *link;
+	ssize_t len = 0;
+
+	read_lock_bh(&fake->lock);
+	list_for_each_entry(dp, &fake->list, list)
+		list_for_each_entry(link, &dp->links, list) {
+			len += snprintf(buf + len, PAGE_SIZE - len,
+					"%s %s %u %u\n",
+					wpan_phy_name(dp->dev->phy),
+					wpan_phy_name(link->to->dev->phy),
+					link->lqi, link->loss);
+			if (len >= PAGE_SIZE - 1) {
+				len = PAGE_SIZE - 1;
+				goto out;
+			}
+		}
+out:
+	read_unlock_bh(&fake->lock);
+
+	return len;
+}
+
+/*
+ * "<from> <to> <lqi> <loss %>" adds or updates the link from one phy
+ * to another, "-<from> <to>" removes it. Links are one way.
+ */
+static ssize_t
+link_store(struct device *dev, struct device_attribute *attr,
+	const char *buf, size_t n)
+{
+	struct platform_device *pdev = to_platform_device(dev);
+	struct fake_priv *fake = platform_get_drvdata(pdev);
+	struct fake_dev_priv *from, *to;
+	struct fake_link *link, *new;
+	char from_name[32], to_name[32];
+	unsigned int lqi = 0, loss = 0;
+	bool del = false;
+	int err = 0;
+
+	if (buf[0] == '-') {
+		if (sscanf(buf + 1, "%31s %31s", from_name, to_name) != 2)
+			return -EINVAL;
+		del = true;
+	} else if (sscanf(buf, "%31s %31s %u %u",
+				from_name, to_name, &lqi, &loss) != 4)
+		return -EINVAL;
+
+	if (lqi > 0xff || loss > 100)
+		return -EINVAL;
+
+	new = kzalloc(sizeof(*new), GFP_KERNEL);
+	if (!new)
+		return -ENOMEM;
+
+	write_lock_bh(&fake->lock);
+	from = ieee802154fake_find(fake, from_name);
+	to = ieee802154fake_find(fake, to_name);
+	if (!from || !to || from == to) {
+		err = -ENODEV;
+		goto out;
+	}
+
+	list_for_each_entry(link, &from->links, list)
+		if (link->to == to)
+			break;
+
+	if (&link->list == &from->links) {
+		if (del) {
+			err = -ENOENT;
+			goto out;
+		}
+		link = new;
+		new = NULL;
+		link->to = to;
+		list_add_tail(&link->list, &from->links);
+		from->n_links++;
+	} else if (del) {
+		list_del(&link->list);
+		from->n_links--;
+		kfree(link);
+		goto out;
+	}
+
+	link->lqi = lqi;
+	link->loss = loss;
+out:
+	write_unlock_bh(&fake->lock);
+	kfree(new);
+
+	return err ? err : n;
+}
+
+static DEVICE_ATTR(link, 0600, link_show, link_store);
+
 static struct attribute *fake_attrs[] = {
 	&dev_attr_adddev.attr,
+	&dev_attr_link.attr,
 	NULL,
 };
 
@@ -234,7 +665,6 @@ static struct attribute_group fake_group = {
 static int __devinit ieee802154fake_probe(struct platform_device *pdev)
 {
 	struct fake_priv *priv;
-	struct fake_dev_priv *dp;
 
 	int err = -ENOMEM;
 	priv = kzalloc(sizeof(struct fake_priv), GFP_KERNEL);
@@ -244,6 +674,8 @@ static int __devinit ieee802154fake_probe(struct platform_device *pdev)
 	INIT_LIST_HEAD(&priv->list);
 	rwlock_init(&priv->lock);
 
+	platform_set_drvdata(pdev, priv);
+
 	err = sysfs_create_group(&pdev->dev.kobj, &fake_group);
 	if (err)
 		goto err_grp;
@@ -252,14 +684,12 @@ static int __devinit ieee802154fake_probe(struct platform_device *pdev)
 	if (err < 0)
 		goto err_slave;
 
-	platform_set_drvdata(pdev, priv);
 	dev_info(&pdev->dev, "Added ieee802154 hardware\n");
 	return 0;
 
 err_slave:
-	list_for_each_entry(dp, &priv->list, list)
-		ieee802154fake_del_priv(dp);
 	sysfs_remove_group(&pdev->dev.kobj, &fake_group);
+	ieee802154fake_del_all(priv);
 err_grp:
 	kfree(priv);
 err_alloc:
@@ -269,11 +699,9 @@ err_alloc:
 static int __devexit ieee802154fake_remove(struct platform_device *pdev)
 {
 	struct fake_priv *priv = platform_get_drvdata(pdev);
-	struct fake_dev_priv *dp, *temp;
 
-	list_for_each_entry_safe(dp, temp, &priv->list, list)
-		ieee802154fake_del_priv(dp);
 	sysfs_remove_group(&pdev->dev.kobj, &fake_group);
+	ieee802154fake_del_all(priv);
 	kfree(priv);
 	return 0;
 }
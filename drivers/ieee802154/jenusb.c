@@ -61,6 +61,10 @@ struct jenusb {
 	bool                 running;
 
 	atomic_t             panid, shortaddr;
+
+	struct wpan_phy      *phy;
+	bool                 started;          /* start below is valid */
+	MAC_MlmeReqStart_s   start;            /* last successful start request */
 };
 
 struct cdc_ieee802154_desc {
@@ -210,6 +214,73 @@ jenusb_get_short_addr(const struct net_device *net)
 	return atomic_read(&dev->shortaddr);
 }
 
+static struct wpan_phy *
+jenusb_get_phy(const struct net_device *net)
+{
+	struct jenusb *dev = netdev_priv(net);
+	BUG_ON(net->type != ARPHRD_IEEE802154);
+	return to_phy(get_device(&dev->phy->dev));
+}
+
+/* mirrors the channel the device has been put on into the PHY PIB */
+static void
+jenusb_phy_update(struct jenusb *dev, u8 channel)
+{
+	struct wpan_phy *phy = dev->phy;
+
+	mutex_lock(&phy->pib_lock);
+	if (phy->current_channel != channel)
+		wpan_phy_stats_inc(phy, channel_switches);
+	phy->current_channel = channel;
+	phy->current_page = 0;
+	mutex_unlock(&phy->pib_lock);
+}
+
+/* called with the pib_lock of the phy held */
+static int
+jenusb_phy_set_channel(struct wpan_phy *phy, u8 page, u8 channel)
+{
+	struct jenusb *dev = *(struct jenusb **) wpan_phy_priv(phy);
+	struct jenusb_req *req = &dev->req;
+	struct jenusb_cfm *cfm = &dev->cfm;
+	int retval;
+
+	if (page != 0)
+		return -EINVAL;
+
+	retval = mutex_lock_interruptible(&dev->transaction);
+	if (retval) return retval;
+
+	/* not running a PAN, the next start or associate request tunes the
+	 * radio anyway */
+	if (!dev->started)
+		goto out;
+
+	/* the jennic SAP has no PHY PIB access, so move the running PAN
+	 * with a coordinator realignment instead of restarting it */
+	req->type = MAC_SAP_MLME;
+	req->mlme.u8Type = MAC_MLME_REQ_START;
+	req->mlme.u8ParamLength = sizeof(MAC_MlmeReqStart_s);
+	req->mlme.sReqStart = dev->start;
+	req->mlme.sReqStart.u8Channel = channel;
+	req->mlme.sReqStart.u8Realignment = true;
+
+	retval = jenusb_post_req(dev, req, cfm);
+
+	if (retval) {
+		// nothing to be done
+	} else if (jenusb_chk_err(cfm, sCfmStart)) {
+		retval = -EIO;
+	} else {
+		dev->start.u8Channel = channel;
+		wpan_phy_stats_inc(phy, channel_switches);
+	}
+
+out:
+	mutex_unlock(&dev->transaction);
+	return retval;
+}
+
 static int
 jenusb_set_panid(const struct net_device *net, u16 panid) {
 	struct jenusb *dev = netdev_priv(net);
@@ -314,6 +385,10 @@ jenusb_assoc_req(struct net_device *net, struct ieee802154_addr *coord,
 	}
 
 	mutex_unlock(&dev->transaction);
+
+	if (!retval)
+		jenusb_phy_update(dev, channel);
+
 	return retval;
 }
 
@@ -402,7 +477,7 @@ jenusb_start_req(struct net_device *net, struct ieee802154_addr *addr,
 	/* when we get started as a coordinator, the jennic chip switches to
 	 * the IEEE 802.15.4 coord short addr (0x0000) */
 	if (pan_coord) retval = jenusb_set_short_addr(net, 0x0000);
-	if (retval) goto err;
+	if (retval) return retval;
 
 	retval = mutex_lock_interruptible(&dev->transaction);
 	if (retval) return retval;
@@ -425,10 +500,16 @@ jenusb_start_req(struct net_device *net, struct ieee802154_addr *addr,
 		// nothing to be done
 	} else if (jenusb_chk_err(cfm, sCfmStart)) {
 		retval = -EIO;
+	} else {
+		dev->start = req->mlme.sReqStart;
+		dev->started = true;
 	}
 
-err:
 	mutex_unlock(&dev->transaction);
+
+	if (!retval)
+		jenusb_phy_update(dev, channel);
+
 	return retval;
 }
 
@@ -470,6 +551,7 @@ static struct ieee802154_mlme_ops jenusb_mlme_ops = {
 	.start_req = 		jenusb_start_req,
 	.scan_req = 		jenusb_scan_req,
 
+	.get_phy = 		jenusb_get_phy,
 	.get_pan_id = 		jenusb_get_pan_id,
 	.get_short_addr = 	jenusb_get_short_addr,
 	.get_dsn = 		jenusb_get_dsn,
@@ -749,6 +831,7 @@ jenusb_net_open(struct net_device *net) {
 	req->mlme.sReqReset.u8SetDefaultPib = false;
 
 	dev->running = true;
+	dev->started = false;
 	retval = jenusb_post_req(dev, req, cfm);
 
 	if (retval) {
@@ -780,6 +863,7 @@ static int
 jenusb_net_close(struct net_device *net) {
 	struct jenusb *dev = netdev_priv(net);
 	dev->running = false;
+	dev->started = false;
 	netif_stop_queue(net);
 	flush_workqueue(dev->workqueue);
 	return 0;
@@ -970,6 +1054,17 @@ jenusb_release(struct kref *kref)
 		destroy_workqueue(dev->workqueue);
 	}
 
+	if (dev->phy) {
+		/* netlink may still hold a reference to the phy */
+		mutex_lock(&dev->phy->pib_lock);
+		dev->phy->set_channel = NULL;
+		mutex_unlock(&dev->phy->pib_lock);
+
+		if (device_is_registered(&dev->phy->dev))
+			wpan_phy_unregister(dev->phy);
+		wpan_phy_free(dev->phy);
+	}
+
 	usb_put_dev(dev->udev);
 	free_netdev(dev->net);
 }
@@ -1113,13 +1208,34 @@ jenusb_probe(struct usb_interface *interface, const struct usb_device_id *prod)
 		goto error;
 	}
 
+	/* the phy pib as set up by the jennic MAC after a reset */
+	dev->phy = wpan_phy_alloc(sizeof(dev));
+	if (!dev->phy) {
+		retval = -ENOMEM;
+		goto error;
+	}
+
+	*(struct jenusb **) wpan_phy_priv(dev->phy) = dev;
+	dev->phy->channels_supported[0] = PHY_PIB_CHANNELS_SUPPORTED_DEF;
+	dev->phy->current_channel = PHY_PIB_CURRENT_CHANNEL_DEF;
+	dev->phy->transmit_power = PHY_PIB_TX_POWER_DEF;
+	dev->phy->cca_mode = PHY_PIB_CCA_MODE_DEF;
+	dev->phy->set_channel = jenusb_phy_set_channel;
+	wpan_phy_set_dev(dev->phy, &interface->dev);
+
+	retval = wpan_phy_register(dev->phy);
+	if (retval < 0) {
+		err("unable to register wpan phy");
+		goto error;
+	}
+
 	/* register our ops */
 	net->netdev_ops = &jenusb_net_ops;
 	net->ml_priv = &jenusb_mlme_ops;
 
 	/* save our data pointers  */
 	usb_set_intfdata(interface, dev);
-	SET_NETDEV_DEV(net, &interface->dev);
+	SET_NETDEV_DEV(net, &dev->phy->dev);
 
 	/* create pipes */
 	dev->in = usb_rcvbulkpipe(interface_to_usbdev(interface), bulkinep);
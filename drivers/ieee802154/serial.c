@@ -31,6 +31,8 @@
 #include <linux/tty.h>
 #include <linux/skbuff.h>
 #include <linux/sched.h>
+#include <linux/spinlock.h>
+#include <linux/crc-ccitt.h>
 #include <net/mac802154.h>
 #include <net/wpan-phy.h>
 
@@ -57,6 +59,16 @@
 
 #define STATUS_WAIT	((u8) -1) /* waiting for the answer */
 
+/* Feature bits reported by RESP_GET_FEATURES */
+#define FEATURE_XMIT_CCA	(1 << 0)
+#define FEATURE_RECV_CRC	(1 << 1)
+
+/* Number of DATA_XMIT_CCA_BLOCK commands we keep in flight */
+#define TX_WINDOW	4
+/* 2 start bytes, id, seq and len */
+#define XMIT_CCA_HDR_LEN	5
+#define TX_BUF_SIZE	(TX_WINDOW * (XMIT_CCA_HDR_LEN + MAX_DATA_SIZE))
+
 /* We re-use PPP ioctl for our purposes */
 #define	PPPIOCGUNIT	_IOR('t', 86, int)	/* get ppp unit number */
 
@@ -64,6 +76,18 @@
  * The following messages are used to control ZigBee firmware.
  * All communication has request/response format,
  * except of asynchronous incoming data stream (DATA_RECV_* messages).
+ *
+ * Firmware answering CMD_GET_FEATURES with FEATURE_XMIT_CCA set also
+ * accepts DATA_XMIT_CCA_BLOCK: it performs CCA, sends the frame and
+ * returns to RX on its own. These carry a sequence number echoed in
+ * RESP_XMIT_CCA_BLOCK, so up to TX_WINDOW of them may be outstanding
+ * while other commands are still processed one at a time. Older
+ * firmware does not answer CMD_GET_FEATURES and is driven with the
+ * CMD_CCA, CMD_SET_STATE, DATA_XMIT_BLOCK sequence.
+ *
+ * Firmware with FEATURE_RECV_CRC switches to DATA_RECV_CRC_BLOCK once it
+ * has answered CMD_GET_FEATURES. It is DATA_RECV_BLOCK followed by the
+ * little-endian CRC-CCITT of the id, lq, len and data octets.
  */
 enum {
 	NO_ID			= 0, /* means no pending id */
@@ -77,6 +101,8 @@ enum {
 	CMD_SET_STATE		= 0x07, /* u8 id, u8 flag */
 	DATA_XMIT_BLOCK		= 0x09, /* u8 id, u8 len, u8 data[len] */
 	RESP_RECV_BLOCK		= 0x0b, /* u8 id, u8 status */
+	CMD_GET_FEATURES	= 0x0c, /* u8 id */
+	DATA_XMIT_CCA_BLOCK	= 0x0d, /* u8 id, u8 seq, u8 len, u8 data[len] */
 
 	/* Firmware to Driver */
 	RESP_OPEN		= 0x81, /* u8 id, u8 status */
@@ -87,6 +113,10 @@ enum {
 	RESP_SET_STATE		= 0x87, /* u8 id, u8 status */
 	RESP_XMIT_BLOCK		= 0x89, /* u8 id, u8 status */
 	DATA_RECV_BLOCK		= 0x8b, /* u8 id, u8 lq, u8 len, u8 data[len] */
+	RESP_GET_FEATURES	= 0x8c, /* u8 id, u8 status, u8 features */
+	RESP_XMIT_CCA_BLOCK	= 0x8d, /* u8 id, u8 seq, u8 status */
+	DATA_RECV_CRC_BLOCK	= 0x8e, /* u8 id, u8 lq, u8 len, u8 data[len],
+					   u16 crc */
 };
 
 enum {
@@ -95,7 +125,9 @@ enum {
 	STATE_WAIT_COMMAND,
 	STATE_WAIT_PARAM1,
 	STATE_WAIT_PARAM2,
-	STATE_WAIT_DATA
+	STATE_WAIT_DATA,
+	STATE_WAIT_CRC1,
+	STATE_WAIT_CRC2
 };
 
 struct zb_device {
@@ -114,10 +146,21 @@ struct zb_device {
 	/* Internal state */
 	struct completion	open_done;
 	unsigned char		opened;
+	unsigned char		probed;
+	u8			features;
 	u8			pending_id;
 	unsigned int		pending_size;
 	u8			*pending_data;
 	/* FIXME: WE NEED LOCKING!!! */
+	u8			cmd_buf[4 + MAX_DATA_SIZE];
+
+	/* Pipelined transmission, see DATA_XMIT_CCA_BLOCK */
+	spinlock_t		tx_lock;
+	u8			tx_seq; /* next sequence number to use */
+	int			tx_outstanding;
+	unsigned int		tx_head;
+	unsigned int		tx_len;
+	u8			tx_buf[TX_BUF_SIZE];
 
 	/* Command (rx) processing */
 	int			state;
@@ -125,24 +168,47 @@ struct zb_device {
 	unsigned char		param1;
 	unsigned char		param2;
 	unsigned char		index;
-	unsigned char		data[MAX_DATA_SIZE];
+	u16			crc;
+	/* preallocated buffer for the next received frame */
+	struct sk_buff		*rx_skb;
 };
 
 /*****************************************************************************
  * ZigBee serial device protocol handling
  *****************************************************************************/
 static int _open_dev(struct zb_device *zbdev);
+static void _probe_features(struct zb_device *zbdev);
+
+static void
+_clear_pending(struct zb_device *zbdev)
+{
+	zbdev->pending_id = 0;
+	zbdev->pending_data = NULL;
+	zbdev->pending_size = 0;
+}
 
 static int
 _send_pending_data(struct zb_device *zbdev)
 {
 	struct tty_struct *tty;
+	unsigned long flags;
 
 	BUG_ON(!zbdev);
 	tty = zbdev->tty;
 	if (!tty)
 		return -ENODEV;
 
+	/* Commands must not overtake the frames in flight */
+	if (zbdev->tx_outstanding &&
+	    wait_event_interruptible_timeout(zbdev->wq,
+				!zbdev->tx_outstanding,
+				msecs_to_jiffies(1000)) <= 0) {
+		printk(KERN_ERR "%s: transmission did not finish\n", __func__);
+		spin_lock_irqsave(&zbdev->tx_lock, flags);
+		zbdev->tx_outstanding = 0;
+		spin_unlock_irqrestore(&zbdev->tx_lock, flags);
+	}
+
 	zbdev->status = STATUS_WAIT;
 
 	/* Debug info */
@@ -191,13 +257,7 @@ send_cmd(struct zb_device *zbdev, u8 id)
 
 	zbdev->pending_id = id;
 	zbdev->pending_size = len;
-	zbdev->pending_data = kzalloc(zbdev->pending_size, GFP_KERNEL);
-	if (!zbdev->pending_data) {
-		printk(KERN_ERR "%s(): unable to allocate memory\n", __func__);
-		zbdev->pending_id = 0;
-		zbdev->pending_size = 0;
-		return -ENOMEM;
-	}
+	zbdev->pending_data = zbdev->cmd_buf;
 	memcpy(zbdev->pending_data, buf, len);
 
 	return _send_pending_data(zbdev);
@@ -233,18 +293,105 @@ send_cmd2(struct zb_device *zbdev, u8 id, u8 extra)
 
 	zbdev->pending_id = id;
 	zbdev->pending_size = len;
-	zbdev->pending_data = kzalloc(zbdev->pending_size, GFP_KERNEL);
-	if (!zbdev->pending_data) {
-		printk(KERN_ERR "%s(): unable to allocate memory\n", __func__);
-		zbdev->pending_id = 0;
-		zbdev->pending_size = 0;
-		return -ENOMEM;
-	}
+	zbdev->pending_data = zbdev->cmd_buf;
 	memcpy(zbdev->pending_data, buf, len);
 
 	return _send_pending_data(zbdev);
 }
 
+/*
+ * Write as much of the queued DATA_XMIT_CCA_BLOCK commands as the tty
+ * accepts, the rest goes from ieee802154_tty_wakeup.
+ */
+static void
+serial_tx_push(struct zb_device *zbdev)
+{
+	struct tty_struct *tty = zbdev->tty;
+	unsigned long flags;
+	int n;
+
+	if (!tty)
+		return;
+
+	spin_lock_irqsave(&zbdev->tx_lock, flags);
+	if (zbdev->tx_len) {
+		set_bit(TTY_DO_WRITE_WAKEUP, &tty->flags);
+		n = tty->ops->write(tty, zbdev->tx_buf + zbdev->tx_head,
+				zbdev->tx_len);
+		if (n > 0) {
+			zbdev->tx_head += n;
+			zbdev->tx_len -= n;
+		}
+	}
+	if (!zbdev->tx_len) {
+		zbdev->tx_head = 0;
+		clear_bit(TTY_DO_WRITE_WAKEUP, &tty->flags);
+	}
+	spin_unlock_irqrestore(&zbdev->tx_lock, flags);
+}
+
+static int
+send_xmit_cca_block(struct zb_device *zbdev, u8 len, u8 *data)
+{
+	unsigned long flags;
+	u8 *buf;
+
+	spin_lock_irqsave(&zbdev->tx_lock, flags);
+
+	if (zbdev->tx_head + zbdev->tx_len + XMIT_CCA_HDR_LEN + len >
+			TX_BUF_SIZE) {
+		memmove(zbdev->tx_buf, zbdev->tx_buf + zbdev->tx_head,
+				zbdev->tx_len);
+		zbdev->tx_head = 0;
+	}
+	/* Can't happen, the window limits the amount of unsent data */
+	if (WARN_ON(zbdev->tx_len + XMIT_CCA_HDR_LEN + len > TX_BUF_SIZE)) {
+		spin_unlock_irqrestore(&zbdev->tx_lock, flags);
+		return -ENOBUFS;
+	}
+
+	buf = zbdev->tx_buf + zbdev->tx_head + zbdev->tx_len;
+	buf[0] = START_BYTE1;
+	buf[1] = START_BYTE2;
+	buf[2] = DATA_XMIT_CCA_BLOCK;
+	buf[3] = zbdev->tx_seq++;
+	buf[4] = len;
+	memcpy(buf + XMIT_CCA_HDR_LEN, data, len);
+
+	zbdev->tx_len += XMIT_CCA_HDR_LEN + len;
+	zbdev->tx_outstanding++;
+
+	spin_unlock_irqrestore(&zbdev->tx_lock, flags);
+
+	serial_tx_push(zbdev);
+
+	return 0;
+}
+
+static void
+process_xmit_cca_resp(struct zb_device *zbdev)
+{
+	/* zbdev->param1 is seq, zbdev->param2 is status */
+	unsigned long flags;
+	int left;
+
+	spin_lock_irqsave(&zbdev->tx_lock, flags);
+	/* Responses come in order, everything sent before seq is done */
+	left = (u8)(zbdev->tx_seq - zbdev->param1 - 1);
+	if (left < zbdev->tx_outstanding)
+		zbdev->tx_outstanding = left;
+	else
+		pr_debug("%s(): stray response, seq %u\n", __func__,
+				zbdev->param1);
+	spin_unlock_irqrestore(&zbdev->tx_lock, flags);
+
+	if (zbdev->param2 != STATUS_SUCCESS)
+		pr_debug("%s(): frame %u failed, status %u\n", __func__,
+				zbdev->param1, zbdev->param2);
+
+	wake_up(&zbdev->wq);
+}
+
 static int
 send_block(struct zb_device *zbdev, u8 len, u8 *data)
 {
@@ -273,13 +420,7 @@ send_block(struct zb_device *zbdev, u8 len, u8 *data)
 
 	zbdev->pending_id = DATA_XMIT_BLOCK;
 	zbdev->pending_size = i + len;
-	zbdev->pending_data = kzalloc(zbdev->pending_size, GFP_KERNEL);
-	if (!zbdev->pending_data) {
-		printk(KERN_ERR "%s(): unable to allocate memory\n", __func__);
-		zbdev->pending_id = 0;
-		zbdev->pending_size = 0;
-		return -ENOMEM;
-	}
+	zbdev->pending_data = zbdev->cmd_buf;
 	memcpy(zbdev->pending_data, buf, i);
 	memcpy(zbdev->pending_data + i, data, len);
 
@@ -309,6 +450,9 @@ is_command(unsigned char c)
 	case RESP_SET_STATE:
 	case RESP_XMIT_BLOCK:
 	case DATA_RECV_BLOCK:
+	case RESP_GET_FEATURES:
+	case RESP_XMIT_CCA_BLOCK:
+	case DATA_RECV_CRC_BLOCK:
 		return 1;
 	}
 	return 0;
@@ -331,25 +475,78 @@ _match_pending_id(struct zb_device *zbdev)
 			RESP_SET_STATE == zbdev->id) ||
 		(DATA_XMIT_BLOCK == zbdev->pending_id &&
 			RESP_XMIT_BLOCK == zbdev->id) ||
-		DATA_RECV_BLOCK == zbdev->id);
+		(CMD_GET_FEATURES == zbdev->pending_id &&
+			RESP_GET_FEATURES == zbdev->id));
+}
+
+static int
+is_recv_block(unsigned char id)
+{
+	return DATA_RECV_BLOCK == id || DATA_RECV_CRC_BLOCK == id;
+}
+
+/* Get an empty skb for the frame being received, called before its data */
+static void
+serial_rx_prepare(struct zb_device *zbdev)
+{
+	if (zbdev->rx_skb)
+		skb_trim(zbdev->rx_skb, 0);
+	else
+		zbdev->rx_skb = dev_alloc_skb(MAX_DATA_SIZE);
+
+	if (!zbdev->rx_skb)
+		pr_debug("%s(): no memory, dropping frame\n", __func__);
 }
 
 static void serial_net_rx(struct zb_device *zbdev)
 {
 	/* zbdev->param1 is LQI
 	 * zbdev->param2 is length of data
-	 * zbdev->data is data itself
+	 * zbdev->rx_skb holds data itself
 	 */
-	struct sk_buff *skb;
-	skb = alloc_skb(zbdev->param2, GFP_ATOMIC);
-	skb_put(skb, zbdev->param2);
-	skb_copy_to_linear_data(skb, zbdev->data, zbdev->param2);
+	struct sk_buff *skb = zbdev->rx_skb;
+
+	if (!skb)
+		return;
+
+	if (DATA_RECV_CRC_BLOCK == zbdev->id) {
+		u8 hdr[3] = { zbdev->id, zbdev->param1, zbdev->param2 };
+		u16 crc = crc_ccitt(0, hdr, sizeof(hdr));
+
+		crc = crc_ccitt(crc, skb->data, skb->len);
+		if (crc != zbdev->crc) {
+			pr_debug("%s(): CRC mismatch, dropping frame\n",
+					__func__);
+			return;
+		}
+	}
+
+	/* The next frame goes to a fresh buffer */
+	zbdev->rx_skb = NULL;
 	ieee802154_rx_irqsafe(zbdev->dev, skb, zbdev->param1);
+	zbdev->rx_skb = dev_alloc_skb(MAX_DATA_SIZE);
 }
 
 static void
 process_command(struct zb_device *zbdev)
 {
+	/* Pipelined transmissions are not tracked by pending_id */
+	if (RESP_XMIT_CCA_BLOCK == zbdev->id) {
+		process_xmit_cca_resp(zbdev);
+		return;
+	}
+
+	/* Incoming data doesn't affect the pending command */
+	if (is_recv_block(zbdev->id)) {
+		if (!zbdev->opened)
+			return;
+		pr_debug("Received block, lqi %02x, len %02x\n",
+				zbdev->param1, zbdev->param2);
+		/* zbdev->param1 is LQ, zbdev->param2 is length */
+		serial_net_rx(zbdev);
+		return;
+	}
+
 	/* Command processing */
 	if (!_match_pending_id(zbdev))
 		return;
@@ -369,33 +566,37 @@ process_command(struct zb_device *zbdev)
 	if (!zbdev->opened)
 		return;
 
-	zbdev->pending_id = 0;
-	kfree(zbdev->pending_data);
-	zbdev->pending_data = NULL;
-	zbdev->pending_size = 0;
-	if (zbdev->id != DATA_RECV_BLOCK) {
-		/* XXX: w/around for old FW, REMOVE */
-		if (zbdev->param1 == STATUS_IDLE)
-			zbdev->status = STATUS_SUCCESS;
-		else
-			zbdev->status = zbdev->param1;
-	}
+	_clear_pending(zbdev);
+	/* XXX: w/around for old FW, REMOVE */
+	if (zbdev->param1 == STATUS_IDLE)
+		zbdev->status = STATUS_SUCCESS;
+	else
+		zbdev->status = zbdev->param1;
 
 	switch (zbdev->id) {
 	case RESP_ED:
 		zbdev->ed = zbdev->param2;
 		break;
-	case DATA_RECV_BLOCK:
-		pr_debug("Received block, lqi %02x, len %02x\n",
-				zbdev->param1, zbdev->param2);
-		/* zbdev->param1 is LQ, zbdev->param2 is length */
-		serial_net_rx(zbdev);
+	case RESP_GET_FEATURES:
+		zbdev->features = zbdev->param2;
 		break;
 	}
 
 	wake_up(&zbdev->wq);
 }
 
+/* All of the frame data has been received */
+static void
+process_data_done(struct zb_device *zbdev)
+{
+	if (DATA_RECV_CRC_BLOCK == zbdev->id)
+		zbdev->state = STATE_WAIT_CRC1;
+	else {
+		process_command(zbdev);
+		cleanup(zbdev);
+	}
+}
+
 static void
 process_char(struct zb_device *zbdev, unsigned char c)
 {
@@ -426,7 +627,9 @@ process_char(struct zb_device *zbdev, unsigned char c)
 
 	case STATE_WAIT_PARAM1:
 		zbdev->param1 = c;
-		if ((RESP_ED == zbdev->id) || (DATA_RECV_BLOCK == zbdev->id))
+		if ((RESP_ED == zbdev->id) || is_recv_block(zbdev->id) ||
+		    (RESP_GET_FEATURES == zbdev->id) ||
+		    (RESP_XMIT_CCA_BLOCK == zbdev->id))
 			zbdev->state = STATE_WAIT_PARAM2;
 		else {
 			process_command(zbdev);
@@ -436,32 +639,34 @@ process_char(struct zb_device *zbdev, unsigned char c)
 
 	case STATE_WAIT_PARAM2:
 		zbdev->param2 = c;
-		if (RESP_ED == zbdev->id) {
+		if ((RESP_ED == zbdev->id) || (RESP_GET_FEATURES == zbdev->id) ||
+		    (RESP_XMIT_CCA_BLOCK == zbdev->id)) {
 			process_command(zbdev);
 			cleanup(zbdev);
-		} else if (DATA_RECV_BLOCK == zbdev->id)
+		} else if (is_recv_block(zbdev->id)) {
+			if (zbdev->param2 > MAX_DATA_SIZE) {
+				printk(KERN_ERR "%s(): data size is greater "
+					"than buffer available\n", __func__);
+				cleanup(zbdev);
+				break;
+			}
+			serial_rx_prepare(zbdev);
 			zbdev->state = STATE_WAIT_DATA;
-		else
+			if (!zbdev->param2)
+				process_data_done(zbdev);
+		} else
 			cleanup(zbdev);
 		break;
 
-	case STATE_WAIT_DATA:
-		if (zbdev->index < sizeof(zbdev->data)) {
-			zbdev->data[zbdev->index] = c;
-			zbdev->index++;
-			/*
-			 * Pending data is received,
-			 * param2 is length for DATA_RECV_BLOCK
-			 */
-			if (zbdev->index == zbdev->param2) {
-				process_command(zbdev);
-				cleanup(zbdev);
-			}
-		} else {
-			printk(KERN_ERR "%s(): data size is greater "
-				"than buffer available\n", __func__);
-			cleanup(zbdev);
-		}
+	case STATE_WAIT_CRC1:
+		zbdev->crc = c;
+		zbdev->state = STATE_WAIT_CRC2;
+		break;
+
+	case STATE_WAIT_CRC2:
+		zbdev->crc |= c << 8;
+		process_command(zbdev);
+		cleanup(zbdev);
 		break;
 
 	default:
@@ -469,6 +674,40 @@ process_char(struct zb_device *zbdev, unsigned char c)
 	}
 }
 
+/*
+ * Consume as much of the input as possible in one step: skip garbage
+ * up to the start byte and copy frame data in bulk, only the few header
+ * octets go through process_char. Returns the number of bytes used.
+ */
+static int
+process_bytes(struct zb_device *zbdev, const unsigned char *buf, int count)
+{
+	const unsigned char *p;
+	int n;
+
+	switch (zbdev->state) {
+	case STATE_WAIT_START1:
+		p = memchr(buf, START_BYTE1, count);
+		if (!p)
+			return count;
+		zbdev->state = STATE_WAIT_START2;
+		return p - buf + 1;
+
+	case STATE_WAIT_DATA:
+		n = min_t(int, count, zbdev->param2 - zbdev->index);
+		if (zbdev->rx_skb)
+			memcpy(skb_put(zbdev->rx_skb, n), buf, n);
+		zbdev->index += n;
+		if (zbdev->index == zbdev->param2)
+			process_data_done(zbdev);
+		return n;
+
+	default:
+		process_char(zbdev, *buf);
+		return 1;
+	}
+}
+
 /*****************************************************************************
  * Device operations for IEEE 802.15.4 PHY side interface ZigBee stack
  *****************************************************************************/
@@ -499,13 +738,7 @@ static int _open_dev(struct zb_device *zbdev)
 
 	zbdev->pending_id = CMD_OPEN;
 	zbdev->pending_size = len;
-	zbdev->pending_data = kzalloc(zbdev->pending_size, GFP_KERNEL);
-	if (!zbdev->pending_data) {
-		printk(KERN_ERR "%s(): unable to allocate memory\n", __func__);
-		zbdev->pending_id = 0;
-		zbdev->pending_size = 0;
-		return -ENOMEM;
-	}
+	zbdev->pending_data = zbdev->cmd_buf;
 	memcpy(zbdev->pending_data, buf, len);
 
 	retries = 5;
@@ -519,10 +752,7 @@ static int _open_dev(struct zb_device *zbdev)
 		--retries;
 	}
 
-	zbdev->pending_id = 0;
-	kfree(zbdev->pending_data);
-	zbdev->pending_data = NULL;
-	zbdev->pending_size = 0;
+	_clear_pending(zbdev);
 
 	if (zbdev->opened) {
 		printk(KERN_INFO "Opened connection to device\n");
@@ -631,6 +861,8 @@ ieee802154_serial_start(struct ieee802154_dev *dev)
 	if (mutex_lock_interruptible(&zbdev->mutex))
 		return -EINTR;
 
+	_probe_features(zbdev);
+
 	ret = send_cmd2(zbdev, CMD_SET_STATE, RX_MODE);
 	if (ret)
 		goto out;
@@ -675,8 +907,115 @@ out:
 	pr_debug("%s end\n", __func__);
 }
 
+/* Wait for the answer to the pending command, called with mutex held */
 static int
-ieee802154_serial_xmit(struct ieee802154_dev *dev, struct sk_buff *skb)
+_wait_status_timeout(struct zb_device *zbdev, unsigned long timeout)
+{
+	if (wait_event_interruptible_timeout(zbdev->wq,
+				zbdev->status != STATUS_WAIT,
+				timeout) > 0) {
+		if (zbdev->status != STATUS_SUCCESS)
+			return -EBUSY;
+	} else {
+		_clear_pending(zbdev);
+		return -ETIMEDOUT;
+	}
+
+	return 0;
+}
+
+static int
+_wait_status(struct zb_device *zbdev)
+{
+	return _wait_status_timeout(zbdev, msecs_to_jiffies(1000));
+}
+
+/*
+ * Old firmware doesn't know CMD_GET_FEATURES and stays silent,
+ * so don't wait for too long.
+ */
+static void
+_probe_features(struct zb_device *zbdev)
+{
+	if (zbdev->probed)
+		return;
+
+	zbdev->features = 0;
+	if (send_cmd(zbdev, CMD_GET_FEATURES) ||
+	    _wait_status_timeout(zbdev, msecs_to_jiffies(200)))
+		zbdev->features = 0;
+
+	zbdev->probed = 1;
+
+	if (zbdev->features & FEATURE_XMIT_CCA) {
+		pr_debug("%s: firmware supports pipelined xmit\n",
+				wpan_phy_name(zbdev->dev->phy));
+		zbdev->dev->flags |= IEEE802154_HW_CSMA;
+	}
+}
+
+/* Queue the frame to the firmware doing CCA itself, called with mutex held */
+static int
+_xmit_cca(struct zb_device *zbdev, struct sk_buff *skb)
+{
+	unsigned long flags;
+
+	if (wait_event_interruptible_timeout(zbdev->wq,
+				zbdev->tx_outstanding < TX_WINDOW,
+				msecs_to_jiffies(1000)) <= 0) {
+		printk(KERN_ERR "%s: no response to pipelined xmit\n",
+				__func__);
+		spin_lock_irqsave(&zbdev->tx_lock, flags);
+		zbdev->tx_outstanding = 0;
+		spin_unlock_irqrestore(&zbdev->tx_lock, flags);
+		return -ETIMEDOUT;
+	}
+
+	return send_xmit_cca_block(zbdev, skb->len, skb->data);
+}
+
+static int
+_cca(struct zb_device *zbdev)
+{
+	int ret;
+
+	ret = send_cmd(zbdev, CMD_CCA);
+	if (ret)
+		return ret;
+
+	return _wait_status(zbdev);
+}
+
+static int
+_xmit_raw(struct zb_device *zbdev, struct sk_buff *skb)
+{
+	int ret;
+
+	ret = send_cmd2(zbdev, CMD_SET_STATE, TX_MODE);
+	if (ret)
+		return ret;
+
+	ret = _wait_status(zbdev);
+	if (ret)
+		return ret;
+
+	ret = send_block(zbdev, skb->len, skb->data);
+	if (ret)
+		return ret;
+
+	ret = _wait_status(zbdev);
+	if (ret)
+		return ret;
+
+	ret = send_cmd2(zbdev, CMD_SET_STATE, RX_MODE);
+	if (ret)
+		return ret;
+
+	return _wait_status(zbdev);
+}
+
+static int
+ieee802154_serial_cca(struct ieee802154_dev *dev)
 {
 	struct zb_device *zbdev;
 	int ret;
@@ -692,72 +1031,66 @@ ieee802154_serial_xmit(struct ieee802154_dev *dev, struct sk_buff *skb)
 	if (mutex_lock_interruptible(&zbdev->mutex))
 		return -EINTR;
 
-	ret = send_cmd(zbdev, CMD_CCA);
-	if (ret)
-		goto out;
+	ret = _cca(zbdev);
 
-	if (wait_event_interruptible_timeout(zbdev->wq,
-				zbdev->status != STATUS_WAIT,
-				msecs_to_jiffies(1000)) > 0) {
-		if (zbdev->status != STATUS_SUCCESS) {
-			ret = -EBUSY;
-			goto out;
-		}
-	} else {
-		ret = -ETIMEDOUT;
-		goto out;
+	mutex_unlock(&zbdev->mutex);
+	pr_debug("%s end\n", __func__);
+	return ret;
+}
+
+static int
+ieee802154_serial_xmit_raw(struct ieee802154_dev *dev, struct sk_buff *skb)
+{
+	struct zb_device *zbdev;
+	int ret;
+
+	pr_debug("%s\n", __func__);
+
+	zbdev = dev->priv;
+	if (NULL == zbdev) {
+		printk(KERN_ERR "%s: wrong phy\n", __func__);
+		return -EINVAL;
 	}
 
-	ret = send_cmd2(zbdev, CMD_SET_STATE, TX_MODE);
-	if (ret)
-		goto out;
+	if (mutex_lock_interruptible(&zbdev->mutex))
+		return -EINTR;
 
-	if (wait_event_interruptible_timeout(zbdev->wq,
-				zbdev->status != STATUS_WAIT,
-				msecs_to_jiffies(1000)) > 0) {
-		if (zbdev->status != STATUS_SUCCESS) {
-			ret = -EBUSY;
-			goto out;
-		}
-	} else {
-		ret = -ETIMEDOUT;
-		goto out;
+	ret = _xmit_raw(zbdev, skb);
+
+	mutex_unlock(&zbdev->mutex);
+	pr_debug("%s end\n", __func__);
+	return ret;
+}
+
+static int
+ieee802154_serial_xmit(struct ieee802154_dev *dev, struct sk_buff *skb)
+{
+	struct zb_device *zbdev;
+	int ret;
+
+	pr_debug("%s\n", __func__);
+
+	zbdev = dev->priv;
+	if (NULL == zbdev) {
+		printk(KERN_ERR "%s: wrong phy\n", __func__);
+		return -EINVAL;
 	}
 
-	ret = send_block(zbdev, skb->len, skb->data);
-	if (ret)
-		goto out;
+	if (mutex_lock_interruptible(&zbdev->mutex))
+		return -EINTR;
 
-	if (wait_event_interruptible_timeout(zbdev->wq,
-				zbdev->status != STATUS_WAIT,
-				msecs_to_jiffies(1000)) > 0) {
-		if (zbdev->status != STATUS_SUCCESS) {
-			ret = -EBUSY;
-			goto out;
-		}
-	} else {
-		ret = -ETIMEDOUT;
+	if (zbdev->features & FEATURE_XMIT_CCA) {
+		ret = _xmit_cca(zbdev, skb);
 		goto out;
 	}
 
-	ret = send_cmd2(zbdev, CMD_SET_STATE, RX_MODE);
+	ret = _cca(zbdev);
 	if (ret)
 		goto out;
 
-	if (wait_event_interruptible_timeout(zbdev->wq,
-				zbdev->status != STATUS_WAIT,
-				msecs_to_jiffies(1000)) > 0) {
-		if (zbdev->status != STATUS_SUCCESS) {
-			ret = -EBUSY;
-			goto out;
-		}
-	} else {
-		ret = -ETIMEDOUT;
-		goto out;
-	}
+	ret = _xmit_raw(zbdev, skb);
 
 out:
-
 	mutex_unlock(&zbdev->mutex);
 	pr_debug("%s end\n", __func__);
 	return ret;
@@ -770,6 +1103,8 @@ out:
 static struct ieee802154_ops serial_ops = {
 	.owner = THIS_MODULE,
 	.xmit		= ieee802154_serial_xmit,
+	.cca		= ieee802154_serial_cca,
+	.xmit_raw	= ieee802154_serial_xmit_raw,
 	.ed		= ieee802154_serial_ed,
 	.set_channel	= ieee802154_serial_set_channel,
 	.start		= ieee802154_serial_start,
@@ -802,6 +1137,7 @@ ieee802154_tty_open(struct tty_struct *tty)
 	zbdev->dev = dev;
 
 	mutex_init(&zbdev->mutex);
+	spin_lock_init(&zbdev->tx_lock);
 	init_completion(&zbdev->open_done);
 	init_waitqueue_head(&zbdev->wq);
 
@@ -815,6 +1151,7 @@ ieee802154_tty_open(struct tty_struct *tty)
 
 	zbdev->tty = tty_kref_get(tty);
 	cleanup(zbdev);
+	zbdev->rx_skb = dev_alloc_skb(MAX_DATA_SIZE);
 
 	tty->disc_data = zbdev;
 	tty->receive_room = MAX_DATA_SIZE;
@@ -843,6 +1180,7 @@ out_free:
 	tty->disc_data = NULL;
 	tty_kref_put(tty);
 	zbdev->tty = NULL;
+	kfree_skb(zbdev->rx_skb);
 
 	ieee802154_free_device(zbdev->dev);
 
@@ -876,6 +1214,7 @@ ieee802154_tty_close(struct tty_struct *tty)
 	tty_ldisc_flush(tty);
 	tty_driver_flush_buffer(tty);
 
+	kfree_skb(zbdev->rx_skb);
 	ieee802154_free_device(zbdev->dev);
 }
 
@@ -926,15 +1265,10 @@ ieee802154_tty_receive(struct tty_struct *tty, const unsigned char *buf,
 		char *cflags, int count)
 {
 	struct zb_device *zbdev;
-	int i;
+	int n;
 
 	/* Debug info */
-	printk(KERN_INFO "%s, received %d bytes\n", __func__,
-			count);
-#ifdef DEBUG
-	print_hex_dump_bytes("ieee802154_tty_receive ", DUMP_PREFIX_NONE,
-			buf, count);
-#endif
+	pr_debug("%s, received %d bytes\n", __func__, count);
 
 	/* Actual processing */
 	zbdev = tty->disc_data;
@@ -943,8 +1277,11 @@ ieee802154_tty_receive(struct tty_struct *tty, const unsigned char *buf,
 				__func__);
 		return;
 	}
-	for (i = 0; i < count; ++i)
-		process_char(zbdev, buf[i]);
+	while (count > 0) {
+		n = process_bytes(zbdev, buf, count);
+		buf += n;
+		count -= n;
+	}
 #if 0
 	if (tty->driver->flush_chars)
 		tty->driver->flush_chars(tty);
@@ -952,6 +1289,22 @@ ieee802154_tty_receive(struct tty_struct *tty, const unsigned char *buf,
 	tty_unthrottle(tty);
 }
 
+/*
+ * Called by the tty driver when there's room for more data.
+ */
+static void
+ieee802154_tty_wakeup(struct tty_struct *tty)
+{
+	struct zb_device *zbdev = tty->disc_data;
+
+	if (!zbdev) {
+		clear_bit(TTY_DO_WRITE_WAKEUP, &tty->flags);
+		return;
+	}
+
+	serial_tx_push(zbdev);
+}
+
 /*
  * Line discipline device structure
  */
@@ -963,6 +1316,7 @@ static struct tty_ldisc_ops ieee802154_ldisc = {
 	.close	= ieee802154_tty_close,
 	.hangup	= ieee802154_tty_hangup,
 	.receive_buf = ieee802154_tty_receive,
+	.write_wakeup = ieee802154_tty_wakeup,
 	.ioctl	= ieee802154_tty_ioctl,
 };
 
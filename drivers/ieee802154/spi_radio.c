@@ -0,0 +1,167 @@
+/*
+ * Frame buffer helpers shared by the SPI attached radio drivers
+ *
+ * Copyright 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Written by:
+ * agent <agent@local>
+ */
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/slab.h>
+#include <linux/skbuff.h>
+#include <linux/spi/spi.h>
+
+#include "spi_radio.h"
+
+static struct sk_buff *spi_radio_alloc(struct spi_radio *radio, gfp_t gfp)
+{
+	struct sk_buff *skb;
+
+	skb = __dev_alloc_skb(radio->hdr_len + radio->buf_size, gfp);
+	if (skb)
+		skb_reserve(skb, radio->hdr_len);
+
+	return skb;
+}
+
+static void spi_radio_refill(struct work_struct *work)
+{
+	struct spi_radio *radio =
+		container_of(work, struct spi_radio, refill_work);
+	struct sk_buff *skb;
+
+	while (skb_queue_len(&radio->pool) < radio->pool_size) {
+		skb = spi_radio_alloc(radio, GFP_KERNEL);
+		if (!skb)
+			break;
+		skb_queue_tail(&radio->pool, skb);
+	}
+}
+
+int spi_radio_init(struct spi_radio *radio, struct spi_device *spi,
+		const u8 *read_hdr, unsigned int hdr_len,
+		unsigned int buf_size, unsigned int pool_size)
+{
+	radio->spi = spi;
+	radio->hdr_len = hdr_len;
+	radio->buf_size = buf_size;
+	radio->pool_size = pool_size;
+
+	/* kmalloc'ed, so it is fine for DMA */
+	radio->read_cmd = kzalloc(hdr_len + buf_size, GFP_KERNEL);
+	if (!radio->read_cmd)
+		return -ENOMEM;
+	memcpy(radio->read_cmd, read_hdr, hdr_len);
+
+	skb_queue_head_init(&radio->pool);
+	INIT_WORK(&radio->refill_work, spi_radio_refill);
+
+	spi_radio_refill(&radio->refill_work);
+	if (skb_queue_empty(&radio->pool)) {
+		kfree(radio->read_cmd);
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+EXPORT_SYMBOL(spi_radio_init);
+
+void spi_radio_fini(struct spi_radio *radio)
+{
+	cancel_work_sync(&radio->refill_work);
+	skb_queue_purge(&radio->pool);
+	kfree(radio->read_cmd);
+}
+EXPORT_SYMBOL(spi_radio_fini);
+
+/*
+ * Get a buffer for the next received frame. Safe in any context, the
+ * pool is refilled from process context.
+ */
+struct sk_buff *spi_radio_get_skb(struct spi_radio *radio)
+{
+	struct sk_buff *skb;
+
+	skb = skb_dequeue(&radio->pool);
+	if (skb_queue_len(&radio->pool) < radio->pool_size / 2 + 1)
+		schedule_work(&radio->refill_work);
+
+	if (!skb)
+		skb = spi_radio_alloc(radio, GFP_ATOMIC);
+
+	return skb;
+}
+EXPORT_SYMBOL(spi_radio_get_skb);
+
+/* Give back a buffer which was not passed up, e.g. for a bad frame */
+void spi_radio_put_skb(struct spi_radio *radio, struct sk_buff *skb)
+{
+	if (skb_queue_len(&radio->pool) >= radio->pool_size ||
+	    skb_cloned(skb) || skb_headroom(skb) != radio->hdr_len) {
+		kfree_skb(skb);
+		return;
+	}
+
+	skb_trim(skb, 0);
+	skb_queue_head(&radio->pool, skb);
+}
+EXPORT_SYMBOL(spi_radio_put_skb);
+
+/* Read len octets following the header into skb, in one transfer */
+void spi_radio_read_xfer(struct spi_radio *radio, struct spi_transfer *xfer,
+		struct sk_buff *skb, unsigned int len)
+{
+	BUG_ON(len > radio->buf_size);
+
+	xfer->tx_buf = radio->read_cmd;
+	xfer->rx_buf = spi_radio_hdr(radio, skb);
+	xfer->len = radio->hdr_len + len;
+}
+EXPORT_SYMBOL(spi_radio_read_xfer);
+
+/* Write hdr followed by the frame, in one transfer */
+void spi_radio_write_xfer(struct spi_radio *radio, struct spi_transfer *xfer,
+		struct sk_buff *skb, const u8 *hdr)
+{
+	BUG_ON(skb_headroom(skb) < radio->hdr_len);
+
+	memcpy(spi_radio_hdr(radio, skb), hdr, radio->hdr_len);
+
+	xfer->tx_buf = spi_radio_hdr(radio, skb);
+	xfer->rx_buf = NULL;
+	xfer->len = radio->hdr_len + skb->len;
+}
+EXPORT_SYMBOL(spi_radio_write_xfer);
+
+int spi_radio_sync(struct spi_device *spi, struct spi_transfer *xfer)
+{
+	struct spi_message msg;
+	int status;
+
+	spi_message_init(&msg);
+	spi_message_add_tail(xfer, &msg);
+
+	status = spi_sync(spi, &msg);
+	if (!status)
+		status = msg.status;
+
+	return status;
+}
+EXPORT_SYMBOL(spi_radio_sync);
+
+MODULE_DESCRIPTION("IEEE 802.15.4 SPI radio helpers");
+MODULE_LICENSE("GPL v2");
@@ -0,0 +1,72 @@
+/*
+ * Frame buffer helpers shared by the SPI attached radio drivers
+ *
+ * Copyright 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Written by:
+ * agent <agent@local>
+ */
+#ifndef IEEE802154_SPI_RADIO_H
+#define IEEE802154_SPI_RADIO_H
+
+#include <linux/skbuff.h>
+#include <linux/workqueue.h>
+#include <linux/spi/spi.h>
+
+/*
+ * Radios are accessed with a command (and sometimes a length or status)
+ * header followed by the frame buffer contents. Received frames are read
+ * with a single transfer straight into an skb taken from a pool: the
+ * header octets land in the skb headroom. Frames to be sent are written
+ * the same way, with the header put in front of the data, so drivers
+ * have to ask for hdr_len octets of extra_tx_headroom.
+ */
+struct spi_radio {
+	struct spi_device	*spi;
+
+	/* read command followed by zeroes, the tx side of a read burst */
+	u8			*read_cmd;
+	unsigned int		hdr_len;
+	unsigned int		buf_size;
+
+	/* preallocated receive buffers */
+	struct sk_buff_head	pool;
+	unsigned int		pool_size;
+	struct work_struct	refill_work;
+};
+
+int spi_radio_init(struct spi_radio *radio, struct spi_device *spi,
+		const u8 *read_hdr, unsigned int hdr_len,
+		unsigned int buf_size, unsigned int pool_size);
+void spi_radio_fini(struct spi_radio *radio);
+
+struct sk_buff *spi_radio_get_skb(struct spi_radio *radio);
+void spi_radio_put_skb(struct spi_radio *radio, struct sk_buff *skb);
+
+void spi_radio_read_xfer(struct spi_radio *radio, struct spi_transfer *xfer,
+		struct sk_buff *skb, unsigned int len);
+void spi_radio_write_xfer(struct spi_radio *radio, struct spi_transfer *xfer,
+		struct sk_buff *skb, const u8 *hdr);
+
+int spi_radio_sync(struct spi_device *spi, struct spi_transfer *xfer);
+
+/* Header octets of a burst read into skb */
+static inline u8 *spi_radio_hdr(struct spi_radio *radio, struct sk_buff *skb)
+{
+	return skb->data - radio->hdr_len;
+}
+
+#endif
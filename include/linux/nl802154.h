@@ -69,11 +69,92 @@ enum {
 
 	IEEE802154_ATTR_PHY_NAME,
 
+	IEEE802154_ATTR_PHY_STATS,
+	IEEE802154_ATTR_MIB,
+	IEEE802154_ATTR_NEIGH,
+
+	IEEE802154_ATTR_TXPOWER,
+	IEEE802154_ATTR_NEW_CHANNEL,
+	IEEE802154_ATTR_DEV_TYPE,
+
 	__IEEE802154_ATTR_MAX,
 };
 
 #define IEEE802154_ATTR_MAX (__IEEE802154_ATTR_MAX - 1)
 
+/* IEEE802154_ATTR_DEV_TYPE values */
+enum {
+	IEEE802154_DEV_WPAN,
+	IEEE802154_DEV_MONITOR,
+};
+
+/* nested in IEEE802154_ATTR_PHY_STATS */
+enum {
+	__IEEE802154_STAT_INVALID,
+
+	IEEE802154_STAT_TX_FRAMES,
+	IEEE802154_STAT_TX_ERRORS,
+	IEEE802154_STAT_RX_FRAMES,
+	IEEE802154_STAT_RX_CRC_ERRORS,
+	IEEE802154_STAT_CCA_FAILURES,
+	IEEE802154_STAT_RETRIES,
+	IEEE802154_STAT_CHANNEL_SWITCHES,
+	IEEE802154_STAT_TX_QUEUE_LEN,
+	/* (channel, level) byte pairs, oldest first */
+	IEEE802154_STAT_ED_HISTORY,
+	IEEE802154_STAT_RX_OVERFLOWS,
+	IEEE802154_STAT_RX_DUPLICATES,
+
+	__IEEE802154_STAT_MAX,
+};
+
+#define IEEE802154_STAT_MAX (__IEEE802154_STAT_MAX - 1)
+
+/* nested in IEEE802154_ATTR_MIB */
+enum {
+	__IEEE802154_MIB_INVALID,
+
+	IEEE802154_MIB_PAN_ID,
+	IEEE802154_MIB_SHORT_ADDR,
+	IEEE802154_MIB_CHANNEL,
+	IEEE802154_MIB_PAGE,
+	IEEE802154_MIB_BSN,
+	IEEE802154_MIB_DSN,
+	IEEE802154_MIB_BCN_ORD,
+	IEEE802154_MIB_SF_ORD,
+	IEEE802154_MIB_MIN_BE,
+	IEEE802154_MIB_MAX_BE,
+	IEEE802154_MIB_MAX_CSMA_BACKOFFS,
+	IEEE802154_MIB_MAX_FRAME_RETRIES,
+	IEEE802154_MIB_INDIRECT_FRAMES,
+
+	__IEEE802154_MIB_MAX,
+};
+
+#define IEEE802154_MIB_MAX (__IEEE802154_MIB_MAX - 1)
+
+/* nested in IEEE802154_ATTR_NEIGH */
+enum {
+	__IEEE802154_NEIGH_INVALID,
+
+	IEEE802154_NEIGH_PAN_ID,
+	IEEE802154_NEIGH_SHORT_ADDR,
+	IEEE802154_NEIGH_HW_ADDR,
+	IEEE802154_NEIGH_LQI,
+	/* expected transmissions, in 1/16 */
+	IEEE802154_NEIGH_ETX,
+	IEEE802154_NEIGH_SEQ,
+	/* ms since last heard of */
+	IEEE802154_NEIGH_AGE,
+	IEEE802154_NEIGH_RX_FRAMES,
+	IEEE802154_NEIGH_TX_ACKED,
+	IEEE802154_NEIGH_TX_FAILED,
+
+	__IEEE802154_NEIGH_MAX,
+};
+
+#define IEEE802154_NEIGH_MAX (__IEEE802154_NEIGH_MAX - 1)
+
 extern const struct nla_policy ieee802154_policy[];
 
 /* commands */
@@ -121,6 +202,19 @@ enum {
 	IEEE802154_ADD_IFACE,
 	IEEE802154_DEL_IFACE,
 
+	IEEE802154_SET_EVENT_FILTER,
+	IEEE802154_GET_STATS,
+
+	IEEE802154_LIST_NEIGH,
+	IEEE802154_NEIGH_NEW_INDIC,
+	IEEE802154_NEIGH_DEL_INDIC,
+
+	IEEE802154_ASSOCIATE_DONE_INDIC,
+
+	IEEE802154_SET_PHY,
+
+	IEEE802154_CHANNEL_INDIC,
+
 	__IEEE802154_CMD_MAX,
 };
 
@@ -127,6 +127,12 @@ struct tc_multiq_qopt {
 	__u16	max_bands;		/* Maximum number of queues */
 };
 
+/* IEEE802154 section */
+
+struct tc_ieee802154_qopt {
+	__u32	limit;		/* Queue length in packets */
+};
+
 /* TBF section */
 
 struct tc_tbf_qopt {
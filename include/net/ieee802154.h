@@ -67,6 +67,18 @@
 #define IEEE802154_CMD_COORD_REALIGN_NOTIFY	0x08
 #define IEEE802154_CMD_GTS_REQ			0x09
 
+/* Capability information field of the association request */
+#define IEEE802154_CAP_ALT_PAN_COORD	(1 << 0)
+#define IEEE802154_CAP_FFD		(1 << 1)
+#define IEEE802154_CAP_MAINS_POWER	(1 << 2)
+#define IEEE802154_CAP_RX_ON_IDLE	(1 << 3)
+#define IEEE802154_CAP_SECURITY		(1 << 6)
+#define IEEE802154_CAP_ALLOC_ADDR	(1 << 7)
+
+/* Association status, 7.3.2.3 */
+#define IEEE802154_ASSOC_PAN_AT_CAPACITY	0x01
+#define IEEE802154_ASSOC_ACCESS_DENIED		0x02
+
 /*
  * The return values of MAC operations
  */
@@ -81,6 +81,41 @@ struct wpan_phy;
  * get_phy should increment the reference counting on returned phy.
  * Use wpan_wpy_put to put that reference.
  */
+/* MAC PIB of an interface, as reported by get_mib */
+struct ieee802154_mib {
+	u16 pan_id;
+	u16 short_addr;
+	u8 channel;
+	u8 page;
+	u8 bsn;
+	u8 dsn;
+	u8 bcn_ord;
+	u8 sf_ord;
+	u8 min_be;
+	u8 max_be;
+	u8 max_csma_backoffs;
+	u8 max_frame_retries;
+	/* frames held for indirect transmission */
+	u32 indirect_frames;
+};
+
+/* Link estimate of a neighbour, as reported by neigh_dump */
+struct ieee802154_neigh_info {
+	u16 pan_id;
+	/* IEEE802154_ADDR_UNDEF if not known */
+	u16 short_addr;
+	u8 hwaddr[IEEE802154_ADDR_LEN];
+	bool has_hwaddr;
+	/* moving averages */
+	u8 lqi;
+	u16 etx; /* in 1/16 transmissions, 0 if nothing was sent yet */
+	u8 seq; /* of the last frame received */
+	u32 age; /* ms since last heard of */
+	u32 rx_frames;
+	u32 tx_acked;
+	u32 tx_failed;
+};
+
 struct ieee802154_mlme_ops {
 	int (*assoc_req)(struct net_device *dev,
 			struct ieee802154_addr *addr,
@@ -108,6 +143,17 @@ struct ieee802154_mlme_ops {
 	u16 (*get_short_addr)(const struct net_device *dev);
 	u8 (*get_dsn)(const struct net_device *dev);
 	u8 (*get_bsn)(const struct net_device *dev);
+	/* Optional, fills in a snapshot of the MIB */
+	void (*get_mib)(const struct net_device *dev,
+			struct ieee802154_mib *mib);
+	/*
+	 * Optional, calls fill for the neighbours past the first skip ones
+	 * until it returns non-zero. Returns the number of them passed.
+	 */
+	int (*neigh_dump)(struct net_device *dev, int skip,
+			int (*fill)(const struct ieee802154_neigh_info *info,
+				void *arg),
+			void *arg);
 };
 
 static inline struct ieee802154_mlme_ops *ieee802154_mlme_ops(
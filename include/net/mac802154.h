@@ -40,19 +40,31 @@
  *
  * @IEEE802515_PANC_CHANGED:
  *	Indicates that PAN Coordinator status changed
+ *
+ * @IEEE802515_PROMISC_CHANGED:
+ *	Indicates that the radio should start or stop passing all frames,
+ *	regardless of their destination
  */
 enum ieee802154_hw_addr_filt_flags {
 	IEEE802515_SADDR_CHANGED	= 1 << 0,
 	IEEE802515_IEEEADDR_CHANGED	= 1 << 1,
 	IEEE802515_PANID_CHANGED	= 1 << 2,
 	IEEE802515_PANC_CHANGED	 = 1 << 3,
+	IEEE802515_PROMISC_CHANGED	= 1 << 4,
 };
 
+#define IEEE802515_AFILT_CHANGED	(IEEE802515_SADDR_CHANGED |	\
+					 IEEE802515_IEEEADDR_CHANGED |	\
+					 IEEE802515_PANID_CHANGED |	\
+					 IEEE802515_PANC_CHANGED |	\
+					 IEEE802515_PROMISC_CHANGED)
+
 struct ieee802154_hw_addr_filt {
 	u16 pan_id;
 	u16 short_addr;
 	u8 ieee_addr[IEEE802154_ADDR_LEN];
 	u8 pan_coord;
+	u8 promisc;
 };
 
 struct ieee802154_dev {
@@ -83,10 +95,18 @@ struct ieee802154_dev {
  *
  * @IEEE802154_HW_AACK:
  * 	Indicates that receiver will autorespond with ACK frames.
+ *	Such a receiver filters frames on the addresses passed to
+ *	set_hw_addr_filt and should acknowledge only those.
+ *
+ * @IEEE802154_HW_CSMA:
+ *	Indicates that the xmit callback performs channel access itself,
+ *	so it is used even if cca and xmit_raw are provided. May be set
+ *	by the start callback, once the device capabilities are known.
  */
 enum ieee802154_hw_flags {
 	IEEE802154_HW_OMIT_CKSUM			= 1 << 0,
 	IEEE802154_HW_AACK				= 1 << 1,
+	IEEE802154_HW_CSMA				= 1 << 2,
 };
 
 struct sk_buff;
@@ -123,8 +143,31 @@ struct sk_buff;
  *	Called with pib_lock held.
  *
  * @set_hw_addr_filt: Set radio for listening on specific address.
- *	Set the device for listening on specified address.
+ *	Set the device for listening on specified address. The changed
+ *	mask tells which fields of filt were updated; with filt->promisc
+ *	set all received frames should be passed up.
  *	Returns either zero, or negative errno.
+ *	Called with pib_lock held.
+ *
+ * @cca: Optional. Perform a single clear channel assessment.
+ *	Returns zero if the channel is idle, -EBUSY if it is busy or
+ *	other negative errno.
+ *	Called with pib_lock held.
+ *
+ * @xmit_raw: Optional. Send the frame immediately, without channel
+ *	access or retransmissions. If both cca and xmit_raw are provided,
+ *	mac802154 performs CSMA/CA, waits for acknowledgements and
+ *	retransmits frames itself instead of calling xmit.
+ *	Called with pib_lock held.
+ *
+ * @xmit_async: Optional. Start sending the frame and return without
+ *	waiting for it to go out. The driver reports the result with
+ *	ieee802154_xmit_complete(); until then mac802154 owns the skb and
+ *	neither passes another frame nor calls any callback taking
+ *	pib_lock. Used instead of all other transmit callbacks.
+ *	Returns zero or negative errno, in the latter case
+ *	ieee802154_xmit_complete() must not be called.
+ *	Called with pib_lock held, must not sleep.
  */
 struct ieee802154_ops {
 	struct module	*owner;
@@ -138,6 +181,11 @@ struct ieee802154_ops {
 	int		(*set_hw_addr_filt)(struct ieee802154_dev *dev,
 					struct ieee802154_hw_addr_filt *filt,
 					unsigned long changed);
+	int		(*cca)(struct ieee802154_dev *dev);
+	int		(*xmit_raw)(struct ieee802154_dev *dev,
+					struct sk_buff *skb);
+	int		(*xmit_async)(struct ieee802154_dev *dev,
+					struct sk_buff *skb);
 };
 
 struct ieee802154_dev *ieee802154_alloc_device(size_t priv_size,
@@ -149,5 +197,7 @@ void ieee802154_free_device(struct ieee802154_dev *dev);
 void ieee802154_rx(struct ieee802154_dev *dev, struct sk_buff *skb, u8 lqi);
 void ieee802154_rx_irqsafe(struct ieee802154_dev *dev, struct sk_buff *skb,
 		u8 lqi);
+void ieee802154_xmit_complete(struct ieee802154_dev *dev, struct sk_buff *skb,
+		int result);
 #endif
 
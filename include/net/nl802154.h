@@ -22,7 +22,9 @@
 #define IEEE802154_NL_H
 
 struct net_device;
+struct wpan_phy;
 struct ieee802154_addr;
+struct ieee802154_neigh_info;
 
 /**
  * ieee802154_nl_assoc_indic - Notify userland of an association request.
@@ -39,6 +41,23 @@ struct ieee802154_addr;
 int ieee802154_nl_assoc_indic(struct net_device *dev,
 		struct ieee802154_addr *addr, u8 cap);
 
+/**
+ * ieee802154_nl_assoc_done_indic - Notify userland of an association
+ * handled by the kernel.
+ * @dev: The network device on which this association request was
+ *       received.
+ * @addr: The address of the device requesting association.
+ * @short_addr: The short address given to the device.
+ * @cap: The capability information field from the device.
+ * @status: The status sent in the association response.
+ *
+ * Sent instead of ieee802154_nl_assoc_indic() when the coordinator
+ * answers association requests itself.
+ */
+int ieee802154_nl_assoc_done_indic(struct net_device *dev,
+		struct ieee802154_addr *addr, u16 short_addr, u8 cap,
+		u8 status);
+
 /**
  * ieee802154_nl_assoc_confirm - Notify userland of association.
  * @dev: The device which has completed association.
@@ -123,4 +142,29 @@ int ieee802154_nl_beacon_indic(struct net_device *dev, u16 panid,
  */
 int ieee802154_nl_start_confirm(struct net_device *dev, u8 status);
 
+/**
+ * ieee802154_nl_channel_indic - Notify userland of a degraded channel.
+ * @phy: The PHY whose operating channel is degraded.
+ * @page: The channel page in use.
+ * @channel: The operating channel.
+ * @new_channel: The channel the PAN is being moved to, or 0xff if it
+ *               stays where it is.
+ * @edl: The averaged energy levels of all 27 channels, 0 for channels
+ *       not sampled.
+ */
+int ieee802154_nl_channel_indic(struct wpan_phy *phy, u8 page, u8 channel,
+		u8 new_channel, const u8 *edl);
+
+/**
+ * ieee802154_nl_neigh_indic - Notify userland of a neighbour change.
+ * @dev: The device the neighbour was heard on.
+ * @info: The link estimate of the neighbour.
+ * @cmd: IEEE802154_NEIGH_NEW_INDIC for a new neighbour,
+ *       IEEE802154_NEIGH_DEL_INDIC for one dropped from the table.
+ *
+ * May be called in atomic context.
+ */
+int ieee802154_nl_neigh_indic(struct net_device *dev,
+		const struct ieee802154_neigh_info *info, u8 cmd);
+
 #endif
@@ -23,6 +23,39 @@
 
 #include <linux/netdevice.h>
 #include <linux/mutex.h>
+#include <linux/spinlock.h>
+#include <asm/atomic.h>
+
+#define WPAN_PHY_ED_HISTORY	16
+
+/*
+ * Counters kept by the MAC for monitoring, protected by lock.
+ */
+struct wpan_phy_stats {
+	spinlock_t lock;
+
+	u32 tx_frames;
+	u32 tx_errors;
+	u32 rx_frames;
+	u32 rx_crc_errors;
+	/* frames lost in the radio receive buffer */
+	u32 rx_overflows;
+	/* retransmissions dropped as already received */
+	u32 rx_duplicates;
+	u32 cca_failures;
+	u32 retries;
+	u32 channel_switches;
+	/* frames waiting for the transmit worker, updated without the lock */
+	atomic_t tx_queue_len;
+
+	/* channel and level of the last energy detections */
+	struct {
+		u8 channel;
+		u8 level;
+	} ed[WPAN_PHY_ED_HISTORY];
+	u8 ed_pos;
+	u8 ed_count;
+};
 
 struct wpan_phy {
 	struct mutex pib_lock;
@@ -38,18 +71,39 @@ struct wpan_phy {
 	u8 transmit_power;
 	u8 cca_mode;
 
+	struct wpan_phy_stats stats;
+
 	struct device dev;
 	int idx;
 
+	/* type is one of IEEE802154_DEV_* */
 	struct net_device *(*add_iface)(struct wpan_phy *phy,
-			const char *name);
+			const char *name, int type);
 	void (*del_iface)(struct wpan_phy *phy, struct net_device *dev);
 
+	/*
+	 * Optional, retune the radio or change its output power. Called
+	 * with pib_lock held, the PIB fields are updated by the caller
+	 * on success.
+	 */
+	int (*set_channel)(struct wpan_phy *phy, u8 page, u8 channel);
+	int (*set_txpower)(struct wpan_phy *phy, u8 power);
+
 	char priv[0] __attribute__((__aligned__(NETDEV_ALIGN)));
 };
 
 #define to_phy(_dev)	container_of(_dev, struct wpan_phy, dev)
 
+#define wpan_phy_stats_add(phy, field, val)				\
+	do {								\
+		unsigned long __flags;					\
+		spin_lock_irqsave(&(phy)->stats.lock, __flags);		\
+		(phy)->stats.field += (val);				\
+		spin_unlock_irqrestore(&(phy)->stats.lock, __flags);	\
+	} while (0)
+
+#define wpan_phy_stats_inc(phy, field)	wpan_phy_stats_add(phy, field, 1)
+
 struct wpan_phy *wpan_phy_alloc(size_t priv_size);
 static inline void wpan_phy_set_dev(struct wpan_phy *phy, struct device *dev)
 {
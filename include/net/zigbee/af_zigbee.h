@@ -1,17 +1,60 @@
 #ifndef  _AF_ZIGBEE_H
 #define  _AF_ZIGBEE_H
 #include <linux/if.h>
+#include <linux/sockios.h>
 
 struct sockaddr_zb {
 	sa_family_t family; /* AF_ZIGBEE */
 	u16 addr;
 };
 
-#ifdef __KERNEL__
-extern struct proto zb_raw_prot;
-extern struct proto zb_dgram_prot;
-void zb_raw_deliver(struct net_device *dev, struct sk_buff *skb);
-int zb_dgram_deliver(struct net_device *dev, struct sk_buff *skb);
-#endif
+/*
+ * NWK management, issued on any AF_ZIGBEE socket, CAP_NET_ADMIN only.
+ *
+ * Network discovery, formation and joining are left to userspace;
+ * once the device has its short address it starts the in-kernel NWK
+ * layer with SIOCZBNWKSTART and feeds it the routes it discovered.
+ */
+#define SIOCZBNWKSTART	(SIOCPROTOPRIVATE + 0)	/* struct zb_nwk_req */
+#define SIOCZBNWKSTOP	(SIOCPROTOPRIVATE + 1)	/* struct zb_nwk_req */
+#define SIOCZBADDRT	(SIOCPROTOPRIVATE + 2)	/* struct zb_route_req */
+#define SIOCZBDELRT	(SIOCPROTOPRIVATE + 3)	/* struct zb_route_req */
+#define SIOCZBADDNBR	(SIOCPROTOPRIVATE + 4)	/* struct zb_neigh_req */
+#define SIOCZBDELNBR	(SIOCPROTOPRIVATE + 5)	/* struct zb_neigh_req */
+
+struct zb_nwk_req {
+	char	ifname[IFNAMSIZ];
+	__u8	router;		/* forward traffic for other nodes */
+	__u8	depth;		/* our depth in the tree */
+	__u8	max_depth;	/* nwkMaxDepth (Lm) */
+	__u8	max_children;	/* nwkMaxChildren (Cm) */
+	__u8	max_routers;	/* nwkMaxRouters (Rm) */
+	__u8	radius;		/* default radius, 0 means 2 * Lm */
+	__u16	parent;		/* short address of our parent */
+};
+
+struct zb_route_req {
+	char	ifname[IFNAMSIZ];
+	__u16	dst;
+	__u16	next_hop;
+};
+
+/* Relationship values, ZigBee-2007 table 3.48 */
+#define ZB_REL_PARENT		0x00
+#define ZB_REL_CHILD		0x01
+#define ZB_REL_SIBLING		0x02
+#define ZB_REL_NONE		0x03
+
+/* Device types */
+#define ZB_DEV_COORD		0x00
+#define ZB_DEV_ROUTER		0x01
+#define ZB_DEV_END		0x02
+
+struct zb_neigh_req {
+	char	ifname[IFNAMSIZ];
+	__u16	addr;
+	__u8	relationship;
+	__u8	dev_type;
+};
 
 #endif /* _AF_ZIGBEE_H */
@@ -51,36 +51,45 @@
  * bit   Subfield         Value
  * ---   --------         -----
  * 0-1   Frame Type       <Data/Command>
- * 2-5   Protocol Version 0x1
- * 6-7   Discover Route   <Supress/Enable/Force>
+ * 2-5   Protocol Version 0x2
+ * 6-7   Discover Route   <Supress/Enable>
+ * 8     Multicast
  * 9     Security         <Enabled/Disabled>
- * 10-15 Reserved
+ * 10    Source Route
+ * 11    Destination IEEE Address
+ * 12    Source IEEE Address
+ * 13-15 Reserved
  *
- *
-*/
+ * All multi-octet fields are little-endian.
+ */
+#define ZB_NWK_FC_TYPE_MASK		0x0003
+#define ZB_NWK_FC_TYPE_DATA		0x0000
+#define ZB_NWK_FC_TYPE_CMD		0x0001
+#define ZB_NWK_FC_VERSION_SHIFT		2
+#define ZB_NWK_FC_VERSION_MASK		(0xf << ZB_NWK_FC_VERSION_SHIFT)
+#define ZB_NWK_FC_DISC_ROUTE_SHIFT	6
+#define ZB_NWK_FC_DISC_ROUTE_MASK	(0x3 << ZB_NWK_FC_DISC_ROUTE_SHIFT)
+#define ZB_NWK_FC_MULTICAST		(1 << 8)
+#define ZB_NWK_FC_SECURITY		(1 << 9)
+#define ZB_NWK_FC_SRC_ROUTE		(1 << 10)
+#define ZB_NWK_FC_DST_IEEE		(1 << 11)
+#define ZB_NWK_FC_SRC_IEEE		(1 << 12)
+
+#define ZB_NWK_PROTOCOL_VERSION		0x2
+
+/* Broadcast addresses, 0xfff8 - 0xfffb are reserved */
+#define ZB_NWK_ADDR_BCAST_MIN		0xfff8
+#define ZB_NWK_ADDR_BCAST_ROUTERS	0xfffc
+#define ZB_NWK_ADDR_BCAST_RXON		0xfffd
+#define ZB_NWK_ADDR_BCAST_ALL		0xffff
+
 struct nwkhdr {
-#if defined(__LITTLE_ENDIAN_BITFIELD)
-	__u16	reserved2:6,
-		security:1,
-		reserved1:1,
-		disc_route:2,
-  		version:4,
-		type:2;
-#elif defined (__BIG_ENDIAN_BITFIELD)
-	__u16	type:2,
-  		version:4,
-		disc_route:2,
-		reserved1:1,
-		security:1,
-		reserved2:6;
-#else
-#error	"Please fix <asm/byteorder.h>"
-#endif
-	__be16	daddr;
-	__be16	saddr;
+	__le16	fc;
+	__le16	daddr;
+	__le16	saddr;
 	__u8	radius;
 	__u8	seqnum;
-};
+} __attribute__ ((packed));
 
 #ifdef __KERNEL__
 #include <linux/skbuff.h>
@@ -89,6 +98,11 @@ static inline struct nwkhdr *nwk_hdr(const struct sk_buff *skb)
 {
 	return (struct nwkhdr *)skb_network_header(skb);
 }
+
+static inline int zb_nwk_addr_is_bcast(u16 addr)
+{
+	return addr >= ZB_NWK_ADDR_BCAST_MIN;
+}
 #endif
 
 #endif /* _NET_ZIGBEE_NWK_H */
@@ -0,0 +1,391 @@
+#undef TRACE_SYSTEM
+#define TRACE_SYSTEM ieee802154
+
+#if !defined(_TRACE_IEEE802154_H) || defined(TRACE_HEADER_MULTI_READ)
+#define _TRACE_IEEE802154_H
+
+#include <linux/skbuff.h>
+#include <linux/netdevice.h>
+#include <linux/tracepoint.h>
+#include <net/wpan-phy.h>
+
+#ifndef __IEEE802154_TRACE_HELPERS
+#define __IEEE802154_TRACE_HELPERS
+
+/* Addressing fields of an MHR as it is sent over the air */
+struct ieee802154_trace_mhr {
+	u16 fc;
+	u8 seq;
+	u8 dst_mode;
+	u16 dst_pan;
+	u64 dst;
+	u8 src_mode;
+	u16 src_pan;
+	u64 src;
+};
+
+static inline const u8 *ieee802154_trace_addr(const u8 *p, const u8 *end,
+		u8 mode, u64 *addr)
+{
+	int len = mode == 3 ? 8 : mode == 2 ? 2 : 0;
+
+	*addr = 0;
+	if (p + len > end)
+		return end;
+	while (len--)
+		*addr = (*addr << 8) | p[len];
+
+	return p + (mode == 3 ? 8 : mode == 2 ? 2 : 0);
+}
+
+static inline void ieee802154_trace_parse(const u8 *p, unsigned int len,
+		struct ieee802154_trace_mhr *mhr)
+{
+	const u8 *end = p + len;
+
+	memset(mhr, 0, sizeof(*mhr));
+	if (len < 3)
+		return;
+
+	mhr->fc = p[0] | (p[1] << 8);
+	mhr->seq = p[2];
+	mhr->dst_mode = (mhr->fc >> 10) & 3;
+	mhr->src_mode = (mhr->fc >> 14) & 3;
+	p += 3;
+
+	if (mhr->dst_mode && p + 2 <= end) {
+		mhr->dst_pan = p[0] | (p[1] << 8);
+		p = ieee802154_trace_addr(p + 2, end, mhr->dst_mode, &mhr->dst);
+	}
+
+	if (mhr->src_mode) {
+		/* PAN ID compression */
+		if (mhr->fc & 0x40)
+			mhr->src_pan = mhr->dst_pan;
+		else if (p + 2 <= end) {
+			mhr->src_pan = p[0] | (p[1] << 8);
+			p += 2;
+		}
+		ieee802154_trace_addr(p, end, mhr->src_mode, &mhr->src);
+	}
+}
+
+#endif
+
+#define MHR_ENTRY							\
+	__field(	u16,		fc			)	\
+	__field(	u8,		seq			)	\
+	__field(	u16,		dst_pan			)	\
+	__field(	u64,		dst			)	\
+	__field(	u16,		src_pan			)	\
+	__field(	u64,		src			)
+
+/* The MAC header of received frames stays at skb_mac_header() */
+#define MHR_ASSIGN(data, len)						\
+	do {								\
+		struct ieee802154_trace_mhr __mhr;			\
+		ieee802154_trace_parse(data, len, &__mhr);		\
+		__entry->fc = __mhr.fc;					\
+		__entry->seq = __mhr.seq;				\
+		__entry->dst_pan = __mhr.dst_pan;			\
+		__entry->dst = __mhr.dst;				\
+		__entry->src_pan = __mhr.src_pan;			\
+		__entry->src = __mhr.src;				\
+	} while (0)
+
+#define MHR_ASSIGN_SKB(skb)						\
+	MHR_ASSIGN(skb_mac_header(skb),					\
+		skb_tail_pointer(skb) - skb_mac_header(skb))
+
+#define MHR_PR_FMT	"seq=%u fc=%04x dst=%04x:%llx src=%04x:%llx"
+#define MHR_PR_ARG	__entry->seq, __entry->fc,			\
+			__entry->dst_pan, (unsigned long long)__entry->dst, \
+			__entry->src_pan, (unsigned long long)__entry->src
+
+/*
+ * Frames handed over by the driver, before any processing.
+ */
+TRACE_EVENT(ieee802154_drv_rx,
+
+	TP_PROTO(struct wpan_phy *phy, struct sk_buff *skb, u8 lqi),
+
+	TP_ARGS(phy, skb, lqi),
+
+	TP_STRUCT__entry(
+		__field(	int,		phy			)
+		__field(	unsigned int,	len			)
+		__field(	u8,		lqi			)
+		MHR_ENTRY
+	),
+
+	TP_fast_assign(
+		__entry->phy = phy->idx;
+		__entry->len = skb->len;
+		__entry->lqi = lqi;
+		MHR_ASSIGN(skb->data, skb->len);
+	),
+
+	TP_printk("phy=%d len=%u lqi=%u " MHR_PR_FMT,
+		__entry->phy, __entry->len, __entry->lqi, MHR_PR_ARG)
+);
+
+/*
+ * Receive filtering verdict of an interface, pkt_type is one of
+ * PACKET_HOST, PACKET_BROADCAST or PACKET_OTHERHOST.
+ */
+TRACE_EVENT(ieee802154_subif_rx,
+
+	TP_PROTO(struct net_device *dev, struct sk_buff *skb),
+
+	TP_ARGS(dev, skb),
+
+	TP_STRUCT__entry(
+		__field(	int,		ifindex			)
+		__field(	u8,		pkt_type		)
+		MHR_ENTRY
+	),
+
+	TP_fast_assign(
+		__entry->ifindex = dev->ifindex;
+		__entry->pkt_type = skb->pkt_type;
+		MHR_ASSIGN_SKB(skb);
+	),
+
+	TP_printk("ifindex=%d pkt_type=%u " MHR_PR_FMT,
+		__entry->ifindex, __entry->pkt_type, MHR_PR_ARG)
+);
+
+/*
+ * Number of sockets a received frame matched.
+ */
+DECLARE_EVENT_CLASS(ieee802154_sock_deliver,
+
+	TP_PROTO(struct net_device *dev, struct sk_buff *skb, int socks),
+
+	TP_ARGS(dev, skb, socks),
+
+	TP_STRUCT__entry(
+		__field(	int,		ifindex			)
+		__field(	int,		socks			)
+		MHR_ENTRY
+	),
+
+	TP_fast_assign(
+		__entry->ifindex = dev->ifindex;
+		__entry->socks = socks;
+		MHR_ASSIGN_SKB(skb);
+	),
+
+	TP_printk("ifindex=%d socks=%d " MHR_PR_FMT,
+		__entry->ifindex, __entry->socks, MHR_PR_ARG)
+);
+
+DEFINE_EVENT(ieee802154_sock_deliver, ieee802154_raw_deliver,
+
+	TP_PROTO(struct net_device *dev, struct sk_buff *skb, int socks),
+
+	TP_ARGS(dev, skb, socks)
+);
+
+DEFINE_EVENT(ieee802154_sock_deliver, ieee802154_dgram_deliver,
+
+	TP_PROTO(struct net_device *dev, struct sk_buff *skb, int socks),
+
+	TP_ARGS(dev, skb, socks)
+);
+
+/*
+ * Frame queued to the transmit worker of the PHY.
+ */
+TRACE_EVENT(ieee802154_xmit_enqueue,
+
+	TP_PROTO(struct net_device *dev, struct sk_buff *skb),
+
+	TP_ARGS(dev, skb),
+
+	TP_STRUCT__entry(
+		__field(	int,		ifindex			)
+		__field(	unsigned int,	len			)
+		MHR_ENTRY
+	),
+
+	TP_fast_assign(
+		__entry->ifindex = dev->ifindex;
+		__entry->len = skb->len;
+		MHR_ASSIGN(skb->data, skb->len);
+	),
+
+	TP_printk("ifindex=%d len=%u " MHR_PR_FMT,
+		__entry->ifindex, __entry->len, MHR_PR_ARG)
+);
+
+/*
+ * Transmit path inside the PHY, ifindex is the interface that sent
+ * the frame.
+ */
+DECLARE_EVENT_CLASS(ieee802154_phy_xmit,
+
+	TP_PROTO(struct wpan_phy *phy, struct sk_buff *skb),
+
+	TP_ARGS(phy, skb),
+
+	TP_STRUCT__entry(
+		__field(	int,		phy			)
+		__field(	int,		ifindex			)
+		__field(	unsigned int,	len			)
+		MHR_ENTRY
+	),
+
+	TP_fast_assign(
+		__entry->phy = phy->idx;
+		__entry->ifindex = skb->skb_iif;
+		__entry->len = skb->len;
+		MHR_ASSIGN(skb->data, skb->len);
+	),
+
+	TP_printk("phy=%d ifindex=%d len=%u " MHR_PR_FMT,
+		__entry->phy, __entry->ifindex, __entry->len, MHR_PR_ARG)
+);
+
+/* The transmit worker picked up the frame */
+DEFINE_EVENT(ieee802154_phy_xmit, ieee802154_xmit_dequeue,
+
+	TP_PROTO(struct wpan_phy *phy, struct sk_buff *skb),
+
+	TP_ARGS(phy, skb)
+);
+
+/* The frame is handed to the driver */
+DEFINE_EVENT(ieee802154_phy_xmit, ieee802154_drv_xmit,
+
+	TP_PROTO(struct wpan_phy *phy, struct sk_buff *skb),
+
+	TP_ARGS(phy, skb)
+);
+
+TRACE_EVENT(ieee802154_drv_xmit_done,
+
+	TP_PROTO(struct wpan_phy *phy, struct sk_buff *skb, int result),
+
+	TP_ARGS(phy, skb, result),
+
+	TP_STRUCT__entry(
+		__field(	int,		phy			)
+		__field(	int,		ifindex			)
+		__field(	int,		result			)
+		MHR_ENTRY
+	),
+
+	TP_fast_assign(
+		__entry->phy = phy->idx;
+		__entry->ifindex = skb->skb_iif;
+		__entry->result = result;
+		MHR_ASSIGN(skb->data, skb->len);
+	),
+
+	TP_printk("phy=%d ifindex=%d result=%d " MHR_PR_FMT,
+		__entry->phy, __entry->ifindex, __entry->result, MHR_PR_ARG)
+);
+
+TRACE_EVENT(ieee802154_set_channel,
+
+	TP_PROTO(struct wpan_phy *phy, u8 page, u8 channel, int result),
+
+	TP_ARGS(phy, page, channel, result),
+
+	TP_STRUCT__entry(
+		__field(	int,		phy			)
+		__field(	u8,		page			)
+		__field(	u8,		channel			)
+		__field(	int,		result			)
+	),
+
+	TP_fast_assign(
+		__entry->phy = phy->idx;
+		__entry->page = page;
+		__entry->channel = channel;
+		__entry->result = result;
+	),
+
+	TP_printk("phy=%d page=%u channel=%u result=%d", __entry->phy,
+		__entry->page, __entry->channel, __entry->result)
+);
+
+/*
+ * One channel of an MLME-SCAN.request done, level is the ED result.
+ */
+TRACE_EVENT(ieee802154_scan_channel,
+
+	TP_PROTO(struct net_device *dev, u8 type, u8 page, u8 channel,
+		u8 level, int result),
+
+	TP_ARGS(dev, type, page, channel, level, result),
+
+	TP_STRUCT__entry(
+		__field(	int,		ifindex			)
+		__field(	u8,		type			)
+		__field(	u8,		page			)
+		__field(	u8,		channel			)
+		__field(	u8,		level			)
+		__field(	int,		result			)
+	),
+
+	TP_fast_assign(
+		__entry->ifindex = dev->ifindex;
+		__entry->type = type;
+		__entry->page = page;
+		__entry->channel = channel;
+		__entry->level = level;
+		__entry->result = result;
+	),
+
+	TP_printk("ifindex=%d type=%u page=%u channel=%u level=%u result=%d",
+		__entry->ifindex, __entry->type, __entry->page,
+		__entry->channel, __entry->level, __entry->result)
+);
+
+/*
+ * MLME primitives, cmd is the IEEE802154_*_REQ or IEEE802154_*_CONF
+ * netlink command. For requests status is the value returned by the
+ * MAC, for confirms the 802.15.4 status code.
+ */
+DECLARE_EVENT_CLASS(ieee802154_mlme,
+
+	TP_PROTO(struct net_device *dev, u8 cmd, int status),
+
+	TP_ARGS(dev, cmd, status),
+
+	TP_STRUCT__entry(
+		__field(	int,		ifindex			)
+		__field(	u8,		cmd			)
+		__field(	int,		status			)
+	),
+
+	TP_fast_assign(
+		__entry->ifindex = dev->ifindex;
+		__entry->cmd = cmd;
+		__entry->status = status;
+	),
+
+	TP_printk("ifindex=%d cmd=%u status=%d", __entry->ifindex,
+		__entry->cmd, __entry->status)
+);
+
+DEFINE_EVENT(ieee802154_mlme, ieee802154_mlme_req,
+
+	TP_PROTO(struct net_device *dev, u8 cmd, int status),
+
+	TP_ARGS(dev, cmd, status)
+);
+
+DEFINE_EVENT(ieee802154_mlme, ieee802154_mlme_confirm,
+
+	TP_PROTO(struct net_device *dev, u8 cmd, int status),
+
+	TP_ARGS(dev, cmd, status)
+);
+
+#endif /* _TRACE_IEEE802154_H */
+
+/* This part must be outside protection */
+#include <trace/define_trace.h>
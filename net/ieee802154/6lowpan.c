@@ -0,0 +1,1209 @@
+/*
+ * IPv6 over IEEE 802.15.4 (6LoWPAN), RFC 4944 and RFC 6282
+ *
+ * Copyright 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Written by:
+ * agent <agent@local>
+ */
+
+/*
+ * A "lowpan" link is created on top of an ARPHRD_IEEE802154 slave
+ * device (ip link add link wpan0 name lowpan0 type lowpan). IPv6
+ * packets sent through it are IPHC compressed in header_ops->create
+ * and fragmented in ndo_start_xmit when they don't fit into a single
+ * 802.15.4 frame. Incoming data frames are picked up by a packet
+ * handler on ETH_P_IEEE802154 and either decompressed in place or
+ * collected in the reassembly cache.
+ *
+ * Only the stateless (context free) parts of IPHC are implemented,
+ * the only next header compression supported is UDP.
+ */
+
+#include <linux/bitops.h>
+#include <linux/if_arp.h>
+#include <linux/jhash.h>
+#include <linux/list.h>
+#include <linux/module.h>
+#include <linux/netdevice.h>
+#include <linux/random.h>
+#include <linux/skbuff.h>
+#include <linux/timer.h>
+#include <linux/udp.h>
+#include <net/af_ieee802154.h>
+#include <net/ieee802154.h>
+#include <net/ieee802154_netdev.h>
+#include <net/ipv6.h>
+#include <net/rtnetlink.h>
+
+#include "6lowpan.h"
+
+struct lowpan_dev_info {
+	struct net_device	*real_dev;	/* underlying wpan slave */
+	struct net_device	*ldev;		/* back pointer */
+	struct list_head	list;		/* lowpan_devices, RCU */
+	u16			fragment_tag;
+};
+
+/* Protected by RTNL for writers and by RCU for the receive path */
+static LIST_HEAD(lowpan_devices);
+
+static inline struct lowpan_dev_info *lowpan_dev_info(
+		const struct net_device *dev)
+{
+	return netdev_priv(dev);
+}
+
+static struct net_device *lowpan_find_dev(const struct net_device *real_dev)
+{
+	struct lowpan_dev_info *info;
+
+	list_for_each_entry_rcu(info, &lowpan_devices, list)
+		if (info->real_dev == real_dev)
+			return info->ldev;
+
+	return NULL;
+}
+
+/*
+ * Reassembly cache
+ *
+ * Datagrams are identified by (source, tag, datagram_size). Entries are
+ * kept both in a hash table for lookup and in a list in creation order,
+ * so that the oldest entry can be recycled once the cache is full.
+ */
+struct lowpan_fragment {
+	struct hlist_node	node;
+	struct list_head	list;
+	struct sk_buff		*skb;		/* datagram being rebuilt */
+	struct ieee802154_addr	src;
+	u16			tag;
+	u16			dgram_size;
+	u16			units_rcv;
+	unsigned long		units[BITS_TO_LONGS(LOWPAN_FRAG_UNITS)];
+	struct timer_list	timer;
+};
+
+static struct hlist_head lowpan_frag_hash[LOWPAN_FRAG_HASH_SIZE];
+static LIST_HEAD(lowpan_frag_list);
+static unsigned int lowpan_frag_count;
+static DEFINE_SPINLOCK(lowpan_frag_lock);
+static u32 lowpan_frag_rnd;
+
+static unsigned int lowpan_frag_hashfn(u16 tag,
+		const struct ieee802154_addr *src)
+{
+	u32 key;
+
+	if (src->addr_type == IEEE802154_ADDR_LONG)
+		key = jhash(src->hwaddr, IEEE802154_ADDR_LEN, lowpan_frag_rnd);
+	else
+		key = jhash_2words(src->short_addr, src->pan_id,
+				lowpan_frag_rnd);
+
+	return jhash_2words(tag, key, lowpan_frag_rnd) &
+		(LOWPAN_FRAG_HASH_SIZE - 1);
+}
+
+static int lowpan_addr_equal(const struct ieee802154_addr *a,
+		const struct ieee802154_addr *b)
+{
+	if (a->addr_type != b->addr_type)
+		return 0;
+
+	if (a->addr_type == IEEE802154_ADDR_LONG)
+		return !memcmp(a->hwaddr, b->hwaddr, IEEE802154_ADDR_LEN);
+
+	return a->short_addr == b->short_addr && a->pan_id == b->pan_id;
+}
+
+/* called with lowpan_frag_lock held */
+static void lowpan_frag_unlink(struct lowpan_fragment *frag)
+{
+	hlist_del_init(&frag->node);
+	list_del(&frag->list);
+	lowpan_frag_count--;
+}
+
+/*
+ * Frees an already unlinked entry. The timer only frees entries it
+ * manages to unlink itself, so waiting for it here is safe.
+ */
+static void lowpan_frag_destroy(struct lowpan_fragment *frag)
+{
+	del_timer_sync(&frag->timer);
+	kfree_skb(frag->skb);
+	kfree(frag);
+}
+
+static void lowpan_frag_expire(unsigned long data)
+{
+	struct lowpan_fragment *frag = (struct lowpan_fragment *)data;
+	int owned = 0;
+
+	spin_lock(&lowpan_frag_lock);
+	if (!hlist_unhashed(&frag->node)) {
+		lowpan_frag_unlink(frag);
+		owned = 1;
+	}
+	spin_unlock(&lowpan_frag_lock);
+
+	if (!owned)
+		return;
+
+	pr_debug("%s(): reassembly of tag %#x timed out\n",
+			__func__, frag->tag);
+	kfree_skb(frag->skb);
+	kfree(frag);
+}
+
+/* called with lowpan_frag_lock held */
+static struct lowpan_fragment *lowpan_frag_find(unsigned int hash,
+		u16 tag, u16 size, const struct ieee802154_addr *src)
+{
+	struct lowpan_fragment *frag;
+	struct hlist_node *n;
+
+	hlist_for_each_entry(frag, n, &lowpan_frag_hash[hash], node)
+		if (frag->tag == tag && frag->dgram_size == size &&
+		    lowpan_addr_equal(&frag->src, src))
+			return frag;
+
+	return NULL;
+}
+
+/* called with lowpan_frag_lock held */
+static struct lowpan_fragment *lowpan_frag_create(unsigned int hash,
+		u16 tag, u16 size, struct sk_buff *skb)
+{
+	struct lowpan_fragment *frag;
+
+	frag = kzalloc(sizeof(*frag), GFP_ATOMIC);
+	if (!frag)
+		return NULL;
+
+	frag->skb = alloc_skb(size, GFP_ATOMIC);
+	if (!frag->skb) {
+		kfree(frag);
+		return NULL;
+	}
+
+	skb_put(frag->skb, size);
+	frag->skb->pkt_type = skb->pkt_type;
+	memcpy(frag->skb->cb, skb->cb, sizeof(skb->cb));
+
+	frag->src = mac_cb(skb)->sa;
+	frag->tag = tag;
+	frag->dgram_size = size;
+
+	setup_timer(&frag->timer, lowpan_frag_expire, (unsigned long)frag);
+	mod_timer(&frag->timer, jiffies + LOWPAN_FRAG_TIMEOUT);
+
+	hlist_add_head(&frag->node, &lowpan_frag_hash[hash]);
+	list_add_tail(&frag->list, &lowpan_frag_list);
+	lowpan_frag_count++;
+
+	return frag;
+}
+
+static void lowpan_frag_flush(void)
+{
+	struct lowpan_fragment *frag;
+
+	for (;;) {
+		spin_lock_bh(&lowpan_frag_lock);
+		if (list_empty(&lowpan_frag_list)) {
+			spin_unlock_bh(&lowpan_frag_lock);
+			break;
+		}
+		frag = list_first_entry(&lowpan_frag_list,
+				struct lowpan_fragment, list);
+		lowpan_frag_unlink(frag);
+		spin_unlock_bh(&lowpan_frag_lock);
+
+		lowpan_frag_destroy(frag);
+	}
+}
+
+/*
+ * Header decompression
+ *
+ * All fields are parsed straight from skb->data into an on-stack
+ * header, then the IPv6 (and UDP) header is pushed in front of the
+ * payload. The payload itself is never copied.
+ */
+static int lowpan_fetch_skb(struct sk_buff *skb, void *data, unsigned int len)
+{
+	if (unlikely(!pskb_may_pull(skb, len)))
+		return -EINVAL;
+
+	memcpy(data, skb->data, len);
+	skb_pull(skb, len);
+
+	return 0;
+}
+
+/* Interface identifier derived from a MAC address, RFC 6282 section 3.2.2 */
+static int lowpan_iid_from_mac(u8 *iid, const struct ieee802154_addr *addr)
+{
+	switch (addr->addr_type) {
+	case IEEE802154_ADDR_LONG:
+		memcpy(iid, addr->hwaddr, IEEE802154_ADDR_LEN);
+		/* invert the universal/local bit */
+		iid[0] ^= 0x02;
+		return 0;
+	case IEEE802154_ADDR_SHORT:
+		/* 0000:00ff:fe00:XXXX */
+		memset(iid, 0, 8);
+		iid[3] = 0xff;
+		iid[4] = 0xfe;
+		iid[6] = addr->short_addr >> 8;
+		iid[7] = addr->short_addr & 0xff;
+		return 0;
+	}
+
+	return -EINVAL;
+}
+
+static int lowpan_uncompress_addr(struct sk_buff *skb, struct in6_addr *ipaddr,
+		u8 mode, const struct ieee802154_addr *lladdr)
+{
+	if (mode == LOWPAN_IPHC_ADDR_128)
+		return lowpan_fetch_skb(skb, ipaddr->s6_addr, 16);
+
+	/* everything else is link-local */
+	ipaddr->s6_addr32[0] = htonl(0xfe800000);
+
+	switch (mode) {
+	case LOWPAN_IPHC_ADDR_64:
+		return lowpan_fetch_skb(skb, &ipaddr->s6_addr[8], 8);
+	case LOWPAN_IPHC_ADDR_16:
+		ipaddr->s6_addr[11] = 0xff;
+		ipaddr->s6_addr[12] = 0xfe;
+		return lowpan_fetch_skb(skb, &ipaddr->s6_addr[14], 2);
+	default:
+		return lowpan_iid_from_mac(&ipaddr->s6_addr[8], lladdr);
+	}
+}
+
+static int lowpan_uncompress_mcast(struct sk_buff *skb,
+		struct in6_addr *ipaddr, u8 mode)
+{
+	ipaddr->s6_addr[0] = 0xff;
+
+	switch (mode) {
+	case LOWPAN_IPHC_MCAST_128:
+		return lowpan_fetch_skb(skb, ipaddr->s6_addr, 16);
+	case LOWPAN_IPHC_MCAST_48:
+		/* ffXX::00XX:XXXX:XXXX */
+		if (lowpan_fetch_skb(skb, &ipaddr->s6_addr[1], 1))
+			return -EINVAL;
+		return lowpan_fetch_skb(skb, &ipaddr->s6_addr[11], 5);
+	case LOWPAN_IPHC_MCAST_32:
+		/* ffXX::00XX:XXXX */
+		if (lowpan_fetch_skb(skb, &ipaddr->s6_addr[1], 1))
+			return -EINVAL;
+		return lowpan_fetch_skb(skb, &ipaddr->s6_addr[13], 3);
+	default:
+		/* ff02::00XX */
+		ipaddr->s6_addr[1] = 0x02;
+		return lowpan_fetch_skb(skb, &ipaddr->s6_addr[15], 1);
+	}
+}
+
+static int lowpan_uncompress_udp(struct sk_buff *skb, struct udphdr *uh)
+{
+	u8 nhc, tmp;
+
+	if (lowpan_fetch_skb(skb, &nhc, 1))
+		return -EINVAL;
+
+	if ((nhc & LOWPAN_NHC_UDP_MASK) != LOWPAN_NHC_UDP_ID) {
+		pr_debug("%s(): unsupported NHC %#x\n", __func__, nhc);
+		return -EINVAL;
+	}
+
+	switch (nhc & LOWPAN_NHC_UDP_PORTS) {
+	case LOWPAN_NHC_UDP_PORTS_INLINE:
+		if (lowpan_fetch_skb(skb, &uh->source, 2) ||
+		    lowpan_fetch_skb(skb, &uh->dest, 2))
+			return -EINVAL;
+		break;
+	case LOWPAN_NHC_UDP_PORTS_DST8:
+		if (lowpan_fetch_skb(skb, &uh->source, 2) ||
+		    lowpan_fetch_skb(skb, &tmp, 1))
+			return -EINVAL;
+		uh->dest = htons(LOWPAN_NHC_UDP_8BIT_PORT | tmp);
+		break;
+	case LOWPAN_NHC_UDP_PORTS_SRC8:
+		if (lowpan_fetch_skb(skb, &tmp, 1) ||
+		    lowpan_fetch_skb(skb, &uh->dest, 2))
+			return -EINVAL;
+		uh->source = htons(LOWPAN_NHC_UDP_8BIT_PORT | tmp);
+		break;
+	default:
+		if (lowpan_fetch_skb(skb, &tmp, 1))
+			return -EINVAL;
+		uh->source = htons(LOWPAN_NHC_UDP_4BIT_PORT | (tmp >> 4));
+		uh->dest = htons(LOWPAN_NHC_UDP_4BIT_PORT | (tmp & 0x0f));
+		break;
+	}
+
+	/* we have no way to recompute an elided checksum */
+	if (nhc & LOWPAN_NHC_UDP_CSUM) {
+		pr_debug("%s(): elided UDP checksum\n", __func__);
+		return -EINVAL;
+	}
+
+	return lowpan_fetch_skb(skb, &uh->check, 2);
+}
+
+/* IPHC carries ECN in front of DSCP, IPv6 the other way around */
+static void lowpan_set_tc(struct ipv6hdr *hdr, u8 tc)
+{
+	hdr->priority = tc >> 4;
+	hdr->flow_lbl[0] = ((tc & 0x0f) << 4) | (hdr->flow_lbl[0] & 0x0f);
+}
+
+static inline u8 lowpan_iphc_tc(u8 ecn_dscp)
+{
+	return ((ecn_dscp & 0x3f) << 2) | (ecn_dscp >> 6);
+}
+
+/*
+ * @dgram_size is the size of the whole datagram for a FRAG1 payload,
+ * or 0 when the frame holds the complete packet.
+ */
+static int lowpan_iphc_decompress(struct sk_buff *skb, u16 dgram_size)
+{
+	static const u8 hlim[] = { 0, 1, 64, 255 };
+	struct ipv6hdr hdr;
+	struct udphdr uh;
+	u8 iphc0, iphc1, buf[4];
+	unsigned int hlen = sizeof(hdr), total;
+	int err;
+
+	if (lowpan_fetch_skb(skb, &iphc0, 1) ||
+	    lowpan_fetch_skb(skb, &iphc1, 1))
+		return -EINVAL;
+
+	/* context based compression isn't supported */
+	if (iphc1 & (LOWPAN_IPHC_CID | LOWPAN_IPHC_DAC)) {
+		pr_debug("%s(): stateful IPHC is not supported\n", __func__);
+		return -EINVAL;
+	}
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.version = 6;
+
+	switch ((iphc0 & LOWPAN_IPHC_TF) >> LOWPAN_IPHC_TF_SHIFT) {
+	case LOWPAN_IPHC_TF_ALL:
+		if (lowpan_fetch_skb(skb, buf, 4))
+			return -EINVAL;
+		hdr.flow_lbl[0] = buf[1] & 0x0f;
+		hdr.flow_lbl[1] = buf[2];
+		hdr.flow_lbl[2] = buf[3];
+		lowpan_set_tc(&hdr, lowpan_iphc_tc(buf[0]));
+		break;
+	case LOWPAN_IPHC_TF_ECN_FL:
+		if (lowpan_fetch_skb(skb, buf, 3))
+			return -EINVAL;
+		hdr.flow_lbl[0] = buf[0] & 0x0f;
+		hdr.flow_lbl[1] = buf[1];
+		hdr.flow_lbl[2] = buf[2];
+		lowpan_set_tc(&hdr, buf[0] >> 6);
+		break;
+	case LOWPAN_IPHC_TF_ECN_DSCP:
+		if (lowpan_fetch_skb(skb, buf, 1))
+			return -EINVAL;
+		lowpan_set_tc(&hdr, lowpan_iphc_tc(buf[0]));
+		break;
+	}
+
+	if (!(iphc0 & LOWPAN_IPHC_NH) &&
+	    lowpan_fetch_skb(skb, &hdr.nexthdr, 1))
+		return -EINVAL;
+
+	if ((iphc0 & LOWPAN_IPHC_HLIM) == LOWPAN_IPHC_HLIM_INLINE) {
+		if (lowpan_fetch_skb(skb, &hdr.hop_limit, 1))
+			return -EINVAL;
+	} else
+		hdr.hop_limit = hlim[iphc0 & LOWPAN_IPHC_HLIM];
+
+	if (iphc1 & LOWPAN_IPHC_SAC) {
+		/* only the unspecified address is context free */
+		if (iphc1 & LOWPAN_IPHC_SAM)
+			return -EINVAL;
+	} else {
+		err = lowpan_uncompress_addr(skb, &hdr.saddr,
+				(iphc1 & LOWPAN_IPHC_SAM) >> LOWPAN_IPHC_SAM_SHIFT,
+				&mac_cb(skb)->sa);
+		if (err)
+			return err;
+	}
+
+	if (iphc1 & LOWPAN_IPHC_M)
+		err = lowpan_uncompress_mcast(skb, &hdr.daddr,
+				iphc1 & LOWPAN_IPHC_DAM);
+	else
+		err = lowpan_uncompress_addr(skb, &hdr.daddr,
+				iphc1 & LOWPAN_IPHC_DAM, &mac_cb(skb)->da);
+	if (err)
+		return err;
+
+	if (iphc0 & LOWPAN_IPHC_NH) {
+		err = lowpan_uncompress_udp(skb, &uh);
+		if (err)
+			return err;
+		hdr.nexthdr = IPPROTO_UDP;
+		hlen += sizeof(uh);
+	}
+
+	total = dgram_size ? dgram_size : skb->len + hlen;
+	if (total < hlen)
+		return -EINVAL;
+
+	hdr.payload_len = htons(total - sizeof(hdr));
+	uh.len = hdr.payload_len;
+
+	/* only reallocates if the frame is shared with other slaves */
+	if (skb_cow_head(skb, hlen))
+		return -ENOMEM;
+
+	if (iphc0 & LOWPAN_IPHC_NH) {
+		memcpy(skb_push(skb, sizeof(uh)), &uh, sizeof(uh));
+		skb_reset_transport_header(skb);
+	}
+
+	memcpy(skb_push(skb, sizeof(hdr)), &hdr, sizeof(hdr));
+	skb_reset_network_header(skb);
+
+	return 0;
+}
+
+/* Leaves an uncompressed IPv6 header at skb->data */
+static int lowpan_rcv_header(struct sk_buff *skb, u16 dgram_size)
+{
+	if (!skb->len)
+		return -EINVAL;
+
+	if (skb->data[0] == LOWPAN_DISPATCH_IPV6) {
+		skb_pull(skb, 1);
+		return 0;
+	}
+
+	if ((skb->data[0] & LOWPAN_DISPATCH_IPHC_MASK) == LOWPAN_DISPATCH_IPHC)
+		return lowpan_iphc_decompress(skb, dgram_size);
+
+	pr_debug("%s(): unknown dispatch %#x\n", __func__, skb->data[0]);
+	return -EINVAL;
+}
+
+static int lowpan_give_skb(struct sk_buff *skb, struct net_device *ldev)
+{
+	skb->protocol = htons(ETH_P_IPV6);
+	skb->dev = ldev;
+	skb_reset_network_header(skb);
+
+	ldev->stats.rx_packets++;
+	ldev->stats.rx_bytes += skb->len;
+
+	return netif_rx(skb);
+}
+
+static int lowpan_frag_rcv(struct sk_buff *skb, struct net_device *ldev,
+		u8 type)
+{
+	struct lowpan_fragment *frag, *dead = NULL, *evicted = NULL;
+	struct sk_buff *complete = NULL;
+	unsigned int hlen, hash, offset = 0, i, last;
+	u16 size, tag;
+
+	hlen = (type == LOWPAN_DISPATCH_FRAG1) ?
+		LOWPAN_FRAG1_HEAD_SIZE : LOWPAN_FRAGN_HEAD_SIZE;
+	if (!pskb_may_pull(skb, hlen))
+		goto drop;
+
+	size = ((skb->data[0] & 0x07) << 8) | skb->data[1];
+	tag = (skb->data[2] << 8) | skb->data[3];
+	if (type == LOWPAN_DISPATCH_FRAGN)
+		offset = skb->data[4] << 3;
+	skb_pull(skb, hlen);
+
+	if (type == LOWPAN_DISPATCH_FRAG1 && lowpan_rcv_header(skb, size))
+		goto drop;
+
+	if (size < sizeof(struct ipv6hdr) || !skb->len ||
+	    offset + skb->len > size)
+		goto drop;
+
+	/* all but the last fragment have to cover whole 8 octet units */
+	if (offset + skb->len < size && (skb->len & 7))
+		goto drop;
+
+	hash = lowpan_frag_hashfn(tag, &mac_cb(skb)->sa);
+
+	spin_lock_bh(&lowpan_frag_lock);
+
+	frag = lowpan_frag_find(hash, tag, size, &mac_cb(skb)->sa);
+	if (!frag) {
+		if (lowpan_frag_count >= LOWPAN_FRAG_MAX_ENTRIES) {
+			evicted = list_first_entry(&lowpan_frag_list,
+					struct lowpan_fragment, list);
+			lowpan_frag_unlink(evicted);
+		}
+
+		frag = lowpan_frag_create(hash, tag, size, skb);
+		if (!frag)
+			goto unlock;
+	}
+
+	if (skb_copy_bits(skb, 0, frag->skb->data + offset, skb->len))
+		goto unlock;
+
+	last = DIV_ROUND_UP(offset + skb->len, 8);
+	for (i = offset >> 3; i < last; i++)
+		if (!__test_and_set_bit(i, frag->units))
+			frag->units_rcv++;
+
+	if (frag->units_rcv == DIV_ROUND_UP(size, 8)) {
+		complete = frag->skb;
+		frag->skb = NULL;
+		lowpan_frag_unlink(frag);
+		dead = frag;
+	}
+
+unlock:
+	spin_unlock_bh(&lowpan_frag_lock);
+
+	if (evicted) {
+		pr_debug("%s(): cache full, dropping tag %#x\n",
+				__func__, evicted->tag);
+		lowpan_frag_destroy(evicted);
+	}
+	if (dead)
+		lowpan_frag_destroy(dead);
+
+	consume_skb(skb);
+
+	if (complete)
+		return lowpan_give_skb(complete, ldev);
+
+	return NET_RX_SUCCESS;
+
+drop:
+	kfree_skb(skb);
+	return NET_RX_DROP;
+}
+
+static int lowpan_rcv(struct sk_buff *skb, struct net_device *dev,
+		struct packet_type *pt, struct net_device *orig_dev)
+{
+	struct net_device *ldev;
+	u8 dispatch;
+
+	if (dev->type != ARPHRD_IEEE802154)
+		goto drop;
+
+	ldev = lowpan_find_dev(dev);
+	if (!ldev || !netif_running(ldev))
+		goto drop;
+
+	if (skb->pkt_type == PACKET_OTHERHOST)
+		goto drop;
+
+	skb = skb_share_check(skb, GFP_ATOMIC);
+	if (!skb)
+		return NET_RX_DROP;
+
+	if (!skb->len)
+		goto drop;
+
+	dispatch = skb->data[0] & LOWPAN_DISPATCH_FRAG_MASK;
+	if (dispatch == LOWPAN_DISPATCH_FRAG1 ||
+	    dispatch == LOWPAN_DISPATCH_FRAGN)
+		return lowpan_frag_rcv(skb, ldev, dispatch);
+
+	if (lowpan_rcv_header(skb, 0))
+		goto drop;
+
+	return lowpan_give_skb(skb, ldev);
+
+drop:
+	kfree_skb(skb);
+	return NET_RX_DROP;
+}
+
+/*
+ * Header compression
+ */
+static int lowpan_is_zero(const u8 *p, int len)
+{
+	while (len--)
+		if (*p++)
+			return 0;
+	return 1;
+}
+
+static u8 lowpan_compress_addr(u8 **hc, const struct in6_addr *ipaddr,
+		const struct ieee802154_addr *lladdr)
+{
+	u8 iid[8];
+
+	if (ipaddr->s6_addr32[0] != htonl(0xfe800000) ||
+	    ipaddr->s6_addr32[1]) {
+		memcpy(*hc, ipaddr->s6_addr, 16);
+		*hc += 16;
+		return LOWPAN_IPHC_ADDR_128;
+	}
+
+	if (!lowpan_iid_from_mac(iid, lladdr) &&
+	    !memcmp(&ipaddr->s6_addr[8], iid, 8))
+		return LOWPAN_IPHC_ADDR_0;
+
+	if (ipaddr->s6_addr32[2] == htonl(0x000000ff) &&
+	    ipaddr->s6_addr16[6] == htons(0xfe00)) {
+		memcpy(*hc, &ipaddr->s6_addr[14], 2);
+		*hc += 2;
+		return LOWPAN_IPHC_ADDR_16;
+	}
+
+	memcpy(*hc, &ipaddr->s6_addr[8], 8);
+	*hc += 8;
+	return LOWPAN_IPHC_ADDR_64;
+}
+
+static u8 lowpan_compress_mcast(u8 **hc, const struct in6_addr *ipaddr)
+{
+	const u8 *a = ipaddr->s6_addr;
+
+	if (a[1] == 0x02 && lowpan_is_zero(&a[2], 13)) {
+		*(*hc)++ = a[15];
+		return LOWPAN_IPHC_MCAST_8;
+	}
+
+	if (lowpan_is_zero(&a[2], 11)) {
+		*(*hc)++ = a[1];
+		memcpy(*hc, &a[13], 3);
+		*hc += 3;
+		return LOWPAN_IPHC_MCAST_32;
+	}
+
+	if (lowpan_is_zero(&a[2], 9)) {
+		*(*hc)++ = a[1];
+		memcpy(*hc, &a[11], 5);
+		*hc += 5;
+		return LOWPAN_IPHC_MCAST_48;
+	}
+
+	memcpy(*hc, a, 16);
+	*hc += 16;
+	return LOWPAN_IPHC_MCAST_128;
+}
+
+static void lowpan_compress_udp(u8 **hc, const struct udphdr *uh)
+{
+	u16 sport = ntohs(uh->source), dport = ntohs(uh->dest);
+	u8 *p = *hc;
+
+	if ((sport & LOWPAN_NHC_UDP_4BIT_MASK) == LOWPAN_NHC_UDP_4BIT_PORT &&
+	    (dport & LOWPAN_NHC_UDP_4BIT_MASK) == LOWPAN_NHC_UDP_4BIT_PORT) {
+		*p++ = LOWPAN_NHC_UDP_ID | LOWPAN_NHC_UDP_PORTS_4;
+		*p++ = ((sport & 0x0f) << 4) | (dport & 0x0f);
+	} else if ((dport & LOWPAN_NHC_UDP_8BIT_MASK) ==
+			LOWPAN_NHC_UDP_8BIT_PORT) {
+		*p++ = LOWPAN_NHC_UDP_ID | LOWPAN_NHC_UDP_PORTS_DST8;
+		memcpy(p, &uh->source, 2);
+		p += 2;
+		*p++ = dport & 0xff;
+	} else if ((sport & LOWPAN_NHC_UDP_8BIT_MASK) ==
+			LOWPAN_NHC_UDP_8BIT_PORT) {
+		*p++ = LOWPAN_NHC_UDP_ID | LOWPAN_NHC_UDP_PORTS_SRC8;
+		*p++ = sport & 0xff;
+		memcpy(p, &uh->dest, 2);
+		p += 2;
+	} else {
+		*p++ = LOWPAN_NHC_UDP_ID | LOWPAN_NHC_UDP_PORTS_INLINE;
+		memcpy(p, &uh->source, 4);
+		p += 4;
+	}
+
+	/* checksum is always carried inline */
+	memcpy(p, &uh->check, 2);
+	p += 2;
+
+	*hc = p;
+}
+
+static int lowpan_header_create(struct sk_buff *skb,
+			   struct net_device *dev,
+			   unsigned short type, const void *_daddr,
+			   const void *_saddr, unsigned len)
+{
+	struct net_device *real_dev = lowpan_dev_info(dev)->real_dev;
+	const u8 *saddr = _saddr, *daddr = _daddr;
+	struct ieee802154_addr sa, da;
+	u8 head[LOWPAN_IPHC_MAX_HC_LEN];
+	u8 *hc = head + 2;
+	struct ipv6hdr *hdr;
+	unsigned int ip_len;
+	u8 iphc0, iphc1, tc;
+	int udp;
+
+	if (type != ETH_P_IPV6)
+		return -EINVAL;
+
+	if (!daddr)
+		return -EINVAL;
+
+	if (!saddr)
+		saddr = dev->dev_addr;
+
+	sa.addr_type = IEEE802154_ADDR_LONG;
+	sa.pan_id = ieee802154_mlme_ops(real_dev)->get_pan_id(real_dev);
+	memcpy(sa.hwaddr, saddr, IEEE802154_ADDR_LEN);
+
+	da.pan_id = sa.pan_id;
+	if (!memcmp(daddr, dev->broadcast, IEEE802154_ADDR_LEN)) {
+		da.addr_type = IEEE802154_ADDR_SHORT;
+		da.short_addr = IEEE802154_ADDR_BROADCAST;
+	} else {
+		da.addr_type = IEEE802154_ADDR_LONG;
+		memcpy(da.hwaddr, daddr, IEEE802154_ADDR_LEN);
+	}
+
+	hdr = ipv6_hdr(skb);
+	iphc0 = LOWPAN_DISPATCH_IPHC;
+	iphc1 = 0;
+
+	tc = (hdr->priority << 4) | (hdr->flow_lbl[0] >> 4);
+	/* reorder to ECN + DSCP */
+	tc = ((tc & 0x03) << 6) | (tc >> 2);
+
+	if (!(hdr->flow_lbl[0] & 0x0f) && !hdr->flow_lbl[1] &&
+	    !hdr->flow_lbl[2]) {
+		if (!tc)
+			iphc0 |= LOWPAN_IPHC_TF_NONE << LOWPAN_IPHC_TF_SHIFT;
+		else {
+			iphc0 |= LOWPAN_IPHC_TF_ECN_DSCP <<
+				LOWPAN_IPHC_TF_SHIFT;
+			*hc++ = tc;
+		}
+	} else if (!(tc & 0x3f)) {
+		iphc0 |= LOWPAN_IPHC_TF_ECN_FL << LOWPAN_IPHC_TF_SHIFT;
+		*hc++ = (tc & 0xc0) | (hdr->flow_lbl[0] & 0x0f);
+		*hc++ = hdr->flow_lbl[1];
+		*hc++ = hdr->flow_lbl[2];
+	} else {
+		iphc0 |= LOWPAN_IPHC_TF_ALL << LOWPAN_IPHC_TF_SHIFT;
+		*hc++ = tc;
+		*hc++ = hdr->flow_lbl[0] & 0x0f;
+		*hc++ = hdr->flow_lbl[1];
+		*hc++ = hdr->flow_lbl[2];
+	}
+
+	udp = hdr->nexthdr == IPPROTO_UDP &&
+		skb_headlen(skb) >= sizeof(*hdr) + sizeof(struct udphdr);
+	if (udp)
+		iphc0 |= LOWPAN_IPHC_NH;
+	else
+		*hc++ = hdr->nexthdr;
+
+	switch (hdr->hop_limit) {
+	case 1:
+		iphc0 |= LOWPAN_IPHC_HLIM_1;
+		break;
+	case 64:
+		iphc0 |= LOWPAN_IPHC_HLIM_64;
+		break;
+	case 255:
+		iphc0 |= LOWPAN_IPHC_HLIM_255;
+		break;
+	default:
+		*hc++ = hdr->hop_limit;
+	}
+
+	if (ipv6_addr_any(&hdr->saddr))
+		iphc1 |= LOWPAN_IPHC_SAC;
+	else
+		iphc1 |= lowpan_compress_addr(&hc, &hdr->saddr, &sa) <<
+			LOWPAN_IPHC_SAM_SHIFT;
+
+	if (hdr->daddr.s6_addr[0] == 0xff)
+		iphc1 |= LOWPAN_IPHC_M |
+			lowpan_compress_mcast(&hc, &hdr->daddr);
+	else
+		iphc1 |= lowpan_compress_addr(&hc, &hdr->daddr, &da);
+
+	ip_len = sizeof(*hdr);
+	if (udp) {
+		lowpan_compress_udp(&hc, (struct udphdr *)(hdr + 1));
+		ip_len += sizeof(struct udphdr);
+	}
+
+	head[0] = iphc0;
+	head[1] = iphc1;
+
+	/* compressed headers are never longer than the original ones */
+	skb_pull(skb, ip_len);
+	memcpy(skb_push(skb, hc - head), head, hc - head);
+	skb_reset_network_header(skb);
+
+	mac_cb(skb)->flags = IEEE802154_FC_TYPE_DATA;
+	if (da.addr_type == IEEE802154_ADDR_LONG)
+		mac_cb(skb)->flags |= MAC_CB_FLAG_ACKREQ;
+	mac_cb(skb)->seq = ieee802154_mlme_ops(real_dev)->get_dsn(real_dev);
+
+	return dev_hard_header(skb, real_dev, type, &da, &sa, skb->len);
+}
+
+/*
+ * Fragmentation
+ */
+
+/* Room for MAC header and payload in a single frame, FCS excluded */
+static inline int lowpan_frame_room(const struct net_device *real_dev)
+{
+	return real_dev->mtu - real_dev->needed_tailroom;
+}
+
+/*
+ * Length of the IPHC (+ UDP NHC) encoding we produced at @hc and of
+ * the headers it stands for.
+ */
+static int lowpan_iphc_len(const u8 *hc, int len, unsigned int *ip_len)
+{
+	static const u8 tf_len[] = { 4, 3, 1, 0 };
+	static const u8 addr_len[] = { 16, 8, 2, 0 };
+	static const u8 mcast_len[] = { 16, 6, 4, 1 };
+	static const u8 ports_len[] = { 4, 3, 3, 1 };
+	u8 nhc;
+	int n;
+
+	if (len < 2 ||
+	    (hc[0] & LOWPAN_DISPATCH_IPHC_MASK) != LOWPAN_DISPATCH_IPHC)
+		return -EINVAL;
+
+	n = 2 + tf_len[(hc[0] & LOWPAN_IPHC_TF) >> LOWPAN_IPHC_TF_SHIFT];
+	if (!(hc[0] & LOWPAN_IPHC_NH))
+		n++;
+	if ((hc[0] & LOWPAN_IPHC_HLIM) == LOWPAN_IPHC_HLIM_INLINE)
+		n++;
+	if (!(hc[1] & LOWPAN_IPHC_SAC))
+		n += addr_len[(hc[1] & LOWPAN_IPHC_SAM) >>
+			LOWPAN_IPHC_SAM_SHIFT];
+	if (hc[1] & LOWPAN_IPHC_M)
+		n += mcast_len[hc[1] & LOWPAN_IPHC_DAM];
+	else
+		n += addr_len[hc[1] & LOWPAN_IPHC_DAM];
+
+	*ip_len = sizeof(struct ipv6hdr);
+
+	if (hc[0] & LOWPAN_IPHC_NH) {
+		if (n >= len)
+			return -EINVAL;
+		nhc = hc[n];
+		n += 1 + ports_len[nhc & LOWPAN_NHC_UDP_PORTS];
+		if (!(nhc & LOWPAN_NHC_UDP_CSUM))
+			n += 2;
+		*ip_len += sizeof(struct udphdr);
+	}
+
+	return n > len ? -EINVAL : n;
+}
+
+static int lowpan_xmit_fragment(struct sk_buff *skb,
+		struct net_device *real_dev, const u8 *head, int hlen,
+		int mhr_len, int offset, int len)
+{
+	struct sk_buff *frag;
+	int err;
+
+	frag = alloc_skb(real_dev->needed_headroom + mhr_len + hlen + len +
+			real_dev->needed_tailroom, GFP_ATOMIC);
+	if (!frag)
+		return -ENOMEM;
+
+	skb_reserve(frag, real_dev->needed_headroom);
+	skb_reset_mac_header(frag);
+
+	memcpy(skb_put(frag, mhr_len), skb->data, mhr_len);
+	/* every fragment is a frame of its own: FC(2) DSN(1) ... */
+	frag->data[2] = ieee802154_mlme_ops(real_dev)->get_dsn(real_dev);
+
+	skb_set_network_header(frag, mhr_len);
+	memcpy(skb_put(frag, hlen), head, hlen);
+
+	err = skb_copy_bits(skb, offset, skb_put(frag, len), len);
+	if (err) {
+		kfree_skb(frag);
+		return err;
+	}
+
+	memcpy(frag->cb, skb->cb, sizeof(frag->cb));
+	frag->priority = skb->priority;
+	frag->protocol = htons(ETH_P_IEEE802154);
+	frag->dev = real_dev;
+
+	return net_xmit_errno(dev_queue_xmit(frag));
+}
+
+static int lowpan_fragment_xmit(struct sk_buff *skb, struct net_device *dev)
+{
+	struct lowpan_dev_info *info = lowpan_dev_info(dev);
+	struct net_device *real_dev = info->real_dev;
+	int mhr_len = skb_network_offset(skb);
+	int room = lowpan_frame_room(real_dev) - mhr_len;
+	unsigned int ip_len;
+	int hc_len, dgram_size, offset, chunk, len, err;
+	u8 head[LOWPAN_FRAGN_HEAD_SIZE];
+	u16 tag;
+
+	hc_len = lowpan_iphc_len(skb_network_header(skb),
+			skb->len - mhr_len, &ip_len);
+	if (hc_len < 0)
+		return hc_len;
+
+	dgram_size = skb->len - mhr_len - hc_len + ip_len;
+	if (dgram_size > LOWPAN_FRAG_SIZE_MAX)
+		return -EMSGSIZE;
+
+	/*
+	 * FRAG1 carries the compressed headers, its share of the
+	 * uncompressed datagram must end on an 8 octet boundary.
+	 */
+	offset = (room - LOWPAN_FRAG1_HEAD_SIZE - hc_len + ip_len) & ~7;
+	chunk = (room - LOWPAN_FRAGN_HEAD_SIZE) & ~7;
+	if (offset <= (int)ip_len || chunk <= 0)
+		return -EMSGSIZE;
+
+	tag = info->fragment_tag++;
+
+	head[0] = LOWPAN_DISPATCH_FRAG1 | ((dgram_size >> 8) & 0x07);
+	head[1] = dgram_size & 0xff;
+	head[2] = tag >> 8;
+	head[3] = tag & 0xff;
+
+	err = lowpan_xmit_fragment(skb, real_dev, head, LOWPAN_FRAG1_HEAD_SIZE,
+			mhr_len, mhr_len, hc_len + offset - ip_len);
+
+	head[0] = LOWPAN_DISPATCH_FRAGN | ((dgram_size >> 8) & 0x07);
+
+	while (!err && offset < dgram_size) {
+		len = min(chunk, dgram_size - offset);
+		head[4] = offset >> 3;
+
+		err = lowpan_xmit_fragment(skb, real_dev, head,
+				LOWPAN_FRAGN_HEAD_SIZE, mhr_len,
+				mhr_len + hc_len + offset - ip_len, len);
+		offset += len;
+	}
+
+	return err;
+}
+
+static netdev_tx_t lowpan_xmit(struct sk_buff *skb, struct net_device *dev)
+{
+	struct net_device *real_dev = lowpan_dev_info(dev)->real_dev;
+	int err;
+
+	dev->stats.tx_packets++;
+	dev->stats.tx_bytes += skb->len;
+
+	if (skb->len <= lowpan_frame_room(real_dev)) {
+		skb->dev = real_dev;
+		err = net_xmit_errno(dev_queue_xmit(skb));
+	} else {
+		err = lowpan_fragment_xmit(skb, dev);
+		dev_kfree_skb(skb);
+	}
+
+	if (err) {
+		pr_debug("%s(): xmit failed: %d\n", __func__, err);
+		dev->stats.tx_errors++;
+	}
+
+	return NETDEV_TX_OK;
+}
+
+static const struct header_ops lowpan_header_ops = {
+	.create		= lowpan_header_create,
+};
+
+static const struct net_device_ops lowpan_netdev_ops = {
+	.ndo_start_xmit		= lowpan_xmit,
+};
+
+static void lowpan_setup(struct net_device *dev)
+{
+	dev->addr_len		= IEEE802154_ADDR_LEN;
+	memset(dev->broadcast, 0xff, IEEE802154_ADDR_LEN);
+	dev->type		= ARPHRD_6LOWPAN;
+	/* Frame Control + Sequence Number + Address fields + Security Header */
+	dev->hard_header_len	= 2 + 1 + 20 + 14;
+	dev->needed_tailroom	= 2; /* FCS */
+	dev->mtu		= IPV6_MIN_MTU;
+	dev->tx_queue_len	= 0;
+	dev->flags		= IFF_BROADCAST | IFF_MULTICAST;
+	dev->watchdog_timeo	= 0;
+
+	dev->netdev_ops		= &lowpan_netdev_ops;
+	dev->header_ops		= &lowpan_header_ops;
+	dev->destructor		= free_netdev;
+}
+
+static int lowpan_validate(struct nlattr *tb[], struct nlattr *data[])
+{
+	if (tb[IFLA_ADDRESS] &&
+	    nla_len(tb[IFLA_ADDRESS]) != IEEE802154_ADDR_LEN)
+		return -EINVAL;
+
+	return 0;
+}
+
+static int lowpan_newlink(struct net *src_net, struct net_device *dev,
+		struct nlattr *tb[], struct nlattr *data[])
+{
+	struct lowpan_dev_info *info = lowpan_dev_info(dev);
+	struct net_device *real_dev;
+	int err;
+
+	ASSERT_RTNL();
+
+	if (!tb[IFLA_LINK])
+		return -EINVAL;
+
+	real_dev = dev_get_by_index(src_net, nla_get_u32(tb[IFLA_LINK]));
+	if (!real_dev)
+		return -ENODEV;
+
+	if (real_dev->type != ARPHRD_IEEE802154) {
+		err = -EINVAL;
+		goto out_put;
+	}
+
+	if (lowpan_find_dev(real_dev)) {
+		err = -EBUSY;
+		goto out_put;
+	}
+
+	info->real_dev = real_dev;
+	info->ldev = dev;
+	get_random_bytes(&info->fragment_tag, sizeof(info->fragment_tag));
+
+	if (!tb[IFLA_ADDRESS])
+		memcpy(dev->dev_addr, real_dev->dev_addr, IEEE802154_ADDR_LEN);
+	dev->needed_headroom = real_dev->needed_headroom;
+
+	err = register_netdevice(dev);
+	if (err < 0)
+		goto out_put;
+
+	list_add_tail_rcu(&info->list, &lowpan_devices);
+
+	return 0;
+
+out_put:
+	dev_put(real_dev);
+	return err;
+}
+
+static void lowpan_dellink(struct net_device *dev, struct list_head *head)
+{
+	struct lowpan_dev_info *info = lowpan_dev_info(dev);
+
+	ASSERT_RTNL();
+
+	list_del_rcu(&info->list);
+	unregister_netdevice_queue(dev, head);
+
+	dev_put(info->real_dev);
+}
+
+static struct rtnl_link_ops lowpan_link_ops __read_mostly = {
+	.kind		= "lowpan",
+	.priv_size	= sizeof(struct lowpan_dev_info),
+	.setup		= lowpan_setup,
+	.newlink	= lowpan_newlink,
+	.dellink	= lowpan_dellink,
+	.validate	= lowpan_validate,
+};
+
+static int lowpan_device_event(struct notifier_block *unused,
+		unsigned long event, void *ptr)
+{
+	struct net_device *dev = ptr;
+	struct lowpan_dev_info *info, *tmp;
+	LIST_HEAD(del_list);
+
+	if (dev->type != ARPHRD_IEEE802154 || event != NETDEV_UNREGISTER)
+		return NOTIFY_DONE;
+
+	list_for_each_entry_safe(info, tmp, &lowpan_devices, list)
+		if (info->real_dev == dev)
+			lowpan_dellink(info->ldev, &del_list);
+
+	unregister_netdevice_many(&del_list);
+
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block lowpan_dev_notifier = {
+	.notifier_call = lowpan_device_event,
+};
+
+static struct packet_type lowpan_packet_type = {
+	.type = __constant_htons(ETH_P_IEEE802154),
+	.func = lowpan_rcv,
+};
+
+static int __init lowpan_init_module(void)
+{
+	int err;
+
+	get_random_bytes(&lowpan_frag_rnd, sizeof(lowpan_frag_rnd));
+
+	err = rtnl_link_register(&lowpan_link_ops);
+	if (err < 0)
+		goto out;
+
+	err = register_netdevice_notifier(&lowpan_dev_notifier);
+	if (err < 0)
+		goto out_link;
+
+	dev_add_pack(&lowpan_packet_type);
+
+	return 0;
+
+out_link:
+	rtnl_link_unregister(&lowpan_link_ops);
+out:
+	return err;
+}
+module_init(lowpan_init_module);
+
+static void __exit lowpan_cleanup_module(void)
+{
+	dev_remove_pack(&lowpan_packet_type);
+	unregister_netdevice_notifier(&lowpan_dev_notifier);
+	rtnl_link_unregister(&lowpan_link_ops);
+
+	lowpan_frag_flush();
+}
+module_exit(lowpan_cleanup_module);
+
+MODULE_LICENSE("GPL");
+MODULE_ALIAS_RTNL_LINK("lowpan");
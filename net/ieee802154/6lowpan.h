@@ -0,0 +1,124 @@
+/*
+ * Copyright 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __6LOWPAN_H__
+#define __6LOWPAN_H__
+
+/*
+ * Dispatch values, RFC 4944 section 5.1 and RFC 6282 section 3.
+ */
+#define LOWPAN_DISPATCH_IPV6		0x41 /* 01000001 = 65 */
+#define LOWPAN_DISPATCH_IPHC		0x60 /* 011xxxxx = ... */
+#define LOWPAN_DISPATCH_IPHC_MASK	0xe0
+#define LOWPAN_DISPATCH_FRAG1		0xc0 /* 11000xxx */
+#define LOWPAN_DISPATCH_FRAGN		0xe0 /* 11100xxx */
+#define LOWPAN_DISPATCH_FRAG_MASK	0xf8
+
+#define LOWPAN_FRAG1_HEAD_SIZE		4
+#define LOWPAN_FRAGN_HEAD_SIZE		5
+
+/* Largest datagram_size representable in a fragment header */
+#define LOWPAN_FRAG_SIZE_MAX		0x7ff
+
+/* RFC 4944: reassembly of a datagram is abandoned after 60 seconds */
+#define LOWPAN_FRAG_TIMEOUT		(HZ * 60)
+#define LOWPAN_FRAG_HASH_SHIFT		6
+#define LOWPAN_FRAG_HASH_SIZE		(1 << LOWPAN_FRAG_HASH_SHIFT)
+#define LOWPAN_FRAG_MAX_ENTRIES		32
+/* fragment offsets are counted in 8 octet units */
+#define LOWPAN_FRAG_UNITS		((LOWPAN_FRAG_SIZE_MAX + 1) / 8)
+
+/*
+ * IPHC encoding, first octet:
+ *   0   1   2   3   4   5   6   7
+ * +---+---+---+---+---+---+---+---+
+ * | 0 | 1 | 1 |  TF   |NH | HLIM  |
+ * +---+---+---+---+---+---+---+---+
+ */
+#define LOWPAN_IPHC_TF			0x18
+#define LOWPAN_IPHC_TF_SHIFT		3
+#define LOWPAN_IPHC_NH			0x04
+#define LOWPAN_IPHC_HLIM		0x03
+
+/* TF values */
+#define LOWPAN_IPHC_TF_ALL		0x0 /* ECN + DSCP + 4 bit pad + FL */
+#define LOWPAN_IPHC_TF_ECN_FL		0x1 /* ECN + 2 bit pad + FL */
+#define LOWPAN_IPHC_TF_ECN_DSCP		0x2 /* ECN + DSCP, FL elided */
+#define LOWPAN_IPHC_TF_NONE		0x3 /* everything elided */
+
+/* HLIM values */
+#define LOWPAN_IPHC_HLIM_INLINE		0x0
+#define LOWPAN_IPHC_HLIM_1		0x1
+#define LOWPAN_IPHC_HLIM_64		0x2
+#define LOWPAN_IPHC_HLIM_255		0x3
+
+/*
+ * IPHC encoding, second octet:
+ *   0   1   2   3   4   5   6   7
+ * +---+---+---+---+---+---+---+---+
+ * |CID|SAC|  SAM  | M |DAC|  DAM  |
+ * +---+---+---+---+---+---+---+---+
+ */
+#define LOWPAN_IPHC_CID			0x80
+#define LOWPAN_IPHC_SAC			0x40
+#define LOWPAN_IPHC_SAM			0x30
+#define LOWPAN_IPHC_SAM_SHIFT		4
+#define LOWPAN_IPHC_M			0x08
+#define LOWPAN_IPHC_DAC			0x04
+#define LOWPAN_IPHC_DAM			0x03
+
+/* SAM/DAM values for stateless unicast addresses */
+#define LOWPAN_IPHC_ADDR_128		0x0 /* full address inline */
+#define LOWPAN_IPHC_ADDR_64		0x1 /* fe80::/64 + 64 bit IID */
+#define LOWPAN_IPHC_ADDR_16		0x2 /* fe80::ff:fe00:XXXX */
+#define LOWPAN_IPHC_ADDR_0		0x3 /* derived from the MAC header */
+
+/* DAM values for multicast addresses (M = 1, DAC = 0) */
+#define LOWPAN_IPHC_MCAST_128		0x0 /* full address inline */
+#define LOWPAN_IPHC_MCAST_48		0x1 /* ffXX::00XX:XXXX:XXXX */
+#define LOWPAN_IPHC_MCAST_32		0x2 /* ffXX::00XX:XXXX */
+#define LOWPAN_IPHC_MCAST_8		0x3 /* ff02::00XX */
+
+/*
+ * UDP next header compression, RFC 6282 section 4.3.3:
+ *   0   1   2   3   4   5   6   7
+ * +---+---+---+---+---+---+---+---+
+ * | 1 | 1 | 1 | 1 | 0 | C |   P   |
+ * +---+---+---+---+---+---+---+---+
+ */
+#define LOWPAN_NHC_UDP_ID		0xf0
+#define LOWPAN_NHC_UDP_MASK		0xf8
+#define LOWPAN_NHC_UDP_CSUM		0x04
+#define LOWPAN_NHC_UDP_PORTS		0x03
+
+#define LOWPAN_NHC_UDP_PORTS_INLINE	0x0 /* both ports inline */
+#define LOWPAN_NHC_UDP_PORTS_DST8	0x1 /* dst port 0xf0XX */
+#define LOWPAN_NHC_UDP_PORTS_SRC8	0x2 /* src port 0xf0XX */
+#define LOWPAN_NHC_UDP_PORTS_4		0x3 /* both ports 0xf0bX */
+
+#define LOWPAN_NHC_UDP_8BIT_PORT	0xf000
+#define LOWPAN_NHC_UDP_8BIT_MASK	0xff00
+#define LOWPAN_NHC_UDP_4BIT_PORT	0xf0b0
+#define LOWPAN_NHC_UDP_4BIT_MASK	0xfff0
+
+/*
+ * Worst case of the compressed headers: IPHC with everything inline
+ * (2 + 4 + 1 + 1 + 16 + 16) plus inline UDP ports and checksum (1 + 4 + 2).
+ */
+#define LOWPAN_IPHC_MAX_HC_LEN		47
+
+#endif /* __6LOWPAN_H__ */
@@ -29,6 +29,7 @@
 #include <net/af_ieee802154.h>
 #include <net/ieee802154.h>
 #include <net/ieee802154_netdev.h>
+#include <trace/events/ieee802154.h>
 
 #include <asm/ioctls.h>
 
@@ -348,6 +349,7 @@ int ieee802154_dgram_deliver(struct net_device *dev, struct sk_buff *skb)
 	struct hlist_node *node;
 	int ret = NET_RX_SUCCESS;
 	u16 pan_id, short_addr;
+	int socks = 0;
 
 	/* Data frame processing */
 	BUG_ON(dev->type != ARPHRD_IEEE802154);
@@ -367,9 +369,12 @@ int ieee802154_dgram_deliver(struct net_device *dev, struct sk_buff *skb)
 			}
 
 			prev = sk;
+			socks++;
 		}
 	}
 
+	trace_ieee802154_dgram_deliver(dev, skb, socks);
+
 	if (prev)
 		dgram_rcv_skb(prev, skb);
 	else {
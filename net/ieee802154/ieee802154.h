@@ -18,6 +18,9 @@
 #ifndef IEEE_802154_LOCAL_H
 #define IEEE_802154_LOCAL_H
 
+#include <linux/spinlock.h>
+#include <linux/timer.h>
+
 int __init ieee802154_nl_init(void);
 void __exit ieee802154_nl_exit(void);
 
@@ -39,15 +42,33 @@ void __exit ieee802154_nl_exit(void);
 	}
 
 struct genl_info;
+struct genl_multicast_group;
 
 struct sk_buff *ieee802154_nl_create(int flags, u8 req);
 int ieee802154_nl_mcast(struct sk_buff *msg, unsigned int group);
+
+struct ieee802154_nl_batch {
+	spinlock_t			lock;
+	struct sk_buff			*skb;
+	struct timer_list		timer;
+	struct genl_multicast_group	*grp;
+};
+
+void ieee802154_nl_batch_init(struct ieee802154_nl_batch *batch,
+		struct genl_multicast_group *grp);
+int ieee802154_nl_batch_add(struct ieee802154_nl_batch *batch, u8 req,
+		int (*fill)(struct sk_buff *msg, void *arg), void *arg);
+void ieee802154_nl_batch_flush(struct ieee802154_nl_batch *batch);
+void ieee802154_nl_batch_stop(struct ieee802154_nl_batch *batch);
+
 struct sk_buff *ieee802154_nl_new_reply(struct genl_info *info,
 		int flags, u8 req);
 int ieee802154_nl_reply(struct sk_buff *msg, struct genl_info *info);
 
 extern struct genl_family nl802154_family;
 int nl802154_mac_register(void);
+void nl802154_mac_unregister(void);
 int nl802154_phy_register(void);
+int nl802154_stats_register(void);
 
 #endif
@@ -28,8 +28,10 @@
 
 #include "ieee802154.h"
 
-static unsigned int ieee802154_seq_num;
-static DEFINE_SPINLOCK(ieee802154_seq_lock);
+/* Messages gathered in a batch are sent at the latest after this delay */
+#define IEEE802154_NL_BATCH_DELAY	(HZ / 10)
+
+static atomic_t ieee802154_seq_num;
 
 struct genl_family nl802154_family = {
 	.id		= GENL_ID_GENERATE,
@@ -44,15 +46,12 @@ struct sk_buff *ieee802154_nl_create(int flags, u8 req)
 {
 	void *hdr;
 	struct sk_buff *msg = nlmsg_new(NLMSG_GOODSIZE, GFP_ATOMIC);
-	unsigned long f;
 
 	if (!msg)
 		return NULL;
 
-	spin_lock_irqsave(&ieee802154_seq_lock, f);
-	hdr = genlmsg_put(msg, 0, ieee802154_seq_num++,
+	hdr = genlmsg_put(msg, 0, atomic_inc_return(&ieee802154_seq_num),
 			&nl802154_family, flags, req);
-	spin_unlock_irqrestore(&ieee802154_seq_lock, f);
 	if (!hdr) {
 		nlmsg_free(msg);
 		return NULL;
@@ -75,6 +74,107 @@ out:
 	return -ENOBUFS;
 }
 
+/*
+ * Multicast messages which may come in bursts, like beacon notifications
+ * during a scan, are packed into a single skb as a sequence of netlink
+ * messages. The skb is sent when it is full, when the timer fires or
+ * when ieee802154_nl_batch_flush() is called.
+ */
+static void ieee802154_nl_batch_send(struct ieee802154_nl_batch *batch,
+		struct sk_buff *skb)
+{
+	if (!skb)
+		return;
+
+	if (skb->len)
+		genlmsg_multicast(skb, 0, batch->grp->id, GFP_ATOMIC);
+	else
+		nlmsg_free(skb);
+}
+
+void ieee802154_nl_batch_flush(struct ieee802154_nl_batch *batch)
+{
+	struct sk_buff *skb;
+	unsigned long flags;
+
+	spin_lock_irqsave(&batch->lock, flags);
+	skb = batch->skb;
+	batch->skb = NULL;
+	spin_unlock_irqrestore(&batch->lock, flags);
+
+	ieee802154_nl_batch_send(batch, skb);
+}
+
+static void ieee802154_nl_batch_timer(unsigned long data)
+{
+	ieee802154_nl_batch_flush((struct ieee802154_nl_batch *)data);
+}
+
+void ieee802154_nl_batch_init(struct ieee802154_nl_batch *batch,
+		struct genl_multicast_group *grp)
+{
+	spin_lock_init(&batch->lock);
+	setup_timer(&batch->timer, ieee802154_nl_batch_timer,
+			(unsigned long)batch);
+	batch->skb = NULL;
+	batch->grp = grp;
+}
+
+int ieee802154_nl_batch_add(struct ieee802154_nl_batch *batch, u8 req,
+		int (*fill)(struct sk_buff *msg, void *arg), void *arg)
+{
+	struct sk_buff *full = NULL;
+	unsigned long flags;
+	void *hdr;
+	int rc;
+
+	spin_lock_irqsave(&batch->lock, flags);
+
+	for (;;) {
+		if (!batch->skb) {
+			batch->skb = nlmsg_new(NLMSG_GOODSIZE, GFP_ATOMIC);
+			if (!batch->skb) {
+				rc = -ENOBUFS;
+				break;
+			}
+		}
+
+		hdr = genlmsg_put(batch->skb, 0,
+				atomic_inc_return(&ieee802154_seq_num),
+				&nl802154_family, 0, req);
+		rc = hdr ? fill(batch->skb, arg) : -EMSGSIZE;
+		if (!rc) {
+			genlmsg_end(batch->skb, hdr);
+			if (!timer_pending(&batch->timer))
+				mod_timer(&batch->timer,
+					jiffies + IEEE802154_NL_BATCH_DELAY);
+			break;
+		}
+
+		if (hdr)
+			genlmsg_cancel(batch->skb, hdr);
+
+		/* Start over with an empty skb if this one is full */
+		if (rc != -EMSGSIZE || !batch->skb->len || full)
+			break;
+
+		full = batch->skb;
+		batch->skb = NULL;
+	}
+
+	spin_unlock_irqrestore(&batch->lock, flags);
+
+	ieee802154_nl_batch_send(batch, full);
+
+	return rc;
+}
+
+void ieee802154_nl_batch_stop(struct ieee802154_nl_batch *batch)
+{
+	del_timer_sync(&batch->timer);
+	ieee802154_nl_batch_flush(batch);
+}
+
 struct sk_buff *ieee802154_nl_new_reply(struct genl_info *info,
 		int flags, u8 req)
 {
@@ -124,6 +224,10 @@ int __init ieee802154_nl_init(void)
 	if (rc)
 		goto fail;
 
+	rc = nl802154_stats_register();
+	if (rc)
+		goto fail;
+
 	return 0;
 
 fail:
@@ -133,6 +237,7 @@ fail:
 
 void __exit ieee802154_nl_exit(void)
 {
+	nl802154_mac_unregister();
 	genl_unregister_family(&nl802154_family);
 }
 
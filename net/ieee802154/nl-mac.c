@@ -25,6 +25,7 @@
 #include <linux/kernel.h>
 #include <linux/if_arp.h>
 #include <linux/netdevice.h>
+#include <linux/rculist.h>
 #include <net/netlink.h>
 #include <net/genetlink.h>
 #include <net/sock.h>
@@ -34,6 +35,7 @@
 #include <net/ieee802154.h>
 #include <net/ieee802154_netdev.h>
 #include <net/wpan-phy.h>
+#include <trace/events/ieee802154.h>
 
 #include "ieee802154.h"
 
@@ -45,46 +47,215 @@ static struct genl_multicast_group ieee802154_beacon_mcgrp = {
 	.name		= IEEE802154_MCAST_BEACON_NAME,
 };
 
-int ieee802154_nl_assoc_indic(struct net_device *dev,
-		struct ieee802154_addr *addr, u8 cap)
+static struct ieee802154_nl_batch ieee802154_coord_batch;
+
+/*
+ * Indications are batched, confirms are sent right away. Flush pending
+ * indications first, so that e.g. the beacon notifications of a scan
+ * arrive before its confirm.
+ */
+static int ieee802154_nl_coord_mcast(struct sk_buff *msg)
 {
-	struct sk_buff *msg;
+	ieee802154_nl_batch_flush(&ieee802154_coord_batch);
 
-	pr_debug("%s\n", __func__);
+	return ieee802154_nl_mcast(msg, ieee802154_coord_mcgrp.id);
+}
 
-	if (addr->addr_type != IEEE802154_ADDR_LONG) {
-		pr_err("%s: received non-long source address!\n", __func__);
-		return -EINVAL;
+/*
+ * Kernel side event filter, set with IEEE802154_SET_EVENT_FILTER. As
+ * long as the list is empty all indications are sent. Otherwise only
+ * indications of the listed interfaces are, and beacon notifications
+ * only for the given PAN unless that is the broadcast PAN id.
+ */
+struct ieee802154_nl_filter {
+	struct list_head	list;
+	struct rcu_head		rcu;
+	int			ifindex;
+	u16			pan_id;
+};
+
+static LIST_HEAD(ieee802154_nl_filters);
+static DEFINE_SPINLOCK(ieee802154_nl_filter_lock);
+
+static bool ieee802154_nl_filter_pass(struct net_device *dev, u16 pan_id)
+{
+	struct ieee802154_nl_filter *f;
+	bool pass;
+
+	rcu_read_lock();
+	pass = list_empty(&ieee802154_nl_filters);
+	list_for_each_entry_rcu(f, &ieee802154_nl_filters, list) {
+		if (f->ifindex != dev->ifindex)
+			continue;
+
+		pass = f->pan_id == IEEE802154_PANID_BROADCAST ||
+			pan_id == IEEE802154_PANID_BROADCAST ||
+			f->pan_id == pan_id;
+		break;
 	}
+	rcu_read_unlock();
 
-	msg = ieee802154_nl_create(0, IEEE802154_ASSOCIATE_INDIC);
-	if (!msg)
-		return -ENOBUFS;
+	return pass;
+}
+
+static void ieee802154_nl_filter_free(struct rcu_head *head)
+{
+	kfree(container_of(head, struct ieee802154_nl_filter, rcu));
+}
+
+static void ieee802154_nl_filter_clear(void)
+{
+	struct ieee802154_nl_filter *f, *tmp;
+
+	spin_lock(&ieee802154_nl_filter_lock);
+	list_for_each_entry_safe(f, tmp, &ieee802154_nl_filters, list) {
+		list_del_rcu(&f->list);
+		call_rcu(&f->rcu, ieee802154_nl_filter_free);
+	}
+	spin_unlock(&ieee802154_nl_filter_lock);
+}
+
+/* Filters are keyed by ifindex, which a later device may reuse */
+static int ieee802154_nl_filter_event(struct notifier_block *unused,
+		unsigned long event, void *ptr)
+{
+	struct net_device *dev = ptr;
+	struct ieee802154_nl_filter *f, *tmp;
+
+	if (event != NETDEV_UNREGISTER)
+		return NOTIFY_DONE;
 
+	spin_lock(&ieee802154_nl_filter_lock);
+	list_for_each_entry_safe(f, tmp, &ieee802154_nl_filters, list) {
+		if (f->ifindex != dev->ifindex)
+			continue;
+
+		list_del_rcu(&f->list);
+		call_rcu(&f->rcu, ieee802154_nl_filter_free);
+	}
+	spin_unlock(&ieee802154_nl_filter_lock);
+
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block ieee802154_nl_filter_notifier = {
+	.notifier_call = ieee802154_nl_filter_event,
+};
+
+struct ieee802154_nl_indic {
+	struct net_device *dev;
+	struct ieee802154_addr *addr;
+	u16 panid;
+	u16 coord_addr;
+	u8 val;
+	u8 status;
+};
+
+static int ieee802154_nl_put_dev(struct sk_buff *msg, struct net_device *dev)
+{
 	NLA_PUT_STRING(msg, IEEE802154_ATTR_DEV_NAME, dev->name);
 	NLA_PUT_U32(msg, IEEE802154_ATTR_DEV_INDEX, dev->ifindex);
 	NLA_PUT(msg, IEEE802154_ATTR_HW_ADDR, IEEE802154_ADDR_LEN,
 			dev->dev_addr);
 
+	return 0;
+
+nla_put_failure:
+	return -EMSGSIZE;
+}
+
+static int ieee802154_nl_fill_assoc_indic(struct sk_buff *msg, void *arg)
+{
+	struct ieee802154_nl_indic *ind = arg;
+
+	if (ieee802154_nl_put_dev(msg, ind->dev))
+		goto nla_put_failure;
+
 	NLA_PUT(msg, IEEE802154_ATTR_SRC_HW_ADDR, IEEE802154_ADDR_LEN,
-			addr->hwaddr);
+			ind->addr->hwaddr);
 
-	NLA_PUT_U8(msg, IEEE802154_ATTR_CAPABILITY, cap);
+	NLA_PUT_U8(msg, IEEE802154_ATTR_CAPABILITY, ind->val);
 
-	return ieee802154_nl_mcast(msg, ieee802154_coord_mcgrp.id);
+	return 0;
 
 nla_put_failure:
-	nlmsg_free(msg);
-	return -ENOBUFS;
+	return -EMSGSIZE;
+}
+
+int ieee802154_nl_assoc_indic(struct net_device *dev,
+		struct ieee802154_addr *addr, u8 cap)
+{
+	struct ieee802154_nl_indic ind = {
+		.dev	= dev,
+		.addr	= addr,
+		.val	= cap,
+	};
+
+	pr_debug("%s\n", __func__);
+
+	if (addr->addr_type != IEEE802154_ADDR_LONG) {
+		pr_err("%s: received non-long source address!\n", __func__);
+		return -EINVAL;
+	}
+
+	if (!ieee802154_nl_filter_pass(dev, IEEE802154_PANID_BROADCAST))
+		return 0;
+
+	return ieee802154_nl_batch_add(&ieee802154_coord_batch,
+			IEEE802154_ASSOCIATE_INDIC,
+			ieee802154_nl_fill_assoc_indic, &ind);
 }
 EXPORT_SYMBOL(ieee802154_nl_assoc_indic);
 
+static int ieee802154_nl_fill_assoc_done_indic(struct sk_buff *msg, void *arg)
+{
+	struct ieee802154_nl_indic *ind = arg;
+
+	if (ieee802154_nl_put_dev(msg, ind->dev))
+		goto nla_put_failure;
+
+	NLA_PUT(msg, IEEE802154_ATTR_SRC_HW_ADDR, IEEE802154_ADDR_LEN,
+			ind->addr->hwaddr);
+	NLA_PUT_U16(msg, IEEE802154_ATTR_SRC_SHORT_ADDR, ind->coord_addr);
+	NLA_PUT_U8(msg, IEEE802154_ATTR_CAPABILITY, ind->val);
+	NLA_PUT_U8(msg, IEEE802154_ATTR_STATUS, ind->status);
+
+	return 0;
+
+nla_put_failure:
+	return -EMSGSIZE;
+}
+
+int ieee802154_nl_assoc_done_indic(struct net_device *dev,
+		struct ieee802154_addr *addr, u16 short_addr, u8 cap,
+		u8 status)
+{
+	struct ieee802154_nl_indic ind = {
+		.dev		= dev,
+		.addr		= addr,
+		.coord_addr	= short_addr,
+		.val		= cap,
+		.status		= status,
+	};
+
+	pr_debug("%s\n", __func__);
+
+	if (!ieee802154_nl_filter_pass(dev, IEEE802154_PANID_BROADCAST))
+		return 0;
+
+	return ieee802154_nl_batch_add(&ieee802154_coord_batch,
+			IEEE802154_ASSOCIATE_DONE_INDIC,
+			ieee802154_nl_fill_assoc_done_indic, &ind);
+}
+EXPORT_SYMBOL(ieee802154_nl_assoc_done_indic);
+
 int ieee802154_nl_assoc_confirm(struct net_device *dev, u16 short_addr,
 		u8 status)
 {
 	struct sk_buff *msg;
 
 	pr_debug("%s\n", __func__);
+	trace_ieee802154_mlme_confirm(dev, IEEE802154_ASSOCIATE_CONF, status);
 
 	msg = ieee802154_nl_create(0, IEEE802154_ASSOCIATE_CONF);
 	if (!msg)
@@ -98,7 +269,7 @@ int ieee802154_nl_assoc_confirm(struct net_device *dev, u16 short_addr,
 	NLA_PUT_U16(msg, IEEE802154_ATTR_SHORT_ADDR, short_addr);
 	NLA_PUT_U8(msg, IEEE802154_ATTR_STATUS, status);
 
-	return ieee802154_nl_mcast(msg, ieee802154_coord_mcgrp.id);
+	return ieee802154_nl_coord_mcast(msg);
 
 nla_put_failure:
 	nlmsg_free(msg);
@@ -106,36 +277,45 @@ nla_put_failure:
 }
 EXPORT_SYMBOL(ieee802154_nl_assoc_confirm);
 
-int ieee802154_nl_disassoc_indic(struct net_device *dev,
-		struct ieee802154_addr *addr, u8 reason)
+static int ieee802154_nl_fill_disassoc_indic(struct sk_buff *msg, void *arg)
 {
-	struct sk_buff *msg;
+	struct ieee802154_nl_indic *ind = arg;
 
-	pr_debug("%s\n", __func__);
+	if (ieee802154_nl_put_dev(msg, ind->dev))
+		goto nla_put_failure;
 
-	msg = ieee802154_nl_create(0, IEEE802154_DISASSOCIATE_INDIC);
-	if (!msg)
-		return -ENOBUFS;
-
-	NLA_PUT_STRING(msg, IEEE802154_ATTR_DEV_NAME, dev->name);
-	NLA_PUT_U32(msg, IEEE802154_ATTR_DEV_INDEX, dev->ifindex);
-	NLA_PUT(msg, IEEE802154_ATTR_HW_ADDR, IEEE802154_ADDR_LEN,
-			dev->dev_addr);
-
-	if (addr->addr_type == IEEE802154_ADDR_LONG)
+	if (ind->addr->addr_type == IEEE802154_ADDR_LONG)
 		NLA_PUT(msg, IEEE802154_ATTR_SRC_HW_ADDR, IEEE802154_ADDR_LEN,
-				addr->hwaddr);
+				ind->addr->hwaddr);
 	else
 		NLA_PUT_U16(msg, IEEE802154_ATTR_SRC_SHORT_ADDR,
-				addr->short_addr);
+				ind->addr->short_addr);
 
-	NLA_PUT_U8(msg, IEEE802154_ATTR_REASON, reason);
+	NLA_PUT_U8(msg, IEEE802154_ATTR_REASON, ind->val);
 
-	return ieee802154_nl_mcast(msg, ieee802154_coord_mcgrp.id);
+	return 0;
 
 nla_put_failure:
-	nlmsg_free(msg);
-	return -ENOBUFS;
+	return -EMSGSIZE;
+}
+
+int ieee802154_nl_disassoc_indic(struct net_device *dev,
+		struct ieee802154_addr *addr, u8 reason)
+{
+	struct ieee802154_nl_indic ind = {
+		.dev	= dev,
+		.addr	= addr,
+		.val	= reason,
+	};
+
+	pr_debug("%s\n", __func__);
+
+	if (!ieee802154_nl_filter_pass(dev, IEEE802154_PANID_BROADCAST))
+		return 0;
+
+	return ieee802154_nl_batch_add(&ieee802154_coord_batch,
+			IEEE802154_DISASSOCIATE_INDIC,
+			ieee802154_nl_fill_disassoc_indic, &ind);
 }
 EXPORT_SYMBOL(ieee802154_nl_disassoc_indic);
 
@@ -144,6 +324,8 @@ int ieee802154_nl_disassoc_confirm(struct net_device *dev, u8 status)
 	struct sk_buff *msg;
 
 	pr_debug("%s\n", __func__);
+	trace_ieee802154_mlme_confirm(dev, IEEE802154_DISASSOCIATE_CONF,
+			status);
 
 	msg = ieee802154_nl_create(0, IEEE802154_DISASSOCIATE_CONF);
 	if (!msg)
@@ -156,7 +338,7 @@ int ieee802154_nl_disassoc_confirm(struct net_device *dev, u8 status)
 
 	NLA_PUT_U8(msg, IEEE802154_ATTR_STATUS, status);
 
-	return ieee802154_nl_mcast(msg, ieee802154_coord_mcgrp.id);
+	return ieee802154_nl_coord_mcast(msg);
 
 nla_put_failure:
 	nlmsg_free(msg);
@@ -164,29 +346,39 @@ nla_put_failure:
 }
 EXPORT_SYMBOL(ieee802154_nl_disassoc_confirm);
 
+static int ieee802154_nl_fill_beacon_indic(struct sk_buff *msg, void *arg)
+{
+	struct ieee802154_nl_indic *ind = arg;
+
+	if (ieee802154_nl_put_dev(msg, ind->dev))
+		goto nla_put_failure;
+
+	NLA_PUT_U16(msg, IEEE802154_ATTR_COORD_SHORT_ADDR, ind->coord_addr);
+	NLA_PUT_U16(msg, IEEE802154_ATTR_COORD_PAN_ID, ind->panid);
+
+	return 0;
+
+nla_put_failure:
+	return -EMSGSIZE;
+}
+
 int ieee802154_nl_beacon_indic(struct net_device *dev,
 		u16 panid, u16 coord_addr)
 {
-	struct sk_buff *msg;
+	struct ieee802154_nl_indic ind = {
+		.dev		= dev,
+		.panid		= panid,
+		.coord_addr	= coord_addr,
+	};
 
 	pr_debug("%s\n", __func__);
 
-	msg = ieee802154_nl_create(0, IEEE802154_BEACON_NOTIFY_INDIC);
-	if (!msg)
-		return -ENOBUFS;
-
-	NLA_PUT_STRING(msg, IEEE802154_ATTR_DEV_NAME, dev->name);
-	NLA_PUT_U32(msg, IEEE802154_ATTR_DEV_INDEX, dev->ifindex);
-	NLA_PUT(msg, IEEE802154_ATTR_HW_ADDR, IEEE802154_ADDR_LEN,
-			dev->dev_addr);
-	NLA_PUT_U16(msg, IEEE802154_ATTR_COORD_SHORT_ADDR, coord_addr);
-	NLA_PUT_U16(msg, IEEE802154_ATTR_COORD_PAN_ID, panid);
-
-	return ieee802154_nl_mcast(msg, ieee802154_coord_mcgrp.id);
+	if (!ieee802154_nl_filter_pass(dev, panid))
+		return 0;
 
-nla_put_failure:
-	nlmsg_free(msg);
-	return -ENOBUFS;
+	return ieee802154_nl_batch_add(&ieee802154_coord_batch,
+			IEEE802154_BEACON_NOTIFY_INDIC,
+			ieee802154_nl_fill_beacon_indic, &ind);
 }
 EXPORT_SYMBOL(ieee802154_nl_beacon_indic);
 
@@ -197,6 +389,7 @@ int ieee802154_nl_scan_confirm(struct net_device *dev,
 	struct sk_buff *msg;
 
 	pr_debug("%s\n", __func__);
+	trace_ieee802154_mlme_confirm(dev, IEEE802154_SCAN_CONF, status);
 
 	msg = ieee802154_nl_create(0, IEEE802154_SCAN_CONF);
 	if (!msg)
@@ -215,7 +408,7 @@ int ieee802154_nl_scan_confirm(struct net_device *dev,
 	if (edl)
 		NLA_PUT(msg, IEEE802154_ATTR_ED_LIST, 27, edl);
 
-	return ieee802154_nl_mcast(msg, ieee802154_coord_mcgrp.id);
+	return ieee802154_nl_coord_mcast(msg);
 
 nla_put_failure:
 	nlmsg_free(msg);
@@ -228,6 +421,7 @@ int ieee802154_nl_start_confirm(struct net_device *dev, u8 status)
 	struct sk_buff *msg;
 
 	pr_debug("%s\n", __func__);
+	trace_ieee802154_mlme_confirm(dev, IEEE802154_START_CONF, status);
 
 	msg = ieee802154_nl_create(0, IEEE802154_START_CONF);
 	if (!msg)
@@ -240,7 +434,7 @@ int ieee802154_nl_start_confirm(struct net_device *dev, u8 status)
 
 	NLA_PUT_U8(msg, IEEE802154_ATTR_STATUS, status);
 
-	return ieee802154_nl_mcast(msg, ieee802154_coord_mcgrp.id);
+	return ieee802154_nl_coord_mcast(msg);
 
 nla_put_failure:
 	nlmsg_free(msg);
@@ -248,6 +442,95 @@ nla_put_failure:
 }
 EXPORT_SYMBOL(ieee802154_nl_start_confirm);
 
+int ieee802154_nl_channel_indic(struct wpan_phy *phy, u8 page, u8 channel,
+		u8 new_channel, const u8 *edl)
+{
+	struct sk_buff *msg;
+
+	pr_debug("%s\n", __func__);
+
+	msg = ieee802154_nl_create(0, IEEE802154_CHANNEL_INDIC);
+	if (!msg)
+		return -ENOBUFS;
+
+	NLA_PUT_STRING(msg, IEEE802154_ATTR_PHY_NAME, wpan_phy_name(phy));
+	NLA_PUT_U8(msg, IEEE802154_ATTR_PAGE, page);
+	NLA_PUT_U8(msg, IEEE802154_ATTR_CHANNEL, channel);
+	if (new_channel != 0xff)
+		NLA_PUT_U8(msg, IEEE802154_ATTR_NEW_CHANNEL, new_channel);
+	NLA_PUT(msg, IEEE802154_ATTR_ED_LIST, 27, edl);
+
+	return ieee802154_nl_coord_mcast(msg);
+
+nla_put_failure:
+	nlmsg_free(msg);
+	return -ENOBUFS;
+}
+EXPORT_SYMBOL(ieee802154_nl_channel_indic);
+
+static int ieee802154_nl_put_neigh(struct sk_buff *msg,
+		const struct ieee802154_neigh_info *info)
+{
+	struct nlattr *nest;
+
+	nest = nla_nest_start(msg, IEEE802154_ATTR_NEIGH);
+	if (!nest)
+		goto nla_put_failure;
+
+	NLA_PUT_U16(msg, IEEE802154_NEIGH_PAN_ID, info->pan_id);
+	NLA_PUT_U16(msg, IEEE802154_NEIGH_SHORT_ADDR, info->short_addr);
+	if (info->has_hwaddr)
+		NLA_PUT(msg, IEEE802154_NEIGH_HW_ADDR, IEEE802154_ADDR_LEN,
+				info->hwaddr);
+	NLA_PUT_U8(msg, IEEE802154_NEIGH_LQI, info->lqi);
+	NLA_PUT_U16(msg, IEEE802154_NEIGH_ETX, info->etx);
+	NLA_PUT_U8(msg, IEEE802154_NEIGH_SEQ, info->seq);
+	NLA_PUT_U32(msg, IEEE802154_NEIGH_AGE, info->age);
+	NLA_PUT_U32(msg, IEEE802154_NEIGH_RX_FRAMES, info->rx_frames);
+	NLA_PUT_U32(msg, IEEE802154_NEIGH_TX_ACKED, info->tx_acked);
+	NLA_PUT_U32(msg, IEEE802154_NEIGH_TX_FAILED, info->tx_failed);
+
+	nla_nest_end(msg, nest);
+
+	return 0;
+
+nla_put_failure:
+	return -EMSGSIZE;
+}
+
+struct ieee802154_nl_neigh {
+	struct net_device *dev;
+	const struct ieee802154_neigh_info *info;
+};
+
+static int ieee802154_nl_fill_neigh_indic(struct sk_buff *msg, void *arg)
+{
+	struct ieee802154_nl_neigh *ind = arg;
+
+	if (ieee802154_nl_put_dev(msg, ind->dev))
+		return -EMSGSIZE;
+
+	return ieee802154_nl_put_neigh(msg, ind->info);
+}
+
+int ieee802154_nl_neigh_indic(struct net_device *dev,
+		const struct ieee802154_neigh_info *info, u8 cmd)
+{
+	struct ieee802154_nl_neigh ind = {
+		.dev	= dev,
+		.info	= info,
+	};
+
+	pr_debug("%s\n", __func__);
+
+	if (!ieee802154_nl_filter_pass(dev, info->pan_id))
+		return 0;
+
+	return ieee802154_nl_batch_add(&ieee802154_coord_batch, cmd,
+			ieee802154_nl_fill_neigh_indic, &ind);
+}
+EXPORT_SYMBOL(ieee802154_nl_neigh_indic);
+
 static int ieee802154_nl_fill_iface(struct sk_buff *msg, u32 pid,
 	u32 seq, int flags, struct net_device *dev)
 {
@@ -351,6 +634,7 @@ static int ieee802154_associate_req(struct sk_buff *skb,
 			nla_get_u8(info->attrs[IEEE802154_ATTR_CHANNEL]),
 			page,
 			nla_get_u8(info->attrs[IEEE802154_ATTR_CAPABILITY]));
+	trace_ieee802154_mlme_req(dev, IEEE802154_ASSOCIATE_REQ, ret);
 
 	dev_put(dev);
 	return ret;
@@ -381,6 +665,7 @@ static int ieee802154_associate_resp(struct sk_buff *skb,
 	ret = ieee802154_mlme_ops(dev)->assoc_resp(dev, &addr,
 		nla_get_u16(info->attrs[IEEE802154_ATTR_DEST_SHORT_ADDR]),
 		nla_get_u8(info->attrs[IEEE802154_ATTR_STATUS]));
+	trace_ieee802154_mlme_req(dev, IEEE802154_ASSOCIATE_RESP, ret);
 
 	dev_put(dev);
 	return ret;
@@ -416,6 +701,7 @@ static int ieee802154_disassociate_req(struct sk_buff *skb,
 
 	ret = ieee802154_mlme_ops(dev)->disassoc_req(dev, &addr,
 			nla_get_u8(info->attrs[IEEE802154_ATTR_REASON]));
+	trace_ieee802154_mlme_req(dev, IEEE802154_DISASSOCIATE_REQ, ret);
 
 	dev_put(dev);
 	return ret;
@@ -477,6 +763,7 @@ static int ieee802154_start_req(struct sk_buff *skb, struct genl_info *info)
 
 	ret = ieee802154_mlme_ops(dev)->start_req(dev, &addr, channel, page,
 		bcn_ord, sf_ord, pan_coord, blx, coord_realign);
+	trace_ieee802154_mlme_req(dev, IEEE802154_START_REQ, ret);
 
 	dev_put(dev);
 	return ret;
@@ -512,6 +799,7 @@ static int ieee802154_scan_req(struct sk_buff *skb, struct genl_info *info)
 
 	ret = ieee802154_mlme_ops(dev)->scan_req(dev, type, channels, page,
 			duration);
+	trace_ieee802154_mlme_req(dev, IEEE802154_SCAN_REQ, ret);
 
 	dev_put(dev);
 	return ret;
@@ -578,6 +866,137 @@ cont:
 	return skb->len;
 }
 
+struct dump_neigh_data {
+	struct sk_buff *skb;
+	struct netlink_callback *cb;
+	struct net_device *dev;
+	bool full;
+};
+
+static int ieee802154_dump_neigh_fill(const struct ieee802154_neigh_info *info,
+		void *arg)
+{
+	struct dump_neigh_data *data = arg;
+	void *hdr;
+
+	hdr = genlmsg_put(data->skb, 0, data->cb->nlh->nlmsg_seq,
+			&nl802154_family, NLM_F_MULTI, IEEE802154_LIST_NEIGH);
+	if (!hdr)
+		goto full;
+
+	if (ieee802154_nl_put_dev(data->skb, data->dev) ||
+	    ieee802154_nl_put_neigh(data->skb, info)) {
+		genlmsg_cancel(data->skb, hdr);
+		goto full;
+	}
+
+	genlmsg_end(data->skb, hdr);
+	return 0;
+
+full:
+	data->full = true;
+	return -EMSGSIZE;
+}
+
+/*
+ * IEEE802154_LIST_NEIGH dumps one message per neighbour of every
+ * interface providing neigh_dump. The position is kept as interface
+ * and neighbour index in cb->args[0] and cb->args[1].
+ */
+static int ieee802154_dump_neigh(struct sk_buff *skb,
+	struct netlink_callback *cb)
+{
+	struct net *net = sock_net(skb->sk);
+	struct dump_neigh_data data = {
+		.skb = skb,
+		.cb = cb,
+	};
+	struct ieee802154_mlme_ops *ops;
+	struct net_device *dev;
+	int idx, s_idx = cb->args[0];
+	int n_idx;
+
+	pr_debug("%s\n", __func__);
+
+	idx = 0;
+	rcu_read_lock();
+	for_each_netdev_rcu(net, dev) {
+		if (idx < s_idx || (dev->type != ARPHRD_IEEE802154))
+			goto cont;
+
+		ops = ieee802154_mlme_ops(dev);
+		if (!ops->neigh_dump)
+			goto cont;
+
+		data.dev = dev;
+		n_idx = ops->neigh_dump(dev, idx == s_idx ? cb->args[1] : 0,
+				ieee802154_dump_neigh_fill, &data);
+		if (data.full) {
+			cb->args[1] = n_idx;
+			break;
+		}
+cont:
+		idx++;
+	}
+	rcu_read_unlock();
+
+	cb->args[0] = idx;
+	if (!data.full)
+		cb->args[1] = 0;
+
+	return skb->len;
+}
+
+/*
+ * Without a device all filters are removed. Otherwise indications of
+ * the device are passed, beacon notifications only for PAN_ID if given.
+ */
+static int ieee802154_set_event_filter(struct sk_buff *skb,
+		struct genl_info *info)
+{
+	struct ieee802154_nl_filter *f, *old = NULL;
+	struct net_device *dev;
+	u16 pan_id = IEEE802154_PANID_BROADCAST;
+
+	pr_debug("%s\n", __func__);
+
+	if (!info->attrs[IEEE802154_ATTR_DEV_NAME] &&
+	    !info->attrs[IEEE802154_ATTR_DEV_INDEX]) {
+		ieee802154_nl_filter_clear();
+		return 0;
+	}
+
+	dev = ieee802154_nl_get_dev(info);
+	if (!dev)
+		return -ENODEV;
+
+	if (info->attrs[IEEE802154_ATTR_PAN_ID])
+		pan_id = nla_get_u16(info->attrs[IEEE802154_ATTR_PAN_ID]);
+
+	f = kzalloc(sizeof(*f), GFP_KERNEL);
+	if (!f) {
+		dev_put(dev);
+		return -ENOMEM;
+	}
+
+	f->ifindex = dev->ifindex;
+	f->pan_id = pan_id;
+	dev_put(dev);
+
+	spin_lock(&ieee802154_nl_filter_lock);
+	list_for_each_entry(old, &ieee802154_nl_filters, list)
+		if (old->ifindex == f->ifindex) {
+			list_replace_rcu(&old->list, &f->list);
+			call_rcu(&old->rcu, ieee802154_nl_filter_free);
+			goto out;
+		}
+	list_add_tail_rcu(&f->list, &ieee802154_nl_filters);
+out:
+	spin_unlock(&ieee802154_nl_filter_lock);
+
+	return 0;
+}
+
 static struct genl_ops ieee802154_coordinator_ops[] = {
 	IEEE802154_OP(IEEE802154_ASSOCIATE_REQ, ieee802154_associate_req),
 	IEEE802154_OP(IEEE802154_ASSOCIATE_RESP, ieee802154_associate_resp),
@@ -586,6 +1005,9 @@ static struct genl_ops ieee802154_coordinator_ops[] = {
 	IEEE802154_OP(IEEE802154_START_REQ, ieee802154_start_req),
 	IEEE802154_DUMP(IEEE802154_LIST_IFACE, ieee802154_list_iface,
 							ieee802154_dump_iface),
+	IEEE802154_OP(IEEE802154_SET_EVENT_FILTER,
+			ieee802154_set_event_filter),
+	IEEE802154_DUMP(IEEE802154_LIST_NEIGH, NULL, ieee802154_dump_neigh),
 };
 
 /*
@@ -601,6 +1023,9 @@ int nl802154_mac_register(void)
 	if (rc)
 		return rc;
 
+	ieee802154_nl_batch_init(&ieee802154_coord_batch,
+			&ieee802154_coord_mcgrp);
+
 	rc = genl_register_mc_group(&nl802154_family,
 			&ieee802154_beacon_mcgrp);
 	if (rc)
@@ -613,5 +1038,13 @@ int nl802154_mac_register(void)
 			return rc;
 	}
 
-	return 0;
+	return register_netdevice_notifier(&ieee802154_nl_filter_notifier);
+}
+
+void nl802154_mac_unregister(void)
+{
+	unregister_netdevice_notifier(&ieee802154_nl_filter_notifier);
+	ieee802154_nl_batch_stop(&ieee802154_coord_batch);
+	ieee802154_nl_filter_clear();
+	rcu_barrier();
 }
@@ -55,6 +55,7 @@ static int ieee802154_nl_fill_phy(struct sk_buff *msg, u32 pid,
 
 	NLA_PUT_U8(msg, IEEE802154_ATTR_PAGE, phy->current_page);
 	NLA_PUT_U8(msg, IEEE802154_ATTR_CHANNEL, phy->current_channel);
+	NLA_PUT_U8(msg, IEEE802154_ATTR_TXPOWER, phy->transmit_power);
 	for (i = 0; i < 32; i++) {
 		if (phy->channels_supported[i])
 			buf[pages++] = phy->channels_supported[i] | (i << 27);
@@ -176,6 +177,7 @@ static int ieee802154_add_iface(struct sk_buff *skb,
 	const char *devname;
 	int rc = -ENOBUFS;
 	struct net_device *dev;
+	int type = IEEE802154_DEV_WPAN;
 
 	pr_debug("%s\n", __func__);
 
@@ -198,6 +200,9 @@ static int ieee802154_add_iface(struct sk_buff *skb,
 	if (strlen(devname) >= IFNAMSIZ)
 		return -ENAMETOOLONG;
 
+	if (info->attrs[IEEE802154_ATTR_DEV_TYPE])
+		type = nla_get_u8(info->attrs[IEEE802154_ATTR_DEV_TYPE]);
+
 	phy = wpan_phy_find(name);
 	if (!phy)
 		return -ENODEV;
@@ -211,7 +216,7 @@ static int ieee802154_add_iface(struct sk_buff *skb,
 		goto nla_put_failure;
 	}
 
-	dev = phy->add_iface(phy, devname);
+	dev = phy->add_iface(phy, devname, type);
 	if (IS_ERR(dev)) {
 		rc = PTR_ERR(dev);
 		goto nla_put_failure;
@@ -219,6 +224,7 @@ static int ieee802154_add_iface(struct sk_buff *skb,
 
 	NLA_PUT_STRING(msg, IEEE802154_ATTR_PHY_NAME, wpan_phy_name(phy));
 	NLA_PUT_STRING(msg, IEEE802154_ATTR_DEV_NAME, dev->name);
+	NLA_PUT_U8(msg, IEEE802154_ATTR_DEV_TYPE, type);
 
 	dev_put(dev);
 
@@ -318,11 +324,95 @@ out_dev:
 	return rc;
 }
 
+/*
+ * Retunes the PHY and/or changes its output power without touching the
+ * interfaces on top of it. Many PHYs can be changed at once by sending
+ * several of these in a single netlink batch.
+ */
+static int ieee802154_set_phy(struct sk_buff *skb,
+		struct genl_info *info)
+{
+	struct wpan_phy *phy;
+	const char *name;
+	u8 page, channel, power;
+	int rc = 0;
+
+	pr_debug("%s\n", __func__);
+
+	if (!info->attrs[IEEE802154_ATTR_PHY_NAME])
+		return -EINVAL;
+
+	if (!info->attrs[IEEE802154_ATTR_CHANNEL] &&
+	    !info->attrs[IEEE802154_ATTR_TXPOWER])
+		return -EINVAL;
+
+	name = nla_data(info->attrs[IEEE802154_ATTR_PHY_NAME]);
+	if (name[nla_len(info->attrs[IEEE802154_ATTR_PHY_NAME]) - 1] != '\0')
+		return -EINVAL; /* phy name should be null-terminated */
+
+	phy = wpan_phy_find(name);
+	if (!phy)
+		return -ENODEV;
+
+	mutex_lock(&phy->pib_lock);
+
+	if (info->attrs[IEEE802154_ATTR_CHANNEL]) {
+		channel = nla_get_u8(info->attrs[IEEE802154_ATTR_CHANNEL]);
+		if (info->attrs[IEEE802154_ATTR_PAGE])
+			page = nla_get_u8(info->attrs[IEEE802154_ATTR_PAGE]);
+		else
+			page = phy->current_page;
+
+		if (page >= 32 || channel >= 27 ||
+		    !(phy->channels_supported[page] & BIT(channel))) {
+			rc = -EINVAL;
+			goto out;
+		}
+
+		if (!phy->set_channel) {
+			rc = -EOPNOTSUPP;
+			goto out;
+		}
+
+		if (page != phy->current_page ||
+		    channel != phy->current_channel) {
+			rc = phy->set_channel(phy, page, channel);
+			if (rc)
+				goto out;
+
+			phy->current_page = page;
+			phy->current_channel = channel;
+		}
+	}
+
+	if (info->attrs[IEEE802154_ATTR_TXPOWER]) {
+		power = nla_get_u8(info->attrs[IEEE802154_ATTR_TXPOWER]);
+
+		if (!phy->set_txpower) {
+			rc = -EOPNOTSUPP;
+			goto out;
+		}
+
+		rc = phy->set_txpower(phy, power);
+		if (rc)
+			goto out;
+
+		phy->transmit_power = power;
+	}
+
+out:
+	mutex_unlock(&phy->pib_lock);
+	wpan_phy_put(phy);
+
+	return rc;
+}
+
 static struct genl_ops ieee802154_phy_ops[] = {
 	IEEE802154_DUMP(IEEE802154_LIST_PHY, ieee802154_list_phy,
 							ieee802154_dump_phy),
 	IEEE802154_OP(IEEE802154_ADD_IFACE, ieee802154_add_iface),
 	IEEE802154_OP(IEEE802154_DEL_IFACE, ieee802154_del_iface),
+	IEEE802154_OP(IEEE802154_SET_PHY, ieee802154_set_phy),
 };
 
 /*
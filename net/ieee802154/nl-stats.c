@@ -0,0 +1,283 @@
+/*
+ * Netlink interface for IEEE 802.15.4 statistics
+ *
+ * Copyright 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Written by:
+ * agent <agent@local>
+ */
+
+#include <linux/kernel.h>
+#include <linux/if_arp.h>
+#include <linux/netdevice.h>
+#include <net/netlink.h>
+#include <net/genetlink.h>
+#include <net/sock.h>
+#include <net/wpan-phy.h>
+#include <net/af_ieee802154.h>
+#include <net/ieee802154_netdev.h>
+#include <linux/nl802154.h>
+
+#include "ieee802154.h"
+
+/*
+ * IEEE802154_GET_STATS dumps one message per PHY carrying its counters,
+ * followed by one message per interface carrying its MIB, so that a
+ * single request gives a consistent view of the whole stack.
+ */
+
+enum {
+	STATS_DUMP_PHY,
+	STATS_DUMP_IFACE,
+	STATS_DUMP_DONE,
+};
+
+static int ieee802154_nl_fill_phy_stats(struct sk_buff *msg, u32 pid,
+	u32 seq, int flags, struct wpan_phy *phy)
+{
+	struct wpan_phy_stats stats;
+	u8 ed[WPAN_PHY_ED_HISTORY * 2];
+	struct nlattr *nest;
+	unsigned long irqflags;
+	void *hdr;
+	int i, pos;
+
+	pr_debug("%s\n", __func__);
+
+	/* Everything but the lock itself */
+	spin_lock_irqsave(&phy->stats.lock, irqflags);
+	memcpy(&stats.tx_frames, &phy->stats.tx_frames, sizeof(stats) -
+		offsetof(struct wpan_phy_stats, tx_frames));
+	spin_unlock_irqrestore(&phy->stats.lock, irqflags);
+
+	pos = (stats.ed_pos + WPAN_PHY_ED_HISTORY - stats.ed_count) %
+		WPAN_PHY_ED_HISTORY;
+	for (i = 0; i < stats.ed_count; i++) {
+		ed[2 * i] = stats.ed[pos].channel;
+		ed[2 * i + 1] = stats.ed[pos].level;
+		pos = (pos + 1) % WPAN_PHY_ED_HISTORY;
+	}
+
+	hdr = genlmsg_put(msg, 0, seq, &nl802154_family, flags,
+		IEEE802154_GET_STATS);
+	if (!hdr)
+		goto out;
+
+	NLA_PUT_STRING(msg, IEEE802154_ATTR_PHY_NAME, wpan_phy_name(phy));
+	NLA_PUT_U8(msg, IEEE802154_ATTR_PAGE, phy->current_page);
+	NLA_PUT_U8(msg, IEEE802154_ATTR_CHANNEL, phy->current_channel);
+
+	nest = nla_nest_start(msg, IEEE802154_ATTR_PHY_STATS);
+	if (!nest)
+		goto nla_put_failure;
+
+	NLA_PUT_U32(msg, IEEE802154_STAT_TX_FRAMES, stats.tx_frames);
+	NLA_PUT_U32(msg, IEEE802154_STAT_TX_ERRORS, stats.tx_errors);
+	NLA_PUT_U32(msg, IEEE802154_STAT_RX_FRAMES, stats.rx_frames);
+	NLA_PUT_U32(msg, IEEE802154_STAT_RX_CRC_ERRORS, stats.rx_crc_errors);
+	NLA_PUT_U32(msg, IEEE802154_STAT_RX_OVERFLOWS, stats.rx_overflows);
+	NLA_PUT_U32(msg, IEEE802154_STAT_RX_DUPLICATES, stats.rx_duplicates);
+	NLA_PUT_U32(msg, IEEE802154_STAT_CCA_FAILURES, stats.cca_failures);
+	NLA_PUT_U32(msg, IEEE802154_STAT_RETRIES, stats.retries);
+	NLA_PUT_U32(msg, IEEE802154_STAT_CHANNEL_SWITCHES,
+		stats.channel_switches);
+	NLA_PUT_U32(msg, IEEE802154_STAT_TX_QUEUE_LEN,
+		atomic_read(&stats.tx_queue_len));
+	if (stats.ed_count)
+		NLA_PUT(msg, IEEE802154_STAT_ED_HISTORY,
+			2 * stats.ed_count, ed);
+
+	nla_nest_end(msg, nest);
+
+	return genlmsg_end(msg, hdr);
+
+nla_put_failure:
+	genlmsg_cancel(msg, hdr);
+out:
+	return -EMSGSIZE;
+}
+
+static int ieee802154_nl_fill_mib(struct sk_buff *msg, u32 pid,
+	u32 seq, int flags, struct net_device *dev)
+{
+	struct ieee802154_mlme_ops *ops = ieee802154_mlme_ops(dev);
+	struct ieee802154_mib mib;
+	struct nlattr *nest;
+	struct wpan_phy *phy;
+	void *hdr;
+
+	pr_debug("%s\n", __func__);
+
+	hdr = genlmsg_put(msg, 0, seq, &nl802154_family, flags,
+		IEEE802154_GET_STATS);
+	if (!hdr)
+		goto out;
+
+	phy = ops->get_phy(dev);
+	BUG_ON(!phy);
+
+	NLA_PUT_STRING(msg, IEEE802154_ATTR_DEV_NAME, dev->name);
+	NLA_PUT_U32(msg, IEEE802154_ATTR_DEV_INDEX, dev->ifindex);
+	NLA_PUT_STRING(msg, IEEE802154_ATTR_PHY_NAME, wpan_phy_name(phy));
+	NLA_PUT(msg, IEEE802154_ATTR_HW_ADDR, IEEE802154_ADDR_LEN,
+		dev->dev_addr);
+
+	/* Not every MAC keeps a full MIB */
+	if (ops->get_mib) {
+		ops->get_mib(dev, &mib);
+
+		nest = nla_nest_start(msg, IEEE802154_ATTR_MIB);
+		if (!nest)
+			goto nla_put_failure;
+
+		NLA_PUT_U16(msg, IEEE802154_MIB_PAN_ID, mib.pan_id);
+		NLA_PUT_U16(msg, IEEE802154_MIB_SHORT_ADDR, mib.short_addr);
+		NLA_PUT_U8(msg, IEEE802154_MIB_CHANNEL, mib.channel);
+		NLA_PUT_U8(msg, IEEE802154_MIB_PAGE, mib.page);
+		NLA_PUT_U8(msg, IEEE802154_MIB_BSN, mib.bsn);
+		NLA_PUT_U8(msg, IEEE802154_MIB_DSN, mib.dsn);
+		NLA_PUT_U8(msg, IEEE802154_MIB_BCN_ORD, mib.bcn_ord);
+		NLA_PUT_U8(msg, IEEE802154_MIB_SF_ORD, mib.sf_ord);
+		NLA_PUT_U8(msg, IEEE802154_MIB_MIN_BE, mib.min_be);
+		NLA_PUT_U8(msg, IEEE802154_MIB_MAX_BE, mib.max_be);
+		NLA_PUT_U8(msg, IEEE802154_MIB_MAX_CSMA_BACKOFFS,
+			mib.max_csma_backoffs);
+		NLA_PUT_U8(msg, IEEE802154_MIB_MAX_FRAME_RETRIES,
+			mib.max_frame_retries);
+		NLA_PUT_U32(msg, IEEE802154_MIB_INDIRECT_FRAMES,
+			mib.indirect_frames);
+
+		nla_nest_end(msg, nest);
+	} else {
+		NLA_PUT_U16(msg, IEEE802154_ATTR_SHORT_ADDR,
+			ops->get_short_addr(dev));
+		NLA_PUT_U16(msg, IEEE802154_ATTR_PAN_ID,
+			ops->get_pan_id(dev));
+	}
+
+	wpan_phy_put(phy);
+	return genlmsg_end(msg, hdr);
+
+nla_put_failure:
+	wpan_phy_put(phy);
+	genlmsg_cancel(msg, hdr);
+out:
+	return -EMSGSIZE;
+}
+
+struct dump_stats_data {
+	struct sk_buff *skb;
+	struct netlink_callback *cb;
+	int idx, s_idx;
+};
+
+static int ieee802154_dump_stats_iter(struct wpan_phy *phy, void *_data)
+{
+	struct dump_stats_data *data = _data;
+	int rc;
+
+	if (data->idx++ < data->s_idx)
+		return 0;
+
+	rc = ieee802154_nl_fill_phy_stats(data->skb,
+			NETLINK_CB(data->cb->skb).pid,
+			data->cb->nlh->nlmsg_seq,
+			NLM_F_MULTI,
+			phy);
+	if (rc < 0) {
+		data->idx--;
+		return rc;
+	}
+
+	return 0;
+}
+
+static int ieee802154_dump_stats(struct sk_buff *skb,
+	struct netlink_callback *cb)
+{
+	struct net *net = sock_net(skb->sk);
+	struct net_device *dev;
+	int idx, s_idx;
+
+	pr_debug("%s\n", __func__);
+
+	if (cb->args[0] == STATS_DUMP_PHY) {
+		struct dump_stats_data data = {
+			.cb = cb,
+			.skb = skb,
+			.s_idx = cb->args[1],
+			.idx = 0,
+		};
+		int rc;
+
+		rc = wpan_phy_for_each(ieee802154_dump_stats_iter, &data);
+		cb->args[1] = data.idx;
+		if (rc)
+			return skb->len;
+
+		cb->args[0] = STATS_DUMP_IFACE;
+	}
+
+	if (cb->args[0] == STATS_DUMP_IFACE) {
+		s_idx = cb->args[2];
+		idx = 0;
+
+		rcu_read_lock();
+		for_each_netdev_rcu(net, dev) {
+			if (idx < s_idx || (dev->type != ARPHRD_IEEE802154))
+				goto cont;
+
+			if (ieee802154_nl_fill_mib(skb,
+					NETLINK_CB(cb->skb).pid,
+					cb->nlh->nlmsg_seq,
+					NLM_F_MULTI, dev) < 0) {
+				rcu_read_unlock();
+				cb->args[2] = idx;
+				return skb->len;
+			}
+cont:
+			idx++;
+		}
+		rcu_read_unlock();
+
+		cb->args[2] = idx;
+		cb->args[0] = STATS_DUMP_DONE;
+	}
+
+	return skb->len;
+}
+
+static struct genl_ops ieee802154_stats_ops[] = {
+	IEEE802154_DUMP(IEEE802154_GET_STATS, NULL, ieee802154_dump_stats),
+};
+
+/*
+ * No need to unregister as family unregistration will do it.
+ */
+int nl802154_stats_register(void)
+{
+	int i;
+	int rc;
+
+	for (i = 0; i < ARRAY_SIZE(ieee802154_stats_ops); i++) {
+		rc = genl_register_ops(&nl802154_family,
+				&ieee802154_stats_ops[i]);
+		if (rc)
+			return rc;
+	}
+
+	return 0;
+}
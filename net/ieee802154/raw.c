@@ -27,6 +27,7 @@
 #include <linux/list.h>
 #include <net/sock.h>
 #include <net/af_ieee802154.h>
+#include <trace/events/ieee802154.h>
 
 #include "af802154.h"
 
@@ -218,6 +219,7 @@ void ieee802154_raw_deliver(struct net_device *dev, struct sk_buff *skb)
 {
 	struct sock *sk;
 	struct hlist_node *node;
+	int socks = 0;
 
 	read_lock(&raw_lock);
 	sk_for_each(sk, node, &raw_head) {
@@ -230,10 +232,13 @@ void ieee802154_raw_deliver(struct net_device *dev, struct sk_buff *skb)
 			clone = skb_clone(skb, GFP_ATOMIC);
 			if (clone)
 				raw_rcv_skb(sk, clone);
+			socks++;
 		}
 		bh_unlock_sock(sk);
 	}
 	read_unlock(&raw_lock);
+
+	trace_ieee802154_raw_deliver(dev, skb, socks);
 }
 
 static int raw_getsockopt(struct sock *sk, int level, int optname,
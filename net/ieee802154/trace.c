@@ -0,0 +1,39 @@
+/*
+ * Tracepoints of the IEEE 802.15.4 stack
+ *
+ * Copyright 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Written by:
+ * agent <agent@local>
+ */
+
+#include <linux/module.h>
+#include <linux/skbuff.h>
+#include <linux/netdevice.h>
+
+#define CREATE_TRACE_POINTS
+#include <trace/events/ieee802154.h>
+
+EXPORT_TRACEPOINT_SYMBOL_GPL(ieee802154_drv_rx);
+EXPORT_TRACEPOINT_SYMBOL_GPL(ieee802154_subif_rx);
+EXPORT_TRACEPOINT_SYMBOL_GPL(ieee802154_raw_deliver);
+EXPORT_TRACEPOINT_SYMBOL_GPL(ieee802154_dgram_deliver);
+EXPORT_TRACEPOINT_SYMBOL_GPL(ieee802154_xmit_enqueue);
+EXPORT_TRACEPOINT_SYMBOL_GPL(ieee802154_xmit_dequeue);
+EXPORT_TRACEPOINT_SYMBOL_GPL(ieee802154_drv_xmit);
+EXPORT_TRACEPOINT_SYMBOL_GPL(ieee802154_drv_xmit_done);
+EXPORT_TRACEPOINT_SYMBOL_GPL(ieee802154_set_channel);
+EXPORT_TRACEPOINT_SYMBOL_GPL(ieee802154_scan_channel);
@@ -157,6 +157,7 @@ struct wpan_phy *wpan_phy_alloc(size_t priv_size)
 	mutex_unlock(&wpan_phy_mutex);
 
 	mutex_init(&phy->pib_lock);
+	spin_lock_init(&phy->stats.lock);
 
 	device_initialize(&phy->dev);
 	dev_set_name(&phy->dev, "wpan-phy%d", phy->idx);
@@ -0,0 +1,1001 @@
+/*
+ * Bonding of several IEEE 802.15.4 interfaces into a single one
+ *
+ * Copyright 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Written by:
+ * agent <agent@local>
+ */
+
+/*
+ * A "wpanbond" link groups several ARPHRD_IEEE802154 slaves, usually
+ * one per radio, under a single interface
+ * (ip link add link wpan0 name bond0 type wpanbond), further slaves
+ * are added and removed by writing +wpan1 / -wpan1 to the "slaves"
+ * sysfs file. Sockets bound to the bond see the traffic of all radios.
+ *
+ * Data frames are handed to the slaves with the destination recorded
+ * in mac_cb(skb)->da, the MAC header is built by the slave actually
+ * sending the frame, so each radio uses its own source address and
+ * DSN. A frame goes out through the slave which last heard from its
+ * destination, i.e. the radio tuned to the channel the peer lives on.
+ * Unknown destinations go to the slave with the shortest queue and
+ * broadcasts are sent by every slave.
+ *
+ * Received frames are picked up by a packet handler on ETH_P_IEEE802154
+ * and passed up on the bond. A frame heard by several radios is passed
+ * up once, the copy with the better LQI deciding which slave is used
+ * for replies. A slave going down or away (e.g. the USB stick being
+ * unplugged) is simply not used anymore, the bond is removed along
+ * with its last slave.
+ */
+
+#include <linux/if_arp.h>
+#include <linux/jhash.h>
+#include <linux/list.h>
+#include <linux/module.h>
+#include <linux/netdevice.h>
+#include <linux/random.h>
+#include <linux/rtnetlink.h>
+#include <linux/sched.h>
+#include <linux/skbuff.h>
+#include <linux/timer.h>
+#include <net/af_ieee802154.h>
+#include <net/ieee802154.h>
+#include <net/ieee802154_netdev.h>
+#include <net/rtnetlink.h>
+#include <net/sch_generic.h>
+#include <net/wpan-phy.h>
+
+#define WPANBOND_PEER_HASH_SIZE		64
+#define WPANBOND_PEER_MAX		256
+#define WPANBOND_PEER_TIMEOUT		(300 * HZ)
+#define WPANBOND_GC_INTERVAL		(30 * HZ)
+/* Copies of a frame heard by several radios arrive within this time */
+#define WPANBOND_DUP_TIME		msecs_to_jiffies(500)
+/* A duplicate has to be that much better to move the peer to its slave */
+#define WPANBOND_LQI_MARGIN		16
+
+struct wpanbond_slave {
+	struct list_head	list;		/* wpanbond->slaves, RCU */
+	struct net_device	*dev;		/* reference held */
+};
+
+/* A remote device and the slave it was last heard on */
+struct wpanbond_peer {
+	struct hlist_node	node;
+	int			addr_type;
+	u64			key;
+	struct net_device	*via;
+	unsigned long		last_seen;
+	u8			lqi;
+	u8			seq;
+	u8			type;
+};
+
+struct wpanbond {
+	struct net_device	*dev;		/* back pointer */
+	struct list_head	list;		/* wpanbond_devices, RCU */
+	struct list_head	slaves;		/* RTNL for writers */
+	int			count;
+
+	spinlock_t		lock;		/* protects the peers */
+	struct hlist_head	peers[WPANBOND_PEER_HASH_SIZE];
+	int			peer_count;
+	struct timer_list	gc_timer;
+
+	u32			rx_duplicates;
+};
+
+/* Protected by RTNL for writers and by RCU for the receive path */
+static LIST_HEAD(wpanbond_devices);
+
+static const struct net_device_ops wpanbond_netdev_ops;
+
+static inline struct wpanbond *wpanbond_priv(const struct net_device *dev)
+{
+	return netdev_priv(dev);
+}
+
+static struct wpanbond *wpanbond_find(const struct net_device *sdev)
+{
+	struct wpanbond *bond;
+	struct wpanbond_slave *s;
+
+	list_for_each_entry_rcu(bond, &wpanbond_devices, list)
+		list_for_each_entry_rcu(s, &bond->slaves, list)
+			if (s->dev == sdev)
+				return bond;
+
+	return NULL;
+}
+
+/*
+ * The MLME requests and the PIB of the bond are those of its first
+ * slave. The caller has to dev_put() the result.
+ */
+static struct net_device *wpanbond_primary_get(const struct net_device *dev)
+{
+	struct wpanbond *bond = wpanbond_priv(dev);
+	struct wpanbond_slave *s;
+	struct net_device *sdev = NULL;
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(s, &bond->slaves, list) {
+		sdev = s->dev;
+		dev_hold(sdev);
+		break;
+	}
+	rcu_read_unlock();
+
+	return sdev;
+}
+
+static int wpanbond_assoc_req(struct net_device *dev,
+		struct ieee802154_addr *addr, u8 channel, u8 page, u8 cap)
+{
+	struct net_device *sdev = wpanbond_primary_get(dev);
+	int ret;
+
+	if (!sdev)
+		return -ENODEV;
+
+	ret = ieee802154_mlme_ops(sdev)->assoc_req(sdev, addr,
+			channel, page, cap);
+	dev_put(sdev);
+
+	return ret;
+}
+
+static int wpanbond_assoc_resp(struct net_device *dev,
+		struct ieee802154_addr *addr, u16 short_addr, u8 status)
+{
+	struct net_device *sdev = wpanbond_primary_get(dev);
+	int ret;
+
+	if (!sdev)
+		return -ENODEV;
+
+	ret = ieee802154_mlme_ops(sdev)->assoc_resp(sdev, addr,
+			short_addr, status);
+	dev_put(sdev);
+
+	return ret;
+}
+
+static int wpanbond_disassoc_req(struct net_device *dev,
+		struct ieee802154_addr *addr, u8 reason)
+{
+	struct net_device *sdev = wpanbond_primary_get(dev);
+	int ret;
+
+	if (!sdev)
+		return -ENODEV;
+
+	ret = ieee802154_mlme_ops(sdev)->disassoc_req(sdev, addr, reason);
+	dev_put(sdev);
+
+	return ret;
+}
+
+static int wpanbond_start_req(struct net_device *dev,
+		struct ieee802154_addr *addr, u8 channel, u8 page,
+		u8 bcn_ord, u8 sf_ord, u8 pan_coord, u8 blx, u8 coord_realign)
+{
+	struct net_device *sdev = wpanbond_primary_get(dev);
+	int ret;
+
+	if (!sdev)
+		return -ENODEV;
+
+	ret = ieee802154_mlme_ops(sdev)->start_req(sdev, addr, channel, page,
+			bcn_ord, sf_ord, pan_coord, blx, coord_realign);
+	dev_put(sdev);
+
+	return ret;
+}
+
+static int wpanbond_scan_req(struct net_device *dev,
+		u8 type, u32 channels, u8 page, u8 duration)
+{
+	struct net_device *sdev = wpanbond_primary_get(dev);
+	int ret;
+
+	if (!sdev)
+		return -ENODEV;
+
+	ret = ieee802154_mlme_ops(sdev)->scan_req(sdev, type, channels,
+			page, duration);
+	dev_put(sdev);
+
+	return ret;
+}
+
+static struct wpan_phy *wpanbond_get_phy(const struct net_device *dev)
+{
+	struct net_device *sdev = wpanbond_primary_get(dev);
+	struct wpan_phy *phy;
+
+	if (!sdev)
+		return NULL;
+
+	phy = ieee802154_mlme_ops(sdev)->get_phy(sdev);
+	dev_put(sdev);
+
+	return phy;
+}
+
+static u16 wpanbond_get_pan_id(const struct net_device *dev)
+{
+	struct net_device *sdev = wpanbond_primary_get(dev);
+	u16 pan_id;
+
+	if (!sdev)
+		return IEEE802154_PANID_BROADCAST;
+
+	pan_id = ieee802154_mlme_ops(sdev)->get_pan_id(sdev);
+	dev_put(sdev);
+
+	return pan_id;
+}
+
+static u16 wpanbond_get_short_addr(const struct net_device *dev)
+{
+	struct net_device *sdev = wpanbond_primary_get(dev);
+	u16 short_addr;
+
+	if (!sdev)
+		return IEEE802154_ADDR_BROADCAST;
+
+	short_addr = ieee802154_mlme_ops(sdev)->get_short_addr(sdev);
+	dev_put(sdev);
+
+	return short_addr;
+}
+
+/* The slave sending the frame fills in its own DSN, see wpanbond_xmit_one */
+static u8 wpanbond_get_dsn(const struct net_device *dev)
+{
+	return 0;
+}
+
+static u8 wpanbond_get_bsn(const struct net_device *dev)
+{
+	return 0;
+}
+
+static struct ieee802154_mlme_ops wpanbond_mlme = {
+	.assoc_req	= wpanbond_assoc_req,
+	.assoc_resp	= wpanbond_assoc_resp,
+	.disassoc_req	= wpanbond_disassoc_req,
+	.start_req	= wpanbond_start_req,
+	.scan_req	= wpanbond_scan_req,
+
+	.get_phy	= wpanbond_get_phy,
+	.get_pan_id	= wpanbond_get_pan_id,
+	.get_short_addr	= wpanbond_get_short_addr,
+	.get_dsn	= wpanbond_get_dsn,
+	.get_bsn	= wpanbond_get_bsn,
+};
+
+static bool wpanbond_addr_key(const struct ieee802154_addr *addr, u64 *key)
+{
+	switch (addr->addr_type) {
+	case IEEE802154_ADDR_LONG:
+		memcpy(key, addr->hwaddr, IEEE802154_ADDR_LEN);
+		return true;
+	case IEEE802154_ADDR_SHORT:
+		*key = ((u64)addr->pan_id << 16) | addr->short_addr;
+		return true;
+	default:
+		return false;
+	}
+}
+
+static inline struct hlist_head *wpanbond_peer_head(struct wpanbond *bond,
+		int addr_type, u64 key)
+{
+	return &bond->peers[jhash_2words((u32)key, (u32)(key >> 32),
+			addr_type) & (WPANBOND_PEER_HASH_SIZE - 1)];
+}
+
+/* Called with bond->lock held */
+static struct wpanbond_peer *wpanbond_peer_find(struct wpanbond *bond,
+		int addr_type, u64 key)
+{
+	struct wpanbond_peer *p;
+	struct hlist_node *node;
+
+	hlist_for_each_entry(p, node,
+			wpanbond_peer_head(bond, addr_type, key), node)
+		if (p->addr_type == addr_type && p->key == key)
+			return p;
+
+	return NULL;
+}
+
+/* Returns the slave DA was last heard on, if any */
+static struct net_device *wpanbond_peer_via(struct wpanbond *bond,
+		const struct ieee802154_addr *da)
+{
+	struct wpanbond_peer *p;
+	struct net_device *via = NULL;
+	u64 key;
+
+	if (!wpanbond_addr_key(da, &key))
+		return NULL;
+
+	spin_lock_bh(&bond->lock);
+	p = wpanbond_peer_find(bond, da->addr_type, key);
+	if (p)
+		via = p->via;
+	spin_unlock_bh(&bond->lock);
+
+	return via;
+}
+
+/*
+ * Records that the source of SKB was heard on SDEV. Returns true if
+ * the frame is a copy of one already received by another slave.
+ */
+static bool wpanbond_peer_learn(struct wpanbond *bond, struct sk_buff *skb,
+		struct net_device *sdev)
+{
+	struct ieee802154_addr *sa = &mac_cb(skb)->sa;
+	struct wpanbond_peer *p;
+	u8 lqi = mac_cb(skb)->lqi;
+	u8 seq = mac_cb(skb)->seq;
+	u8 type = mac_cb_type(skb);
+	bool dup = false;
+	u64 key;
+
+	if (!wpanbond_addr_key(sa, &key))
+		return false;
+
+	spin_lock_bh(&bond->lock);
+
+	p = wpanbond_peer_find(bond, sa->addr_type, key);
+	if (!p) {
+		if (bond->peer_count >= WPANBOND_PEER_MAX)
+			goto out;
+
+		p = kzalloc(sizeof(*p), GFP_ATOMIC);
+		if (!p)
+			goto out;
+
+		p->addr_type = sa->addr_type;
+		p->key = key;
+		hlist_add_head(&p->node,
+				wpanbond_peer_head(bond, sa->addr_type, key));
+		bond->peer_count++;
+	} else if (p->via != sdev && p->seq == seq && p->type == type &&
+			time_before(jiffies, p->last_seen + WPANBOND_DUP_TIME)) {
+		dup = true;
+		if (lqi > p->lqi + WPANBOND_LQI_MARGIN) {
+			p->via = sdev;
+			p->lqi = lqi;
+		}
+		goto out;
+	}
+
+	p->via = sdev;
+	p->lqi = lqi;
+	p->seq = seq;
+	p->type = type;
+	p->last_seen = jiffies;
+
+out:
+	spin_unlock_bh(&bond->lock);
+
+	return dup;
+}
+
+/* Drops the peers heard on SDEV, or all of them if it is NULL */
+static void wpanbond_peer_forget(struct wpanbond *bond,
+		struct net_device *sdev, unsigned long timeout)
+{
+	struct wpanbond_peer *p;
+	struct hlist_node *node, *tmp;
+	int i;
+
+	spin_lock_bh(&bond->lock);
+	for (i = 0; i < WPANBOND_PEER_HASH_SIZE; i++)
+		hlist_for_each_entry_safe(p, node, tmp, &bond->peers[i], node) {
+			if (sdev && p->via != sdev)
+				continue;
+			if (timeout && time_before(jiffies,
+					p->last_seen + timeout))
+				continue;
+
+			hlist_del(&p->node);
+			kfree(p);
+			bond->peer_count--;
+		}
+	spin_unlock_bh(&bond->lock);
+}
+
+static void wpanbond_gc(unsigned long data)
+{
+	struct wpanbond *bond = (struct wpanbond *)data;
+
+	wpanbond_peer_forget(bond, NULL, WPANBOND_PEER_TIMEOUT);
+
+	mod_timer(&bond->gc_timer, jiffies + WPANBOND_GC_INTERVAL);
+}
+
+/* Frames sent by one of our radios are heard by the others */
+static bool wpanbond_from_slave(struct wpanbond *bond,
+		const struct ieee802154_addr *sa)
+{
+	struct ieee802154_mlme_ops *ops;
+	struct wpanbond_slave *s;
+
+	list_for_each_entry_rcu(s, &bond->slaves, list) {
+		ops = ieee802154_mlme_ops(s->dev);
+
+		switch (sa->addr_type) {
+		case IEEE802154_ADDR_LONG:
+			if (!memcmp(sa->hwaddr, s->dev->dev_addr,
+					IEEE802154_ADDR_LEN))
+				return true;
+			break;
+		case IEEE802154_ADDR_SHORT:
+			if (sa->short_addr != IEEE802154_ADDR_BROADCAST &&
+			    sa->short_addr == ops->get_short_addr(s->dev) &&
+			    sa->pan_id == ops->get_pan_id(s->dev))
+				return true;
+			break;
+		}
+	}
+
+	return false;
+}
+
+static void wpanbond_update_carrier(struct wpanbond *bond)
+{
+	struct wpanbond_slave *s;
+
+	ASSERT_RTNL();
+
+	list_for_each_entry(s, &bond->slaves, list)
+		if (netif_running(s->dev)) {
+			netif_carrier_on(bond->dev);
+			return;
+		}
+
+	netif_carrier_off(bond->dev);
+}
+
+/* Takes over the reference to SDEV on success */
+static int wpanbond_enslave(struct wpanbond *bond, struct net_device *sdev)
+{
+	struct wpanbond_slave *s;
+
+	ASSERT_RTNL();
+
+	if (sdev->type != ARPHRD_IEEE802154 ||
+	    sdev->netdev_ops == &wpanbond_netdev_ops)
+		return -EINVAL;
+
+	if (wpanbond_find(sdev))
+		return -EBUSY;
+
+	s = kzalloc(sizeof(*s), GFP_KERNEL);
+	if (!s)
+		return -ENOMEM;
+
+	s->dev = sdev;
+	list_add_tail_rcu(&s->list, &bond->slaves);
+	bond->count++;
+
+	if (sdev->needed_headroom > bond->dev->needed_headroom)
+		bond->dev->needed_headroom = sdev->needed_headroom;
+
+	pr_debug("%s: enslaved %s\n", bond->dev->name, sdev->name);
+
+	return 0;
+}
+
+static void wpanbond_release(struct wpanbond *bond, struct wpanbond_slave *s)
+{
+	ASSERT_RTNL();
+
+	pr_debug("%s: releasing %s\n", bond->dev->name, s->dev->name);
+
+	list_del_rcu(&s->list);
+	bond->count--;
+	synchronize_rcu();
+
+	wpanbond_peer_forget(bond, s->dev, 0);
+
+	dev_put(s->dev);
+	kfree(s);
+}
+
+static int wpanbond_header_create(struct sk_buff *skb, struct net_device *dev,
+		unsigned short type, const void *daddr, const void *saddr,
+		unsigned len)
+{
+	if (!daddr)
+		return -EINVAL;
+
+	/* The header is built by the slave, see wpanbond_xmit_one */
+	memcpy(&mac_cb(skb)->da, daddr, sizeof(struct ieee802154_addr));
+
+	return 0;
+}
+
+static unsigned int wpanbond_load(struct net_device *sdev)
+{
+	struct Qdisc *q = rcu_dereference(netdev_get_tx_queue(sdev, 0)->qdisc);
+
+	return (q ? q->q.qlen : 0) + netif_queue_stopped(sdev);
+}
+
+static struct net_device *wpanbond_pick(struct wpanbond *bond,
+		const struct ieee802154_addr *da)
+{
+	struct wpanbond_slave *s;
+	struct net_device *via, *best = NULL;
+	unsigned int load, best_load = UINT_MAX;
+
+	via = wpanbond_peer_via(bond, da);
+
+	list_for_each_entry_rcu(s, &bond->slaves, list) {
+		if (!netif_running(s->dev))
+			continue;
+
+		if (s->dev == via)
+			return via;
+
+		load = wpanbond_load(s->dev);
+		if (load < best_load) {
+			best = s->dev;
+			best_load = load;
+		}
+	}
+
+	return best;
+}
+
+static int wpanbond_xmit_one(struct sk_buff *skb, struct net_device *sdev)
+{
+	struct ieee802154_addr da;
+	int err;
+
+	/* Frames from raw sockets come with the header already built */
+	if (mac_cb(skb)->da.addr_type != IEEE802154_ADDR_NONE) {
+		err = skb_cow_head(skb, LL_RESERVED_SPACE(sdev));
+		if (err)
+			goto drop;
+
+		da = mac_cb(skb)->da;
+		mac_cb(skb)->seq = ieee802154_mlme_ops(sdev)->get_dsn(sdev);
+
+		err = dev_hard_header(skb, sdev, ETH_P_IEEE802154, &da,
+				NULL, skb->len);
+		if (err < 0)
+			goto drop;
+
+		skb_reset_mac_header(skb);
+	}
+
+	skb->dev = sdev;
+
+	return net_xmit_errno(dev_queue_xmit(skb));
+
+drop:
+	kfree_skb(skb);
+	return err;
+}
+
+static netdev_tx_t wpanbond_xmit(struct sk_buff *skb, struct net_device *dev)
+{
+	struct wpanbond *bond = wpanbond_priv(dev);
+	struct ieee802154_addr *da = &mac_cb(skb)->da;
+	struct wpanbond_slave *s;
+	struct net_device *sdev = NULL;
+	struct sk_buff *copy;
+	int err = -ENETDOWN;
+
+	dev->stats.tx_packets++;
+	dev->stats.tx_bytes += skb->len;
+
+	rcu_read_lock();
+
+	if (da->addr_type == IEEE802154_ADDR_SHORT &&
+	    da->short_addr == IEEE802154_ADDR_BROADCAST) {
+		list_for_each_entry_rcu(s, &bond->slaves, list) {
+			if (!netif_running(s->dev))
+				continue;
+
+			/* Every slave builds its own header */
+			if (sdev) {
+				copy = skb_copy(skb, GFP_ATOMIC);
+				if (copy)
+					wpanbond_xmit_one(copy, sdev);
+			}
+			sdev = s->dev;
+		}
+	} else
+		sdev = wpanbond_pick(bond, da);
+
+	if (sdev)
+		err = wpanbond_xmit_one(skb, sdev);
+	else
+		kfree_skb(skb);
+
+	rcu_read_unlock();
+
+	if (err) {
+		pr_debug("%s(): xmit failed: %d\n", __func__, err);
+		dev->stats.tx_errors++;
+	}
+
+	return NETDEV_TX_OK;
+}
+
+static int wpanbond_rcv(struct sk_buff *skb, struct net_device *dev,
+		struct packet_type *pt, struct net_device *orig_dev)
+{
+	struct wpanbond *bond;
+
+	if (dev->type != ARPHRD_IEEE802154)
+		goto drop;
+
+	bond = wpanbond_find(dev);
+	if (!bond || !netif_running(bond->dev))
+		goto drop;
+
+	if (skb->pkt_type == PACKET_OTHERHOST)
+		goto drop;
+
+	if (wpanbond_from_slave(bond, &mac_cb(skb)->sa))
+		goto drop;
+
+	if (wpanbond_peer_learn(bond, skb, dev)) {
+		bond->rx_duplicates++;
+		goto drop;
+	}
+
+	skb = skb_share_check(skb, GFP_ATOMIC);
+	if (!skb)
+		goto out;
+
+	skb->dev = bond->dev;
+
+	bond->dev->stats.rx_packets++;
+	bond->dev->stats.rx_bytes += skb->len;
+
+	return netif_rx(skb);
+
+drop:
+	kfree_skb(skb);
+out:
+	return NET_RX_DROP;
+}
+
+static ssize_t wpanbond_show_slaves(struct device *d,
+		struct device_attribute *attr, char *buf)
+{
+	struct wpanbond *bond = wpanbond_priv(to_net_dev(d));
+	struct wpanbond_slave *s;
+	int len = 0;
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(s, &bond->slaves, list)
+		len += scnprintf(buf + len, PAGE_SIZE - len, "%s%s",
+				len ? " " : "", s->dev->name);
+	rcu_read_unlock();
+
+	len += scnprintf(buf + len, PAGE_SIZE - len, "\n");
+
+	return len;
+}
+
+static ssize_t wpanbond_store_slaves(struct device *d,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct net_device *dev = to_net_dev(d);
+	struct wpanbond *bond = wpanbond_priv(dev);
+	struct wpanbond_slave *s, *found = NULL;
+	struct net_device *sdev;
+	char name[IFNAMSIZ + 1];
+	int err = 0;
+
+	if (sscanf(buf, "%16s", name) != 1 ||
+	    (name[0] != '+' && name[0] != '-'))
+		return -EINVAL;
+
+	/* Unregistering the bond removes this file under RTNL */
+	if (!rtnl_trylock())
+		return restart_syscall();
+
+	if (name[0] == '+') {
+		sdev = dev_get_by_name(dev_net(dev), name + 1);
+		if (!sdev) {
+			err = -ENODEV;
+			goto out;
+		}
+
+		err = wpanbond_enslave(bond, sdev);
+		if (err)
+			dev_put(sdev);
+		else
+			wpanbond_update_carrier(bond);
+		goto out;
+	}
+
+	list_for_each_entry(s, &bond->slaves, list)
+		if (!strcmp(s->dev->name, name + 1))
+			found = s;
+
+	if (!found)
+		err = -ENODEV;
+	else if (bond->count == 1)
+		/* Delete the link instead */
+		err = -EBUSY;
+	else {
+		wpanbond_release(bond, found);
+		wpanbond_update_carrier(bond);
+	}
+
+out:
+	rtnl_unlock();
+
+	return err ? err : count;
+}
+
+static ssize_t wpanbond_show_rx_duplicates(struct device *d,
+		struct device_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%u\n", wpanbond_priv(to_net_dev(d))->rx_duplicates);
+}
+
+static ssize_t wpanbond_show_peers(struct device *d,
+		struct device_attribute *attr, char *buf)
+{
+	return sprintf(buf, "%d\n", wpanbond_priv(to_net_dev(d))->peer_count);
+}
+
+static DEVICE_ATTR(slaves, S_IRUGO | S_IWUSR,
+		wpanbond_show_slaves, wpanbond_store_slaves);
+static DEVICE_ATTR(rx_duplicates, S_IRUGO, wpanbond_show_rx_duplicates, NULL);
+static DEVICE_ATTR(peers, S_IRUGO, wpanbond_show_peers, NULL);
+
+static struct attribute *wpanbond_attrs[] = {
+	&dev_attr_slaves.attr,
+	&dev_attr_rx_duplicates.attr,
+	&dev_attr_peers.attr,
+	NULL,
+};
+
+static struct attribute_group wpanbond_group = {
+	.name	= "wpanbond",
+	.attrs	= wpanbond_attrs,
+};
+
+static const struct header_ops wpanbond_header_ops = {
+	.create		= wpanbond_header_create,
+};
+
+static const struct net_device_ops wpanbond_netdev_ops = {
+	.ndo_start_xmit		= wpanbond_xmit,
+};
+
+static void wpanbond_free(struct net_device *dev)
+{
+	struct wpanbond *bond = wpanbond_priv(dev);
+
+	del_timer_sync(&bond->gc_timer);
+	wpanbond_peer_forget(bond, NULL, 0);
+
+	free_netdev(dev);
+}
+
+static void wpanbond_setup(struct net_device *dev)
+{
+	struct wpanbond *bond = wpanbond_priv(dev);
+	int i;
+
+	bond->dev = dev;
+	INIT_LIST_HEAD(&bond->slaves);
+	spin_lock_init(&bond->lock);
+	for (i = 0; i < WPANBOND_PEER_HASH_SIZE; i++)
+		INIT_HLIST_HEAD(&bond->peers[i]);
+	setup_timer(&bond->gc_timer, wpanbond_gc, (unsigned long)bond);
+
+	dev->addr_len		= IEEE802154_ADDR_LEN;
+	memset(dev->broadcast, 0xff, IEEE802154_ADDR_LEN);
+	dev->type		= ARPHRD_IEEE802154;
+	/* Frame Control + Sequence Number + Address fields + Security Header */
+	dev->hard_header_len	= 2 + 1 + 20 + 14;
+	dev->needed_tailroom	= 2; /* FCS */
+	dev->mtu		= 127;
+	dev->tx_queue_len	= 0;
+	dev->flags		= IFF_NOARP | IFF_BROADCAST;
+	dev->watchdog_timeo	= 0;
+
+	dev->ml_priv		= &wpanbond_mlme;
+	dev->netdev_ops		= &wpanbond_netdev_ops;
+	dev->header_ops		= &wpanbond_header_ops;
+	dev->destructor		= wpanbond_free;
+	dev->sysfs_groups[0]	= &wpanbond_group;
+}
+
+static int wpanbond_validate(struct nlattr *tb[], struct nlattr *data[])
+{
+	if (tb[IFLA_ADDRESS] &&
+	    nla_len(tb[IFLA_ADDRESS]) != IEEE802154_ADDR_LEN)
+		return -EINVAL;
+
+	return 0;
+}
+
+static int wpanbond_newlink(struct net *src_net, struct net_device *dev,
+		struct nlattr *tb[], struct nlattr *data[])
+{
+	struct wpanbond *bond = wpanbond_priv(dev);
+	struct wpanbond_slave *s;
+	struct net_device *sdev;
+	int err;
+
+	ASSERT_RTNL();
+
+	if (!tb[IFLA_LINK])
+		return -EINVAL;
+
+	sdev = dev_get_by_index(src_net, nla_get_u32(tb[IFLA_LINK]));
+	if (!sdev)
+		return -ENODEV;
+
+	err = wpanbond_enslave(bond, sdev);
+	if (err) {
+		dev_put(sdev);
+		return err;
+	}
+
+	/*
+	 * The slaves send with their own addresses, the bond needs one
+	 * of its own for sockets to be bound to it.
+	 */
+	if (!tb[IFLA_ADDRESS])
+		get_random_bytes(dev->dev_addr, IEEE802154_ADDR_LEN);
+
+	err = register_netdevice(dev);
+	if (err < 0) {
+		s = list_first_entry(&bond->slaves,
+				struct wpanbond_slave, list);
+		wpanbond_release(bond, s);
+		return err;
+	}
+
+	list_add_tail_rcu(&bond->list, &wpanbond_devices);
+	wpanbond_update_carrier(bond);
+	mod_timer(&bond->gc_timer, jiffies + WPANBOND_GC_INTERVAL);
+
+	return 0;
+}
+
+static void wpanbond_dellink(struct net_device *dev, struct list_head *head)
+{
+	struct wpanbond *bond = wpanbond_priv(dev);
+	struct wpanbond_slave *s, *tmp;
+
+	ASSERT_RTNL();
+
+	list_del_rcu(&bond->list);
+
+	list_for_each_entry_safe(s, tmp, &bond->slaves, list)
+		wpanbond_release(bond, s);
+
+	unregister_netdevice_queue(dev, head);
+}
+
+static struct rtnl_link_ops wpanbond_link_ops __read_mostly = {
+	.kind		= "wpanbond",
+	.priv_size	= sizeof(struct wpanbond),
+	.setup		= wpanbond_setup,
+	.newlink	= wpanbond_newlink,
+	.dellink	= wpanbond_dellink,
+	.validate	= wpanbond_validate,
+};
+
+static int wpanbond_device_event(struct notifier_block *unused,
+		unsigned long event, void *ptr)
+{
+	struct net_device *dev = ptr;
+	struct wpanbond *bond, *btmp;
+	struct wpanbond_slave *s, *stmp;
+	LIST_HEAD(del_list);
+
+	if (dev->type != ARPHRD_IEEE802154 ||
+	    dev->netdev_ops == &wpanbond_netdev_ops)
+		return NOTIFY_DONE;
+
+	switch (event) {
+	case NETDEV_UP:
+	case NETDEV_DOWN:
+		bond = wpanbond_find(dev);
+		if (!bond)
+			break;
+
+		/* Replies have to go through the remaining radios */
+		if (event == NETDEV_DOWN)
+			wpanbond_peer_forget(bond, dev, 0);
+		wpanbond_update_carrier(bond);
+		break;
+	case NETDEV_UNREGISTER:
+		list_for_each_entry_safe(bond, btmp, &wpanbond_devices, list) {
+			list_for_each_entry_safe(s, stmp, &bond->slaves, list)
+				if (s->dev == dev)
+					wpanbond_release(bond, s);
+
+			if (!bond->count)
+				wpanbond_dellink(bond->dev, &del_list);
+			else
+				wpanbond_update_carrier(bond);
+		}
+
+		unregister_netdevice_many(&del_list);
+		break;
+	}
+
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block wpanbond_dev_notifier = {
+	.notifier_call = wpanbond_device_event,
+};
+
+static struct packet_type wpanbond_packet_type = {
+	.type = __constant_htons(ETH_P_IEEE802154),
+	.func = wpanbond_rcv,
+};
+
+static int __init wpanbond_init_module(void)
+{
+	int err;
+
+	err = rtnl_link_register(&wpanbond_link_ops);
+	if (err < 0)
+		goto out;
+
+	err = register_netdevice_notifier(&wpanbond_dev_notifier);
+	if (err < 0)
+		goto out_link;
+
+	dev_add_pack(&wpanbond_packet_type);
+
+	return 0;
+
+out_link:
+	rtnl_link_unregister(&wpanbond_link_ops);
+out:
+	return err;
+}
+module_init(wpanbond_init_module);
+
+static void __exit wpanbond_cleanup_module(void)
+{
+	dev_remove_pack(&wpanbond_packet_type);
+	unregister_netdevice_notifier(&wpanbond_dev_notifier);
+	rtnl_link_unregister(&wpanbond_link_ops);
+}
+module_exit(wpanbond_cleanup_module);
+
+MODULE_LICENSE("GPL");
+MODULE_ALIAS_RTNL_LINK("wpanbond");
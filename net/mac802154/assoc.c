@@ -0,0 +1,470 @@
+/*
+ * In-kernel association handling for PAN coordinators
+ *
+ * Copyright 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Written by:
+ * agent <agent@local>
+ */
+
+/*
+ * By default association requests are passed to userspace, which
+ * answers with an association response. With the "assoc/enabled"
+ * attribute set, the coordinator answers them itself:
+ *
+ * - a device already known gets its previous short address again;
+ * - otherwise, with joining permitted and less than max_devices known,
+ *   it gets the next free address of [first, last] from a bitmap, or
+ *   0xfffe if it did not ask for one;
+ * - requests beyond the token bucket of rate per second and burst are
+ *   dropped, the device will retry after macResponseWaitTime.
+ *
+ * Responses are sent from a work item, as sending a command may sleep.
+ * Userspace learns the outcome with an IEEE802154_ASSOCIATE_DONE_INDIC.
+ */
+
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/jhash.h>
+#include <linux/bitops.h>
+#include <linux/netdevice.h>
+#include <linux/skbuff.h>
+
+#include <net/af_ieee802154.h>
+#include <net/mac802154.h>
+#include <net/ieee802154.h>
+#include <net/ieee802154_netdev.h>
+#include <net/nl802154.h>
+
+#include "mac802154.h"
+#include "mib.h"
+
+#define IEEE802154_ASSOC_SHORT_FIRST	0x0001
+#define IEEE802154_ASSOC_SHORT_LAST	0xfff7
+#define IEEE802154_ASSOC_MAX_DEVS	4096
+#define IEEE802154_ASSOC_RATE		50
+#define IEEE802154_ASSOC_BURST		100
+/* Responses waiting for the work item */
+#define IEEE802154_ASSOC_MAX_PENDING	256
+
+struct assoc_dev {
+	struct hlist_node	node;
+	u8			hwaddr[IEEE802154_ADDR_LEN];
+	u16			short_addr;
+};
+
+struct assoc_resp {
+	struct list_head	list;
+	struct ieee802154_addr	addr;
+	u16			short_addr;
+	u8			cap;
+	u8			status;
+};
+
+static inline unsigned int assoc_hash(const u8 *hwaddr)
+{
+	return jhash(hwaddr, IEEE802154_ADDR_LEN, 0) &
+		(IEEE802154_ASSOC_HASH_SIZE - 1);
+}
+
+/* Must be called with as->lock held */
+static struct assoc_dev *assoc_find(struct ieee802154_assoc *as,
+		const u8 *hwaddr)
+{
+	struct assoc_dev *ad;
+	struct hlist_node *node;
+
+	hlist_for_each_entry(ad, node, &as->by_long[assoc_hash(hwaddr)], node)
+		if (!memcmp(ad->hwaddr, hwaddr, IEEE802154_ADDR_LEN))
+			return ad;
+
+	return NULL;
+}
+
+/* Must be called with as->lock held */
+static bool assoc_rate_ok(struct ieee802154_assoc *as)
+{
+	unsigned long elapsed = jiffies - as->last_fill;
+
+	if (!as->rate)
+		return true;
+
+	/* Refill in whole tokens, keeping the remainder of time */
+	if (elapsed >= (as->burst / as->rate + 1) * HZ) {
+		as->tokens = as->burst;
+		as->last_fill = jiffies;
+	} else {
+		as->tokens += elapsed * as->rate / HZ;
+		as->last_fill += elapsed - elapsed * as->rate % HZ / as->rate;
+		if (as->tokens > as->burst)
+			as->tokens = as->burst;
+	}
+
+	if (!as->tokens)
+		return false;
+
+	as->tokens--;
+	return true;
+}
+
+/* Must be called with as->lock held */
+static int assoc_alloc_short(struct ieee802154_sub_if_data *priv)
+{
+	struct ieee802154_assoc *as = &priv->assoc;
+	u16 own = ieee802154_dev_get_short_addr(priv->dev);
+	unsigned long bit;
+
+	/* Our own address is never given out */
+	if (own >= as->first && own <= as->last)
+		set_bit(own, as->bitmap);
+
+	/* Start after the last address given out, wrap around once */
+	bit = find_next_zero_bit(as->bitmap, as->last + 1, as->hint);
+	if (bit > as->last)
+		bit = find_next_zero_bit(as->bitmap, as->last + 1, as->first);
+	if (bit > as->last)
+		return -ENOSPC;
+
+	set_bit(bit, as->bitmap);
+	as->hint = bit + 1;
+
+	return bit;
+}
+
+/* Must be called with as->lock held */
+static u8 assoc_admit(struct ieee802154_sub_if_data *priv, const u8 *hwaddr,
+		u8 cap, u16 *short_addr)
+{
+	struct ieee802154_assoc *as = &priv->assoc;
+	struct assoc_dev *ad;
+	int bit;
+
+	ad = assoc_find(as, hwaddr);
+	if (ad) {
+		*short_addr = ad->short_addr;
+		return IEEE802154_SUCCESS;
+	}
+
+	if (!as->permit)
+		return IEEE802154_ASSOC_ACCESS_DENIED;
+
+	if (as->count >= as->max_devs)
+		return IEEE802154_ASSOC_PAN_AT_CAPACITY;
+
+	ad = kzalloc(sizeof(*ad), GFP_ATOMIC);
+	if (!ad)
+		return IEEE802154_ASSOC_PAN_AT_CAPACITY;
+
+	if (cap & IEEE802154_CAP_ALLOC_ADDR) {
+		bit = assoc_alloc_short(priv);
+		if (bit < 0) {
+			kfree(ad);
+			return IEEE802154_ASSOC_PAN_AT_CAPACITY;
+		}
+		ad->short_addr = bit;
+	} else
+		ad->short_addr = IEEE802154_ADDR_UNDEF;
+
+	memcpy(ad->hwaddr, hwaddr, IEEE802154_ADDR_LEN);
+	hlist_add_head(&ad->node, &as->by_long[assoc_hash(hwaddr)]);
+	as->count++;
+
+	*short_addr = ad->short_addr;
+	return IEEE802154_SUCCESS;
+}
+
+/* Must be called with as->lock held */
+static void assoc_dev_free(struct ieee802154_assoc *as, struct assoc_dev *ad)
+{
+	if (ad->short_addr != IEEE802154_ADDR_UNDEF)
+		clear_bit(ad->short_addr, as->bitmap);
+	hlist_del(&ad->node);
+	as->count--;
+	kfree(ad);
+}
+
+/*
+ * Called for association requests received by a coordinator. Returns
+ * false if the request is to be passed to userspace.
+ */
+bool ieee802154_assoc_req(struct ieee802154_sub_if_data *priv,
+		struct ieee802154_addr *addr, u8 cap)
+{
+	struct ieee802154_assoc *as = &priv->assoc;
+	struct assoc_resp *resp;
+	u16 short_addr = IEEE802154_ADDR_BROADCAST;
+	u8 status;
+
+	spin_lock_bh(&as->lock);
+
+	if (!as->bitmap) {
+		spin_unlock_bh(&as->lock);
+		return false;
+	}
+
+	if (as->pending >= IEEE802154_ASSOC_MAX_PENDING ||
+	    !assoc_rate_ok(as)) {
+		as->dropped++;
+		goto out;
+	}
+
+	resp = kzalloc(sizeof(*resp), GFP_ATOMIC);
+	if (!resp) {
+		as->dropped++;
+		goto out;
+	}
+
+	status = assoc_admit(priv, addr->hwaddr, cap, &short_addr);
+	if (status == IEEE802154_SUCCESS)
+		as->accepted++;
+	else
+		as->rejected++;
+
+	resp->addr = *addr;
+	resp->addr.pan_id = ieee802154_dev_get_pan_id(priv->dev);
+	resp->short_addr = short_addr;
+	resp->cap = cap;
+	resp->status = status;
+	list_add_tail(&resp->list, &as->resps);
+	as->pending++;
+
+	schedule_work(&as->work);
+out:
+	spin_unlock_bh(&as->lock);
+
+	return true;
+}
+
+/* The device left the PAN, its short address may be given out again */
+void ieee802154_assoc_release(struct ieee802154_sub_if_data *priv,
+		const u8 *hwaddr)
+{
+	struct ieee802154_assoc *as = &priv->assoc;
+	struct assoc_dev *ad;
+
+	spin_lock_bh(&as->lock);
+	if (as->bitmap) {
+		ad = assoc_find(as, hwaddr);
+		if (ad)
+			assoc_dev_free(as, ad);
+	}
+	spin_unlock_bh(&as->lock);
+}
+
+static void ieee802154_assoc_worker(struct work_struct *work)
+{
+	struct ieee802154_assoc *as =
+		container_of(work, struct ieee802154_assoc, work);
+	struct ieee802154_sub_if_data *priv =
+		container_of(as, struct ieee802154_sub_if_data, assoc);
+	struct net_device *dev = priv->dev;
+	struct assoc_resp *resp, *next;
+	LIST_HEAD(resps);
+
+	spin_lock_bh(&as->lock);
+	list_splice_init(&as->resps, &resps);
+	as->pending = 0;
+	spin_unlock_bh(&as->lock);
+
+	list_for_each_entry_safe(resp, next, &resps, list) {
+		mac802154_mlme.assoc_resp(dev, &resp->addr, resp->short_addr,
+				resp->status);
+		ieee802154_nl_assoc_done_indic(dev, &resp->addr,
+				resp->short_addr, resp->cap, resp->status);
+		kfree(resp);
+	}
+}
+
+static void assoc_flush(struct ieee802154_assoc *as)
+{
+	struct assoc_dev *ad;
+	struct hlist_node *node, *tmp;
+	struct assoc_resp *resp, *next;
+	int i;
+
+	for (i = 0; i < IEEE802154_ASSOC_HASH_SIZE; i++)
+		hlist_for_each_entry_safe(ad, node, tmp, &as->by_long[i], node)
+			assoc_dev_free(as, ad);
+
+	list_for_each_entry_safe(resp, next, &as->resps, list) {
+		list_del(&resp->list);
+		kfree(resp);
+	}
+	as->pending = 0;
+}
+
+void ieee802154_assoc_init(struct ieee802154_sub_if_data *priv)
+{
+	struct ieee802154_assoc *as = &priv->assoc;
+	int i;
+
+	spin_lock_init(&as->lock);
+
+	for (i = 0; i < IEEE802154_ASSOC_HASH_SIZE; i++)
+		INIT_HLIST_HEAD(&as->by_long[i]);
+	INIT_LIST_HEAD(&as->resps);
+	INIT_WORK(&as->work, ieee802154_assoc_worker);
+
+	as->first = IEEE802154_ASSOC_SHORT_FIRST;
+	as->last = IEEE802154_ASSOC_SHORT_LAST;
+	as->hint = as->first;
+	as->permit = 1;
+	as->max_devs = IEEE802154_ASSOC_MAX_DEVS;
+	as->rate = IEEE802154_ASSOC_RATE;
+	as->burst = as->tokens = IEEE802154_ASSOC_BURST;
+	as->last_fill = jiffies;
+}
+
+static int ieee802154_assoc_enable(struct ieee802154_sub_if_data *priv,
+		bool enable)
+{
+	struct ieee802154_assoc *as = &priv->assoc;
+	unsigned long *bitmap = NULL, *old;
+
+	if (enable) {
+		bitmap = kzalloc(BITS_TO_LONGS(0x10000) * sizeof(long),
+				GFP_KERNEL);
+		if (!bitmap)
+			return -ENOMEM;
+	}
+
+	spin_lock_bh(&as->lock);
+	if (!!as->bitmap == enable) {
+		spin_unlock_bh(&as->lock);
+		kfree(bitmap);
+		return 0;
+	}
+
+	assoc_flush(as);
+	old = as->bitmap;
+	as->bitmap = bitmap;
+	as->hint = as->first;
+	spin_unlock_bh(&as->lock);
+
+	if (!enable)
+		cancel_work_sync(&as->work);
+	kfree(old);
+
+	return 0;
+}
+
+void ieee802154_assoc_flush(struct ieee802154_sub_if_data *priv)
+{
+	ieee802154_assoc_enable(priv, false);
+}
+
+#define ASSOC_SHOW(name)						\
+static ssize_t name##_show(struct device *d,				\
+		struct device_attribute *attr, char *buf)		\
+{									\
+	struct ieee802154_sub_if_data *priv = netdev_priv(to_net_dev(d)); \
+	struct ieee802154_assoc *as = &priv->assoc;			\
+	ssize_t ret;							\
+									\
+	spin_lock_bh(&as->lock);					\
+	ret = snprintf(buf, PAGE_SIZE, "%u\n", as->name);		\
+	spin_unlock_bh(&as->lock);					\
+	return ret;							\
+}
+
+#define ASSOC_ATTR_RO(name)						\
+ASSOC_SHOW(name)							\
+static DEVICE_ATTR(name, S_IRUGO, name##_show, NULL)
+
+/* The address range can only be changed while disabled */
+#define ASSOC_ATTR_RW(name, min, max, range)				\
+ASSOC_SHOW(name)							\
+static ssize_t name##_store(struct device *d,				\
+		struct device_attribute *attr,				\
+		const char *buf, size_t count)				\
+{									\
+	struct ieee802154_sub_if_data *priv = netdev_priv(to_net_dev(d)); \
+	struct ieee802154_assoc *as = &priv->assoc;			\
+	unsigned long val;						\
+	int ret;							\
+									\
+	ret = strict_strtoul(buf, 0, &val);				\
+	if (ret)							\
+		return ret;						\
+									\
+	spin_lock_bh(&as->lock);					\
+	if (val < (min) || val > (max))					\
+		ret = -EINVAL;						\
+	else if ((range) && as->bitmap)					\
+		ret = -EBUSY;						\
+	else								\
+		as->name = val;						\
+	spin_unlock_bh(&as->lock);					\
+	return ret ? ret : count;					\
+}									\
+static DEVICE_ATTR(name, S_IRUGO | S_IWUSR, name##_show, name##_store)
+
+ASSOC_ATTR_RW(permit, 0, 1, false);
+ASSOC_ATTR_RW(max_devs, 0, 0xffff, false);
+ASSOC_ATTR_RW(rate, 0, 1000, false);
+ASSOC_ATTR_RW(burst, 0, 0xffff, false);
+ASSOC_ATTR_RW(first, 0, as->last, true);
+ASSOC_ATTR_RW(last, as->first, IEEE802154_ADDR_UNDEF - 1, true);
+ASSOC_ATTR_RO(count);
+ASSOC_ATTR_RO(accepted);
+ASSOC_ATTR_RO(rejected);
+ASSOC_ATTR_RO(dropped);
+
+static ssize_t enabled_show(struct device *d,
+		struct device_attribute *attr, char *buf)
+{
+	struct ieee802154_sub_if_data *priv = netdev_priv(to_net_dev(d));
+
+	return snprintf(buf, PAGE_SIZE, "%d\n", priv->assoc.bitmap != NULL);
+}
+
+static ssize_t enabled_store(struct device *d,
+		struct device_attribute *attr, const char *buf, size_t count)
+{
+	struct ieee802154_sub_if_data *priv = netdev_priv(to_net_dev(d));
+	unsigned long val;
+	int ret;
+
+	ret = strict_strtoul(buf, 0, &val);
+	if (ret)
+		return ret;
+	if (val > 1)
+		return -EINVAL;
+
+	ret = ieee802154_assoc_enable(priv, val);
+	return ret ? ret : count;
+}
+static DEVICE_ATTR(enabled, S_IRUGO | S_IWUSR, enabled_show, enabled_store);
+
+static struct attribute *ieee802154_assoc_attrs[] = {
+	&dev_attr_enabled.attr,
+	&dev_attr_permit.attr,
+	&dev_attr_max_devs.attr,
+	&dev_attr_rate.attr,
+	&dev_attr_burst.attr,
+	&dev_attr_first.attr,
+	&dev_attr_last.attr,
+	&dev_attr_count.attr,
+	&dev_attr_accepted.attr,
+	&dev_attr_rejected.attr,
+	&dev_attr_dropped.attr,
+	NULL,
+};
+
+struct attribute_group ieee802154_assoc_group = {
+	.name	= "assoc",
+	.attrs	= ieee802154_assoc_attrs,
+};
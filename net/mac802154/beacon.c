@@ -79,20 +79,21 @@
  * 0-2   Number of short addresses pending
  * */
 
+#define IEEE802154_BEACON_SF_BO(x)		((x & 0xf) << 0)
 #define IEEE802154_BEACON_SF_BO_BEACONLESS	(15 << 0)
 #define IEEE802154_BEACON_SF_SO(x)		((x & 0xf) << 4)
 #define IEEE802154_BEACON_SF_SO_INACTIVE	IEEE802154_BEACON_SF_SO(15)
+#define IEEE802154_BEACON_SF_FINAL_CAP(x)	((x & 0xf) << 8)
 #define IEEE802154_BEACON_SF_PANCOORD		(1 << 14)
 #define IEEE802154_BEACON_SF_CANASSOC		(1 << 15)
 #define IEEE802154_BEACON_GTS_COUNT(x)		(x << 0)
 #define IEEE802154_BEACON_GTS_PERMIT		(1 << 7)
 #define IEEE802154_BEACON_PA_SHORT(x)		((x & 7) << 0)
 #define IEEE802154_BEACON_PA_LONG(x)		((x & 7) << 4)
-
-/* Flags parameter */
-#define IEEE802154_BEACON_FLAG_PANCOORD		(1 << 0)
-#define IEEE802154_BEACON_FLAG_CANASSOC		(1 << 1)
-#define IEEE802154_BEACON_FLAG_GTSPERMIT		(1 << 2)
+#define IEEE802154_BEACON_PA_SHORT_CNT(x)	((x) & 7)
+#define IEEE802154_BEACON_PA_LONG_CNT(x)	(((x) >> 4) & 7)
+#define IEEE802154_BEACON_PA_MAX_LEN		\
+	(1 + IEEE802154_INDIRECT_PA_MAX * IEEE802154_ADDR_LEN)
 
 struct ieee802154_address_list {
 	struct list_head list;
@@ -121,25 +122,24 @@ struct ieee802154_address_list {
 */
 
 
-int ieee802154_send_beacon(struct net_device *dev,
-		struct ieee802154_addr *saddr,
-		u16 pan_id, const u8 *buf, int len,
-		int flags, struct list_head *al)
+struct sk_buff *ieee802154_beacon_build(struct net_device *dev,
+		struct ieee802154_addr *saddr, const u8 *buf, int len,
+		int flags)
 {
+	struct ieee802154_sub_if_data *priv = netdev_priv(dev);
 	struct sk_buff *skb;
 	int err;
-	u16 sf;
+	__le16 sf;
+	u16 sf_spec;
 	u8 gts;
-	u8 pa_spec;
-	int addr16_cnt;
-	int addr64_cnt;
 	struct ieee802154_addr addr;
 
 	BUG_ON(dev->type != ARPHRD_IEEE802154);
 
-	skb = alloc_skb(LL_ALLOCATED_SPACE(dev) + len, GFP_ATOMIC);
+	skb = alloc_skb(LL_ALLOCATED_SPACE(dev) + sizeof(sf) + sizeof(gts) +
+			IEEE802154_BEACON_PA_MAX_LEN + len, GFP_ATOMIC);
 	if (!skb)
-		return -ENOMEM;
+		return ERR_PTR(-ENOMEM);
 
 	skb_reserve(skb, LL_RESERVED_SPACE(dev));
 
@@ -152,18 +152,27 @@ int ieee802154_send_beacon(struct net_device *dev,
 	err = dev_hard_header(skb, dev, ETH_P_IEEE802154, &addr, saddr, len);
 	if (err < 0) {
 		kfree_skb(skb);
-		return err;
+		return ERR_PTR(err);
 	}
 	skb_reset_mac_header(skb);
 
 	/* Superframe */
-	sf = IEEE802154_BEACON_SF_BO_BEACONLESS;
-	sf |= IEEE802154_BEACON_SF_SO_INACTIVE;
+	if (priv->sf.active) {
+		/* No GTS are allocated, so the CAP spans the whole
+		 * active portion */
+		sf_spec = IEEE802154_BEACON_SF_BO(priv->sf.bo);
+		sf_spec |= IEEE802154_BEACON_SF_SO(priv->sf.so);
+		sf_spec |= IEEE802154_BEACON_SF_FINAL_CAP(15);
+	} else {
+		sf_spec = IEEE802154_BEACON_SF_BO_BEACONLESS;
+		sf_spec |= IEEE802154_BEACON_SF_SO_INACTIVE;
+	}
 	if (flags & IEEE802154_BEACON_FLAG_PANCOORD)
-		sf |= IEEE802154_BEACON_SF_PANCOORD;
+		sf_spec |= IEEE802154_BEACON_SF_PANCOORD;
 
 	if (flags & IEEE802154_BEACON_FLAG_CANASSOC)
-		sf |= IEEE802154_BEACON_SF_CANASSOC;
+		sf_spec |= IEEE802154_BEACON_SF_CANASSOC;
+	sf = cpu_to_le16(sf_spec);
 	memcpy(skb_put(skb,  sizeof(sf)), &sf, sizeof(sf));
 
 	/* TODO GTS */
@@ -173,19 +182,28 @@ int ieee802154_send_beacon(struct net_device *dev,
 		gts |= IEEE802154_BEACON_GTS_PERMIT;
 	memcpy(skb_put(skb, sizeof(gts)), &gts, sizeof(gts));
 
-	/* FIXME pending address */
-	addr16_cnt = 0;
-	addr64_cnt = 0;
-
-	pa_spec = IEEE802154_BEACON_PA_LONG(addr64_cnt) |
-		IEEE802154_BEACON_PA_SHORT(addr16_cnt);
-	memcpy(skb_put(skb, sizeof(pa_spec)), &pa_spec, sizeof(pa_spec));
+	/* Pending addresses come from the indirect transmission queue */
+	ieee802154_indirect_fill_pa(priv, skb);
 
 	memcpy(skb_put(skb, len), buf, len);
 
 	skb->dev = dev;
 	skb->protocol = htons(ETH_P_IEEE802154);
 
+	return skb;
+}
+
+int ieee802154_send_beacon(struct net_device *dev,
+		struct ieee802154_addr *saddr,
+		u16 pan_id, const u8 *buf, int len,
+		int flags, struct list_head *al)
+{
+	struct sk_buff *skb;
+
+	skb = ieee802154_beacon_build(dev, saddr, buf, len, flags);
+	if (IS_ERR(skb))
+		return PTR_ERR(skb);
+
 	return dev_queue_xmit(skb);
 }
 
@@ -223,11 +241,11 @@ int parse_beacon_frame(struct sk_buff *skb, u8 *buf,
 		return -ENOTSUPP;
 	}
 	pa_spec = skb->data[offt++];
-	/* FIXME !!! */
-	if (pa_spec != 0) {
-		pr_debug("We still don't parse PA part properly");
-		return -ENOTSUPP;
-	}
+	/* FIXME: check if we are in the list and send a data request */
+	offt += IEEE802154_BEACON_PA_SHORT_CNT(pa_spec) * 2 +
+		IEEE802154_BEACON_PA_LONG_CNT(pa_spec) * IEEE802154_ADDR_LEN;
+	if (offt > skb->len)
+		return -EINVAL;
 
 	*flags = 0;
 
@@ -37,6 +37,11 @@ struct ieee802154_pandsc {
 	u32			timestamp;
 };
 
+/* Flags parameter */
+#define IEEE802154_BEACON_FLAG_PANCOORD		(1 << 0)
+#define IEEE802154_BEACON_FLAG_CANASSOC		(1 << 1)
+#define IEEE802154_BEACON_FLAG_GTSPERMIT		(1 << 2)
+
 int parse_beacon_frame(struct sk_buff *skb, u8 * buf,
 		int *flags, struct list_head *al);
 
@@ -45,5 +50,9 @@ int ieee802154_send_beacon(struct net_device *dev,
 		u16 pan_id, const u8 *buf, int len,
 		int flags, struct list_head *al);
 
+struct sk_buff *ieee802154_beacon_build(struct net_device *dev,
+		struct ieee802154_addr *saddr, const u8 *buf, int len,
+		int flags);
+
 #endif /* IEEE802154_BEACON_H */
 
@@ -0,0 +1,499 @@
+/*
+ * Data path benchmark for mac802154
+ *
+ * Copyright 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Written by:
+ * agent <agent@local>
+ */
+
+/*
+ * The module registers a virtual PHY with one interface and pushes
+ * synthetic data frames through mac802154, controlled through
+ * debugfs (mac802154_bench/):
+ *
+ *  size, count, rate	payload octets, number of frames and frames per
+ *			second (0 for as fast as possible)
+ *  run			write "rx" to feed frames to ieee802154_rx(),
+ *			"tx" to send them through the interface
+ *  results		throughput, cycles (without the time spent waiting
+ *			for the rate) and allocations per frame and latency
+ *			percentiles of the last run
+ *
+ * RX latency is the time spent in ieee802154_rx(), up to the frame being
+ * queued to the network stack. TX latency is the time from
+ * dev_queue_xmit() until the frame reaches the driver.
+ */
+
+#include <linux/kernel.h>
+#include <linux/module.h>
+#include <linux/netdevice.h>
+#include <linux/skbuff.h>
+#include <linux/debugfs.h>
+#include <linux/vmalloc.h>
+#include <linux/sort.h>
+#include <linux/hrtimer.h>
+#include <linux/sched.h>
+#include <linux/crc-ccitt.h>
+#include <linux/uaccess.h>
+#include <linux/rtnetlink.h>
+#include <net/netlink.h>
+#include <linux/nl802154.h>
+#include <asm/timex.h>
+
+#include <net/af_ieee802154.h>
+#include <net/mac802154.h>
+#include <net/ieee802154.h>
+#include <net/ieee802154_netdev.h>
+#include <net/wpan-phy.h>
+
+#include "mac802154.h"
+
+#define BENCH_MAX_COUNT		(1 << 20)
+#define BENCH_PAN_ID		0x1234
+#define BENCH_SHORT_ADDR	0x0001
+#define BENCH_CHANNEL		11
+/* Data frame, intra PAN, short destination and source addresses */
+#define BENCH_FC		0x8841
+#define BENCH_HDR_LEN		9
+
+struct mac802154_bench {
+	struct ieee802154_dev *hw;
+	struct net_device *dev;
+	struct dentry *dir;
+
+	u32 size;
+	u32 count;
+	u32 rate;
+
+	/* Serialises runs and access to the results */
+	struct mutex lock;
+
+	/* Current run */
+	u32 *lat;
+	u32 n;
+	atomic_t done;
+	wait_queue_head_t wq;
+	cycles_t paced;
+
+	/* Results of the last run */
+	const char *mode;
+	u32 frames;
+	u64 elapsed_ns;
+	u64 cycles;
+	u32 allocs;
+	u32 p50, p90, p99, max;
+};
+
+static struct mac802154_bench bench = {
+	.size	= 50,
+	.count	= 10000,
+};
+
+static int bench_xmit(struct ieee802154_dev *dev, struct sk_buff *skb)
+{
+	u32 i = atomic_read(&bench.done);
+	u32 n = ACCESS_ONCE(bench.n);
+
+	/* Frames left over from a timed out run are not recorded */
+	if (i >= n)
+		return 0;
+
+	bench.lat[i] = ktime_to_ns(ktime_sub(ktime_get_real(),
+			skb->tstamp));
+
+	if (atomic_inc_return(&bench.done) >= n)
+		wake_up(&bench.wq);
+
+	return 0;
+}
+
+static int bench_ed(struct ieee802154_dev *dev, u8 *level)
+{
+	*level = 0;
+	return 0;
+}
+
+static int bench_set_channel(struct ieee802154_dev *dev, int channel)
+{
+	dev->phy->current_channel = channel;
+	return 0;
+}
+
+static int bench_start(struct ieee802154_dev *dev)
+{
+	return 0;
+}
+
+static void bench_stop(struct ieee802154_dev *dev)
+{
+}
+
+static struct ieee802154_ops bench_ops = {
+	.owner		= THIS_MODULE,
+	.xmit		= bench_xmit,
+	.ed		= bench_ed,
+	.set_channel	= bench_set_channel,
+	.start		= bench_start,
+	.stop		= bench_stop,
+};
+
+static struct sk_buff *bench_rx_frame(u8 seq)
+{
+	struct sk_buff *skb;
+	u8 *data;
+	u16 crc;
+
+	skb = alloc_skb(BENCH_HDR_LEN + bench.size + 2, GFP_KERNEL);
+	if (!skb)
+		return NULL;
+
+	data = skb_put(skb, BENCH_HDR_LEN);
+	data[0] = BENCH_FC & 0xff;
+	data[1] = BENCH_FC >> 8;
+	data[2] = seq;
+	data[3] = BENCH_PAN_ID & 0xff;
+	data[4] = BENCH_PAN_ID >> 8;
+	data[5] = IEEE802154_ADDR_BROADCAST & 0xff;
+	data[6] = IEEE802154_ADDR_BROADCAST >> 8;
+	data[7] = (BENCH_SHORT_ADDR + 1) & 0xff;
+	data[8] = (BENCH_SHORT_ADDR + 1) >> 8;
+	memset(skb_put(skb, bench.size), 0xa5, bench.size);
+
+	crc = crc_ccitt(0, skb->data, skb->len);
+	data = skb_put(skb, 2);
+	data[0] = crc & 0xff;
+	data[1] = crc >> 8;
+
+	return skb;
+}
+
+static struct sk_buff *bench_tx_frame(u8 seq)
+{
+	struct net_device *dev = bench.dev;
+	struct ieee802154_addr da;
+	struct sk_buff *skb;
+	int err;
+
+	skb = alloc_skb(LL_ALLOCATED_SPACE(dev) + bench.size, GFP_KERNEL);
+	if (!skb)
+		return NULL;
+
+	skb_reserve(skb, LL_RESERVED_SPACE(dev));
+	skb_reset_network_header(skb);
+	memset(skb_put(skb, bench.size), 0xa5, bench.size);
+
+	skb->dev = dev;
+	skb->protocol = htons(ETH_P_IEEE802154);
+
+	mac_cb(skb)->flags = IEEE802154_FC_TYPE_DATA;
+	mac_cb(skb)->seq = seq;
+
+	da.addr_type = IEEE802154_ADDR_SHORT;
+	da.pan_id = BENCH_PAN_ID;
+	da.short_addr = BENCH_SHORT_ADDR + 1;
+
+	err = dev_hard_header(skb, dev, ETH_P_IEEE802154, &da, NULL,
+			bench.size);
+	if (err < 0) {
+		kfree_skb(skb);
+		return NULL;
+	}
+	skb_reset_mac_header(skb);
+
+	return skb;
+}
+
+/* Wait until the i-th frame is due, the wait is not counted in cycles */
+static void bench_pace(ktime_t start, u32 i)
+{
+	cycles_t c;
+	ktime_t t;
+
+	if (!bench.rate)
+		return;
+
+	c = get_cycles();
+	t = ktime_add_ns(start, div_u64((u64)i * NSEC_PER_SEC, bench.rate));
+	set_current_state(TASK_UNINTERRUPTIBLE);
+	schedule_hrtimeout(&t, HRTIMER_MODE_ABS);
+	bench.paced += get_cycles() - c;
+}
+
+static int bench_run_rx(void)
+{
+	struct sk_buff *skb;
+	ktime_t start, t;
+	u32 i;
+
+	start = ktime_get();
+	for (i = 0; i < bench.n; i++) {
+		bench_pace(start, i);
+
+		skb = bench_rx_frame(i);
+		if (!skb)
+			return -ENOMEM;
+
+		t = ktime_get();
+		ieee802154_rx(bench.hw, skb, 0xff);
+		bench.lat[i] = ktime_to_ns(ktime_sub(ktime_get(), t));
+	}
+	atomic_set(&bench.done, bench.n);
+
+	return 0;
+}
+
+static int bench_run_tx(void)
+{
+	struct sk_buff *skb;
+	ktime_t start;
+	u32 i;
+
+	start = ktime_get();
+	for (i = 0; i < bench.n; i++) {
+		bench_pace(start, i);
+
+		skb = bench_tx_frame(i);
+		if (!skb)
+			return -ENOMEM;
+
+		__net_timestamp(skb);
+		dev_queue_xmit(skb);
+	}
+
+	/* Dropped frames never reach the driver */
+	if (!wait_event_timeout(bench.wq, atomic_read(&bench.done) >= bench.n,
+				10 * HZ))
+		return -ETIMEDOUT;
+
+	return 0;
+}
+
+static int bench_cmp(const void *a, const void *b)
+{
+	u32 x = *(const u32 *)a, y = *(const u32 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static int bench_run(bool tx)
+{
+	struct ieee802154_priv *priv = ieee802154_to_priv(bench.hw);
+	unsigned int allocs;
+	cycles_t cycles;
+	ktime_t start;
+	u32 n;
+	int ret;
+
+	if (!bench.count || bench.count > BENCH_MAX_COUNT ||
+	    bench.size > 127 - BENCH_HDR_LEN - 2)
+		return -EINVAL;
+
+	bench.lat = vmalloc(bench.count * sizeof(*bench.lat));
+	if (!bench.lat)
+		return -ENOMEM;
+
+	atomic_set(&bench.done, 0);
+	bench.paced = 0;
+	bench.n = bench.count;
+
+	allocs = atomic_read(&priv->allocs);
+	cycles = get_cycles();
+	start = ktime_get();
+
+	ret = tx ? bench_run_tx() : bench_run_rx();
+
+	bench.elapsed_ns = ktime_to_ns(ktime_sub(ktime_get(), start));
+	bench.cycles = get_cycles() - cycles - bench.paced;
+	bench.allocs = atomic_read(&priv->allocs) - allocs;
+
+	/*
+	 * Stop recording, then wait for the transmit and receive workers
+	 * already running on the device workqueue to finish, so nothing
+	 * touches the latency buffer once it is sorted and freed.
+	 */
+	n = bench.n;
+	bench.n = 0;
+	smp_mb();
+	flush_workqueue(priv->dev_workqueue);
+
+	n = min_t(u32, atomic_read(&bench.done), n);
+
+	bench.mode = tx ? "tx" : "rx";
+	bench.frames = n;
+	bench.p50 = bench.p90 = bench.p99 = bench.max = 0;
+	if (n) {
+		sort(bench.lat, n, sizeof(*bench.lat), bench_cmp, NULL);
+		bench.p50 = bench.lat[n / 2];
+		bench.p90 = bench.lat[(u64)n * 90 / 100];
+		bench.p99 = bench.lat[(u64)n * 99 / 100];
+		bench.max = bench.lat[n - 1];
+	}
+
+	vfree(bench.lat);
+	bench.lat = NULL;
+
+	return ret;
+}
+
+static ssize_t bench_run_write(struct file *file, const char __user *ubuf,
+		size_t count, loff_t *ppos)
+{
+	char buf[8] = {};
+	int ret;
+
+	if (copy_from_user(buf, ubuf, min(count, sizeof(buf) - 1)))
+		return -EFAULT;
+
+	mutex_lock(&bench.lock);
+	if (!strncmp(buf, "rx", 2))
+		ret = bench_run(false);
+	else if (!strncmp(buf, "tx", 2))
+		ret = bench_run(true);
+	else
+		ret = -EINVAL;
+	mutex_unlock(&bench.lock);
+
+	return ret ? ret : count;
+}
+
+static const struct file_operations bench_run_fops = {
+	.owner	= THIS_MODULE,
+	.write	= bench_run_write,
+};
+
+static ssize_t bench_results_read(struct file *file, char __user *ubuf,
+		size_t count, loff_t *ppos)
+{
+	char buf[256];
+	u64 fps = 0, cpf = 0, apf = 0;
+	int len;
+
+	mutex_lock(&bench.lock);
+	if (bench.frames) {
+		if (bench.elapsed_ns)
+			fps = div64_u64((u64)bench.frames * NSEC_PER_SEC,
+					bench.elapsed_ns);
+		cpf = div_u64(bench.cycles, bench.frames);
+		apf = div_u64((u64)bench.allocs * 100, bench.frames);
+	}
+
+	len = snprintf(buf, sizeof(buf),
+			"mode %s\nframes %u\nframes/s %llu\n"
+			"cycles/frame %llu\nallocs/frame %llu.%02llu\n"
+			"latency ns p50 %u p90 %u p99 %u max %u\n",
+			bench.mode ? bench.mode : "none", bench.frames,
+			(unsigned long long)fps, (unsigned long long)cpf,
+			(unsigned long long)apf / 100,
+			(unsigned long long)apf % 100,
+			bench.p50, bench.p90, bench.p99, bench.max);
+	mutex_unlock(&bench.lock);
+
+	return simple_read_from_buffer(ubuf, count, ppos, buf, len);
+}
+
+static const struct file_operations bench_results_fops = {
+	.owner	= THIS_MODULE,
+	.read	= bench_results_read,
+};
+
+static int bench_iface_init(void)
+{
+	struct ieee802154_priv *priv = ieee802154_to_priv(bench.hw);
+	struct ieee802154_sub_if_data *sdata;
+	struct net_device *dev;
+	int err;
+
+	dev = priv->phy->add_iface(priv->phy, "wpanbench%d",
+			IEEE802154_DEV_WPAN);
+	if (IS_ERR(dev))
+		return PTR_ERR(dev);
+	/* The interface goes away with the phy */
+	dev_put(dev);
+
+	sdata = netdev_priv(dev);
+	spin_lock_bh(&sdata->mib_lock);
+	sdata->pan_id = BENCH_PAN_ID;
+	sdata->short_addr = BENCH_SHORT_ADDR;
+	sdata->chan = BENCH_CHANNEL;
+	sdata->page = 0;
+	spin_unlock_bh(&sdata->mib_lock);
+
+	rtnl_lock();
+	err = dev_open(dev);
+	rtnl_unlock();
+	if (err)
+		return err;
+
+	bench.dev = dev;
+
+	return 0;
+}
+
+static int __init mac802154_bench_init(void)
+{
+	int err;
+
+	mutex_init(&bench.lock);
+	init_waitqueue_head(&bench.wq);
+
+	bench.hw = ieee802154_alloc_device(0, &bench_ops);
+	if (!bench.hw)
+		return -ENOMEM;
+
+	bench.hw->phy->channels_supported[0] = 1 << BENCH_CHANNEL;
+
+	err = ieee802154_register_device(bench.hw);
+	if (err)
+		goto err_free;
+
+	err = bench_iface_init();
+	if (err)
+		goto err_unreg;
+
+	bench.dir = debugfs_create_dir("mac802154_bench", NULL);
+	if (!bench.dir) {
+		err = -ENOMEM;
+		goto err_unreg;
+	}
+
+	debugfs_create_u32("size", 0600, bench.dir, &bench.size);
+	debugfs_create_u32("count", 0600, bench.dir, &bench.count);
+	debugfs_create_u32("rate", 0600, bench.dir, &bench.rate);
+	debugfs_create_file("run", 0200, bench.dir, NULL, &bench_run_fops);
+	debugfs_create_file("results", 0400, bench.dir, NULL,
+			&bench_results_fops);
+
+	return 0;
+
+err_unreg:
+	ieee802154_unregister_device(bench.hw);
+err_free:
+	ieee802154_free_device(bench.hw);
+	return err;
+}
+module_init(mac802154_bench_init);
+
+static void __exit mac802154_bench_exit(void)
+{
+	debugfs_remove_recursive(bench.dir);
+	ieee802154_unregister_device(bench.hw);
+	ieee802154_free_device(bench.hw);
+}
+module_exit(mac802154_bench_exit);
+
+MODULE_DESCRIPTION("mac802154 data path benchmark");
+MODULE_LICENSE("GPL v2");
@@ -0,0 +1,321 @@
+/*
+ * Software unslotted CSMA/CA and frame retransmission
+ *
+ * Copyright 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Written by:
+ * agent <agent@local>
+ */
+
+/*
+ * Radios which can only do a single CCA and send a frame right away
+ * provide the cca and xmit_raw callbacks; mac802154 then runs the
+ * channel access and acknowledgement logic of 802.15.4-2006 7.5.1.4
+ * and 7.5.6.4 itself:
+ *
+ *  - wait random(2^BE - 1) unit backoff periods, then CCA;
+ *  - on a busy channel increase BE up to macMaxBE, and give up after
+ *    macMaxCSMABackoffs failed attempts;
+ *  - if an acknowledgement was requested, wait macAckWaitDuration for
+ *    it and repeat everything up to macMaxFrameRetries times.
+ *
+ * All of this runs in the transmit worker with pib_lock held. Delays
+ * are slept with hrtimers, as a backoff period is only 320us at 2.4 GHz.
+ * Acknowledgements are picked up when the driver hands over a received
+ * frame, before it is queued to the (busy) workqueue.
+ */
+
+#include <linux/kernel.h>
+#include <linux/netdevice.h>
+#include <linux/skbuff.h>
+#include <linux/random.h>
+#include <linux/crc-ccitt.h>
+#include <linux/hrtimer.h>
+#include <linux/sched.h>
+
+#include <net/mac802154.h>
+#include <net/ieee802154.h>
+#include <net/wpan-phy.h>
+
+#include "mac802154.h"
+
+#define IEEE802154_UNIT_BACKOFF_PERIOD	20 /* symbols */
+/* aUnitBackoffPeriod + aTurnaroundTime + phySHRDuration + 6 octets */
+#define IEEE802154_ACK_WAIT_DURATION	54 /* symbols */
+
+#define IEEE802154_DEFAULT_MIN_BE	3
+#define IEEE802154_DEFAULT_MAX_BE	5
+#define IEEE802154_DEFAULT_MAX_BACKOFFS	4
+#define IEEE802154_DEFAULT_MAX_RETRIES	3
+
+void ieee802154_csma_init(struct ieee802154_priv *priv)
+{
+	struct ieee802154_csma *csma = &priv->csma;
+
+	spin_lock_init(&csma->lock);
+	init_waitqueue_head(&csma->ack_wq);
+
+	csma->min_be = IEEE802154_DEFAULT_MIN_BE;
+	csma->max_be = IEEE802154_DEFAULT_MAX_BE;
+	csma->max_backoffs = IEEE802154_DEFAULT_MAX_BACKOFFS;
+	csma->max_retries = IEEE802154_DEFAULT_MAX_RETRIES;
+}
+
+static void ieee802154_csma_delay(u64 ns)
+{
+	ktime_t t = ns_to_ktime(ns);
+
+	set_current_state(TASK_UNINTERRUPTIBLE);
+	schedule_hrtimeout(&t, HRTIMER_MODE_REL);
+}
+
+/*
+ * Returns zero if the channel was found idle, -EBUSY on channel access
+ * failure or an error from the driver.
+ */
+static int ieee802154_csma_access(struct ieee802154_priv *priv,
+		u32 symbol_ns, int *backoffs)
+{
+	struct ieee802154_csma *csma = &priv->csma;
+	u8 be = csma->min_be;
+	int nb = 0;
+	int ret;
+
+	for (;;) {
+		u32 periods = random32() & ((1 << be) - 1);
+
+		if (periods)
+			ieee802154_csma_delay((u64)periods *
+				IEEE802154_UNIT_BACKOFF_PERIOD * symbol_ns);
+
+		ret = priv->ops->cca(&priv->hw);
+		if (ret != -EBUSY)
+			return ret;
+
+		(*backoffs)++;
+		if (++nb > csma->max_backoffs)
+			return -EBUSY;
+
+		be = min_t(u8, be + 1, csma->max_be);
+	}
+}
+
+static bool ieee802154_csma_wait_ack(struct ieee802154_priv *priv,
+		u32 symbol_ns)
+{
+	struct ieee802154_csma *csma = &priv->csma;
+	ktime_t expires;
+	unsigned long flags;
+	DEFINE_WAIT(wait);
+	bool acked;
+
+	expires = ktime_add_ns(ktime_get(),
+			(u64)IEEE802154_ACK_WAIT_DURATION * symbol_ns);
+
+	for (;;) {
+		prepare_to_wait(&csma->ack_wq, &wait, TASK_UNINTERRUPTIBLE);
+		if (csma->acked)
+			break;
+		if (!schedule_hrtimeout(&expires, HRTIMER_MODE_ABS))
+			break;
+	}
+	finish_wait(&csma->ack_wq, &wait);
+
+	spin_lock_irqsave(&csma->lock, flags);
+	acked = csma->acked;
+	csma->ack_wait = false;
+	spin_unlock_irqrestore(&csma->lock, flags);
+
+	return acked;
+}
+
+int ieee802154_csma_xmit(struct ieee802154_priv *priv, struct sk_buff *skb)
+{
+	struct ieee802154_csma *csma = &priv->csma;
+	unsigned long flags;
+	int backoffs = 0;
+	int retries = 0;
+	bool ackreq;
+	u32 symbol_ns;
+	int ret;
+
+	if (skb->len < 3)
+		return -EINVAL;
+
+	ackreq = skb->data[0] & IEEE802154_FC_ACK_REQ;
+	symbol_ns = ieee802154_symbol_ns(priv->phy->current_page,
+			priv->phy->current_channel);
+
+	for (;;) {
+		ret = ieee802154_csma_access(priv, symbol_ns, &backoffs);
+		if (ret)
+			break;
+
+		if (ackreq) {
+			spin_lock_irqsave(&csma->lock, flags);
+			csma->ack_seq = skb->data[2];
+			csma->acked = false;
+			csma->ack_wait = true;
+			spin_unlock_irqrestore(&csma->lock, flags);
+		}
+
+		ret = priv->ops->xmit_raw(&priv->hw, skb);
+		if (ret || !ackreq)
+			break;
+
+		if (ieee802154_csma_wait_ack(priv, symbol_ns))
+			break;
+
+		if (retries == csma->max_retries) {
+			ret = -ETIMEDOUT;
+			break;
+		}
+		retries++;
+	}
+
+	if (ackreq) {
+		spin_lock_irqsave(&csma->lock, flags);
+		csma->ack_wait = false;
+		spin_unlock_irqrestore(&csma->lock, flags);
+	}
+
+	pr_debug("%s: seq %d, %d backoffs, %d retries, result %d\n",
+			wpan_phy_name(priv->phy), skb->data[2],
+			backoffs, retries, ret);
+
+	spin_lock_irqsave(&csma->lock, flags);
+	csma->frames++;
+	csma->backoffs += backoffs;
+	csma->retries += retries;
+	if (ret == -EBUSY)
+		csma->cca_failures++;
+	else if (ret == -ETIMEDOUT)
+		csma->ack_failures++;
+	csma->last_backoffs = backoffs;
+	csma->last_retries = retries;
+	spin_unlock_irqrestore(&csma->lock, flags);
+
+	return ret;
+}
+
+/*
+ * Called for every received frame before it is queued for processing.
+ * skb->data points to the start of the MAC header.
+ */
+void ieee802154_csma_rx(struct ieee802154_priv *priv, struct sk_buff *skb)
+{
+	struct ieee802154_csma *csma = &priv->csma;
+	unsigned long flags;
+	unsigned int len = 3;
+
+	if (!csma->ack_wait)
+		return;
+
+	if (!(priv->hw.flags & IEEE802154_HW_OMIT_CKSUM))
+		len += 2;
+
+	if (skb->len != len ||
+	    IEEE802154_FC_TYPE(skb->data[0]) != IEEE802154_FC_TYPE_ACK)
+		return;
+
+	if (!(priv->hw.flags & IEEE802154_HW_OMIT_CKSUM) &&
+	    crc_ccitt(0, skb->data, skb->len))
+		return;
+
+	spin_lock_irqsave(&csma->lock, flags);
+	if (csma->ack_wait && csma->ack_seq == skb->data[2]) {
+		csma->acked = true;
+		wake_up(&csma->ack_wq);
+	}
+	spin_unlock_irqrestore(&csma->lock, flags);
+}
+
+#define CSMA_SHOW(name)							\
+static ssize_t name##_show(struct device *dev,				\
+		struct device_attribute *attr, char *buf)		\
+{									\
+	struct ieee802154_priv *priv = wpan_phy_priv(to_phy(dev));	\
+	unsigned long flags;						\
+	ssize_t ret;							\
+									\
+	spin_lock_irqsave(&priv->csma.lock, flags);			\
+	ret = snprintf(buf, PAGE_SIZE, "%u\n", priv->csma.name);	\
+	spin_unlock_irqrestore(&priv->csma.lock, flags);		\
+	return ret;							\
+}
+
+#define CSMA_ATTR_RO(name)						\
+CSMA_SHOW(name)								\
+static DEVICE_ATTR(name, S_IRUGO, name##_show, NULL)
+
+#define CSMA_ATTR_RW(name, min, max)					\
+CSMA_SHOW(name)								\
+static ssize_t name##_store(struct device *dev,				\
+		struct device_attribute *attr,				\
+		const char *buf, size_t count)				\
+{									\
+	struct ieee802154_priv *priv = wpan_phy_priv(to_phy(dev));	\
+	unsigned long val;						\
+	int ret;							\
+									\
+	ret = strict_strtoul(buf, 0, &val);				\
+	if (ret)							\
+		return ret;						\
+									\
+	/* The bounds may depend on each other */			\
+	mutex_lock(&priv->phy->pib_lock);				\
+	if (val < (min) || val > (max)) {				\
+		ret = -EINVAL;						\
+	} else {							\
+		priv->csma.name = val;					\
+		ret = count;						\
+	}								\
+	mutex_unlock(&priv->phy->pib_lock);				\
+	return ret;							\
+}									\
+static DEVICE_ATTR(name, S_IRUGO | S_IWUSR, name##_show, name##_store)
+
+CSMA_ATTR_RW(min_be, 0, priv->csma.max_be);
+CSMA_ATTR_RW(max_be, priv->csma.min_be, 8);
+CSMA_ATTR_RW(max_backoffs, 0, 5);
+CSMA_ATTR_RW(max_retries, 0, 7);
+CSMA_ATTR_RO(frames);
+CSMA_ATTR_RO(backoffs);
+CSMA_ATTR_RO(retries);
+CSMA_ATTR_RO(cca_failures);
+CSMA_ATTR_RO(ack_failures);
+CSMA_ATTR_RO(last_backoffs);
+CSMA_ATTR_RO(last_retries);
+
+static struct attribute *ieee802154_csma_attrs[] = {
+	&dev_attr_min_be.attr,
+	&dev_attr_max_be.attr,
+	&dev_attr_max_backoffs.attr,
+	&dev_attr_max_retries.attr,
+	&dev_attr_frames.attr,
+	&dev_attr_backoffs.attr,
+	&dev_attr_retries.attr,
+	&dev_attr_cca_failures.attr,
+	&dev_attr_ack_failures.attr,
+	&dev_attr_last_backoffs.attr,
+	&dev_attr_last_retries.attr,
+	NULL,
+};
+
+struct attribute_group ieee802154_csma_group = {
+	.name	= "csma",
+	.attrs	= ieee802154_csma_attrs,
+};
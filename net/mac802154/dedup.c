@@ -0,0 +1,128 @@
+/*
+ * Duplicate frame suppression
+ *
+ * Copyright 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Written by:
+ * agent <agent@local>
+ */
+
+/*
+ * A frame requesting an ACK is retransmitted by its sender when our ACK
+ * gets lost, and would be delivered again. The DSN last received from
+ * every source is kept in a small open addressing table per radio, and
+ * a frame repeating it is dropped.
+ *
+ * Slots not refreshed within IEEE802154_DEDUP_AGE count as free: all
+ * retransmissions of a frame happen well within it, and a source would
+ * have to send 256 frames for the DSN to wrap. When none of the probed
+ * slots is free, the least recently used of them is taken over.
+ */
+
+#include <linux/kernel.h>
+#include <linux/jhash.h>
+#include <linux/netdevice.h>
+#include <linux/skbuff.h>
+
+#include <net/af_ieee802154.h>
+#include <net/mac802154.h>
+#include <net/ieee802154_netdev.h>
+
+#include "mac802154.h"
+
+#define IEEE802154_DEDUP_AGE		msecs_to_jiffies(500)
+#define IEEE802154_DEDUP_PROBES		8
+
+static inline bool dedup_slot_live(struct ieee802154_dedup_slot *slot)
+{
+	return slot->addr_type != IEEE802154_ADDR_NONE &&
+		time_before(jiffies, slot->stamp + IEEE802154_DEDUP_AGE);
+}
+
+/*
+ * Returns true if SKB repeats the last frame from its source. Only
+ * frames requesting an ACK and carrying a source address are tracked.
+ */
+bool ieee802154_dedup_check(struct ieee802154_priv *priv, struct sk_buff *skb)
+{
+	struct ieee802154_dedup *dd = &priv->dedup;
+	struct ieee802154_addr *sa = &mac_cb(skb)->sa;
+	struct ieee802154_dedup_slot *slot, *victim = NULL;
+	u8 seq = mac_cb(skb)->seq;
+	bool dup = false;
+	unsigned int h;
+	u64 key;
+	int i;
+
+	if (!mac_cb_is_ackreq(skb))
+		return false;
+
+	switch (sa->addr_type) {
+	case IEEE802154_ADDR_LONG:
+		memcpy(&key, sa->hwaddr, IEEE802154_ADDR_LEN);
+		break;
+	case IEEE802154_ADDR_SHORT:
+		key = ((u64)sa->pan_id << 16) | sa->short_addr;
+		break;
+	default:
+		return false;
+	}
+
+	h = jhash_2words((u32)key, (u32)(key >> 32), sa->addr_type);
+
+	spin_lock_bh(&dd->lock);
+
+	for (i = 0; i < IEEE802154_DEDUP_PROBES; i++) {
+		slot = &dd->slot[(h + i) & (IEEE802154_DEDUP_SIZE - 1)];
+
+		if (!dedup_slot_live(slot)) {
+			if (!victim || dedup_slot_live(victim))
+				victim = slot;
+			continue;
+		}
+
+		if (slot->addr_type == sa->addr_type && slot->key == key) {
+			dup = slot->seq == seq;
+			goto found;
+		}
+
+		if (!victim || (dedup_slot_live(victim) &&
+				time_before(slot->stamp, victim->stamp)))
+			victim = slot;
+	}
+
+	slot = victim;
+	slot->addr_type = sa->addr_type;
+	slot->key = key;
+found:
+	slot->seq = seq;
+	slot->stamp = jiffies;
+
+	spin_unlock_bh(&dd->lock);
+
+	return dup;
+}
+
+void ieee802154_dedup_init(struct ieee802154_priv *priv)
+{
+	struct ieee802154_dedup *dd = &priv->dedup;
+	int i;
+
+	spin_lock_init(&dd->lock);
+
+	for (i = 0; i < IEEE802154_DEDUP_SIZE; i++)
+		dd->slot[i].addr_type = IEEE802154_ADDR_NONE;
+}
@@ -22,11 +22,14 @@
 
 #include <linux/net.h>
 #include <linux/capability.h>
+#include <linux/sched.h>
 #include <linux/module.h>
 #include <linux/if_arp.h>
 #include <linux/rculist.h>
 #include <linux/random.h>
 #include <linux/crc-ccitt.h>
+#include <net/netlink.h>
+#include <linux/nl802154.h>
 
 #include <net/rtnetlink.h>
 #include <net/af_ieee802154.h>
@@ -34,6 +37,7 @@
 #include <net/ieee802154_netdev.h>
 #include <net/ieee802154.h>
 #include <net/wpan-phy.h>
+#include <trace/events/ieee802154.h>
 
 #include "mac802154.h"
 #include "beacon.h"
@@ -48,51 +52,185 @@ struct xmit_work {
 	u8 chan;
 };
 
+/*
+ * Wait until the frame passed to xmit_async is out. With pib_lock held
+ * no other one can be started, so the radio may be reconfigured.
+ */
+void ieee802154_tx_quiesce(struct ieee802154_priv *priv)
+{
+	wait_event(priv->tx_wq, !priv->tx_skb);
+}
+
+/* All phy statistics of a transmitted frame, under a single lock */
+static void ieee802154_tx_stats(struct ieee802154_priv *priv, int result,
+		int retries)
+{
+	struct wpan_phy_stats *stats = &priv->phy->stats;
+	unsigned long flags;
+
+	spin_lock_irqsave(&stats->lock, flags);
+	stats->retries += retries;
+	if (!result)
+		stats->tx_frames++;
+	else
+		stats->tx_errors++;
+	/* Channel access failure, from the driver or software CSMA */
+	if (result == -EBUSY)
+		stats->cca_failures++;
+	spin_unlock_irqrestore(&stats->lock, flags);
+}
+
+/*
+ * Charge a failed transmission to the interface the frame came from.
+ * Retransmission is up to the radio or the software CSMA engine, a frame
+ * failing here has already used up its retries.
+ */
+static void ieee802154_tx_error(struct ieee802154_priv *priv,
+		struct sk_buff *skb)
+{
+	struct ieee802154_sub_if_data *sdata;
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(sdata, &priv->slaves, list) {
+		if (sdata->dev->ifindex == skb->skb_iif) {
+			sdata->dev->stats.tx_errors++;
+			break;
+		}
+	}
+	rcu_read_unlock();
+}
+
+void ieee802154_xmit_complete(struct ieee802154_dev *dev, struct sk_buff *skb,
+		int result)
+{
+	struct ieee802154_priv *priv = ieee802154_to_priv(dev);
+	unsigned long flags;
+
+	spin_lock_irqsave(&priv->tx_lock, flags);
+	WARN_ON(priv->tx_skb != skb);
+	priv->tx_skb = NULL;
+	spin_unlock_irqrestore(&priv->tx_lock, flags);
+
+	wake_up(&priv->tx_wq);
+
+	trace_ieee802154_drv_xmit_done(priv->phy, skb, result);
+	ieee802154_tx_stats(priv, result, 0);
+	ieee802154_neigh_tx(priv, skb, result);
+
+	if (result) {
+		pr_debug("%s: transmission failed: %d\n",
+				wpan_phy_name(priv->phy), result);
+		ieee802154_tx_error(priv, skb);
+	}
+
+	dev_kfree_skb_any(skb);
+}
+EXPORT_SYMBOL(ieee802154_xmit_complete);
+
+static int ieee802154_xmit_async(struct ieee802154_priv *priv,
+		struct sk_buff *skb)
+{
+	unsigned long flags;
+	int res;
+
+	spin_lock_irqsave(&priv->tx_lock, flags);
+	priv->tx_skb = skb;
+	spin_unlock_irqrestore(&priv->tx_lock, flags);
+
+	res = priv->ops->xmit_async(&priv->hw, skb);
+	if (res) {
+		spin_lock_irqsave(&priv->tx_lock, flags);
+		priv->tx_skb = NULL;
+		spin_unlock_irqrestore(&priv->tx_lock, flags);
+	}
+
+	return res;
+}
+
 static void ieee802154_xmit_worker(struct work_struct *work)
 {
 	struct xmit_work *xw = container_of(work, struct xmit_work, work);
+	bool acked = false;
+	int retries = 0;
 	int res;
 
 	BUG_ON(xw->chan == (u8)-1);
 
+	trace_ieee802154_xmit_dequeue(xw->priv->phy, xw->skb);
+	atomic_dec(&xw->priv->phy->stats.tx_queue_len);
+
 	mutex_lock(&xw->priv->phy->pib_lock);
+	ieee802154_tx_quiesce(xw->priv);
 	if (xw->priv->phy->current_channel != xw->chan) {
-		res = xw->priv->ops->set_channel(&xw->priv->hw,
-				xw->chan);
+		res = ieee802154_set_channel(xw->priv, xw->page, xw->chan);
 		if (res) {
 			pr_debug("set_channel failed\n");
 			goto out;
 		}
 	}
 
-	res = xw->priv->ops->xmit(&xw->priv->hw, xw->skb);
+	trace_ieee802154_drv_xmit(xw->priv->phy, xw->skb);
+
+	if (xw->priv->ops->xmit_async) {
+		res = ieee802154_xmit_async(xw->priv, xw->skb);
+		if (!res) {
+			/* skb is freed by ieee802154_xmit_complete() */
+			mutex_unlock(&xw->priv->phy->pib_lock);
+			kfree(xw);
+			return;
+		}
+	} else if (xw->priv->ops->cca && xw->priv->ops->xmit_raw &&
+	    !(xw->priv->hw.flags & IEEE802154_HW_CSMA)) {
+		res = ieee802154_csma_xmit(xw->priv, xw->skb);
+		retries = xw->priv->csma.last_retries;
+		acked = true;
+	} else {
+		res = xw->priv->ops->xmit(&xw->priv->hw, xw->skb);
+		acked = xw->priv->hw.flags & IEEE802154_HW_CSMA;
+	}
+
+	trace_ieee802154_drv_xmit_done(xw->priv->phy, xw->skb, res);
+	ieee802154_tx_stats(xw->priv, res, retries);
+	/* Plain xmit of a radio without CSMA does not wait for the ACK */
+	if (acked)
+		ieee802154_neigh_tx(xw->priv, xw->skb, res);
 
 out:
 	mutex_unlock(&xw->priv->phy->pib_lock);
 
-	/* FIXME: result processing and/or requeue!!! */
+	if (res)
+		ieee802154_tx_error(xw->priv, xw->skb);
+
 	dev_kfree_skb(xw->skb);
 
 	kfree(xw);
 }
 
 
-static netdev_tx_t ieee802154_net_xmit(struct sk_buff *skb, struct net_device *dev)
+netdev_tx_t ieee802154_tx(struct ieee802154_sub_if_data *priv,
+		struct sk_buff *skb)
 {
-	struct ieee802154_sub_if_data *priv;
+	struct net_device *dev = priv->dev;
 	struct xmit_work *work;
 
-	priv = netdev_priv(dev);
-
-	if (priv->chan == (u8)-1) /* not init */
+	if (priv->chan == (u8)-1) { /* not init */
+		dev_kfree_skb(skb);
 		return NETDEV_TX_OK;
+	}
 
 	BUG_ON(priv->page >= 32);
 	BUG_ON(priv->chan >= 27);
 
 	if (WARN_ON(!(priv->hw->phy->channels_supported[priv->page] &
-					(1 << priv->chan))))
+					(1 << priv->chan)))) {
+		dev_kfree_skb(skb);
 		return NETDEV_TX_OK;
+	}
+
+	work = kzalloc(sizeof(struct xmit_work), GFP_ATOMIC);
+	if (!work)
+		return NETDEV_TX_BUSY;
+	ieee802154_count_alloc(priv->hw);
 
 	if (!(priv->hw->hw.flags & IEEE802154_HW_OMIT_CKSUM)) {
 		u16 crc = crc_ccitt(0, skb->data, skb->len);
@@ -107,14 +245,11 @@ static netdev_tx_t ieee802154_net_xmit(struct sk_buff *skb, struct net_device *d
 
 
 	if (skb_cow_head(skb, priv->hw->hw.extra_tx_headroom)) {
+		kfree(work);
 		dev_kfree_skb(skb);
 		return NETDEV_TX_OK;
 	}
 
-	work = kzalloc(sizeof(struct xmit_work), GFP_ATOMIC);
-	if (!work)
-		return NETDEV_TX_BUSY;
-
 	INIT_WORK(&work->work, ieee802154_xmit_worker);
 	work->skb = skb;
 	work->priv = priv->hw;
@@ -124,12 +259,75 @@ static netdev_tx_t ieee802154_net_xmit(struct sk_buff *skb, struct net_device *d
 	work->page = priv->page;
 	spin_unlock_bh(&priv->mib_lock);
 
+	trace_ieee802154_xmit_enqueue(dev, skb);
 
+	atomic_inc(&priv->hw->phy->stats.tx_queue_len);
 	queue_work(priv->hw->dev_workqueue, &work->work);
 
 	return NETDEV_TX_OK;
 }
 
+static netdev_tx_t ieee802154_net_xmit(struct sk_buff *skb, struct net_device *dev)
+{
+	struct ieee802154_sub_if_data *priv;
+	int err;
+
+	priv = netdev_priv(dev);
+
+	/* Frames for sleeping devices wait for their data request */
+	err = ieee802154_indirect_queue(priv, skb);
+	if (!err)
+		return NETDEV_TX_OK;
+	if (err != -ENOENT) {
+		dev->stats.tx_dropped++;
+		dev_kfree_skb(skb);
+		return NETDEV_TX_OK;
+	}
+
+	/* In a beacon-enabled PAN the frame has to fit into the CAP */
+	if (!ieee802154_sf_can_tx(priv, skb->len)) {
+		netif_stop_queue(dev);
+		if (!ieee802154_sf_can_tx(priv, skb->len))
+			return NETDEV_TX_BUSY;
+		netif_start_queue(dev);
+	}
+
+	return ieee802154_tx(priv, skb);
+}
+
+/*
+ * The radio holds a single address filter, so frames are filtered in
+ * hardware only while one interface without IFF_PROMISC is open.
+ * Otherwise the radio passes everything up and ieee802154_subif_frame()
+ * filters for each interface. Monitors want to see everything.
+ */
+void ieee802154_update_promisc(struct ieee802154_priv *hw)
+{
+	struct ieee802154_sub_if_data *sdata, *last = NULL;
+	int open = 0, promisc = 0;
+
+	ASSERT_RTNL();
+
+	if (ieee802154_monitors_running(hw))
+		promisc = 1;
+
+	list_for_each_entry(sdata, &hw->slaves, list) {
+		if (!netif_running(sdata->dev))
+			continue;
+
+		open++;
+		last = sdata;
+		if (sdata->dev->flags & IFF_PROMISC)
+			promisc = 1;
+	}
+
+	/* The filter may still hold the addresses of another interface */
+	if (!promisc && open == 1)
+		ieee802154_dev_load_hw_filt(last->dev);
+
+	ieee802154_set_promisc(hw, promisc || open > 1);
+}
+
 static int ieee802154_slave_open(struct net_device *dev)
 {
 	struct ieee802154_sub_if_data *priv = netdev_priv(dev);
@@ -142,6 +340,8 @@ static int ieee802154_slave_open(struct net_device *dev)
 			goto err;
 	}
 
+	ieee802154_update_promisc(priv->hw);
+
 	netif_start_queue(dev);
 	return 0;
 err:
@@ -158,12 +358,32 @@ static int ieee802154_slave_close(struct net_device *dev)
 
 	netif_stop_queue(dev);
 
-	if ((--priv->hw->open_count) == 0)
+	ieee802154_sf_stop(priv);
+	ieee802154_indirect_flush(priv);
+	ieee802154_neigh_flush(priv);
+
+	if ((--priv->hw->open_count) == 0) {
+		mutex_lock(&priv->hw->phy->pib_lock);
+		ieee802154_tx_quiesce(priv->hw);
+		mutex_unlock(&priv->hw->phy->pib_lock);
+
 		priv->hw->ops->stop(&priv->hw->hw);
+	}
+
+	ieee802154_update_promisc(priv->hw);
 
 	return 0;
 }
 
+static void ieee802154_slave_change_rx_flags(struct net_device *dev,
+		int change)
+{
+	struct ieee802154_sub_if_data *priv = netdev_priv(dev);
+
+	if (change & IFF_PROMISC)
+		ieee802154_update_promisc(priv->hw);
+}
+
 
 static int ieee802154_slave_ioctl(struct net_device *dev, struct ifreq *ifr,
 		int cmd)
@@ -428,8 +648,18 @@ static const struct net_device_ops ieee802154_slave_ops = {
 	.ndo_start_xmit		= ieee802154_net_xmit,
 	.ndo_do_ioctl		= ieee802154_slave_ioctl,
 	.ndo_set_mac_address	= ieee802154_slave_mac_addr,
+	.ndo_change_rx_flags	= ieee802154_slave_change_rx_flags,
 };
 
+static void ieee802154_netdev_free(struct net_device *dev)
+{
+	ieee802154_indirect_flush(netdev_priv(dev));
+	ieee802154_neigh_flush(netdev_priv(dev));
+	ieee802154_assoc_flush(netdev_priv(dev));
+
+	free_netdev(dev);
+}
+
 static void ieee802154_netdev_setup(struct net_device *dev)
 {
 	dev->addr_len		= IEEE802154_ADDR_LEN;
@@ -444,7 +674,7 @@ static void ieee802154_netdev_setup(struct net_device *dev)
 	dev->flags		= IFF_NOARP | IFF_BROADCAST;
 	dev->watchdog_timeo	= 0;
 
-	dev->destructor		= free_netdev;
+	dev->destructor		= ieee802154_netdev_free;
 	dev->netdev_ops		= &ieee802154_slave_ops;
 	dev->ml_priv		= &mac802154_mlme;
 }
@@ -464,8 +694,13 @@ void ieee802154_drop_slaves(struct ieee802154_dev *hw)
 		list_del(&sdata->list);
 		mutex_unlock(&sdata->hw->slaves_mtx);
 
+		sysfs_remove_group(&sdata->dev->dev.kobj, &ieee802154_sf_group);
+		sysfs_remove_group(&sdata->dev->dev.kobj,
+				&ieee802154_assoc_group);
 		unregister_netdevice(sdata->dev);
 	}
+
+	ieee802154_drop_monitors(priv);
 }
 
 static int ieee802154_netdev_register(struct wpan_phy *phy,
@@ -485,6 +720,10 @@ static int ieee802154_netdev_register(struct wpan_phy *phy,
 	priv->page = 0; /* for compat */
 
 	spin_lock_init(&priv->mib_lock);
+	ieee802154_indirect_init(priv);
+	ieee802154_sf_init(priv);
+	ieee802154_neigh_init(priv);
+	ieee802154_assoc_init(priv);
 
 	get_random_bytes(&priv->bsn, 1);
 	get_random_bytes(&priv->dsn, 1);
@@ -500,6 +739,11 @@ static int ieee802154_netdev_register(struct wpan_phy *phy,
 	if (err < 0)
 		return err;
 
+	if (sysfs_create_group(&dev->dev.kobj, &ieee802154_sf_group))
+		dev_warn(&dev->dev, "failed to create superframe attributes\n");
+	if (sysfs_create_group(&dev->dev.kobj, &ieee802154_assoc_group))
+		dev_warn(&dev->dev, "failed to create association attributes\n");
+
 	rtnl_lock();
 	mutex_lock(&ipriv->slaves_mtx);
 	list_add_tail_rcu(&priv->list, &ipriv->slaves);
@@ -515,6 +759,11 @@ void ieee802154_del_iface(struct wpan_phy *phy,
 	struct ieee802154_sub_if_data *sdata;
 	ASSERT_RTNL();
 
+	if (dev->type == ARPHRD_IEEE802154_TAP) {
+		ieee802154_del_monitor(phy, dev);
+		return;
+	}
+
 	BUG_ON(dev->type != ARPHRD_IEEE802154);
 
 	sdata = netdev_priv(dev);
@@ -526,15 +775,27 @@ void ieee802154_del_iface(struct wpan_phy *phy,
 	mutex_unlock(&sdata->hw->slaves_mtx);
 
 	synchronize_rcu();
+	sysfs_remove_group(&sdata->dev->dev.kobj, &ieee802154_sf_group);
+	sysfs_remove_group(&sdata->dev->dev.kobj, &ieee802154_assoc_group);
 	unregister_netdevice(sdata->dev);
 }
 
 struct net_device *ieee802154_add_iface(struct wpan_phy *phy,
-		const char *name)
+		const char *name, int type)
 {
 	struct net_device *dev;
 	int err = -ENOMEM;
 
+	switch (type) {
+	case IEEE802154_DEV_WPAN:
+		break;
+	case IEEE802154_DEV_MONITOR:
+		return ieee802154_add_monitor(phy, name);
+	default:
+		err = -EINVAL;
+		goto err;
+	}
+
 	dev = alloc_netdev(sizeof(struct ieee802154_sub_if_data),
 			name, ieee802154_netdev_setup);
 	if (!dev)
@@ -638,6 +899,18 @@ static int ieee802154_subif_frame(struct ieee802154_sub_if_data *sdata,
 
 	skb->dev = sdata->dev;
 
+	trace_ieee802154_subif_rx(sdata->dev, skb);
+
+	ieee802154_neigh_rx(sdata, skb);
+
+	/* The radio may pass foreign frames for the sake of another one */
+	if (skb->pkt_type == PACKET_OTHERHOST &&
+			mac_cb_type(skb) == IEEE802154_FC_TYPE_DATA &&
+			!(sdata->dev->flags & IFF_PROMISC)) {
+		kfree_skb(skb);
+		return NET_RX_DROP;
+	}
+
 	if (skb->pkt_type == PACKET_HOST && mac_cb_is_ackreq(skb) &&
 			!(sdata->hw->hw.flags & IEEE802154_HW_AACK))
 		dev_warn(&sdata->dev->dev,
@@ -819,6 +1092,12 @@ void ieee802154_subif_rx(struct ieee802154_dev *hw, struct sk_buff *skb)
 	BUILD_BUG_ON(sizeof(struct ieee802154_mac_cb) > sizeof(skb->cb));
 	pr_debug("%s()\n", __func__);
 
+	wpan_phy_stats_inc(priv->phy, rx_frames);
+
+	/* Monitors see the frame as received, FCS and all */
+	if (!list_empty(&priv->monitors))
+		ieee802154_monitors_rx(priv, skb);
+
 	if (!(priv->hw.flags & IEEE802154_HW_OMIT_CKSUM)) {
 		u16 crc;
 
@@ -829,6 +1108,7 @@ void ieee802154_subif_rx(struct ieee802154_dev *hw, struct sk_buff *skb)
 		crc = crc_ccitt(0, skb->data, skb->len);
 		if (crc) {
 			pr_debug("%s(): CRC mismatch\n", __func__);
+			wpan_phy_stats_inc(priv->phy, rx_crc_errors);
 			goto out;
 		}
 		skb_trim(skb, skb->len - 2); /* CRC */
@@ -842,13 +1122,22 @@ void ieee802154_subif_rx(struct ieee802154_dev *hw, struct sk_buff *skb)
 
 	pr_debug("%s() frame %d\n", __func__, mac_cb_type(skb));
 
+	/* Our ACK got lost and the sender tried again */
+	if (ieee802154_dedup_check(priv, skb)) {
+		pr_debug("%s(): duplicate frame\n", __func__);
+		wpan_phy_stats_inc(priv->phy, rx_duplicates);
+		goto out;
+	}
+
 	rcu_read_lock();
 	list_for_each_entry_rcu(sdata, &priv->slaves, list)
 	{
 		if (prev) {
 			struct sk_buff *skb2 = skb_clone(skb, GFP_ATOMIC);
-			if (skb2)
+			if (skb2) {
+				ieee802154_count_alloc(priv);
 				ieee802154_subif_frame(prev, skb2);
+			}
 		}
 
 		prev = sdata;
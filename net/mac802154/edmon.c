@@ -0,0 +1,483 @@
+/*
+ * Background energy detection and channel agility
+ *
+ * Copyright 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Written by:
+ * agent <agent@local>
+ */
+
+/*
+ * Once an interval is set in the phy's edmon directory, the radio takes
+ * an ED reading of its operating channel every interval milliseconds,
+ * and every off_period-th time also one of another supported channel,
+ * going round them in turn. Readings are only taken when the radio is
+ * idle: an interface is up and no frame is being or waiting to be sent.
+ * The last IEEE802154_EDMON_RING readings of every channel are kept.
+ *
+ * When the average of the operating channel stays at or above the
+ * threshold for hold readings in a row, the quietest channel at least
+ * margin below it is looked up and an IEEE802154_CHANNEL_INDIC event is
+ * sent to the coordinator group. If agile is set and the channel is
+ * only used by coordinators, they send a coordinator realignment and
+ * the PAN moves there by itself.
+ *
+ * Everything runs from the phy's workqueue, so readings never overlap
+ * with a scan or a channel switch.
+ */
+
+#include <linux/kernel.h>
+#include <linux/netdevice.h>
+#include <linux/rculist.h>
+
+#include <net/af_ieee802154.h>
+#include <net/mac802154.h>
+#include <net/ieee802154_netdev.h>
+#include <net/wpan-phy.h>
+#include <net/nl802154.h>
+
+#include "mac802154.h"
+#include "mib.h"
+
+/* Give the realignment time to go out before leaving the channel */
+#define IEEE802154_EDMON_MOVE_DELAY	msecs_to_jiffies(50)
+
+static void edmon_add(struct ieee802154_edmon_chan *c, u8 level)
+{
+	c->ring[c->pos] = level;
+	c->pos = (c->pos + 1) % IEEE802154_EDMON_RING;
+	if (c->count < IEEE802154_EDMON_RING)
+		c->count++;
+}
+
+static u8 edmon_avg(struct ieee802154_edmon_chan *c)
+{
+	unsigned int sum = 0;
+	int i;
+
+	if (!c->count)
+		return 0;
+
+	for (i = 0; i < c->count; i++)
+		sum += c->ring[i];
+
+	return sum / c->count;
+}
+
+static bool edmon_idle(struct ieee802154_priv *priv)
+{
+	bool idle;
+
+	if (!priv->open_count ||
+	    atomic_read(&priv->phy->stats.tx_queue_len))
+		return false;
+
+	spin_lock_bh(&priv->tx_lock);
+	idle = !priv->tx_skb;
+	spin_unlock_bh(&priv->tx_lock);
+
+	return idle;
+}
+
+/* Leaving the channel would make us miss our own superframe */
+static bool edmon_may_leave(struct ieee802154_priv *priv)
+{
+	struct ieee802154_sub_if_data *sdata;
+	bool ret = true;
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(sdata, &priv->slaves, list) {
+		if (sdata->sf.active) {
+			ret = false;
+			break;
+		}
+	}
+	rcu_read_unlock();
+
+	return ret;
+}
+
+static int edmon_next_off(struct ieee802154_priv *priv, u8 page, u8 chan)
+{
+	struct ieee802154_edmon *em = &priv->edmon;
+	u32 supported = priv->phy->channels_supported[page];
+	int i, c;
+
+	for (i = 0; i < 27; i++) {
+		c = (em->off_next + i) % 27;
+		if (c == chan || !(supported & (1 << c)))
+			continue;
+
+		em->off_next = (c + 1) % 27;
+		return c;
+	}
+
+	return -1;
+}
+
+static int edmon_sample(struct ieee802154_priv *priv, u8 chan)
+{
+	struct ieee802154_edmon *em = &priv->edmon;
+	u8 level;
+	int ret;
+
+	ret = priv->ops->ed(&priv->hw, &level);
+	if (ret)
+		return ret;
+
+	ieee802154_ed_record(priv, chan, level);
+
+	spin_lock(&em->lock);
+	edmon_add(&em->chan[chan], level);
+	em->samples++;
+	spin_unlock(&em->lock);
+
+	return 0;
+}
+
+/*
+ * The PAN only moves by itself when every interface on the channel is
+ * a coordinator: the others would lose their coordinator.
+ */
+static bool edmon_realign(struct ieee802154_priv *priv, u8 page, u8 chan,
+		u8 to)
+{
+	struct ieee802154_sub_if_data *sdata;
+	int coords = 0;
+
+	mutex_lock(&priv->slaves_mtx);
+
+	list_for_each_entry(sdata, &priv->slaves, list) {
+		if (!netif_running(sdata->dev) ||
+		    sdata->page != page || sdata->chan != chan)
+			continue;
+		if (!(sdata->dev->priv_flags & IFF_IEEE802154_COORD)) {
+			mutex_unlock(&priv->slaves_mtx);
+			return false;
+		}
+		coords++;
+	}
+
+	list_for_each_entry(sdata, &priv->slaves, list) {
+		if (!netif_running(sdata->dev) ||
+		    sdata->page != page || sdata->chan != chan)
+			continue;
+		if (ieee802154_send_realign(sdata->dev, page, to))
+			pr_debug("%s: realignment failed\n", sdata->dev->name);
+	}
+
+	mutex_unlock(&priv->slaves_mtx);
+
+	return coords > 0;
+}
+
+static void edmon_move(struct ieee802154_priv *priv)
+{
+	struct ieee802154_edmon *em = &priv->edmon;
+	struct ieee802154_sub_if_data *sdata;
+
+	mutex_lock(&priv->slaves_mtx);
+	list_for_each_entry(sdata, &priv->slaves, list) {
+		if (sdata->page == em->move_page &&
+		    sdata->chan == em->move_from)
+			ieee802154_dev_set_channel(sdata->dev, em->move_to);
+	}
+	mutex_unlock(&priv->slaves_mtx);
+
+	pr_debug("%s: moved from channel %u to %u\n",
+			wpan_phy_name(priv->phy), em->move_from, em->move_to);
+
+	spin_lock(&em->lock);
+	em->move_to = IEEE802154_EDMON_NO_MOVE;
+	em->moves++;
+	spin_unlock(&em->lock);
+}
+
+static void edmon_evaluate(struct ieee802154_priv *priv, u8 page, u8 chan)
+{
+	struct ieee802154_edmon *em = &priv->edmon;
+	u32 supported = priv->phy->channels_supported[page];
+	u8 edl[27];
+	u8 cur, best = IEEE802154_EDMON_NO_MOVE;
+	bool agile;
+	int i;
+
+	spin_lock(&em->lock);
+
+	cur = edmon_avg(&em->chan[chan]);
+	if (em->chan[chan].count < IEEE802154_EDMON_RING ||
+	    cur < em->threshold) {
+		em->degraded = 0;
+		spin_unlock(&em->lock);
+		return;
+	}
+
+	if (++em->degraded < em->hold) {
+		spin_unlock(&em->lock);
+		return;
+	}
+	em->degraded = 0;
+
+	for (i = 0; i < 27; i++) {
+		edl[i] = edmon_avg(&em->chan[i]);
+		if (i == chan || !(supported & (1 << i)) ||
+		    !em->chan[i].count || edl[i] + em->margin > cur)
+			continue;
+		if (best == IEEE802154_EDMON_NO_MOVE || edl[i] < edl[best])
+			best = i;
+	}
+
+	agile = em->agile;
+	em->indications++;
+
+	spin_unlock(&em->lock);
+
+	pr_debug("%s: channel %u degraded, level %u, best %u\n",
+			wpan_phy_name(priv->phy), chan, cur, best);
+
+	if (best != IEEE802154_EDMON_NO_MOVE &&
+	    !(agile && edmon_realign(priv, page, chan, best)))
+		best = IEEE802154_EDMON_NO_MOVE;
+
+	ieee802154_nl_channel_indic(priv->phy, page, chan, best, edl);
+
+	if (best == IEEE802154_EDMON_NO_MOVE)
+		return;
+
+	spin_lock(&em->lock);
+	em->move_page = page;
+	em->move_from = chan;
+	em->move_to = best;
+	spin_unlock(&em->lock);
+}
+
+static void edmon_work(struct work_struct *work)
+{
+	struct ieee802154_edmon *em = container_of(work,
+			struct ieee802154_edmon, work.work);
+	struct ieee802154_priv *priv = container_of(em,
+			struct ieee802154_priv, edmon);
+	unsigned long delay;
+	bool off;
+	u8 page, chan;
+	int c;
+
+	if (em->move_to != IEEE802154_EDMON_NO_MOVE) {
+		edmon_move(priv);
+		goto out;
+	}
+
+	if (!edmon_idle(priv)) {
+		spin_lock(&em->lock);
+		em->skipped++;
+		spin_unlock(&em->lock);
+		goto out;
+	}
+
+	spin_lock(&em->lock);
+	off = em->off_period && ++em->runs >= em->off_period;
+	if (off)
+		em->runs = 0;
+	spin_unlock(&em->lock);
+
+	mutex_lock(&priv->phy->pib_lock);
+	ieee802154_tx_quiesce(priv);
+
+	page = priv->phy->current_page;
+	chan = priv->phy->current_channel;
+	if (chan >= 27) {
+		mutex_unlock(&priv->phy->pib_lock);
+		goto out;
+	}
+
+	if (edmon_sample(priv, chan)) {
+		mutex_unlock(&priv->phy->pib_lock);
+		pr_debug("%s: ed failed\n", wpan_phy_name(priv->phy));
+		goto out;
+	}
+
+	c = off && edmon_may_leave(priv) ? edmon_next_off(priv, page, chan) : -1;
+	if (c >= 0 && !ieee802154_set_channel(priv, page, c)) {
+		edmon_sample(priv, c);
+		if (ieee802154_set_channel(priv, page, chan))
+			pr_debug("%s: failed to return to channel %u\n",
+					wpan_phy_name(priv->phy), chan);
+	}
+
+	mutex_unlock(&priv->phy->pib_lock);
+
+	edmon_evaluate(priv, page, chan);
+
+out:
+	spin_lock(&em->lock);
+	if (em->move_to != IEEE802154_EDMON_NO_MOVE)
+		delay = IEEE802154_EDMON_MOVE_DELAY;
+	else
+		delay = msecs_to_jiffies(em->interval);
+	if (em->interval)
+		queue_delayed_work(priv->dev_workqueue, &em->work, delay);
+	spin_unlock(&em->lock);
+}
+
+void ieee802154_edmon_init(struct ieee802154_priv *priv)
+{
+	struct ieee802154_edmon *em = &priv->edmon;
+
+	spin_lock_init(&em->lock);
+	INIT_DELAYED_WORK(&em->work, edmon_work);
+
+	em->threshold = 128;
+	em->margin = 32;
+	em->hold = 3;
+	em->off_period = 4;
+	em->move_to = IEEE802154_EDMON_NO_MOVE;
+}
+
+void ieee802154_edmon_stop(struct ieee802154_priv *priv)
+{
+	struct ieee802154_edmon *em = &priv->edmon;
+
+	spin_lock(&em->lock);
+	em->interval = 0;
+	spin_unlock(&em->lock);
+
+	cancel_delayed_work_sync(&em->work);
+}
+
+#define EDMON_SHOW(name)						\
+static ssize_t name##_show(struct device *dev,				\
+		struct device_attribute *attr, char *buf)		\
+{									\
+	struct ieee802154_priv *priv = wpan_phy_priv(to_phy(dev));	\
+	ssize_t ret;							\
+									\
+	spin_lock(&priv->edmon.lock);					\
+	ret = snprintf(buf, PAGE_SIZE, "%u\n", priv->edmon.name);	\
+	spin_unlock(&priv->edmon.lock);					\
+	return ret;							\
+}
+
+#define EDMON_ATTR_RO(name)						\
+EDMON_SHOW(name)							\
+static DEVICE_ATTR(name, S_IRUGO, name##_show, NULL)
+
+#define EDMON_ATTR_RW(name, min, max)					\
+EDMON_SHOW(name)							\
+static ssize_t name##_store(struct device *dev,				\
+		struct device_attribute *attr,				\
+		const char *buf, size_t count)				\
+{									\
+	struct ieee802154_priv *priv = wpan_phy_priv(to_phy(dev));	\
+	unsigned long val;						\
+	int ret;							\
+									\
+	ret = strict_strtoul(buf, 0, &val);				\
+	if (ret)							\
+		return ret;						\
+	if (val < (min) || val > (max))					\
+		return -EINVAL;						\
+									\
+	spin_lock(&priv->edmon.lock);					\
+	priv->edmon.name = val;						\
+	spin_unlock(&priv->edmon.lock);					\
+	return count;							\
+}									\
+static DEVICE_ATTR(name, S_IRUGO | S_IWUSR, name##_show, name##_store)
+
+EDMON_SHOW(interval)
+static ssize_t interval_store(struct device *dev,
+		struct device_attribute *attr,
+		const char *buf, size_t count)
+{
+	struct ieee802154_priv *priv = wpan_phy_priv(to_phy(dev));
+	struct ieee802154_edmon *em = &priv->edmon;
+	unsigned long val;
+	int ret;
+
+	ret = strict_strtoul(buf, 0, &val);
+	if (ret)
+		return ret;
+	if (val > 3600000)
+		return -EINVAL;
+
+	if (!val) {
+		ieee802154_edmon_stop(priv);
+		return count;
+	}
+
+	spin_lock(&em->lock);
+	em->interval = val;
+	em->degraded = 0;
+	spin_unlock(&em->lock);
+
+	queue_delayed_work(priv->dev_workqueue, &em->work,
+			msecs_to_jiffies(val));
+
+	return count;
+}
+static DEVICE_ATTR(interval, S_IRUGO | S_IWUSR, interval_show,
+		interval_store);
+
+static ssize_t channels_show(struct device *dev,
+		struct device_attribute *attr, char *buf)
+{
+	struct ieee802154_priv *priv = wpan_phy_priv(to_phy(dev));
+	struct ieee802154_edmon *em = &priv->edmon;
+	ssize_t len = 0;
+	int i;
+
+	spin_lock(&em->lock);
+	for (i = 0; i < 27; i++) {
+		if (!em->chan[i].count)
+			continue;
+		len += snprintf(buf + len, PAGE_SIZE - len, "%d %u %u\n",
+				i, edmon_avg(&em->chan[i]), em->chan[i].count);
+	}
+	spin_unlock(&em->lock);
+
+	return len;
+}
+static DEVICE_ATTR(channels, S_IRUGO, channels_show, NULL);
+
+EDMON_ATTR_RW(threshold, 0, 255);
+EDMON_ATTR_RW(margin, 0, 255);
+EDMON_ATTR_RW(hold, 1, 1000);
+EDMON_ATTR_RW(off_period, 0, 1000);
+EDMON_ATTR_RW(agile, 0, 1);
+EDMON_ATTR_RO(samples);
+EDMON_ATTR_RO(skipped);
+EDMON_ATTR_RO(indications);
+EDMON_ATTR_RO(moves);
+
+static struct attribute *ieee802154_edmon_attrs[] = {
+	&dev_attr_interval.attr,
+	&dev_attr_threshold.attr,
+	&dev_attr_margin.attr,
+	&dev_attr_hold.attr,
+	&dev_attr_off_period.attr,
+	&dev_attr_agile.attr,
+	&dev_attr_channels.attr,
+	&dev_attr_samples.attr,
+	&dev_attr_skipped.attr,
+	&dev_attr_indications.attr,
+	&dev_attr_moves.attr,
+	NULL,
+};
+
+struct attribute_group ieee802154_edmon_group = {
+	.name	= "edmon",
+	.attrs	= ieee802154_edmon_attrs,
+};
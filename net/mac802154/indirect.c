@@ -0,0 +1,503 @@
+/*
+ * Indirect transmission for devices with receiver off when idle
+ *
+ * Copyright 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Written by:
+ * agent <agent@local>
+ */
+
+/*
+ * A device associating with the "receiver on when idle" capability bit
+ * cleared is registered here. Data and command frames sent to such a
+ * device are not transmitted, but kept until the device polls us with
+ * a data request command or until macTransactionPersistenceTime passes.
+ *
+ * Expiry uses a timer wheel ticking every IEEE802154_INDIRECT_TICK:
+ * all frames share the same persistence time, so every frame found in
+ * the slot being entered has expired.
+ */
+
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/jhash.h>
+#include <linux/netdevice.h>
+#include <linux/skbuff.h>
+
+#include <net/af_ieee802154.h>
+#include <net/mac802154.h>
+#include <net/ieee802154.h>
+#include <net/ieee802154_netdev.h>
+
+#include "mac802154.h"
+
+#define IEEE802154_INDIRECT_TICK	(HZ / 4)
+/* aBaseSuperframeDuration * 0x1f4 at 2.4 GHz, i.e. default
+ * macTransactionPersistenceTime for a beaconless PAN */
+#define IEEE802154_INDIRECT_PERSIST	msecs_to_jiffies(7680)
+
+#define IEEE802154_INDIRECT_MAX_DEVS	64
+#define IEEE802154_INDIRECT_MAX_FRAMES	64
+#define IEEE802154_INDIRECT_MAX_PER_DST	16
+
+struct indirect_dst {
+	struct hlist_node	long_node;
+	struct hlist_node	short_node;
+	u8			hwaddr[IEEE802154_ADDR_LEN];
+	u16			short_addr;
+
+	struct list_head	frames;
+	int			count;
+};
+
+struct indirect_frame {
+	struct list_head	list; /* on the indirect_dst->frames */
+	struct list_head	wheel; /* on the timer wheel slot */
+	struct indirect_dst	*dst;
+	struct sk_buff		*skb;
+};
+
+static inline unsigned int indirect_hash_long(const u8 *hwaddr)
+{
+	return jhash(hwaddr, IEEE802154_ADDR_LEN, 0) &
+		(IEEE802154_INDIRECT_HASH_SIZE - 1);
+}
+
+static inline unsigned int indirect_hash_short(u16 short_addr)
+{
+	return jhash_1word(short_addr, 0) &
+		(IEEE802154_INDIRECT_HASH_SIZE - 1);
+}
+
+static inline bool indirect_short_valid(u16 short_addr)
+{
+	return short_addr != IEEE802154_ADDR_BROADCAST &&
+		short_addr != IEEE802154_ADDR_UNDEF;
+}
+
+/* Must be called with ind->lock held */
+static struct indirect_dst *indirect_find_long(struct ieee802154_indirect *ind,
+		const u8 *hwaddr)
+{
+	struct indirect_dst *dst;
+	struct hlist_node *node;
+
+	hlist_for_each_entry(dst, node,
+			&ind->by_long[indirect_hash_long(hwaddr)], long_node)
+		if (!memcmp(dst->hwaddr, hwaddr, IEEE802154_ADDR_LEN))
+			return dst;
+
+	return NULL;
+}
+
+/* Must be called with ind->lock held */
+static struct indirect_dst *indirect_find_short(
+		struct ieee802154_indirect *ind, u16 short_addr)
+{
+	struct indirect_dst *dst;
+	struct hlist_node *node;
+
+	hlist_for_each_entry(dst, node,
+			&ind->by_short[indirect_hash_short(short_addr)],
+			short_node)
+		if (dst->short_addr == short_addr)
+			return dst;
+
+	return NULL;
+}
+
+static struct indirect_dst *indirect_find(struct ieee802154_indirect *ind,
+		struct ieee802154_addr *addr)
+{
+	switch (addr->addr_type) {
+	case IEEE802154_ADDR_LONG:
+		return indirect_find_long(ind, addr->hwaddr);
+	case IEEE802154_ADDR_SHORT:
+		if (!indirect_short_valid(addr->short_addr))
+			return NULL;
+		return indirect_find_short(ind, addr->short_addr);
+	default:
+		return NULL;
+	}
+}
+
+/* Must be called with ind->lock held */
+static void indirect_frame_unlink(struct ieee802154_indirect *ind,
+		struct indirect_frame *f)
+{
+	list_del(&f->list);
+	list_del(&f->wheel);
+	f->dst->count--;
+	ind->frame_count--;
+}
+
+static void ieee802154_indirect_tick(unsigned long data)
+{
+	struct ieee802154_sub_if_data *priv =
+		(struct ieee802154_sub_if_data *)data;
+	struct ieee802154_indirect *ind = &priv->indirect;
+	struct indirect_frame *f, *next;
+
+	spin_lock(&ind->lock);
+
+	ind->wheel_pos = (ind->wheel_pos + 1) &
+		(IEEE802154_INDIRECT_WHEEL_SIZE - 1);
+
+	list_for_each_entry_safe(f, next, &ind->wheel[ind->wheel_pos], wheel) {
+		pr_debug("%s: transaction expired\n", priv->dev->name);
+		indirect_frame_unlink(ind, f);
+		priv->dev->stats.tx_dropped++;
+		kfree_skb(f->skb);
+		kfree(f);
+	}
+
+	if (ind->frame_count)
+		mod_timer(&ind->timer, jiffies + IEEE802154_INDIRECT_TICK);
+
+	spin_unlock(&ind->lock);
+}
+
+void ieee802154_indirect_init(struct ieee802154_sub_if_data *priv)
+{
+	struct ieee802154_indirect *ind = &priv->indirect;
+	int i;
+
+	spin_lock_init(&ind->lock);
+
+	for (i = 0; i < IEEE802154_INDIRECT_HASH_SIZE; i++) {
+		INIT_HLIST_HEAD(&ind->by_long[i]);
+		INIT_HLIST_HEAD(&ind->by_short[i]);
+	}
+
+	for (i = 0; i < IEEE802154_INDIRECT_WHEEL_SIZE; i++)
+		INIT_LIST_HEAD(&ind->wheel[i]);
+
+	ind->persist = IEEE802154_INDIRECT_PERSIST;
+
+	setup_timer(&ind->timer, ieee802154_indirect_tick,
+			(unsigned long)priv);
+}
+
+/* Must be called with ind->lock held */
+static void indirect_dst_free(struct ieee802154_indirect *ind,
+		struct indirect_dst *dst)
+{
+	struct indirect_frame *f, *next;
+
+	list_for_each_entry_safe(f, next, &dst->frames, list) {
+		indirect_frame_unlink(ind, f);
+		kfree_skb(f->skb);
+		kfree(f);
+	}
+
+	hlist_del(&dst->long_node);
+	if (!hlist_unhashed(&dst->short_node))
+		hlist_del(&dst->short_node);
+
+	ind->dst_count--;
+	kfree(dst);
+}
+
+void ieee802154_indirect_flush(struct ieee802154_sub_if_data *priv)
+{
+	struct ieee802154_indirect *ind = &priv->indirect;
+	struct indirect_dst *dst;
+	struct hlist_node *node, *next;
+	int i;
+
+	spin_lock_bh(&ind->lock);
+	for (i = 0; i < IEEE802154_INDIRECT_HASH_SIZE; i++)
+		hlist_for_each_entry_safe(dst, node, next,
+				&ind->by_long[i], long_node)
+			indirect_dst_free(ind, dst);
+	spin_unlock_bh(&ind->lock);
+
+	del_timer_sync(&ind->timer);
+}
+
+int ieee802154_indirect_add_dev(struct ieee802154_sub_if_data *priv,
+		const u8 *hwaddr)
+{
+	struct ieee802154_indirect *ind = &priv->indirect;
+	struct indirect_dst *dst;
+	int err = 0;
+
+	spin_lock_bh(&ind->lock);
+
+	if (indirect_find_long(ind, hwaddr))
+		goto out;
+
+	if (ind->dst_count >= IEEE802154_INDIRECT_MAX_DEVS) {
+		err = -ENOSPC;
+		goto out;
+	}
+
+	dst = kzalloc(sizeof(*dst), GFP_ATOMIC);
+	if (!dst) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	memcpy(dst->hwaddr, hwaddr, IEEE802154_ADDR_LEN);
+	dst->short_addr = IEEE802154_ADDR_BROADCAST;
+	INIT_HLIST_NODE(&dst->short_node);
+	INIT_LIST_HEAD(&dst->frames);
+
+	hlist_add_head(&dst->long_node,
+			&ind->by_long[indirect_hash_long(hwaddr)]);
+	ind->dst_count++;
+
+out:
+	spin_unlock_bh(&ind->lock);
+	return err;
+}
+
+int ieee802154_indirect_set_short(struct ieee802154_sub_if_data *priv,
+		const u8 *hwaddr, u16 short_addr)
+{
+	struct ieee802154_indirect *ind = &priv->indirect;
+	struct indirect_dst *dst;
+	int err = 0;
+
+	spin_lock_bh(&ind->lock);
+
+	dst = indirect_find_long(ind, hwaddr);
+	if (!dst) {
+		err = -ENOENT;
+		goto out;
+	}
+
+	if (!hlist_unhashed(&dst->short_node))
+		hlist_del_init(&dst->short_node);
+
+	dst->short_addr = short_addr;
+	if (indirect_short_valid(short_addr))
+		hlist_add_head(&dst->short_node,
+			&ind->by_short[indirect_hash_short(short_addr)]);
+
+out:
+	spin_unlock_bh(&ind->lock);
+	return err;
+}
+
+void ieee802154_indirect_del_dev(struct ieee802154_sub_if_data *priv,
+		struct ieee802154_addr *addr)
+{
+	struct ieee802154_indirect *ind = &priv->indirect;
+	struct indirect_dst *dst;
+
+	spin_lock_bh(&ind->lock);
+	dst = indirect_find(ind, addr);
+	if (dst)
+		indirect_dst_free(ind, dst);
+	spin_unlock_bh(&ind->lock);
+}
+
+/*
+ * Fetch the destination of an outgoing frame. The frame is still
+ * as built by ieee802154_header_create, i.e. without the FCS.
+ */
+static int indirect_frame_dst(struct sk_buff *skb,
+		struct ieee802154_addr *addr)
+{
+	const u8 *hdr = skb->data;
+	u16 fc;
+	int i;
+
+	if (skb->len < 3)
+		return -EINVAL;
+
+	fc = hdr[0] | (hdr[1] << 8);
+
+	if (IEEE802154_FC_TYPE(fc) != IEEE802154_FC_TYPE_DATA &&
+	    IEEE802154_FC_TYPE(fc) != IEEE802154_FC_TYPE_MAC_CMD)
+		return -EINVAL;
+
+	addr->addr_type = IEEE802154_FC_DAMODE(fc);
+	hdr += 3;
+
+	switch (addr->addr_type) {
+	case IEEE802154_ADDR_SHORT:
+		if (skb->len < 3 + 2 + 2)
+			return -EINVAL;
+		addr->pan_id = hdr[0] | (hdr[1] << 8);
+		addr->short_addr = hdr[2] | (hdr[3] << 8);
+		break;
+	case IEEE802154_ADDR_LONG:
+		if (skb->len < 3 + 2 + IEEE802154_ADDR_LEN)
+			return -EINVAL;
+		addr->pan_id = hdr[0] | (hdr[1] << 8);
+		for (i = 0; i < IEEE802154_ADDR_LEN; i++)
+			addr->hwaddr[IEEE802154_ADDR_LEN - i - 1] = hdr[2 + i];
+		break;
+	default:
+		return -EINVAL;
+	}
+
+	return 0;
+}
+
+/*
+ * Returns -ENOENT if the frame should be transmitted directly, 0 if
+ * it was stored and other negative values if it should be dropped.
+ */
+int ieee802154_indirect_queue(struct ieee802154_sub_if_data *priv,
+		struct sk_buff *skb)
+{
+	struct ieee802154_indirect *ind = &priv->indirect;
+	struct ieee802154_addr addr;
+	struct indirect_dst *dst;
+	struct indirect_frame *f;
+	unsigned int ticks;
+	int err = 0;
+
+	if (!ind->dst_count ||
+	    !(priv->dev->priv_flags & IFF_IEEE802154_COORD))
+		return -ENOENT;
+
+	if (indirect_frame_dst(skb, &addr))
+		return -ENOENT;
+
+	spin_lock(&ind->lock);
+
+	dst = indirect_find(ind, &addr);
+	if (!dst) {
+		err = -ENOENT;
+		goto out;
+	}
+
+	if (dst->count >= IEEE802154_INDIRECT_MAX_PER_DST ||
+	    ind->frame_count >= IEEE802154_INDIRECT_MAX_FRAMES) {
+		pr_debug("%s: transaction overflow\n", priv->dev->name);
+		err = -ENOBUFS;
+		goto out;
+	}
+
+	f = kmalloc(sizeof(*f), GFP_ATOMIC);
+	if (!f) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	ticks = DIV_ROUND_UP(ind->persist, IEEE802154_INDIRECT_TICK);
+	ticks = clamp_t(unsigned int, ticks, 1,
+			IEEE802154_INDIRECT_WHEEL_SIZE - 1);
+
+	f->skb = skb;
+	f->dst = dst;
+	list_add_tail(&f->list, &dst->frames);
+	list_add_tail(&f->wheel, &ind->wheel[(ind->wheel_pos + ticks) &
+			(IEEE802154_INDIRECT_WHEEL_SIZE - 1)]);
+	dst->count++;
+	ind->frame_count++;
+
+	if (!timer_pending(&ind->timer))
+		mod_timer(&ind->timer, jiffies + IEEE802154_INDIRECT_TICK);
+
+out:
+	spin_unlock(&ind->lock);
+	return err;
+}
+
+/*
+ * Handle a data request from addr: the oldest pending frame is sent
+ * right away, bypassing the qdisc, with the frame pending bit set if
+ * there is more data waiting.
+ */
+int ieee802154_indirect_poll(struct ieee802154_sub_if_data *priv,
+		struct ieee802154_addr *addr)
+{
+	struct ieee802154_indirect *ind = &priv->indirect;
+	struct indirect_dst *dst;
+	struct indirect_frame *f = NULL;
+	struct sk_buff *skb;
+	bool more = false;
+
+	spin_lock_bh(&ind->lock);
+	dst = indirect_find(ind, addr);
+	if (dst && !list_empty(&dst->frames)) {
+		f = list_first_entry(&dst->frames, struct indirect_frame, list);
+		indirect_frame_unlink(ind, f);
+		more = dst->count > 0;
+	}
+	spin_unlock_bh(&ind->lock);
+
+	if (!f)
+		return -ENODATA;
+
+	skb = f->skb;
+	kfree(f);
+
+	if (more)
+		skb->data[0] |= IEEE802154_FC_FRPEND;
+	else
+		skb->data[0] &= ~IEEE802154_FC_FRPEND;
+
+	if (ieee802154_tx(priv, skb) != NETDEV_TX_OK) {
+		kfree_skb(skb);
+		return -ENOMEM;
+	}
+
+	return 0;
+}
+
+/*
+ * Append the pending address fields of a beacon: the specification
+ * octet followed by the short and then the extended addresses.
+ */
+int ieee802154_indirect_fill_pa(struct ieee802154_sub_if_data *priv,
+		struct sk_buff *skb)
+{
+	struct ieee802154_indirect *ind = &priv->indirect;
+	u16 shorts[IEEE802154_INDIRECT_PA_MAX];
+	u8 longs[IEEE802154_INDIRECT_PA_MAX][IEEE802154_ADDR_LEN];
+	struct indirect_dst *dst;
+	struct hlist_node *node;
+	int n16 = 0, n64 = 0;
+	int i, j;
+	u8 *data;
+
+	spin_lock_bh(&ind->lock);
+	for (i = 0; i < IEEE802154_INDIRECT_HASH_SIZE; i++) {
+		hlist_for_each_entry(dst, node, &ind->by_long[i], long_node) {
+			if (n16 + n64 == IEEE802154_INDIRECT_PA_MAX)
+				goto done;
+			if (!dst->count)
+				continue;
+			if (indirect_short_valid(dst->short_addr))
+				shorts[n16++] = dst->short_addr;
+			else
+				memcpy(longs[n64++], dst->hwaddr,
+						IEEE802154_ADDR_LEN);
+		}
+	}
+done:
+	spin_unlock_bh(&ind->lock);
+
+	data = skb_put(skb, 1 + n16 * 2 + n64 * IEEE802154_ADDR_LEN);
+	*data++ = ((n64 & 7) << 4) | (n16 & 7);
+
+	for (i = 0; i < n16; i++) {
+		*data++ = shorts[i] & 0xff;
+		*data++ = shorts[i] >> 8;
+	}
+
+	for (i = 0; i < n64; i++)
+		for (j = 0; j < IEEE802154_ADDR_LEN; j++)
+			*data++ = longs[i][IEEE802154_ADDR_LEN - j - 1];
+
+	return 1 + n16 * 2 + n64 * IEEE802154_ADDR_LEN;
+}
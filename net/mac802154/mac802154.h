@@ -23,6 +23,92 @@
 #define MAC802154_H
 
 #include <linux/spinlock.h>
+#include <linux/timer.h>
+#include <linux/hrtimer.h>
+#include <linux/interrupt.h>
+#include <linux/wait.h>
+#include <linux/workqueue.h>
+
+/*
+ * Software CSMA/CA and retransmission state, used for radios providing
+ * the cca and xmit_raw callbacks.
+ */
+struct ieee802154_csma {
+	spinlock_t		lock;
+	wait_queue_head_t	ack_wq;
+	bool			ack_wait;
+	bool			acked;
+	u8			ack_seq;
+
+	/* MAC PIB attributes */
+	u8			min_be;
+	u8			max_be;
+	u8			max_backoffs;
+	u8			max_retries;
+
+	/* statistics */
+	u32			frames;
+	u32			backoffs;
+	u32			retries;
+	u32			cca_failures;
+	u32			ack_failures;
+	u8			last_backoffs;
+	u8			last_retries;
+};
+
+#define IEEE802154_DEDUP_SIZE	64
+
+/* Last DSN received from a source, see dedup.c */
+struct ieee802154_dedup_slot {
+	u64			key;
+	unsigned long		stamp;
+	u8			addr_type;
+	u8			seq;
+};
+
+struct ieee802154_dedup {
+	spinlock_t			lock;
+	struct ieee802154_dedup_slot	slot[IEEE802154_DEDUP_SIZE];
+};
+
+#define IEEE802154_EDMON_RING		8
+#define IEEE802154_EDMON_NO_MOVE	0xff
+
+/* Last ED readings of a channel, see edmon.c */
+struct ieee802154_edmon_chan {
+	u8			ring[IEEE802154_EDMON_RING];
+	u8			pos;
+	u8			count;
+};
+
+struct ieee802154_edmon {
+	spinlock_t		lock;
+	struct delayed_work	work;
+
+	/* configuration, interval in ms */
+	u32			interval;
+	u32			threshold;
+	u32			margin;
+	u32			hold;
+	u32			off_period;
+	u32			agile;
+
+	struct ieee802154_edmon_chan	chan[27];
+	u32			degraded;
+	u32			runs;
+	u8			off_next;
+
+	/* pending PAN move, after the realignment went out */
+	u8			move_page;
+	u8			move_from;
+	u8			move_to;
+
+	/* statistics */
+	u32			samples;
+	u32			skipped;
+	u32			indications;
+	u32			moves;
+};
 
 struct ieee802154_priv {
 	struct ieee802154_dev	hw;
@@ -40,13 +126,158 @@ struct ieee802154_priv {
 	 */
 	struct list_head	slaves;
 	struct mutex		slaves_mtx;
+	/* Monitor interfaces, modified the same way as slaves */
+	struct list_head	monitors;
 	/* This one is used for scanning and other
 	 * jobs not to be interfered with serial driver */
 	struct workqueue_struct	*dev_workqueue;
+
+	struct ieee802154_csma	csma;
+	struct ieee802154_dedup	dedup;
+	struct ieee802154_edmon	edmon;
+
+	/* Frame handed to xmit_async, protected by tx_lock */
+	spinlock_t		tx_lock;
+	struct sk_buff		*tx_skb;
+	wait_queue_head_t	tx_wq;
+
+#if defined(CONFIG_MAC802154_BENCH) || defined(CONFIG_MAC802154_BENCH_MODULE)
+	/* Data path allocations, for the benchmark module */
+	atomic_t		allocs;
+#endif
 };
 
 #define ieee802154_to_priv(_hw)	container_of(_hw, struct ieee802154_priv, hw)
 
+static inline void ieee802154_count_alloc(struct ieee802154_priv *priv)
+{
+#if defined(CONFIG_MAC802154_BENCH) || defined(CONFIG_MAC802154_BENCH_MODULE)
+	atomic_inc(&priv->allocs);
+#endif
+}
+
+static inline u32 ieee802154_symbol_ns(u8 page, u8 chan)
+{
+	if (page == 0 && chan == 0)
+		return 50000;	/* 868 MHz BPSK, 20 ksymbol/s */
+	if (page == 0 && chan <= 10)
+		return 25000;	/* 915 MHz BPSK, 40 ksymbol/s */
+
+	return 16000;		/* 2.4 GHz O-QPSK, 62.5 ksymbol/s */
+}
+
+#define IEEE802154_INDIRECT_HASH_SIZE	16
+#define IEEE802154_INDIRECT_WHEEL_SIZE	64
+/* At most seven pending addresses fit into a beacon */
+#define IEEE802154_INDIRECT_PA_MAX	7
+
+/*
+ * Frames for devices with the receiver switched off when idle are held
+ * here until the device polls us with a data request. Destinations are
+ * hashed both by their extended and (once assigned) short address, frames
+ * are additionally threaded on a timer wheel for persistence expiry.
+ */
+struct ieee802154_indirect {
+	spinlock_t		lock;
+
+	struct hlist_head	by_long[IEEE802154_INDIRECT_HASH_SIZE];
+	struct hlist_head	by_short[IEEE802154_INDIRECT_HASH_SIZE];
+	int			dst_count;
+	int			frame_count;
+
+	struct list_head	wheel[IEEE802154_INDIRECT_WHEEL_SIZE];
+	unsigned int		wheel_pos;
+	struct timer_list	timer;
+	/* macTransactionPersistenceTime, in jiffies */
+	unsigned long		persist;
+};
+
+#define IEEE802154_NEIGH_HTABLE_SIZE	32
+
+/*
+ * Link estimates of the devices heard from or sent to on an interface,
+ * hashed by extended address and, when known, by PAN id and short
+ * address. Lookups are done under RCU, changes under the lock.
+ */
+struct ieee802154_neigh_table {
+	spinlock_t		lock;
+
+	struct hlist_head	by_long[IEEE802154_NEIGH_HTABLE_SIZE];
+	struct hlist_head	by_short[IEEE802154_NEIGH_HTABLE_SIZE];
+	struct list_head	all;
+	int			count;
+
+	struct timer_list	timer;
+};
+
+#define IEEE802154_ASSOC_HASH_SIZE	256
+
+/*
+ * Association handling by the coordinator itself, see assoc.c. The
+ * engine is enabled as long as the short address bitmap is allocated.
+ */
+struct ieee802154_assoc {
+	spinlock_t		lock;
+
+	unsigned long		*bitmap;
+	struct hlist_head	by_long[IEEE802154_ASSOC_HASH_SIZE];
+	u32			count;
+	u32			hint;
+
+	/* admission policy */
+	u32			permit;
+	u32			max_devs;
+	u32			first;
+	u32			last;
+
+	/* token bucket, requests per second */
+	u32			rate;
+	u32			burst;
+	u32			tokens;
+	unsigned long		last_fill;
+
+	struct list_head	resps;
+	u32			pending;
+	struct work_struct	work;
+
+	/* statistics */
+	u32			accepted;
+	u32			rejected;
+	u32			dropped;
+};
+
+/*
+ * Beacon-enabled PAN state. The hrtimer alternates between the beacon
+ * time and the end of the active portion; the transmit queue is only
+ * running during the CAP.
+ */
+struct ieee802154_superframe {
+	spinlock_t		lock;
+	struct hrtimer		timer;
+	struct tasklet_struct	beacon_tasklet;
+
+	bool			active;
+	bool			in_cap;
+	bool			next_is_beacon;
+	u8			bo;
+	u8			so;
+
+	u32			symbol_ns;
+	u64			interval_ns;
+	u64			sd_ns;
+	ktime_t			beacon_time;
+	ktime_t			cap_end;
+
+	/*
+	 * Delay from the beacon time until the beacon is handed to the
+	 * transmit worker, not until it is on air
+	 */
+	u32			beacons;
+	s64			sched_latency_last;
+	s64			sched_latency_max;
+	s64			sched_latency_sum;
+};
+
 struct ieee802154_sub_if_data {
 	struct list_head list; /* the ieee802154_priv->slaves list */
 
@@ -65,15 +296,28 @@ struct ieee802154_sub_if_data {
 	u8 bsn;
 	/* MAC BSN field */
 	u8 dsn;
+
+	struct ieee802154_indirect indirect;
+	struct ieee802154_superframe sf;
+	struct ieee802154_neigh_table neigh;
+	struct ieee802154_assoc assoc;
 };
 
 void ieee802154_drop_slaves(struct ieee802154_dev *hw);
 struct net_device *ieee802154_add_iface(struct wpan_phy *phy,
-		const char *name);
+		const char *name, int type);
 void ieee802154_del_iface(struct wpan_phy *phy,
 		struct net_device *dev);
 
 void ieee802154_subif_rx(struct ieee802154_dev *hw, struct sk_buff *skb);
+void ieee802154_update_promisc(struct ieee802154_priv *hw);
+
+struct net_device *ieee802154_add_monitor(struct wpan_phy *phy,
+		const char *name);
+void ieee802154_del_monitor(struct wpan_phy *phy, struct net_device *dev);
+void ieee802154_drop_monitors(struct ieee802154_priv *priv);
+int ieee802154_monitors_running(struct ieee802154_priv *priv);
+void ieee802154_monitors_rx(struct ieee802154_priv *priv, struct sk_buff *skb);
 
 extern struct ieee802154_mlme_ops mac802154_mlme;
 
@@ -82,7 +326,74 @@ int ieee802154_mlme_scan_req(struct net_device *dev,
 
 int ieee802154_process_cmd(struct net_device *dev, struct sk_buff *skb);
 int ieee802154_send_beacon_req(struct net_device *dev);
+int ieee802154_send_realign(struct net_device *dev, u8 page, u8 channel);
 
 struct ieee802154_priv *ieee802154_slave_get_priv(struct net_device *dev);
 
+void ieee802154_tx_quiesce(struct ieee802154_priv *priv);
+int ieee802154_set_channel(struct ieee802154_priv *hw, u8 page, u8 chan);
+void ieee802154_ed_record(struct ieee802154_priv *hw, u8 chan, u8 level);
+void ieee802154_set_promisc(struct ieee802154_priv *hw, int promisc);
+netdev_tx_t ieee802154_tx(struct ieee802154_sub_if_data *priv,
+		struct sk_buff *skb);
+
+void ieee802154_indirect_init(struct ieee802154_sub_if_data *priv);
+void ieee802154_indirect_flush(struct ieee802154_sub_if_data *priv);
+int ieee802154_indirect_add_dev(struct ieee802154_sub_if_data *priv,
+		const u8 *hwaddr);
+int ieee802154_indirect_set_short(struct ieee802154_sub_if_data *priv,
+		const u8 *hwaddr, u16 short_addr);
+void ieee802154_indirect_del_dev(struct ieee802154_sub_if_data *priv,
+		struct ieee802154_addr *addr);
+int ieee802154_indirect_queue(struct ieee802154_sub_if_data *priv,
+		struct sk_buff *skb);
+int ieee802154_indirect_poll(struct ieee802154_sub_if_data *priv,
+		struct ieee802154_addr *addr);
+int ieee802154_indirect_fill_pa(struct ieee802154_sub_if_data *priv,
+		struct sk_buff *skb);
+
+struct ieee802154_neigh_info;
+
+void ieee802154_neigh_init(struct ieee802154_sub_if_data *priv);
+void ieee802154_neigh_flush(struct ieee802154_sub_if_data *priv);
+void ieee802154_neigh_rx(struct ieee802154_sub_if_data *priv,
+		struct sk_buff *skb);
+void ieee802154_neigh_tx(struct ieee802154_priv *hw, struct sk_buff *skb,
+		int result);
+void ieee802154_neigh_set_short(struct ieee802154_sub_if_data *priv,
+		const u8 *hwaddr, u16 pan_id, u16 short_addr);
+int ieee802154_neigh_dump(struct net_device *dev, int skip,
+		int (*fill)(const struct ieee802154_neigh_info *info,
+			void *arg),
+		void *arg);
+
+void ieee802154_assoc_init(struct ieee802154_sub_if_data *priv);
+void ieee802154_assoc_flush(struct ieee802154_sub_if_data *priv);
+bool ieee802154_assoc_req(struct ieee802154_sub_if_data *priv,
+		struct ieee802154_addr *addr, u8 cap);
+void ieee802154_assoc_release(struct ieee802154_sub_if_data *priv,
+		const u8 *hwaddr);
+
+extern struct attribute_group ieee802154_sf_group;
+extern struct attribute_group ieee802154_assoc_group;
+extern struct attribute_group ieee802154_csma_group;
+extern struct attribute_group ieee802154_edmon_group;
+
+void ieee802154_dedup_init(struct ieee802154_priv *priv);
+bool ieee802154_dedup_check(struct ieee802154_priv *priv,
+		struct sk_buff *skb);
+
+void ieee802154_edmon_init(struct ieee802154_priv *priv);
+void ieee802154_edmon_stop(struct ieee802154_priv *priv);
+
+void ieee802154_csma_init(struct ieee802154_priv *priv);
+int ieee802154_csma_xmit(struct ieee802154_priv *priv, struct sk_buff *skb);
+void ieee802154_csma_rx(struct ieee802154_priv *priv, struct sk_buff *skb);
+
+void ieee802154_sf_init(struct ieee802154_sub_if_data *priv);
+int ieee802154_sf_start(struct ieee802154_sub_if_data *priv, u8 bo, u8 so);
+void ieee802154_sf_stop(struct ieee802154_sub_if_data *priv);
+bool ieee802154_sf_can_tx(struct ieee802154_sub_if_data *priv,
+		unsigned int len);
+
 #endif
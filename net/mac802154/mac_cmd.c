@@ -36,6 +36,7 @@
 
 static int ieee802154_cmd_beacon_req(struct sk_buff *skb)
 {
+	struct ieee802154_sub_if_data *priv = netdev_priv(skb->dev);
 	struct ieee802154_addr saddr; /* jeez */
 	int flags = 0;
 	if (skb->len != 1)
@@ -49,6 +50,10 @@ static int ieee802154_cmd_beacon_req(struct sk_buff *skb)
 	if (!(skb->dev->priv_flags & IFF_IEEE802154_COORD))
 		return 0;
 
+	/* Beacon-enabled PANs answer with the next periodic beacon */
+	if (priv->sf.active)
+		return 0;
+
 	if (mac_cb(skb)->sa.addr_type != IEEE802154_ADDR_NONE ||
 	    mac_cb(skb)->da.addr_type != IEEE802154_ADDR_SHORT ||
 	    mac_cb(skb)->da.pan_id != IEEE802154_PANID_BROADCAST ||
@@ -86,6 +91,16 @@ static int ieee802154_cmd_assoc_req(struct sk_buff *skb)
 
 	cap = skb->data[1];
 
+	/* Frames to the device will have to wait for its data requests */
+	if ((skb->dev->priv_flags & IFF_IEEE802154_COORD) &&
+	    !(cap & IEEE802154_CAP_RX_ON_IDLE))
+		ieee802154_indirect_add_dev(netdev_priv(skb->dev),
+				mac_cb(skb)->sa.hwaddr);
+
+	if ((skb->dev->priv_flags & IFF_IEEE802154_COORD) &&
+	    ieee802154_assoc_req(netdev_priv(skb->dev), &mac_cb(skb)->sa, cap))
+		return 0;
+
 	return ieee802154_nl_assoc_indic(skb->dev, &mac_cb(skb)->sa, cap);
 }
 
@@ -140,6 +155,11 @@ static int ieee802154_cmd_disassoc_notify(struct sk_buff *skb)
 
 	reason = skb->data[1];
 
+	ieee802154_indirect_del_dev(netdev_priv(skb->dev), &mac_cb(skb)->sa);
+	if (mac_cb(skb)->sa.addr_type == IEEE802154_ADDR_LONG)
+		ieee802154_assoc_release(netdev_priv(skb->dev),
+				mac_cb(skb)->sa.hwaddr);
+
 	/* FIXME: checks if this was our coordinator and the disassoc us */
 	/* FIXME: if we device, one should receive ->da and not ->sa */
 	/* FIXME: the status should also help */
@@ -148,6 +168,25 @@ static int ieee802154_cmd_disassoc_notify(struct sk_buff *skb)
 			reason);
 }
 
+static int ieee802154_cmd_data_req(struct sk_buff *skb)
+{
+	if (skb->len != 1)
+		return -EINVAL;
+
+	if (skb->pkt_type != PACKET_HOST)
+		return 0;
+
+	if (!(skb->dev->priv_flags & IFF_IEEE802154_COORD))
+		return 0;
+
+	if (mac_cb(skb)->sa.addr_type != IEEE802154_ADDR_LONG &&
+	    mac_cb(skb)->sa.addr_type != IEEE802154_ADDR_SHORT)
+		return -EINVAL;
+
+	return ieee802154_indirect_poll(netdev_priv(skb->dev),
+			&mac_cb(skb)->sa);
+}
+
 int ieee802154_process_cmd(struct net_device *dev, struct sk_buff *skb)
 {
 	u8 cmd;
@@ -173,6 +212,9 @@ int ieee802154_process_cmd(struct net_device *dev, struct sk_buff *skb)
 	case IEEE802154_CMD_BEACON_REQ:
 		ieee802154_cmd_beacon_req(skb);
 		break;
+	case IEEE802154_CMD_DATA_REQ:
+		ieee802154_cmd_data_req(skb);
+		break;
 	default:
 		pr_debug("Frame type is not supported yet\n");
 		goto drop;
@@ -204,7 +246,11 @@ static int ieee802154_send_cmd(struct net_device *dev,
 
 	skb_reset_network_header(skb);
 
-	mac_cb(skb)->flags = IEEE802154_FC_TYPE_MAC_CMD | MAC_CB_FLAG_ACKREQ;
+	mac_cb(skb)->flags = IEEE802154_FC_TYPE_MAC_CMD;
+	/* Nobody acknowledges a broadcast */
+	if (addr->addr_type != IEEE802154_ADDR_SHORT ||
+	    addr->short_addr != IEEE802154_ADDR_BROADCAST)
+		mac_cb(skb)->flags |= MAC_CB_FLAG_ACKREQ;
 	mac_cb(skb)->seq = ieee802154_mlme_ops(dev)->get_dsn(dev);
 	err = dev_hard_header(skb, dev, ETH_P_IEEE802154, addr, saddr, len);
 	if (err < 0) {
@@ -233,6 +279,41 @@ int ieee802154_send_beacon_req(struct net_device *dev)
 	return ieee802154_send_cmd(dev, &addr, &saddr, &cmd, 1);
 }
 
+/*
+ * Tell the devices of our PAN that we are moving to another channel,
+ * see 7.3.8 of IEEE 802.15.4-2006.
+ */
+int ieee802154_send_realign(struct net_device *dev, u8 page, u8 channel)
+{
+	struct ieee802154_addr addr;
+	struct ieee802154_addr saddr;
+	u16 pan_id = ieee802154_dev_get_pan_id(dev);
+	u16 short_addr = ieee802154_dev_get_short_addr(dev);
+	u8 buf[9];
+	int pos = 0;
+
+	addr.addr_type = IEEE802154_ADDR_SHORT;
+	addr.short_addr = IEEE802154_ADDR_BROADCAST;
+	addr.pan_id = IEEE802154_PANID_BROADCAST;
+
+	saddr.addr_type = IEEE802154_ADDR_LONG;
+	saddr.pan_id = pan_id;
+	memcpy(saddr.hwaddr, dev->dev_addr, IEEE802154_ADDR_LEN);
+
+	buf[pos++] = IEEE802154_CMD_COORD_REALIGN_NOTIFY;
+	buf[pos++] = pan_id;
+	buf[pos++] = pan_id >> 8;
+	buf[pos++] = short_addr;
+	buf[pos++] = short_addr >> 8;
+	buf[pos++] = channel;
+	/* Not sent to a single orphan, so no short address for it */
+	buf[pos++] = IEEE802154_ADDR_BROADCAST & 0xff;
+	buf[pos++] = IEEE802154_ADDR_BROADCAST >> 8;
+	buf[pos++] = page;
+
+	return ieee802154_send_cmd(dev, &addr, &saddr, buf, pos);
+}
+
 
 static int ieee802154_mlme_assoc_req(struct net_device *dev,
 		struct ieee802154_addr *addr, u8 channel, u8 page, u8 cap)
@@ -269,6 +350,15 @@ static int ieee802154_mlme_assoc_resp(struct net_device *dev,
 	saddr.pan_id = addr->pan_id;
 	memcpy(saddr.hwaddr, dev->dev_addr, IEEE802154_ADDR_LEN);
 
+	/* A sleeping device will fetch the response with a data request */
+	if (status == IEEE802154_SUCCESS &&
+	    addr->addr_type == IEEE802154_ADDR_LONG) {
+		ieee802154_indirect_set_short(netdev_priv(dev), addr->hwaddr,
+				short_addr);
+		ieee802154_neigh_set_short(netdev_priv(dev), addr->hwaddr,
+				addr->pan_id, short_addr);
+	}
+
 	buf[pos++] = IEEE802154_CMD_ASSOCIATION_RESP;
 	buf[pos++] = short_addr;
 	buf[pos++] = short_addr >> 8;
@@ -294,6 +384,9 @@ static int ieee802154_mlme_disassoc_req(struct net_device *dev,
 
 	ret = ieee802154_send_cmd(dev, addr, &saddr, buf, pos);
 
+	if (addr->addr_type == IEEE802154_ADDR_LONG)
+		ieee802154_assoc_release(netdev_priv(dev), addr->hwaddr);
+
 	/* FIXME: this should be after the ack receved */
 	ieee802154_dev_set_pan_id(dev, 0xffff);
 	ieee802154_dev_set_short_addr(dev, 0xffff);
@@ -308,6 +401,8 @@ static int ieee802154_mlme_start_req(struct net_device *dev,
 				u8 bcn_ord, u8 sf_ord, u8 pan_coord, u8 blx,
 				u8 coord_realign)
 {
+	int err;
+
 	BUG_ON(addr->addr_type != IEEE802154_ADDR_SHORT);
 
 	ieee802154_dev_set_pan_id(dev, addr->pan_id);
@@ -327,6 +422,17 @@ static int ieee802154_mlme_start_req(struct net_device *dev,
 		dev->priv_flags &= ~IFF_IEEE802154_COORD;
 
 	ieee802154_dev_set_pan_coord(dev);
+
+	if (bcn_ord < 15 && pan_coord) {
+		err = ieee802154_sf_start(netdev_priv(dev), bcn_ord, sf_ord);
+		if (err) {
+			ieee802154_nl_start_confirm(dev,
+					IEEE802154_INVALID_PARAMETER);
+			return err;
+		}
+	} else
+		ieee802154_sf_stop(netdev_priv(dev));
+
 	ieee802154_nl_start_confirm(dev, IEEE802154_SUCCESS);
 
 	return 0;
@@ -345,5 +451,7 @@ struct ieee802154_mlme_ops mac802154_mlme = {
 	.get_short_addr = ieee802154_dev_get_short_addr,
 	.get_dsn = ieee802154_dev_get_dsn,
 	.get_bsn = ieee802154_dev_get_bsn,
+	.get_mib = ieee802154_dev_get_mib,
+	.neigh_dump = ieee802154_neigh_dump,
 };
 
@@ -46,16 +46,28 @@ struct ieee802154_dev *ieee802154_alloc_device(size_t priv_size,
 	priv->hw.priv = (char *)priv + ALIGN(sizeof(*priv), NETDEV_ALIGN);
 
 	BUG_ON(!ops);
-	BUG_ON(!ops->xmit);
+	BUG_ON(!ops->xmit && !ops->xmit_async);
 	BUG_ON(!ops->ed);
 	BUG_ON(!ops->start);
 	BUG_ON(!ops->stop);
 
 	priv->ops = ops;
 
+	/* Same as a freshly created interface */
+	priv->hw.hw_filt.pan_id = IEEE802154_PANID_BROADCAST;
+	priv->hw.hw_filt.short_addr = IEEE802154_ADDR_BROADCAST;
+
 	INIT_LIST_HEAD(&priv->slaves);
+	INIT_LIST_HEAD(&priv->monitors);
 	mutex_init(&priv->slaves_mtx);
 
+	ieee802154_csma_init(priv);
+	ieee802154_dedup_init(priv);
+	ieee802154_edmon_init(priv);
+
+	spin_lock_init(&priv->tx_lock);
+	init_waitqueue_head(&priv->tx_wq);
+
 	return &priv->hw;
 }
 EXPORT_SYMBOL(ieee802154_alloc_device);
@@ -70,6 +82,17 @@ void ieee802154_free_device(struct ieee802154_dev *hw)
 }
 EXPORT_SYMBOL(ieee802154_free_device);
 
+/* Lets a phy used only by monitors be tuned, see IEEE802154_SET_PHY */
+static int ieee802154_phy_set_channel(struct wpan_phy *phy, u8 page,
+		u8 channel)
+{
+	struct ieee802154_priv *priv = wpan_phy_priv(phy);
+
+	ieee802154_tx_quiesce(priv);
+
+	return ieee802154_set_channel(priv, page, channel);
+}
+
 int ieee802154_register_device(struct ieee802154_dev *dev)
 {
 	struct ieee802154_priv *priv = ieee802154_to_priv(dev);
@@ -86,11 +109,19 @@ int ieee802154_register_device(struct ieee802154_dev *dev)
 
 	priv->phy->add_iface = ieee802154_add_iface;
 	priv->phy->del_iface = ieee802154_del_iface;
+	priv->phy->set_channel = ieee802154_phy_set_channel;
 
 	rc = wpan_phy_register(priv->phy);
 	if (rc < 0)
 		goto out_wq;
 
+	if (priv->ops->cca && priv->ops->xmit_raw &&
+	    sysfs_create_group(&priv->phy->dev.kobj, &ieee802154_csma_group))
+		dev_warn(&priv->phy->dev, "failed to create csma attributes\n");
+
+	if (sysfs_create_group(&priv->phy->dev.kobj, &ieee802154_edmon_group))
+		dev_warn(&priv->phy->dev, "failed to create edmon attributes\n");
+
 	return 0;
 
 out_wq:
@@ -104,15 +135,27 @@ void ieee802154_unregister_device(struct ieee802154_dev *dev)
 {
 	struct ieee802154_priv *priv = ieee802154_to_priv(dev);
 
+	/* Nothing may rearm the monitor once it is stopped */
+	sysfs_remove_group(&priv->phy->dev.kobj, &ieee802154_edmon_group);
+	ieee802154_edmon_stop(priv);
+
 	flush_workqueue(priv->dev_workqueue);
 	destroy_workqueue(priv->dev_workqueue);
 
+	mutex_lock(&priv->phy->pib_lock);
+	ieee802154_tx_quiesce(priv);
+	mutex_unlock(&priv->phy->pib_lock);
+
 	rtnl_lock();
 
 	ieee802154_drop_slaves(dev);
 
 	rtnl_unlock();
 
+	if (priv->ops->cca && priv->ops->xmit_raw)
+		sysfs_remove_group(&priv->phy->dev.kobj,
+				&ieee802154_csma_group);
+
 	wpan_phy_unregister(priv->phy);
 }
 EXPORT_SYMBOL(ieee802154_unregister_device);
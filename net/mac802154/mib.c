@@ -23,7 +23,9 @@
 #include <linux/if_arp.h>
 
 #include <net/mac802154.h>
+#include <net/ieee802154_netdev.h>
 #include <net/wpan-phy.h>
+#include <trace/events/ieee802154.h>
 
 #include "mac802154.h"
 #include "mib.h"
@@ -35,7 +37,7 @@ struct phy_chan_notify_work {
 
 struct hw_addr_filt_notify_work {
 	struct work_struct work;
-	struct net_device *dev;
+	struct ieee802154_priv *hw;
 	unsigned long changed;
 };
 
@@ -43,11 +45,15 @@ static void hw_addr_notify(struct work_struct *work)
 {
 	struct hw_addr_filt_notify_work *nw = container_of(work,
 			struct hw_addr_filt_notify_work, work);
-	struct ieee802154_priv *hw = ieee802154_slave_get_priv(nw->dev);
+	struct ieee802154_priv *hw = nw->hw;
 	int res;
 
+	/* The radio may have to leave the receive state */
+	mutex_lock(&hw->phy->pib_lock);
+	ieee802154_tx_quiesce(hw);
 	res = hw->ops->set_hw_addr_filt(&hw->hw,
 		&hw->hw.hw_filt, nw->changed);
+	mutex_unlock(&hw->phy->pib_lock);
 	if (res)
 		pr_debug("%s: failed changed mask %lx\n",
 			__func__, nw->changed);
@@ -57,9 +63,8 @@ static void hw_addr_notify(struct work_struct *work)
 	return;
 }
 
-static void set_hw_addr_filt(struct net_device *dev, unsigned long changed)
+static void set_hw_addr_filt(struct ieee802154_priv *hw, unsigned long changed)
 {
-	struct ieee802154_sub_if_data *priv = netdev_priv(dev);
 	struct hw_addr_filt_notify_work *work;
 
 	work = kzalloc(sizeof(*work), GFP_ATOMIC);
@@ -67,13 +72,51 @@ static void set_hw_addr_filt(struct net_device *dev, unsigned long changed)
 		return;
 
 	INIT_WORK(&work->work, hw_addr_notify);
-	work->dev = dev;
+	work->hw = hw;
 	work->changed = changed;
-	queue_work(priv->hw->dev_workqueue, &work->work);
+	queue_work(hw->dev_workqueue, &work->work);
 
 	return;
 }
 
+void ieee802154_set_promisc(struct ieee802154_priv *hw, int promisc)
+{
+	if (hw->ops->set_hw_addr_filt && hw->hw.hw_filt.promisc != promisc) {
+		hw->hw.hw_filt.promisc = promisc;
+		set_hw_addr_filt(hw, IEEE802515_PROMISC_CHANGED);
+	}
+}
+
+/*
+ * Switch the radio to another channel, called with pib_lock held and
+ * no transmission in progress.
+ */
+int ieee802154_set_channel(struct ieee802154_priv *hw, u8 page, u8 chan)
+{
+	int res;
+
+	res = hw->ops->set_channel(&hw->hw, chan);
+	trace_ieee802154_set_channel(hw->phy, page, chan, res);
+	if (!res)
+		wpan_phy_stats_inc(hw->phy, channel_switches);
+
+	return res;
+}
+
+void ieee802154_ed_record(struct ieee802154_priv *hw, u8 chan, u8 level)
+{
+	struct wpan_phy_stats *stats = &hw->phy->stats;
+	unsigned long flags;
+
+	spin_lock_irqsave(&stats->lock, flags);
+	stats->ed[stats->ed_pos].channel = chan;
+	stats->ed[stats->ed_pos].level = level;
+	stats->ed_pos = (stats->ed_pos + 1) % WPAN_PHY_ED_HISTORY;
+	if (stats->ed_count < WPAN_PHY_ED_HISTORY)
+		stats->ed_count++;
+	spin_unlock_irqrestore(&stats->lock, flags);
+}
+
 static void phy_chan_notify(struct work_struct *work)
 {
 	struct phy_chan_notify_work *nw = container_of(work,
@@ -82,7 +125,10 @@ static void phy_chan_notify(struct work_struct *work)
 	struct ieee802154_sub_if_data *priv = netdev_priv(nw->dev);
 	int res;
 
-	res = hw->ops->set_channel(&hw->hw, priv->chan);
+	mutex_lock(&hw->phy->pib_lock);
+	ieee802154_tx_quiesce(hw);
+	res = ieee802154_set_channel(hw, priv->page, priv->chan);
+	mutex_unlock(&hw->phy->pib_lock);
 	if (res)
 		pr_debug("set_channel failed\n");
 
@@ -119,6 +165,50 @@ u16 ieee802154_dev_get_short_addr(const struct net_device *dev)
 	return ret;
 }
 
+static void filt_set_pan_id(struct ieee802154_priv *hw, u16 val)
+{
+	if (hw->ops->set_hw_addr_filt && hw->hw.hw_filt.pan_id != val) {
+		hw->hw.hw_filt.pan_id = val;
+		set_hw_addr_filt(hw, IEEE802515_PANID_CHANGED);
+	}
+}
+
+static void filt_set_short_addr(struct ieee802154_priv *hw, u16 val)
+{
+	if (hw->ops->set_hw_addr_filt && hw->hw.hw_filt.short_addr != val) {
+		hw->hw.hw_filt.short_addr = val;
+		set_hw_addr_filt(hw, IEEE802515_SADDR_CHANGED);
+	}
+}
+
+static void filt_set_ieee_addr(struct ieee802154_priv *hw, const u8 *addr)
+{
+	if (hw->ops->set_hw_addr_filt &&
+		memcmp(hw->hw.hw_filt.ieee_addr, addr, IEEE802154_ADDR_LEN)) {
+		memcpy(hw->hw.hw_filt.ieee_addr, addr, IEEE802154_ADDR_LEN);
+		set_hw_addr_filt(hw, IEEE802515_IEEEADDR_CHANGED);
+	}
+}
+
+static void filt_set_pan_coord(struct ieee802154_priv *hw, int pan_coord)
+{
+	if (hw->ops->set_hw_addr_filt &&
+		hw->hw.hw_filt.pan_coord != pan_coord) {
+		hw->hw.hw_filt.pan_coord = pan_coord;
+		set_hw_addr_filt(hw, IEEE802515_PANC_CHANGED);
+	}
+}
+
+/*
+ * The filter holds the addresses of the only open interface. While the
+ * radio is promiscuous nobody owns it, ieee802154_update_promisc()
+ * reloads it when leaving that mode.
+ */
+static bool filt_owner(struct ieee802154_sub_if_data *priv)
+{
+	return netif_running(priv->dev) && !priv->hw->hw.hw_filt.promisc;
+}
+
 void ieee802154_dev_set_pan_id(struct net_device *dev, u16 val)
 {
 	struct ieee802154_sub_if_data *priv = netdev_priv(dev);
@@ -129,23 +219,17 @@ void ieee802154_dev_set_pan_id(struct net_device *dev, u16 val)
 	priv->pan_id = val;
 	spin_unlock_bh(&priv->mib_lock);
 
-	if (priv->hw->ops->set_hw_addr_filt &&
-		(priv->hw->hw.hw_filt.pan_id != priv->pan_id)) {
-		priv->hw->hw.hw_filt.pan_id = priv->pan_id;
-		set_hw_addr_filt(dev, IEEE802515_PANID_CHANGED);
-	}
+	if (filt_owner(priv))
+		filt_set_pan_id(priv->hw, val);
 }
 
 void ieee802154_dev_set_pan_coord(struct net_device *dev)
 {
 	struct ieee802154_sub_if_data *priv = netdev_priv(dev);
-	int pan_coord = !!(dev->priv_flags & IFF_IEEE802154_COORD);
 
-	if (priv->hw->ops->set_hw_addr_filt &&
-		(priv->hw->hw.hw_filt.pan_coord != pan_coord)) {
-		priv->hw->hw.hw_filt.pan_coord = pan_coord;
-		set_hw_addr_filt(dev, IEEE802515_PANC_CHANGED);
-	}
+	if (filt_owner(priv))
+		filt_set_pan_coord(priv->hw,
+				!!(dev->priv_flags & IFF_IEEE802154_COORD));
 }
 
 void ieee802154_dev_set_short_addr(struct net_device *dev, u16 val)
@@ -158,24 +242,34 @@ void ieee802154_dev_set_short_addr(struct net_device *dev, u16 val)
 	priv->short_addr = val;
 	spin_unlock_bh(&priv->mib_lock);
 
-	if (priv->hw->ops->set_hw_addr_filt &&
-		(priv->hw->hw.hw_filt.short_addr != priv->short_addr)) {
-		priv->hw->hw.hw_filt.short_addr = priv->short_addr;
-		set_hw_addr_filt(dev, IEEE802515_SADDR_CHANGED);
-	}
+	if (filt_owner(priv))
+		filt_set_short_addr(priv->hw, val);
 }
 
 void ieee802154_dev_set_ieee_addr(struct net_device *dev)
 {
 	struct ieee802154_sub_if_data *priv = netdev_priv(dev);
 
-	if (priv->hw->ops->set_hw_addr_filt &&
-		memcmp(priv->hw->hw.hw_filt.ieee_addr,
-			dev->dev_addr, IEEE802154_ADDR_LEN)) {
-		memcpy(priv->hw->hw.hw_filt.ieee_addr,
-			dev->dev_addr, IEEE802154_ADDR_LEN);
-		set_hw_addr_filt(dev, IEEE802515_IEEEADDR_CHANGED);
-	}
+	if (filt_owner(priv))
+		filt_set_ieee_addr(priv->hw, dev->dev_addr);
+}
+
+/* Point the hardware filter at the addresses of this interface */
+void ieee802154_dev_load_hw_filt(struct net_device *dev)
+{
+	struct ieee802154_sub_if_data *priv = netdev_priv(dev);
+	u16 pan_id, short_addr;
+
+	spin_lock_bh(&priv->mib_lock);
+	pan_id = priv->pan_id;
+	short_addr = priv->short_addr;
+	spin_unlock_bh(&priv->mib_lock);
+
+	filt_set_pan_id(priv->hw, pan_id);
+	filt_set_short_addr(priv->hw, short_addr);
+	filt_set_ieee_addr(priv->hw, dev->dev_addr);
+	filt_set_pan_coord(priv->hw,
+			!!(dev->priv_flags & IFF_IEEE802154_COORD));
 }
 
 void ieee802154_dev_set_channel(struct net_device *dev, u8 val)
@@ -239,6 +333,43 @@ u8 ieee802154_dev_get_bsn(const struct net_device *dev)
 	return ret;
 }
 
+void ieee802154_dev_get_mib(const struct net_device *dev,
+		struct ieee802154_mib *mib)
+{
+	struct ieee802154_sub_if_data *priv = netdev_priv(dev);
+	struct ieee802154_csma *csma = &priv->hw->csma;
+	unsigned long flags;
+
+	BUG_ON(dev->type != ARPHRD_IEEE802154);
+
+	memset(mib, 0, sizeof(*mib));
+
+	spin_lock_bh(&priv->mib_lock);
+	mib->pan_id = priv->pan_id;
+	mib->short_addr = priv->short_addr;
+	mib->channel = priv->chan;
+	mib->page = priv->page;
+	mib->bsn = priv->bsn;
+	mib->dsn = priv->dsn;
+	spin_unlock_bh(&priv->mib_lock);
+
+	spin_lock_irqsave(&priv->sf.lock, flags);
+	mib->bcn_ord = priv->sf.bo;
+	mib->sf_ord = priv->sf.so;
+	spin_unlock_irqrestore(&priv->sf.lock, flags);
+
+	spin_lock_irqsave(&csma->lock, flags);
+	mib->min_be = csma->min_be;
+	mib->max_be = csma->max_be;
+	mib->max_csma_backoffs = csma->max_backoffs;
+	mib->max_frame_retries = csma->max_retries;
+	spin_unlock_irqrestore(&csma->lock, flags);
+
+	spin_lock_bh(&priv->indirect.lock);
+	mib->indirect_frames = priv->indirect.frame_count;
+	spin_unlock_bh(&priv->indirect.lock);
+}
+
 struct ieee802154_priv *ieee802154_slave_get_priv(struct net_device *dev)
 {
 	struct ieee802154_sub_if_data *priv = netdev_priv(dev);
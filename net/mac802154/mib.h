@@ -28,9 +28,12 @@ void ieee802154_dev_set_pan_id(struct net_device *dev, u16 val);
 void ieee802154_dev_set_pan_coord(struct net_device *dev);
 void ieee802154_dev_set_short_addr(struct net_device *dev, u16 val);
 void ieee802154_dev_set_ieee_addr(struct net_device *dev);
+void ieee802154_dev_load_hw_filt(struct net_device *dev);
 void ieee802154_dev_set_channel(struct net_device *dev, u8 chan);
 void ieee802154_dev_set_page(struct net_device *dev, u8 page);
 struct wpan_phy *ieee802154_get_phy(const struct net_device *dev);
+void ieee802154_dev_get_mib(const struct net_device *dev,
+		struct ieee802154_mib *mib);
 
 
 #endif
@@ -0,0 +1,338 @@
+/*
+ * Monitor interfaces
+ *
+ * Copyright 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Written by:
+ * agent <agent@local>
+ */
+
+/*
+ * A monitor interface gets a copy of every frame the radio passes up,
+ * before the FCS check, duplicate suppression and address filtering.
+ * While one is up the radio is kept promiscuous. Nothing can be sent
+ * through it.
+ *
+ * Every frame is prefixed with a fixed size header in the layout of
+ * LINKTYPE_IEEE802_15_4_TAP (283). The interface type is
+ * ARPHRD_IEEE802154_TAP, capture tools have to map it to that link type;
+ * ARPHRD 805 already stands for bare frames without FCS there.
+ *
+ *   version (0), reserved, header length          4 octets
+ *   TLV 0, FCS type: 1 for 16 bit, 0 without     8 octets
+ *   TLV 3, channel (16 bit) and page              8 octets
+ *   TLV 5, start of frame, ns since the epoch    12 octets
+ *   TLV 10, LQI                                   8 octets
+ *
+ * All fields are little endian. The FCS is left on the frame when the
+ * radio hands it over, so a corrupted frame is recognised by it. The
+ * timestamp is the hardware one when the driver provides it, otherwise
+ * the time the driver handed the frame over.
+ *
+ * AF_PACKET sockets bound to the interface may use PACKET_RX_RING, so
+ * captured frames need neither a per-frame system call nor a copy.
+ */
+
+#include <linux/kernel.h>
+#include <linux/netdevice.h>
+#include <linux/if_arp.h>
+#include <linux/rculist.h>
+#include <linux/rtnetlink.h>
+#include <net/netlink.h>
+#include <linux/nl802154.h>
+
+#include <net/af_ieee802154.h>
+#include <net/mac802154.h>
+#include <net/ieee802154_netdev.h>
+#include <net/wpan-phy.h>
+
+#include "mac802154.h"
+
+enum {
+	IEEE802154_TAP_FCS_TYPE		= 0,
+	IEEE802154_TAP_CHANNEL		= 3,
+	IEEE802154_TAP_SOF_TS		= 5,
+	IEEE802154_TAP_LQI		= 10,
+};
+
+struct ieee802154_tap_hdr {
+	u8	version;
+	u8	reserved;
+	__le16	length;
+
+	__le16	fcs_tlv;
+	__le16	fcs_len;
+	u8	fcs_type;
+	u8	fcs_pad[3];
+
+	__le16	chan_tlv;
+	__le16	chan_len;
+	__le16	channel;
+	u8	page;
+	u8	chan_pad;
+
+	__le16	sof_tlv;
+	__le16	sof_len;
+	__le64	sof_ns;
+
+	__le16	lqi_tlv;
+	__le16	lqi_len;
+	u8	lqi;
+	u8	lqi_pad[3];
+} __attribute__((packed));
+
+struct ieee802154_mon_data {
+	struct list_head	list; /* the ieee802154_priv->monitors list */
+
+	struct ieee802154_priv	*hw;
+	struct net_device	*dev;
+};
+
+static void ieee802154_monitor_fill(struct ieee802154_priv *priv,
+		struct sk_buff *skb, struct ieee802154_tap_hdr *hdr)
+{
+	ktime_t ts;
+
+	ts = skb_hwtstamps(skb)->hwtstamp;
+	if (!ts.tv64)
+		ts = skb->tstamp;
+
+	memset(hdr, 0, sizeof(*hdr));
+	hdr->length = cpu_to_le16(sizeof(*hdr));
+
+	hdr->fcs_tlv = cpu_to_le16(IEEE802154_TAP_FCS_TYPE);
+	hdr->fcs_len = cpu_to_le16(1);
+	hdr->fcs_type = priv->hw.flags & IEEE802154_HW_OMIT_CKSUM ? 0 : 1;
+
+	hdr->chan_tlv = cpu_to_le16(IEEE802154_TAP_CHANNEL);
+	hdr->chan_len = cpu_to_le16(3);
+	hdr->channel = cpu_to_le16(priv->phy->current_channel);
+	hdr->page = priv->phy->current_page;
+
+	hdr->sof_tlv = cpu_to_le16(IEEE802154_TAP_SOF_TS);
+	hdr->sof_len = cpu_to_le16(8);
+	hdr->sof_ns = cpu_to_le64(ktime_to_ns(ts));
+
+	hdr->lqi_tlv = cpu_to_le16(IEEE802154_TAP_LQI);
+	hdr->lqi_len = cpu_to_le16(1);
+	hdr->lqi = mac_cb(skb)->lqi;
+}
+
+void ieee802154_monitors_rx(struct ieee802154_priv *priv, struct sk_buff *skb)
+{
+	struct ieee802154_mon_data *mdata;
+	struct ieee802154_tap_hdr hdr;
+	struct sk_buff *skb2;
+	bool filled = false;
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(mdata, &priv->monitors, list) {
+		if (!netif_running(mdata->dev))
+			continue;
+
+		/* Only build the header when somebody listens */
+		if (!filled) {
+			ieee802154_monitor_fill(priv, skb, &hdr);
+			filled = true;
+		}
+
+		skb2 = skb_copy_expand(skb, sizeof(hdr), 0, GFP_ATOMIC);
+		if (!skb2) {
+			mdata->dev->stats.rx_dropped++;
+			continue;
+		}
+		ieee802154_count_alloc(priv);
+
+		memcpy(skb_push(skb2, sizeof(hdr)), &hdr, sizeof(hdr));
+		skb_reset_mac_header(skb2);
+		skb2->tstamp = ns_to_ktime(le64_to_cpu(hdr.sof_ns));
+		skb2->dev = mdata->dev;
+		skb2->pkt_type = PACKET_OTHERHOST;
+		skb2->protocol = htons(ETH_P_IEEE802154);
+
+		mdata->dev->stats.rx_packets++;
+		mdata->dev->stats.rx_bytes += skb->len;
+
+		if (in_interrupt())
+			netif_rx(skb2);
+		else
+			netif_rx_ni(skb2);
+	}
+	rcu_read_unlock();
+}
+
+static int ieee802154_monitor_open(struct net_device *dev)
+{
+	struct ieee802154_mon_data *mdata = netdev_priv(dev);
+	int res;
+
+	if (mdata->hw->open_count++ == 0) {
+		res = mdata->hw->ops->start(&mdata->hw->hw);
+		WARN_ON(res);
+		if (res) {
+			mdata->hw->open_count--;
+			return res;
+		}
+	}
+
+	ieee802154_update_promisc(mdata->hw);
+
+	return 0;
+}
+
+static int ieee802154_monitor_close(struct net_device *dev)
+{
+	struct ieee802154_mon_data *mdata = netdev_priv(dev);
+
+	if (--mdata->hw->open_count == 0) {
+		mutex_lock(&mdata->hw->phy->pib_lock);
+		ieee802154_tx_quiesce(mdata->hw);
+		mutex_unlock(&mdata->hw->phy->pib_lock);
+
+		mdata->hw->ops->stop(&mdata->hw->hw);
+	}
+
+	ieee802154_update_promisc(mdata->hw);
+
+	return 0;
+}
+
+static netdev_tx_t ieee802154_monitor_xmit(struct sk_buff *skb,
+		struct net_device *dev)
+{
+	dev->stats.tx_dropped++;
+	kfree_skb(skb);
+
+	return NETDEV_TX_OK;
+}
+
+static struct wpan_phy *ieee802154_monitor_get_phy(const struct net_device *dev)
+{
+	struct ieee802154_mon_data *mdata = netdev_priv(dev);
+
+	return to_phy(get_device(&mdata->hw->phy->dev));
+}
+
+static struct ieee802154_mlme_ops mac802154_monitor_mlme = {
+	.get_phy = ieee802154_monitor_get_phy,
+};
+
+static const struct net_device_ops ieee802154_monitor_ops = {
+	.ndo_open		= ieee802154_monitor_open,
+	.ndo_stop		= ieee802154_monitor_close,
+	.ndo_start_xmit		= ieee802154_monitor_xmit,
+};
+
+static void ieee802154_monitor_setup(struct net_device *dev)
+{
+	dev->addr_len		= 0;
+	dev->hard_header_len	= sizeof(struct ieee802154_tap_hdr);
+	dev->mtu		= 127;
+	dev->tx_queue_len	= 0;
+	dev->type		= ARPHRD_IEEE802154_TAP;
+	dev->flags		= IFF_NOARP;
+	dev->watchdog_timeo	= 0;
+
+	dev->destructor		= free_netdev;
+	dev->netdev_ops		= &ieee802154_monitor_ops;
+	dev->ml_priv		= &mac802154_monitor_mlme;
+}
+
+struct net_device *ieee802154_add_monitor(struct wpan_phy *phy,
+		const char *name)
+{
+	struct ieee802154_priv *ipriv = wpan_phy_priv(phy);
+	struct ieee802154_mon_data *mdata;
+	struct net_device *dev;
+	int err = -ENOMEM;
+
+	BUILD_BUG_ON(sizeof(struct ieee802154_tap_hdr) != 40);
+
+	dev = alloc_netdev(sizeof(struct ieee802154_mon_data),
+			name, ieee802154_monitor_setup);
+	if (!dev)
+		goto err;
+
+	mdata = netdev_priv(dev);
+	mdata->dev = dev;
+	mdata->hw = ipriv;
+
+	SET_NETDEV_DEV(dev, &ipriv->phy->dev);
+
+	err = register_netdev(dev);
+	if (err < 0)
+		goto err_free;
+
+	rtnl_lock();
+	mutex_lock(&ipriv->slaves_mtx);
+	list_add_tail_rcu(&mdata->list, &ipriv->monitors);
+	mutex_unlock(&ipriv->slaves_mtx);
+	rtnl_unlock();
+
+	dev_hold(dev); /* we return a device w/ incremented refcount */
+	return dev;
+
+err_free:
+	free_netdev(dev);
+err:
+	return ERR_PTR(err);
+}
+
+void ieee802154_del_monitor(struct wpan_phy *phy, struct net_device *dev)
+{
+	struct ieee802154_mon_data *mdata = netdev_priv(dev);
+
+	ASSERT_RTNL();
+
+	BUG_ON(mdata->hw->phy != phy);
+
+	mutex_lock(&mdata->hw->slaves_mtx);
+	list_del_rcu(&mdata->list);
+	mutex_unlock(&mdata->hw->slaves_mtx);
+
+	synchronize_rcu();
+	unregister_netdevice(dev);
+}
+
+/*
+ * This is for hw unregistration only, as it doesn't do RCU locking
+ */
+void ieee802154_drop_monitors(struct ieee802154_priv *priv)
+{
+	struct ieee802154_mon_data *mdata, *next;
+
+	ASSERT_RTNL();
+
+	list_for_each_entry_safe(mdata, next, &priv->monitors, list) {
+		mutex_lock(&priv->slaves_mtx);
+		list_del(&mdata->list);
+		mutex_unlock(&priv->slaves_mtx);
+
+		unregister_netdevice(mdata->dev);
+	}
+}
+
+int ieee802154_monitors_running(struct ieee802154_priv *priv)
+{
+	struct ieee802154_mon_data *mdata;
+	int running = 0;
+
+	list_for_each_entry(mdata, &priv->monitors, list)
+		if (netif_running(mdata->dev))
+			running++;
+
+	return running;
+}
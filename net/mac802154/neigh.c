@@ -0,0 +1,566 @@
+/*
+ * Neighbour table with link quality estimation
+ *
+ * Copyright 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Written by:
+ * agent <agent@local>
+ */
+
+/*
+ * Every device we hear a frame from, or send an acknowledged frame to,
+ * gets an entry here. Received frames update the LQI average and the
+ * last sequence number, acknowledged transmissions the ACK ratio, from
+ * which the expected transmission count (ETX) is derived.
+ *
+ * Both averages are exponentially weighted with a weight of 1/8 and are
+ * kept in fixed point, scaled by 1 << NEIGH_SCALE. A device is known by
+ * its extended address, its short address or both: association links
+ * the two (see ieee802154_neigh_set_short()).
+ *
+ * Lookups from the RX and TX completion paths are done under RCU, the
+ * table lock serialises insertion and removal. Entries not heard from
+ * for NEIGH_TIMEOUT are dropped by a periodic timer, the least recently
+ * seen one is dropped when the table is full. Userland is notified of
+ * both new and lost neighbours, not of every update.
+ */
+
+#include <linux/kernel.h>
+#include <linux/slab.h>
+#include <linux/jhash.h>
+#include <linux/rculist.h>
+#include <linux/if_arp.h>
+#include <linux/netdevice.h>
+#include <linux/skbuff.h>
+#include <net/netlink.h>
+#include <linux/nl802154.h>
+
+#include <net/af_ieee802154.h>
+#include <net/mac802154.h>
+#include <net/ieee802154.h>
+#include <net/ieee802154_netdev.h>
+#include <net/nl802154.h>
+
+#include "mac802154.h"
+
+#define NEIGH_MAX		64
+#define NEIGH_TIMEOUT		(300 * HZ)
+#define NEIGH_GC_INTERVAL	(30 * HZ)
+
+#define NEIGH_SCALE		12
+#define NEIGH_EWMA_SHIFT	3
+
+struct ieee802154_neigh {
+	struct hlist_node	long_node;
+	struct hlist_node	short_node;
+	struct list_head	list; /* on the ieee802154_neigh_table->all */
+	struct rcu_head		rcu;
+
+	/* Protects everything below */
+	spinlock_t		lock;
+
+	u8			hwaddr[IEEE802154_ADDR_LEN];
+	bool			has_long;
+	u16			pan_id;
+	u16			short_addr;
+
+	unsigned long		last_seen;
+	u32			lqi;	/* scaled */
+	u32			ack;	/* scaled */
+	u8			seq;
+
+	u32			rx_frames;
+	u32			tx_acked;
+	u32			tx_failed;
+};
+
+static inline unsigned int neigh_hash_long(const u8 *hwaddr)
+{
+	return jhash(hwaddr, IEEE802154_ADDR_LEN, 0) &
+		(IEEE802154_NEIGH_HTABLE_SIZE - 1);
+}
+
+static inline unsigned int neigh_hash_short(u16 pan_id, u16 short_addr)
+{
+	return jhash_2words(pan_id, short_addr, 0) &
+		(IEEE802154_NEIGH_HTABLE_SIZE - 1);
+}
+
+static inline bool neigh_short_valid(u16 short_addr)
+{
+	return short_addr != IEEE802154_ADDR_BROADCAST &&
+		short_addr != IEEE802154_ADDR_UNDEF;
+}
+
+static inline u32 neigh_ewma(u32 avg, u32 sample)
+{
+	return avg - (avg >> NEIGH_EWMA_SHIFT) +
+		((sample << NEIGH_SCALE) >> NEIGH_EWMA_SHIFT);
+}
+
+/* Must be called under rcu_read_lock or with tbl->lock held */
+static struct ieee802154_neigh *neigh_find_long(
+		struct ieee802154_neigh_table *tbl, const u8 *hwaddr)
+{
+	struct ieee802154_neigh *n;
+	struct hlist_node *node;
+
+	hlist_for_each_entry_rcu(n, node,
+			&tbl->by_long[neigh_hash_long(hwaddr)], long_node)
+		if (!memcmp(n->hwaddr, hwaddr, IEEE802154_ADDR_LEN))
+			return n;
+
+	return NULL;
+}
+
+/* Must be called under rcu_read_lock or with tbl->lock held */
+static struct ieee802154_neigh *neigh_find_short(
+		struct ieee802154_neigh_table *tbl, u16 pan_id, u16 short_addr)
+{
+	struct ieee802154_neigh *n;
+	struct hlist_node *node;
+
+	hlist_for_each_entry_rcu(n, node,
+			&tbl->by_short[neigh_hash_short(pan_id, short_addr)],
+			short_node)
+		if (n->short_addr == short_addr && n->pan_id == pan_id)
+			return n;
+
+	return NULL;
+}
+
+static struct ieee802154_neigh *neigh_find(struct ieee802154_neigh_table *tbl,
+		struct ieee802154_addr *addr)
+{
+	switch (addr->addr_type) {
+	case IEEE802154_ADDR_LONG:
+		return neigh_find_long(tbl, addr->hwaddr);
+	case IEEE802154_ADDR_SHORT:
+		return neigh_find_short(tbl, addr->pan_id, addr->short_addr);
+	default:
+		return NULL;
+	}
+}
+
+/* Must be called with n->lock held */
+static void neigh_fill_info(struct ieee802154_neigh *n,
+		struct ieee802154_neigh_info *info)
+{
+	u32 tx = n->tx_acked + n->tx_failed;
+	u32 etx;
+
+	memset(info, 0, sizeof(*info));
+
+	info->pan_id = n->pan_id;
+	info->short_addr = n->short_addr;
+	info->has_hwaddr = n->has_long;
+	if (n->has_long)
+		memcpy(info->hwaddr, n->hwaddr, IEEE802154_ADDR_LEN);
+
+	info->lqi = n->lqi >> NEIGH_SCALE;
+	info->seq = n->seq;
+	info->age = jiffies_to_msecs(jiffies - n->last_seen);
+
+	/* ETX is the inverse of the ACK ratio, in 1/16 transmissions */
+	if (tx) {
+		etx = n->ack ? (16 << NEIGH_SCALE) / n->ack : 0xffff;
+		info->etx = min_t(u32, etx, 0xffff);
+	}
+
+	info->rx_frames = n->rx_frames;
+	info->tx_acked = n->tx_acked;
+	info->tx_failed = n->tx_failed;
+}
+
+static void neigh_notify(struct ieee802154_sub_if_data *priv,
+		struct ieee802154_neigh *n, u8 cmd)
+{
+	struct ieee802154_neigh_info info;
+	unsigned long flags;
+
+	spin_lock_irqsave(&n->lock, flags);
+	neigh_fill_info(n, &info);
+	spin_unlock_irqrestore(&n->lock, flags);
+
+	ieee802154_nl_neigh_indic(priv->dev, &info, cmd);
+}
+
+static void neigh_free_rcu(struct rcu_head *head)
+{
+	kfree(container_of(head, struct ieee802154_neigh, rcu));
+}
+
+/* Must be called with tbl->lock held */
+static void neigh_unlink(struct ieee802154_sub_if_data *priv,
+		struct ieee802154_neigh *n)
+{
+	struct ieee802154_neigh_table *tbl = &priv->neigh;
+
+	if (n->has_long)
+		hlist_del_rcu(&n->long_node);
+	if (neigh_short_valid(n->short_addr))
+		hlist_del_rcu(&n->short_node);
+	list_del_rcu(&n->list);
+	tbl->count--;
+
+	neigh_notify(priv, n, IEEE802154_NEIGH_DEL_INDIC);
+
+	call_rcu(&n->rcu, neigh_free_rcu);
+}
+
+/*
+ * Must be called with tbl->lock held. Readers racing with the move may
+ * miss the entry, which only costs them one update.
+ */
+static void neigh_rehash_short(struct ieee802154_neigh_table *tbl,
+		struct ieee802154_neigh *n, u16 pan_id, u16 short_addr)
+{
+	if (neigh_short_valid(n->short_addr))
+		hlist_del_rcu(&n->short_node);
+
+	n->pan_id = pan_id;
+	n->short_addr = short_addr;
+
+	if (neigh_short_valid(short_addr))
+		hlist_add_head_rcu(&n->short_node,
+			&tbl->by_short[neigh_hash_short(pan_id, short_addr)]);
+}
+
+/* Must be called with tbl->lock held */
+static struct ieee802154_neigh *neigh_create(
+		struct ieee802154_sub_if_data *priv,
+		struct ieee802154_addr *addr)
+{
+	struct ieee802154_neigh_table *tbl = &priv->neigh;
+	struct ieee802154_neigh *n, *old;
+
+	if (tbl->count >= NEIGH_MAX) {
+		old = NULL;
+		list_for_each_entry(n, &tbl->all, list)
+			if (!old || time_before(n->last_seen, old->last_seen))
+				old = n;
+
+		pr_debug("%s: neighbour table full\n", priv->dev->name);
+		neigh_unlink(priv, old);
+	}
+
+	n = kzalloc(sizeof(*n), GFP_ATOMIC);
+	if (!n)
+		return NULL;
+
+	spin_lock_init(&n->lock);
+	n->last_seen = jiffies;
+	n->pan_id = addr->pan_id;
+	n->short_addr = IEEE802154_ADDR_UNDEF;
+
+	if (addr->addr_type == IEEE802154_ADDR_LONG) {
+		memcpy(n->hwaddr, addr->hwaddr, IEEE802154_ADDR_LEN);
+		n->has_long = true;
+		hlist_add_head_rcu(&n->long_node,
+				&tbl->by_long[neigh_hash_long(n->hwaddr)]);
+	} else
+		neigh_rehash_short(tbl, n, addr->pan_id, addr->short_addr);
+
+	list_add_tail_rcu(&n->list, &tbl->all);
+	tbl->count++;
+
+	if (!timer_pending(&tbl->timer))
+		mod_timer(&tbl->timer, jiffies + NEIGH_GC_INTERVAL);
+
+	return n;
+}
+
+/*
+ * Must be called under rcu_read_lock. Returns the entry for ADDR,
+ * creating one if needed; *created is set for a new entry, which the
+ * caller should announce once it has been filled in.
+ */
+static struct ieee802154_neigh *neigh_lookup(
+		struct ieee802154_sub_if_data *priv,
+		struct ieee802154_addr *addr, bool *created)
+{
+	struct ieee802154_neigh_table *tbl = &priv->neigh;
+	struct ieee802154_neigh *n;
+	unsigned long flags;
+
+	*created = false;
+
+	if (addr->addr_type != IEEE802154_ADDR_LONG &&
+	    !(addr->addr_type == IEEE802154_ADDR_SHORT &&
+	      neigh_short_valid(addr->short_addr)))
+		return NULL;
+
+	n = neigh_find(tbl, addr);
+	if (n)
+		return n;
+
+	spin_lock_irqsave(&tbl->lock, flags);
+	n = neigh_find(tbl, addr);
+	if (!n) {
+		n = neigh_create(priv, addr);
+		*created = n != NULL;
+	}
+	spin_unlock_irqrestore(&tbl->lock, flags);
+
+	return n;
+}
+
+void ieee802154_neigh_rx(struct ieee802154_sub_if_data *priv,
+		struct sk_buff *skb)
+{
+	struct ieee802154_neigh *n;
+	unsigned long flags;
+	bool created;
+
+	rcu_read_lock();
+
+	n = neigh_lookup(priv, &mac_cb(skb)->sa, &created);
+	if (!n)
+		goto out;
+
+	spin_lock_irqsave(&n->lock, flags);
+	n->last_seen = jiffies;
+	n->seq = mac_cb(skb)->seq;
+	if (!n->rx_frames)
+		n->lqi = mac_cb(skb)->lqi << NEIGH_SCALE;
+	else
+		n->lqi = neigh_ewma(n->lqi, mac_cb(skb)->lqi);
+	n->rx_frames++;
+	spin_unlock_irqrestore(&n->lock, flags);
+
+	if (created)
+		neigh_notify(priv, n, IEEE802154_NEIGH_NEW_INDIC);
+out:
+	rcu_read_unlock();
+}
+
+/* Destination of a frame as built by ieee802154_header_create() */
+static int neigh_parse_da(struct sk_buff *skb, struct ieee802154_addr *addr)
+{
+	u16 fc;
+	int i;
+
+	if (skb->len < 5)
+		return -EINVAL;
+
+	fc = skb->data[0] | (skb->data[1] << 8);
+	if (!(fc & IEEE802154_FC_ACK_REQ))
+		return -ENOENT;
+
+	addr->addr_type = IEEE802154_FC_DAMODE(fc);
+	addr->pan_id = skb->data[3] | (skb->data[4] << 8);
+
+	switch (addr->addr_type) {
+	case IEEE802154_ADDR_SHORT:
+		if (skb->len < 7)
+			return -EINVAL;
+		addr->short_addr = skb->data[5] | (skb->data[6] << 8);
+		return 0;
+	case IEEE802154_ADDR_LONG:
+		if (skb->len < 5 + IEEE802154_ADDR_LEN)
+			return -EINVAL;
+		/* Extended addresses are sent in little endian */
+		for (i = 0; i < IEEE802154_ADDR_LEN; i++)
+			addr->hwaddr[i] =
+				skb->data[5 + IEEE802154_ADDR_LEN - 1 - i];
+		return 0;
+	default:
+		return -EINVAL;
+	}
+}
+
+/*
+ * Called when the outcome of an acknowledged transmission is known,
+ * that is 0 for an ACK received and -ETIMEDOUT for none. May be called
+ * in interrupt context through ieee802154_xmit_complete().
+ */
+void ieee802154_neigh_tx(struct ieee802154_priv *hw, struct sk_buff *skb,
+		int result)
+{
+	struct ieee802154_sub_if_data *sdata;
+	struct ieee802154_neigh *n;
+	struct ieee802154_addr addr;
+	unsigned long flags;
+	bool created;
+
+	if (result && result != -ETIMEDOUT)
+		return;
+
+	if (neigh_parse_da(skb, &addr))
+		return;
+
+	rcu_read_lock();
+
+	list_for_each_entry_rcu(sdata, &hw->slaves, list) {
+		if (sdata->dev->ifindex != skb->skb_iif)
+			continue;
+
+		n = neigh_lookup(sdata, &addr, &created);
+		if (!n)
+			break;
+
+		spin_lock_irqsave(&n->lock, flags);
+		if (!n->tx_acked && !n->tx_failed)
+			n->ack = result ? 0 : 1 << NEIGH_SCALE;
+		else
+			n->ack = neigh_ewma(n->ack, !result);
+		if (result)
+			n->tx_failed++;
+		else {
+			n->tx_acked++;
+			n->last_seen = jiffies;
+		}
+		spin_unlock_irqrestore(&n->lock, flags);
+
+		if (created)
+			neigh_notify(sdata, n, IEEE802154_NEIGH_NEW_INDIC);
+		break;
+	}
+
+	rcu_read_unlock();
+}
+
+/*
+ * Link the short address assigned on association to the device's
+ * extended address. A separate entry the device may have got under
+ * that short address before is dropped.
+ */
+void ieee802154_neigh_set_short(struct ieee802154_sub_if_data *priv,
+		const u8 *hwaddr, u16 pan_id, u16 short_addr)
+{
+	struct ieee802154_neigh_table *tbl = &priv->neigh;
+	struct ieee802154_neigh *n, *old;
+	struct ieee802154_addr addr;
+	unsigned long flags;
+	bool created = false;
+
+	addr.addr_type = IEEE802154_ADDR_LONG;
+	addr.pan_id = pan_id;
+	memcpy(addr.hwaddr, hwaddr, IEEE802154_ADDR_LEN);
+
+	rcu_read_lock();
+	spin_lock_irqsave(&tbl->lock, flags);
+
+	if (neigh_short_valid(short_addr)) {
+		old = neigh_find_short(tbl, pan_id, short_addr);
+		if (old && !(old->has_long &&
+			     !memcmp(old->hwaddr, hwaddr, IEEE802154_ADDR_LEN)))
+			neigh_unlink(priv, old);
+	}
+
+	n = neigh_find_long(tbl, hwaddr);
+	if (!n) {
+		n = neigh_create(priv, &addr);
+		created = n != NULL;
+	}
+	if (n)
+		neigh_rehash_short(tbl, n, pan_id, short_addr);
+
+	spin_unlock_irqrestore(&tbl->lock, flags);
+
+	if (created)
+		neigh_notify(priv, n, IEEE802154_NEIGH_NEW_INDIC);
+	rcu_read_unlock();
+}
+
+static void ieee802154_neigh_gc(unsigned long data)
+{
+	struct ieee802154_sub_if_data *priv =
+		(struct ieee802154_sub_if_data *)data;
+	struct ieee802154_neigh_table *tbl = &priv->neigh;
+	struct ieee802154_neigh *n, *next;
+	unsigned long flags;
+
+	spin_lock_irqsave(&tbl->lock, flags);
+
+	list_for_each_entry_safe(n, next, &tbl->all, list)
+		if (time_after(jiffies, n->last_seen + NEIGH_TIMEOUT)) {
+			pr_debug("%s: neighbour expired\n", priv->dev->name);
+			neigh_unlink(priv, n);
+		}
+
+	if (tbl->count)
+		mod_timer(&tbl->timer, jiffies + NEIGH_GC_INTERVAL);
+
+	spin_unlock_irqrestore(&tbl->lock, flags);
+}
+
+void ieee802154_neigh_init(struct ieee802154_sub_if_data *priv)
+{
+	struct ieee802154_neigh_table *tbl = &priv->neigh;
+	int i;
+
+	spin_lock_init(&tbl->lock);
+
+	for (i = 0; i < IEEE802154_NEIGH_HTABLE_SIZE; i++) {
+		INIT_HLIST_HEAD(&tbl->by_long[i]);
+		INIT_HLIST_HEAD(&tbl->by_short[i]);
+	}
+	INIT_LIST_HEAD(&tbl->all);
+
+	setup_timer(&tbl->timer, ieee802154_neigh_gc, (unsigned long)priv);
+}
+
+void ieee802154_neigh_flush(struct ieee802154_sub_if_data *priv)
+{
+	struct ieee802154_neigh_table *tbl = &priv->neigh;
+	struct ieee802154_neigh *n, *next;
+	unsigned long flags;
+
+	del_timer_sync(&tbl->timer);
+
+	spin_lock_irqsave(&tbl->lock, flags);
+	list_for_each_entry_safe(n, next, &tbl->all, list)
+		neigh_unlink(priv, n);
+	spin_unlock_irqrestore(&tbl->lock, flags);
+}
+
+/*
+ * Calls FILL for every entry past the first SKIP ones, until it returns
+ * non-zero. Returns the number of entries passed, including skipped.
+ */
+int ieee802154_neigh_dump(struct net_device *dev, int skip,
+		int (*fill)(const struct ieee802154_neigh_info *info,
+			void *arg),
+		void *arg)
+{
+	struct ieee802154_sub_if_data *priv = netdev_priv(dev);
+	struct ieee802154_neigh_info info;
+	struct ieee802154_neigh *n;
+	unsigned long flags;
+	int idx = 0;
+
+	BUG_ON(dev->type != ARPHRD_IEEE802154);
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(n, &priv->neigh.all, list) {
+		if (idx < skip) {
+			idx++;
+			continue;
+		}
+
+		spin_lock_irqsave(&n->lock, flags);
+		neigh_fill_info(n, &info);
+		spin_unlock_irqrestore(&n->lock, flags);
+
+		if (fill(&info, arg))
+			break;
+		idx++;
+	}
+	rcu_read_unlock();
+
+	return idx;
+}
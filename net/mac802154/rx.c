@@ -28,6 +28,7 @@
 #include <net/af_ieee802154.h>
 #include <net/mac802154.h>
 #include <net/ieee802154_netdev.h>
+#include <trace/events/ieee802154.h>
 
 #include "mac802154.h"
 
@@ -36,11 +37,19 @@ static void __ieee802154_rx_prepare(struct ieee802154_dev *dev,
 {
 	BUG_ON(!skb);
 
+	trace_ieee802154_drv_rx(ieee802154_to_priv(dev)->phy, skb, lqi);
+
 	mac_cb(skb)->lqi = lqi;
 
+	/* Stamped here, the rest of the receive path may be queued */
+	if (!skb->tstamp.tv64)
+		__net_timestamp(skb);
+
 	skb->protocol = htons(ETH_P_IEEE802154);
 
 	skb_reset_mac_header(skb);
+
+	ieee802154_csma_rx(ieee802154_to_priv(dev), skb);
 }
 
 void ieee802154_rx(struct ieee802154_dev *dev, struct sk_buff *skb, u8 lqi)
@@ -74,6 +83,7 @@ void ieee802154_rx_irqsafe(struct ieee802154_dev *dev,
 
 	if (!work)
 		return;
+	ieee802154_count_alloc(priv);
 
 	__ieee802154_rx_prepare(dev, skb, lqi);
 
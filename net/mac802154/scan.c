@@ -33,6 +33,7 @@
 #include <net/ieee802154.h>
 #include <net/ieee802154_netdev.h>
 #include <net/wpan-phy.h>
+#include <trace/events/ieee802154.h>
 
 #include "mac802154.h"
 #include "beacon.h"
@@ -61,8 +62,11 @@ static int scan_ed(struct scan_work *work, int channel, u8 duration)
 	struct ieee802154_priv *hw = ieee802154_slave_get_priv(work->dev);
 	pr_debug("ed scan channel %d duration %d\n", channel, duration);
 	mutex_lock(&hw->phy->pib_lock);
+	ieee802154_tx_quiesce(hw);
 	ret = hw->ops->ed(&hw->hw, &work->edl[channel]);
 	mutex_unlock(&hw->phy->pib_lock);
+	if (!ret)
+		ieee802154_ed_record(hw, channel, work->edl[channel]);
 	pr_debug("ed scan channel %d value %d\n", channel, work->edl[channel]);
 	return ret;
 }
@@ -110,12 +114,15 @@ static void scanner(struct work_struct *work)
 			continue;
 
 		mutex_lock(&hw->phy->pib_lock);
-		ret = hw->ops->set_channel(&hw->hw,  i);
+		ieee802154_tx_quiesce(hw);
+		ret = ieee802154_set_channel(hw, sw->page, i);
 		mutex_unlock(&hw->phy->pib_lock);
 		if (ret)
 			goto exit_error;
 
 		ret = sw->scan_ch(sw, i, sw->duration);
+		trace_ieee802154_scan_channel(sw->dev, sw->type, sw->page, i,
+				sw->edl[i], ret);
 		if (ret)
 			goto exit_error;
 
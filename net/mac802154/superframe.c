@@ -0,0 +1,307 @@
+/*
+ * Beacon-enabled PAN support: periodic beacons and CAP gating
+ *
+ * Copyright 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Written by:
+ * agent <agent@local>
+ */
+
+/*
+ * With macBeaconOrder (BO) below 15 the coordinator sends a beacon every
+ * aBaseSuperframeDuration * 2^BO symbols. The following
+ * aBaseSuperframeDuration * 2^SO symbols form the active portion, the
+ * rest of the beacon interval is inactive and nothing may be sent.
+ *
+ * The hrtimer fires at the beacon time and, if SO < BO, at the end of
+ * the active portion. Beacon frames are built in a tasklet and handed
+ * directly to the transmit worker, so they do not queue behind data in
+ * the qdisc. The netdev queue is woken once the beacon is on its way and
+ * stopped when the CAP ends; a frame is only accepted if its air time
+ * fits into what is left of the CAP.
+ */
+
+#include <linux/kernel.h>
+#include <linux/netdevice.h>
+#include <linux/skbuff.h>
+#include <linux/if_arp.h>
+
+#include <net/af_ieee802154.h>
+#include <net/mac802154.h>
+#include <net/ieee802154.h>
+#include <net/ieee802154_netdev.h>
+
+#include "mac802154.h"
+#include "beacon.h"
+
+#define IEEE802154_BASE_SUPERFRAME_DURATION	960 /* symbols */
+/* Preamble, SFD and PHR, in octets */
+#define IEEE802154_PHY_SHR_PHR_LEN		6
+/* aTurnaroundTime plus an acknowledgement frame, in symbols */
+#define IEEE802154_SF_ACK_SYMBOLS		(12 + 2 * 11)
+
+static void ieee802154_sf_beacon(unsigned long data)
+{
+	struct ieee802154_sub_if_data *priv =
+		(struct ieee802154_sub_if_data *)data;
+	struct ieee802154_superframe *sf = &priv->sf;
+	struct net_device *dev = priv->dev;
+	struct ieee802154_addr saddr;
+	struct sk_buff *skb;
+	unsigned long flags;
+	s64 late;
+	int bflags = 0;
+
+	spin_lock_bh(&priv->mib_lock);
+	saddr.pan_id = priv->pan_id;
+	if (priv->short_addr == IEEE802154_ADDR_BROADCAST ||
+	    priv->short_addr == IEEE802154_ADDR_UNDEF) {
+		saddr.addr_type = IEEE802154_ADDR_LONG;
+		memcpy(saddr.hwaddr, dev->dev_addr, IEEE802154_ADDR_LEN);
+	} else {
+		saddr.addr_type = IEEE802154_ADDR_SHORT;
+		saddr.short_addr = priv->short_addr;
+	}
+	spin_unlock_bh(&priv->mib_lock);
+
+	if (dev->priv_flags & IFF_IEEE802154_COORD)
+		bflags |= IEEE802154_BEACON_FLAG_PANCOORD;
+
+	skb = ieee802154_beacon_build(dev, &saddr, NULL, 0, bflags);
+	if (IS_ERR(skb))
+		pr_debug("%s: failed to build beacon\n", dev->name);
+	else if (ieee802154_tx(priv, skb) != NETDEV_TX_OK)
+		kfree_skb(skb);
+
+	/* Only queued so far, the radio may still be busy */
+	spin_lock_irqsave(&sf->lock, flags);
+	late = ktime_to_ns(ktime_sub(ktime_get(), sf->beacon_time));
+	sf->beacons++;
+	sf->sched_latency_last = late;
+	sf->sched_latency_sum += late;
+	if (late > sf->sched_latency_max)
+		sf->sched_latency_max = late;
+	spin_unlock_irqrestore(&sf->lock, flags);
+
+	/* The CAP starts behind the beacon */
+	netif_wake_queue(dev);
+}
+
+static enum hrtimer_restart ieee802154_sf_timer(struct hrtimer *timer)
+{
+	struct ieee802154_superframe *sf =
+		container_of(timer, struct ieee802154_superframe, timer);
+	struct ieee802154_sub_if_data *priv =
+		container_of(sf, struct ieee802154_sub_if_data, sf);
+	ktime_t next;
+
+	spin_lock(&sf->lock);
+
+	if (sf->next_is_beacon) {
+		sf->beacon_time = hrtimer_get_expires(timer);
+		sf->cap_end = ktime_add_ns(sf->beacon_time, sf->sd_ns);
+		sf->in_cap = true;
+
+		tasklet_hi_schedule(&sf->beacon_tasklet);
+
+		if (sf->so < sf->bo) {
+			sf->next_is_beacon = false;
+			next = sf->cap_end;
+		} else
+			next = ktime_add_ns(sf->beacon_time, sf->interval_ns);
+	} else {
+		sf->in_cap = false;
+		netif_stop_queue(priv->dev);
+
+		sf->next_is_beacon = true;
+		next = ktime_add_ns(sf->beacon_time, sf->interval_ns);
+	}
+
+	hrtimer_set_expires(timer, next);
+
+	spin_unlock(&sf->lock);
+
+	return HRTIMER_RESTART;
+}
+
+void ieee802154_sf_init(struct ieee802154_sub_if_data *priv)
+{
+	struct ieee802154_superframe *sf = &priv->sf;
+
+	spin_lock_init(&sf->lock);
+	hrtimer_init(&sf->timer, CLOCK_MONOTONIC, HRTIMER_MODE_ABS);
+	sf->timer.function = ieee802154_sf_timer;
+	tasklet_init(&sf->beacon_tasklet, ieee802154_sf_beacon,
+			(unsigned long)priv);
+
+	sf->bo = 15;
+	sf->so = 15;
+}
+
+int ieee802154_sf_start(struct ieee802154_sub_if_data *priv, u8 bo, u8 so)
+{
+	struct ieee802154_superframe *sf = &priv->sf;
+	unsigned long flags;
+	u32 symbol_ns;
+
+	if (bo > 14 || so > bo)
+		return -EINVAL;
+
+	if (!netif_running(priv->dev))
+		return -ENETDOWN;
+
+	ieee802154_sf_stop(priv);
+
+	spin_lock_bh(&priv->mib_lock);
+	symbol_ns = ieee802154_symbol_ns(priv->page, priv->chan);
+	spin_unlock_bh(&priv->mib_lock);
+
+	spin_lock_irqsave(&sf->lock, flags);
+	sf->bo = bo;
+	sf->so = so;
+	sf->symbol_ns = symbol_ns;
+	sf->interval_ns = (u64)IEEE802154_BASE_SUPERFRAME_DURATION *
+		symbol_ns << bo;
+	sf->sd_ns = (u64)IEEE802154_BASE_SUPERFRAME_DURATION *
+		symbol_ns << so;
+	sf->next_is_beacon = true;
+	sf->in_cap = false;
+	sf->beacons = 0;
+	sf->sched_latency_last = 0;
+	sf->sched_latency_max = 0;
+	sf->sched_latency_sum = 0;
+	sf->active = true;
+	spin_unlock_irqrestore(&sf->lock, flags);
+
+	pr_debug("%s: beacon interval %llu ns, active %llu ns\n",
+			priv->dev->name, (unsigned long long)sf->interval_ns,
+			(unsigned long long)sf->sd_ns);
+
+	/* Nothing goes out before the first beacon */
+	netif_stop_queue(priv->dev);
+	hrtimer_start(&sf->timer, ktime_get(), HRTIMER_MODE_ABS);
+
+	return 0;
+}
+
+void ieee802154_sf_stop(struct ieee802154_sub_if_data *priv)
+{
+	struct ieee802154_superframe *sf = &priv->sf;
+	unsigned long flags;
+
+	if (!sf->active)
+		return;
+
+	hrtimer_cancel(&sf->timer);
+	tasklet_kill(&sf->beacon_tasklet);
+
+	spin_lock_irqsave(&sf->lock, flags);
+	sf->active = false;
+	sf->in_cap = false;
+	sf->bo = 15;
+	sf->so = 15;
+	spin_unlock_irqrestore(&sf->lock, flags);
+
+	if (netif_running(priv->dev))
+		netif_wake_queue(priv->dev);
+}
+
+/*
+ * Check if a frame of len octets (MHR and payload) can be sent and
+ * acknowledged before the CAP ends.
+ */
+bool ieee802154_sf_can_tx(struct ieee802154_sub_if_data *priv,
+		unsigned int len)
+{
+	struct ieee802154_superframe *sf = &priv->sf;
+	unsigned long flags;
+	bool ret = true;
+	s64 left;
+	u64 need;
+
+	if (!sf->active)
+		return true;
+
+	spin_lock_irqsave(&sf->lock, flags);
+	/* two symbols per octet */
+	need = (u64)((len + 2 + IEEE802154_PHY_SHR_PHR_LEN) * 2 +
+			IEEE802154_SF_ACK_SYMBOLS) * sf->symbol_ns;
+	if (!sf->in_cap)
+		ret = false;
+	else if (need < sf->sd_ns) {
+		/* Frames not fitting into any CAP are sent anyway */
+		left = ktime_to_ns(ktime_sub(sf->cap_end, ktime_get()));
+		if (left < 0 || need > left)
+			ret = false;
+	}
+	spin_unlock_irqrestore(&sf->lock, flags);
+
+	return ret;
+}
+
+#define SF_SHOW(name, format_string)					\
+static ssize_t name##_show(struct device *d,				\
+		struct device_attribute *attr, char *buf)		\
+{									\
+	struct ieee802154_sub_if_data *priv = netdev_priv(to_net_dev(d)); \
+	struct ieee802154_superframe *sf = &priv->sf;			\
+	unsigned long flags;						\
+	ssize_t ret;							\
+									\
+	spin_lock_irqsave(&sf->lock, flags);				\
+	ret = snprintf(buf, PAGE_SIZE, format_string "\n", sf->name);	\
+	spin_unlock_irqrestore(&sf->lock, flags);			\
+	return ret;							\
+}									\
+static DEVICE_ATTR(name, S_IRUGO, name##_show, NULL)
+
+SF_SHOW(bo, "%u");
+SF_SHOW(so, "%u");
+SF_SHOW(beacons, "%u");
+SF_SHOW(sched_latency_last, "%lld");
+SF_SHOW(sched_latency_max, "%lld");
+
+static ssize_t sched_latency_avg_show(struct device *d,
+		struct device_attribute *attr, char *buf)
+{
+	struct ieee802154_sub_if_data *priv = netdev_priv(to_net_dev(d));
+	struct ieee802154_superframe *sf = &priv->sf;
+	unsigned long flags;
+	s64 avg = 0;
+
+	spin_lock_irqsave(&sf->lock, flags);
+	if (sf->beacons)
+		avg = div_s64(sf->sched_latency_sum, sf->beacons);
+	spin_unlock_irqrestore(&sf->lock, flags);
+
+	return snprintf(buf, PAGE_SIZE, "%lld\n", avg);
+}
+static DEVICE_ATTR(sched_latency_avg, S_IRUGO, sched_latency_avg_show, NULL);
+
+static struct attribute *ieee802154_sf_attrs[] = {
+	&dev_attr_bo.attr,
+	&dev_attr_so.attr,
+	&dev_attr_beacons.attr,
+	&dev_attr_sched_latency_last.attr,
+	&dev_attr_sched_latency_max.attr,
+	&dev_attr_sched_latency_avg.attr,
+	NULL,
+};
+
+struct attribute_group ieee802154_sf_group = {
+	.name	= "superframe",
+	.attrs	= ieee802154_sf_attrs,
+};
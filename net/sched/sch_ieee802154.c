@@ -0,0 +1,305 @@
+/*
+ * net/sched/sch_ieee802154.c	IEEE 802.15.4 frame type priority queue.
+ *
+ *		This program is free software; you can redistribute it and/or
+ *		modify it under the terms of the GNU General Public License
+ *		version 2 as published by the Free Software Foundation.
+ *
+ * Authors:	agent <agent@local>
+ */
+
+#include <linux/module.h>
+#include <linux/types.h>
+#include <linux/kernel.h>
+#include <linux/errno.h>
+#include <linux/skbuff.h>
+#include <linux/jhash.h>
+#include <net/netlink.h>
+#include <net/pkt_sched.h>
+#include <net/af_ieee802154.h>
+#include <net/ieee802154.h>
+#include <net/ieee802154_netdev.h>
+
+/*
+ * Beacons and MAC commands have to go out within the superframe or
+ * macResponseWaitTime, so they are served strictly before any data.
+ * Data frames are spread by destination over WPAN_FLOWS queues served
+ * round robin, one frame at a time: all frames are 127 octets at most,
+ * so counting frames is fair enough.
+ *
+ * The frame type and destination are read from the MAC header when the
+ * device builds one (the SoftMAC interfaces), otherwise the type comes
+ * from mac_cb(skb) and frames are spread by socket. Once the limit is
+ * reached, a frame is dropped from the longest data queue.
+ */
+
+#define WPAN_FLOWS	16
+
+enum {
+	WPAN_BAND_BEACON,
+	WPAN_BAND_CMD,
+	WPAN_BAND_DATA,
+};
+
+struct wpan_sched_data {
+	struct sk_buff_head	beacons;
+	struct sk_buff_head	cmds;
+	struct sk_buff_head	flows[WPAN_FLOWS];
+	unsigned int		next_flow;
+
+	u32			limit;
+	u32			seed;
+};
+
+static int wpan_classify(struct sk_buff *skb, struct Qdisc *sch,
+		unsigned int *flow)
+{
+	struct wpan_sched_data *q = qdisc_priv(sch);
+	u16 fc;
+	int len;
+
+	if (qdisc_dev(sch)->header_ops && skb->len >= 3) {
+		fc = skb->data[0] | (skb->data[1] << 8);
+
+		/* Destination PAN id and address follow the DSN */
+		switch (IEEE802154_FC_DAMODE(fc)) {
+		case IEEE802154_ADDR_SHORT:
+			len = 2 + 2;
+			break;
+		case IEEE802154_ADDR_LONG:
+			len = 2 + IEEE802154_ADDR_LEN;
+			break;
+		default:
+			len = 0;
+			break;
+		}
+		if (skb->len < 3 + len)
+			len = 0;
+
+		*flow = jhash(skb->data + 3, len, q->seed);
+	} else {
+		fc = mac_cb_type(skb);
+		*flow = jhash_1word((u32)(unsigned long)skb->sk, q->seed);
+	}
+
+	*flow %= WPAN_FLOWS;
+
+	switch (IEEE802154_FC_TYPE(fc)) {
+	case IEEE802154_FC_TYPE_BEACON:
+		return WPAN_BAND_BEACON;
+	case IEEE802154_FC_TYPE_MAC_CMD:
+		return WPAN_BAND_CMD;
+	default:
+		return WPAN_BAND_DATA;
+	}
+}
+
+static unsigned int wpan_drop(struct Qdisc *sch)
+{
+	struct wpan_sched_data *q = qdisc_priv(sch);
+	struct sk_buff_head *list = NULL;
+	struct sk_buff *skb;
+	unsigned int len;
+	int i;
+
+	for (i = 0; i < WPAN_FLOWS; i++)
+		if (!list || skb_queue_len(&q->flows[i]) > skb_queue_len(list))
+			list = &q->flows[i];
+
+	/* Control frames are only dropped when there is nothing else */
+	if (!skb_queue_len(list))
+		list = skb_queue_len(&q->cmds) ? &q->cmds : &q->beacons;
+
+	skb = __skb_dequeue_tail(list);
+	if (!skb)
+		return 0;
+
+	len = qdisc_pkt_len(skb);
+	kfree_skb(skb);
+	sch->q.qlen--;
+	sch->qstats.drops++;
+	sch->qstats.backlog -= len;
+
+	return len;
+}
+
+static int wpan_enqueue(struct sk_buff *skb, struct Qdisc *sch)
+{
+	struct wpan_sched_data *q = qdisc_priv(sch);
+	struct sk_buff_head *list;
+	unsigned int flow;
+
+	switch (wpan_classify(skb, sch, &flow)) {
+	case WPAN_BAND_BEACON:
+		list = &q->beacons;
+		break;
+	case WPAN_BAND_CMD:
+		list = &q->cmds;
+		break;
+	default:
+		list = &q->flows[flow];
+		break;
+	}
+
+	sch->qstats.backlog += qdisc_pkt_len(skb);
+	__skb_queue_tail(list, skb);
+
+	if (++sch->q.qlen <= q->limit) {
+		sch->bstats.bytes += qdisc_pkt_len(skb);
+		sch->bstats.packets++;
+		return NET_XMIT_SUCCESS;
+	}
+
+	wpan_drop(sch);
+	return NET_XMIT_CN;
+}
+
+static struct sk_buff_head *wpan_next_list(struct Qdisc *sch,
+		unsigned int *flow)
+{
+	struct wpan_sched_data *q = qdisc_priv(sch);
+	unsigned int i, f;
+
+	*flow = q->next_flow;
+
+	if (!skb_queue_empty(&q->beacons))
+		return &q->beacons;
+	if (!skb_queue_empty(&q->cmds))
+		return &q->cmds;
+
+	for (i = 0; i < WPAN_FLOWS; i++) {
+		f = (q->next_flow + i) % WPAN_FLOWS;
+		if (!skb_queue_empty(&q->flows[f])) {
+			*flow = (f + 1) % WPAN_FLOWS;
+			return &q->flows[f];
+		}
+	}
+
+	return NULL;
+}
+
+static struct sk_buff *wpan_peek(struct Qdisc *sch)
+{
+	struct sk_buff_head *list;
+	unsigned int flow;
+
+	list = wpan_next_list(sch, &flow);
+
+	return list ? skb_peek(list) : NULL;
+}
+
+static struct sk_buff *wpan_dequeue(struct Qdisc *sch)
+{
+	struct wpan_sched_data *q = qdisc_priv(sch);
+	struct sk_buff_head *list;
+	struct sk_buff *skb;
+
+	list = wpan_next_list(sch, &q->next_flow);
+	if (!list)
+		return NULL;
+
+	skb = __skb_dequeue(list);
+	sch->q.qlen--;
+	sch->qstats.backlog -= qdisc_pkt_len(skb);
+
+	return skb;
+}
+
+static void wpan_reset(struct Qdisc *sch)
+{
+	struct wpan_sched_data *q = qdisc_priv(sch);
+	int i;
+
+	__skb_queue_purge(&q->beacons);
+	__skb_queue_purge(&q->cmds);
+	for (i = 0; i < WPAN_FLOWS; i++)
+		__skb_queue_purge(&q->flows[i]);
+
+	sch->q.qlen = 0;
+	sch->qstats.backlog = 0;
+}
+
+static int wpan_change(struct Qdisc *sch, struct nlattr *opt)
+{
+	struct wpan_sched_data *q = qdisc_priv(sch);
+	struct tc_ieee802154_qopt *ctl = nla_data(opt);
+	unsigned int qlen;
+
+	if (opt->nla_len < nla_attr_size(sizeof(*ctl)))
+		return -EINVAL;
+
+	sch_tree_lock(sch);
+	if (ctl->limit)
+		q->limit = ctl->limit;
+
+	qlen = sch->q.qlen;
+	while (sch->q.qlen > q->limit)
+		wpan_drop(sch);
+	qdisc_tree_decrease_qlen(sch, qlen - sch->q.qlen);
+	sch_tree_unlock(sch);
+
+	return 0;
+}
+
+static int wpan_init(struct Qdisc *sch, struct nlattr *opt)
+{
+	struct wpan_sched_data *q = qdisc_priv(sch);
+	int i;
+
+	skb_queue_head_init(&q->beacons);
+	skb_queue_head_init(&q->cmds);
+	for (i = 0; i < WPAN_FLOWS; i++)
+		skb_queue_head_init(&q->flows[i]);
+
+	q->next_flow = 0;
+	q->seed = net_random();
+	q->limit = qdisc_dev(sch)->tx_queue_len ? : 1;
+
+	if (opt)
+		return wpan_change(sch, opt);
+
+	return 0;
+}
+
+static int wpan_dump(struct Qdisc *sch, struct sk_buff *skb)
+{
+	struct wpan_sched_data *q = qdisc_priv(sch);
+	unsigned char *b = skb_tail_pointer(skb);
+	struct tc_ieee802154_qopt opt = {
+		.limit = q->limit,
+	};
+
+	NLA_PUT(skb, TCA_OPTIONS, sizeof(opt), &opt);
+
+	return skb->len;
+
+nla_put_failure:
+	nlmsg_trim(skb, b);
+	return -1;
+}
+
+static struct Qdisc_ops wpan_qdisc_ops __read_mostly = {
+	.id		=	"ieee802154",
+	.priv_size	=	sizeof(struct wpan_sched_data),
+	.enqueue	=	wpan_enqueue,
+	.dequeue	=	wpan_dequeue,
+	.peek		=	wpan_peek,
+	.drop		=	wpan_drop,
+	.init		=	wpan_init,
+	.reset		=	wpan_reset,
+	.change		=	wpan_change,
+	.dump		=	wpan_dump,
+	.owner		=	THIS_MODULE,
+};
+
+static int __init wpan_module_init(void)
+{
+	return register_qdisc(&wpan_qdisc_ops);
+}
+static void __exit wpan_module_exit(void)
+{
+	unregister_qdisc(&wpan_qdisc_ops);
+}
+module_init(wpan_module_init)
+module_exit(wpan_module_exit)
+MODULE_LICENSE("GPL");
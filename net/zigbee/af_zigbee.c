@@ -33,17 +33,10 @@
 #include <net/tcp_states.h>
 #include <net/route.h>
 
-#include <net/ieee80215/af_ieee80215.h>
 #include <net/zigbee/af_zigbee.h>
 #include <net/zigbee/nwk.h>
 
-#define DBG_DUMP(data, len) { \
-	int i; \
-	pr_debug("file %s: function: %s: data: len %d:\n", __FILE__, __func__, len); \
-	for (i = 0; i < len; i++) {\
-		pr_debug("%02x: %02x\n", i, (data)[i]); \
-	} \
-}
+#include "zigbee.h"
 
 static int zb_sock_release(struct socket *sock)
 {
@@ -83,31 +76,6 @@ static int zb_sock_connect(struct socket *sock, struct sockaddr *uaddr,
 	return sk->sk_prot->connect(sk, uaddr, addr_len);
 }
 
-#if 0
-static int zb_dev_ioctl(struct sock *sk, struct ifreq __user *arg, unsigned int cmd)
-{
-	struct ifreq ifr;
-	int ret = -EINVAL;
-	struct net_device *dev;
-
-	if (copy_from_user(&ifr, arg, sizeof(struct ifreq)))
-		return -EFAULT;
-
-	ifr.ifr_name[IFNAMSIZ-1] = 0;
-
-	dev_load(sock_net(sk), ifr.ifr_name);
-	dev = dev_get_by_name(sock_net(sk), ifr.ifr_name);
-	if (dev->type == ARPHRD_ZIGBEE || dev->type == ARPHRD_ZIGBEE_PHY)
-		ret = dev->do_ioctl(dev, &ifr, cmd);
-
-	if (!ret && copy_to_user(arg, &ifr, sizeof(struct ifreq)))
-		ret = -EFAULT;
-	dev_put(dev);
-
-	return ret;
-}
-#endif
-
 static int zb_sock_ioctl(struct socket *sock, unsigned int cmd, unsigned long arg)
 {
 	struct sock *sk = sock->sk;
@@ -117,11 +85,6 @@ static int zb_sock_ioctl(struct socket *sock, unsigned int cmd, unsigned long ar
 		return sock_get_timestamp(sk, (struct timeval __user *)arg);
 	case SIOCGSTAMPNS:
 		return sock_get_timestampns(sk, (struct timespec __user *)arg);
-#if 0
-	case SIOCGIFADDR:
-	case SIOCSIFADDR:
-		return zb_dev_ioctl(sk, (struct ifreq __user *)arg, cmd);
-#endif
 	default:
 		if (!sk->sk_prot->ioctl)
 			return -ENOIOCTLCMD;
@@ -159,22 +122,23 @@ static const struct proto_ops zb_dgram_ops = {
  * Create a socket. Initialise the socket, blank the addresses
  * set the state.
  */
-static int zb_create(struct net *net, struct socket *sock, int protocol)
+static int zb_create(struct net *net, struct socket *sock, int protocol,
+		int kern)
 {
 	struct sock *sk;
 	int rc;
 	struct proto *proto;
 	const struct proto_ops *ops;
 
-	// FIXME: init_net
-	if (net != &init_net)
+	if (!net_eq(net, &init_net))
 		return -EAFNOSUPPORT;
 
-	if (sock->type == SOCK_DGRAM) {
+	switch (sock->type) {
+	case SOCK_DGRAM:
 		proto = &zb_dgram_prot;
 		ops = &zb_dgram_ops;
-	}
-	else {
+		break;
+	default:
 		rc = -ESOCKTNOSUPPORT;
 		goto out;
 	}
@@ -188,18 +152,13 @@ static int zb_create(struct net *net, struct socket *sock, int protocol)
 	sock->ops = ops;
 
 	sock_init_data(sock, sk);
-	// FIXME: sk->sk_destruct
+	/* FIXME: sk->sk_destruct */
 	sk->sk_family = PF_ZIGBEE;
 
-#if 0
-	/* Checksums on by default */
-	// FIXME:
 	sock_set_flag(sk, SOCK_ZAPPED);
 
-	// FIXME:
 	if (sk->sk_prot->hash)
 		sk->sk_prot->hash(sk);
-#endif
 
 	if (sk->sk_prot->init) {
 		rc = sk->sk_prot->init(sk);
@@ -210,70 +169,42 @@ out:
 	return rc;
 }
 
-static struct net_proto_family zb_family_ops = {
+static const struct net_proto_family zb_family_ops = {
 	.family		= PF_ZIGBEE,
 	.create		= zb_create,
 	.owner		= THIS_MODULE,
 };
 
-/* 
- * Main ZigBEE NWK receive routine.
- */
-static int zb_rcv(struct sk_buff *skb, struct net_device *dev, struct packet_type *pt, struct net_device *orig_dev)
-{
-	struct nwkhdr *nwkh;
-	u32 len;
-	
-	DBG_DUMP(skb->data, skb->len);
-	pr_debug("got frame, type %d, dev %p\n", dev->type, dev);
-	// FIXME: init_net
-	if (!net_eq(dev_net(dev), &init_net))
-		goto drop;
-
-	zb_raw_deliver(dev, skb);
-
-	if (skb->pkt_type != PACKET_OTHERHOST)
-		return zb_dgram_deliver(dev, skb);
-
-drop:
-	kfree_skb(skb);
-	return NET_RX_DROP;
-}
-
-
-static struct packet_type zb_packet_type = {
-	.type = __constant_htons(ETH_P_ZIGBEE),
-	.func = zb_rcv,
-};
-
 static int __init af_zb_init(void)
 {
 	int rc = -EINVAL;
 
 	rc = proto_register(&zb_dgram_prot, 1);
 	if (rc)
-		goto err;
+		goto out;
 
 	/* Tell SOCKET that we are alive */
 	rc = sock_register(&zb_family_ops);
-
 	if (rc)
-		goto err;
+		goto err_sock;
 
-	dev_add_pack(&zb_packet_type);
+	rc = zb_nwk_init();
+	if (rc)
+		goto err_nwk;
 
-	rc = 0;
-	goto out;
+	return 0;
 
-err:
+err_nwk:
+	sock_unregister(PF_ZIGBEE);
+err_sock:
 	proto_unregister(&zb_dgram_prot);
 out:
 	return rc;
 }
 
-static void af_zb_remove(void)
+static void __exit af_zb_remove(void)
 {
-	dev_remove_pack(&zb_packet_type);
+	zb_nwk_exit();
 	sock_unregister(PF_ZIGBEE);
 	proto_unregister(&zb_dgram_prot);
 }
@@ -27,23 +27,32 @@
 #include <linux/if_arp.h>
 #include <linux/list.h>
 #include <net/sock.h>
-#include <net/ieee80215/netdev.h>
-#include <net/ieee80215/af_ieee80215.h>
-#include <net/ieee80215/mac_def.h>
+#include <net/af_ieee802154.h>
+#include <net/ieee802154.h>
+#include <net/ieee802154_netdev.h>
+#include <net/zigbee/af_zigbee.h>
 #include <net/zigbee/nwk.h>
 #include <asm/ioctls.h>
 
+#include "zigbee.h"
+
 static HLIST_HEAD(dgram_head);
 static DEFINE_RWLOCK(dgram_lock);
 
 struct dgram_sock {
 	struct sock sk;
 
-	int bound;
-	struct ieee80215_addr src_addr;
-	struct ieee80215_addr dst_addr;
+	u16 src_addr;
+	u16 dst_addr;
+
+	unsigned bound:1;
 };
 
+static inline struct dgram_sock *dgram_sk(const struct sock *sk)
+{
+	return container_of(sk, struct dgram_sock, sk);
+}
+
 static void dgram_hash(struct sock *sk)
 {
 	write_lock_bh(&dgram_lock);
@@ -62,11 +71,9 @@ static void dgram_unhash(struct sock *sk)
 
 static int dgram_init(struct sock *sk)
 {
-	struct dgram_sock *ro = container_of(sk, struct dgram_sock, sk);
+	struct dgram_sock *ro = dgram_sk(sk);
 
-	ro->dst_addr.addr_type = IEEE80215_ADDR_SHORT;
-//	ro->dst_addr.pan_id = 0xffff;
-	ro->dst_addr.short_addr = 0xffff;
+	ro->dst_addr = ZB_NWK_ADDR_BCAST_ALL;
 	return 0;
 }
 
@@ -77,46 +84,36 @@ static void dgram_close(struct sock *sk, long timeout)
 
 static int dgram_bind(struct sock *sk, struct sockaddr *uaddr, int len)
 {
-	struct sockaddr_ieee80215 *addr = (struct sockaddr_ieee80215 *)uaddr;
-	struct dgram_sock *ro = container_of(sk, struct dgram_sock, sk);
+	struct sockaddr_zb *addr = (struct sockaddr_zb *)uaddr;
+	struct dgram_sock *ro = dgram_sk(sk);
+	struct net_device *dev;
 	int err = 0;
 
-	if (ro->bound)
-		return -EINVAL;
-
 	if (len < sizeof(*addr))
 		return -EINVAL;
 
-	if ((addr->family != AF_ZIGBEE) ||
-		(addr->addr.addr_type != IEEE80215_ADDR_SHORT))
+	if (addr->family != AF_ZIGBEE || zb_nwk_addr_is_bcast(addr->addr))
 		return -EINVAL;
 
 	lock_sock(sk);
-	/*
-	* FIXME: should check here that address is not already in use
-	* Problem that this address is not independent - this is the
-	* address of the lower layer
-	*/
-#if 0
-	dev = ieee80215_get_dev(sock_net(sk), &addr->addr);
-	if (!dev) {
-		err = -ENODEV;
+
+	if (ro->bound) {
+		err = -EINVAL;
 		goto out;
 	}
 
-	if (dev->type != ARPHRD_IEEE80215) {
-		err = -ENODEV;
-		goto out_put;
+	/* the NWK address is the MAC short address of a NWK enabled device */
+	dev = zb_nwk_get_dev(sock_net(sk), addr->addr);
+	if (!dev) {
+		err = -EADDRNOTAVAIL;
+		goto out;
 	}
-#endif
-	memcpy(&ro->src_addr, &addr->addr, sizeof(struct ieee80215_addr));
+	dev_put(dev);
 
+	ro->src_addr = addr->addr;
 	ro->bound = 1;
-#if 0
-out_put:
-	dev_put(dev);
+
 out:
-#endif
 	release_sock(sk);
 
 	return err;
@@ -127,7 +124,8 @@ static int dgram_ioctl(struct sock *sk, int cmd, unsigned long arg)
 	switch (cmd) {
 	case SIOCOUTQ:
 	{
-		int amount = atomic_read(&sk->sk_wmem_alloc);
+		int amount = sk_wmem_alloc_get(sk);
+
 		return put_user(amount, (int __user *)arg);
 	}
 
@@ -144,164 +142,113 @@ static int dgram_ioctl(struct sock *sk, int cmd, unsigned long arg)
 			 * of this packet since that is all
 			 * that will be read.
 			 */
-			amount = skb->len - sizeof(struct nwkhdr);
+			amount = skb->len;
 		}
 		spin_unlock_bh(&sk->sk_receive_queue.lock);
 		return put_user(amount, (int __user *)arg);
-
 	}
-#if 0
-	/* May be implement here the commands */ 
-	case IEEE80215_SIOC_NETWORK_DISCOVERY:
-		return ioctl_network_discovery(sk, (struct ieee80215_user_data __user *) arg);
-		break;
-	case IEEE80215_SIOC_NETWORK_FORMATION:
-		return ioctl_network_formation(sk, (struct ieee80215_user_data __user *) arg);
-		break;
-	case IEEE80215_SIOC_PERMIT_JOINING:
-		return ioctl_permit_joining(sk, (struct ieee80215_user_data __user *) arg);
-		break;
-	case IEEE80215_SIOC_START_ROUTER:
-		return ioctl_start_router(sk, (struct ieee80215_user_data __user *) arg);
-		break;
-	case IEEE80215_SIOC_JOIN:
-		return ioctl_mac_join(sk, (struct ieee80215_user_data __user *) arg);
-		break;
-	case IEEE80215_SIOC_MAC_CMD:
-		return ioctl_mac_cmd(sk, (struct ieee80215_user_data __user *) arg);
-
-		break;
-#endif
+
 	default:
-	return -ENOIOCTLCMD;
+		return zb_nwk_ioctl(sock_net(sk), cmd, (void __user *)arg);
 	}
 }
 
-// FIXME: autobind
 static int dgram_connect(struct sock *sk, struct sockaddr *uaddr,
 			int len)
 {
-	struct sockaddr_ieee80215 *addr = (struct sockaddr_ieee80215 *)uaddr;
-	struct dgram_sock *ro = container_of(sk, struct dgram_sock, sk);
-
-	int err = 0;
+	struct sockaddr_zb *addr = (struct sockaddr_zb *)uaddr;
+	struct dgram_sock *ro = dgram_sk(sk);
 
 	if (len < sizeof(*addr))
 		return -EINVAL;
 
-	if ((addr->family != AF_ZIGBEE) ||
-		(addr->addr.addr_type != IEEE80215_ADDR_SHORT))
+	if (addr->family != AF_ZIGBEE)
 		return -EINVAL;
 
 	lock_sock(sk);
-
-	if (!ro->bound) {
-		err = -ENETUNREACH;
-		goto out;
-	}
-
-	memcpy(&ro->dst_addr, &addr->addr, sizeof(struct ieee80215_addr));
-
-out:
+	ro->dst_addr = addr->addr;
 	release_sock(sk);
-	return err;
+
+	return 0;
 }
 
 static int dgram_disconnect(struct sock *sk, int flags)
 {
-	struct dgram_sock *ro = container_of(sk, struct dgram_sock, sk);
+	struct dgram_sock *ro = dgram_sk(sk);
 
 	lock_sock(sk);
-
-	ro->dst_addr.addr_type = IEEE80215_ADDR_SHORT;
-//	ro->dst_addr.pan_id = 0xffff;
-	ro->dst_addr.short_addr = 0xffff;
-
+	ro->dst_addr = ZB_NWK_ADDR_BCAST_ALL;
 	release_sock(sk);
 
 	return 0;
 }
 
-static int dgram_sendmsg(struct kiocb *iocb, struct sock *sk, struct msghdr *msg,
-		       size_t size)
+static int dgram_sendmsg(struct kiocb *iocb, struct sock *sk,
+		struct msghdr *msg, size_t size)
 {
+	struct sockaddr_zb *daddr = (struct sockaddr_zb *)msg->msg_name;
+	struct dgram_sock *ro = dgram_sk(sk);
 	struct net_device *dev;
-	unsigned mtu;
 	struct sk_buff *skb;
-	struct dgram_sock *ro = container_of(sk, struct dgram_sock, sk);
-
-	int err;
-	struct ieee80215_priv *hw;
+	u16 dst;
+	int hlen, err;
 
 	if (msg->msg_flags & MSG_OOB) {
 		pr_debug("msg->msg_flags = 0x%x\n", msg->msg_flags);
 		return -EOPNOTSUPP;
 	}
 
-	if (!ro->bound)
-		dev = dev_getfirstbyhwtype(sock_net(sk), ARPHRD_IEEE80215);
-	else
-		dev = ieee80215_get_dev(sock_net(sk), &ro->src_addr);
+	if (daddr) {
+		if (msg->msg_namelen < sizeof(*daddr) ||
+		    daddr->family != AF_ZIGBEE)
+			return -EINVAL;
+		dst = daddr->addr;
+	} else
+		dst = ro->dst_addr;
 
+	dev = zb_nwk_get_dev(sock_net(sk),
+			ro->bound ? ro->src_addr : ZB_NWK_ADDR_BCAST_ALL);
 	if (!dev) {
 		pr_debug("no dev\n");
-		return -ENXIO;
-	}
-	hw = ieee80215_slave_get_hw(dev);
-	mtu = dev->mtu;
-	pr_debug("name = %s, mtu = %u\n", dev->name, mtu);
-
-	skb = sock_alloc_send_skb(sk, LL_ALLOCATED_SPACE(dev) + size, msg->msg_flags & MSG_DONTWAIT,
-				  &err);
-	if (!skb) {
-		dev_put(dev);
-		return err;
+		err = -ENXIO;
+		goto out;
 	}
-	skb_reserve(skb, LL_RESERVED_SPACE(dev));
-
-	skb_reset_network_header(skb);
 
-	MAC_CB(skb)->flags = IEEE80215_FC_TYPE_DATA | MAC_CB_FLAG_ACKREQ;
-	MAC_CB(skb)->seq = hw->dsn;
-	err = dev_hard_header(skb, dev, ETH_P_IEEE80215, &ro->dst_addr, ro->bound ? &ro->src_addr : NULL, size);
-	if (err < 0) {
-		kfree_skb(skb);
-		dev_put(dev);
-		return err;
+	hlen = LL_RESERVED_SPACE(dev) + sizeof(struct nwkhdr);
+	if (size + sizeof(struct nwkhdr) > dev->mtu - dev->hard_header_len) {
+		pr_debug("size = %Zu, mtu = %u\n", size, dev->mtu);
+		err = -EMSGSIZE;
+		goto out_dev;
 	}
 
-	skb_reset_mac_header(skb);
+	skb = sock_alloc_send_skb(sk, hlen + size + dev->needed_tailroom,
+			msg->msg_flags & MSG_DONTWAIT, &err);
+	if (!skb)
+		goto out_dev;
+
+	skb_reserve(skb, hlen);
 
 	err = memcpy_fromiovec(skb_put(skb, size), msg->msg_iov, size);
 	if (err < 0) {
 		kfree_skb(skb);
-		dev_put(dev);
-		return err;
-	}
-
-	if (size > mtu) {
-		pr_debug("size = %u, mtu = %u\n", size, mtu);
-		return -EINVAL;
+		goto out_dev;
 	}
 
-	skb->dev = dev;
-	skb->sk  = sk;
-	skb->protocol = htons(ETH_P_IEEE80215);
+	skb->sk = sk;
 
-	err = dev_queue_xmit(skb);
-	hw->dsn++;
+	err = zb_nwk_output(dev, skb, dst);
 
+out_dev:
 	dev_put(dev);
-
-	if (err)
-		return err;
-
-	return size;
+out:
+	return err ?: size;
 }
 
-static int dgram_recvmsg(struct kiocb *iocb, struct sock *sk, struct msghdr *msg,
-		       size_t len, int noblock, int flags, int *addr_len)
+static int dgram_recvmsg(struct kiocb *iocb, struct sock *sk,
+		struct msghdr *msg, size_t len, int noblock, int flags,
+		int *addr_len)
 {
+	struct sockaddr_zb *saddr = (struct sockaddr_zb *)msg->msg_name;
 	size_t copied = 0;
 	int err = -EOPNOTSUPP;
 	struct sk_buff *skb;
@@ -316,12 +263,17 @@ static int dgram_recvmsg(struct kiocb *iocb, struct sock *sk, struct msghdr *msg
 		copied = len;
 	}
 
-	// FIXME: skip headers if necessary ?!
 	err = skb_copy_datagram_iovec(skb, 0, msg->msg_iov, copied);
 	if (err)
 		goto done;
 
-	sock_recv_timestamp(msg, sk, skb);
+	sock_recv_ts_and_drops(msg, sk, skb);
+
+	if (saddr) {
+		saddr->family = AF_ZIGBEE;
+		saddr->addr = le16_to_cpu(nwk_hdr(skb)->saddr);
+		*addr_len = sizeof(*saddr);
+	}
 
 	if (flags & MSG_TRUNC)
 		copied = skb->len;
@@ -336,7 +288,6 @@ out:
 static int dgram_rcv_skb(struct sock *sk, struct sk_buff *skb)
 {
 	if (sock_queue_rcv_skb(sk, skb) < 0) {
-		atomic_inc(&sk->sk_drops);
 		kfree_skb(skb);
 		return NET_RX_DROP;
 	}
@@ -344,32 +295,36 @@ static int dgram_rcv_skb(struct sock *sk, struct sk_buff *skb)
 	return NET_RX_SUCCESS;
 }
 
-int ieee80215_dgram_deliver(struct net_device *dev, struct sk_buff *skb)
+/*
+ * Called by the NWK layer with skb->data at the NWK payload and the
+ * NWK header still reachable through skb_network_header().
+ */
+int zb_dgram_deliver(struct net_device *dev, struct sk_buff *skb)
 {
 	struct sock *sk, *prev = NULL;
-	struct hlist_node*node;
+	struct hlist_node *node;
 	int ret = NET_RX_SUCCESS;
+	u16 short_addr;
 
-	/* Data frame processing */
+	BUG_ON(dev->type != ARPHRD_IEEE802154);
+
+	short_addr = ieee802154_mlme_ops(dev)->get_short_addr(dev);
 
 	read_lock(&dgram_lock);
 	sk_for_each(sk, node, &dgram_head) {
-		struct dgram_sock *ro = container_of(sk, struct dgram_sock, sk);
-		if (!ro->bound ||
-		  (ro->src_addr.addr_type == IEEE80215_ADDR_LONG &&
-		     !memcmp(ro->src_addr.hwaddr, dev->dev_addr, IEEE80215_ADDR_LEN)) ||
-		  (ro->src_addr.addr_type == IEEE80215_ADDR_SHORT &&
-		     ieee80215_dev_get_pan_id(dev) == ro->src_addr.pan_id &&
-		     ieee80215_dev_get_short_addr(dev) == ro->src_addr.short_addr)) {
-			if (prev) {
-				struct sk_buff *clone;
-				clone = skb_clone(skb, GFP_ATOMIC);
-				if (clone)
-					dgram_rcv_skb(prev, clone);
-			}
-
-			prev = sk;
+		struct dgram_sock *ro = dgram_sk(sk);
+
+		if (ro->bound && ro->src_addr != short_addr)
+			continue;
+
+		if (prev) {
+			struct sk_buff *clone;
+			clone = skb_clone(skb, GFP_ATOMIC);
+			if (clone)
+				dgram_rcv_skb(prev, clone);
 		}
+
+		prev = sk;
 	}
 
 	if (prev)
@@ -383,7 +338,7 @@ int ieee80215_dgram_deliver(struct net_device *dev, struct sk_buff *skb)
 	return ret;
 }
 
-struct proto ieee80215_dgram_prot = {
+struct proto zb_dgram_prot = {
 	.name		= "ZigBEE",
 	.owner		= THIS_MODULE,
 	.obj_size	= sizeof(struct dgram_sock),
@@ -398,4 +353,3 @@ struct proto ieee80215_dgram_prot = {
 	.disconnect	= dgram_disconnect,
 	.ioctl		= dgram_ioctl,
 };
-
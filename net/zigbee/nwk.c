@@ -0,0 +1,930 @@
+/*
+ * ZigBee NWK layer: neighbor and routing tables, forwarding
+ *
+ * Copyright 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ *
+ * Written by:
+ * agent <agent@local>
+ */
+
+/*
+ * The NWK layer is started on an IEEE 802.15.4 interface once userspace
+ * has formed or joined a network (SIOCZBNWKSTART). From then on data
+ * frames received on that interface are parsed as NWK frames: frames
+ * for us go to AF_ZIGBEE sockets, frames for others are relayed by
+ * routers using, in that order, the neighbor table, the routing table
+ * and tree (Cskip) routing.
+ *
+ * Route discovery and NWK command frames stay in userspace; the daemon
+ * sees them on an AF_IEEE802154 raw socket and installs the resulting
+ * routes with SIOCZBADDRT. NWK security, multicast and source routing
+ * are not supported, such frames are dropped.
+ */
+
+#include <linux/capability.h>
+#include <linux/hash.h>
+#include <linux/if_arp.h>
+#include <linux/list.h>
+#include <linux/netdevice.h>
+#include <linux/random.h>
+#include <linux/rculist.h>
+#include <linux/rtnetlink.h>
+#include <linux/timer.h>
+#include <linux/uaccess.h>
+#include <net/sock.h>
+#include <net/af_ieee802154.h>
+#include <net/ieee802154.h>
+#include <net/ieee802154_netdev.h>
+#include <net/zigbee/af_zigbee.h>
+#include <net/zigbee/nwk.h>
+
+#include "zigbee.h"
+
+#define ZB_NWK_HASH_SHIFT	6
+#define ZB_NWK_HASH_SIZE	(1 << ZB_NWK_HASH_SHIFT)
+#define ZB_NWK_MAX_NEIGH	64
+#define ZB_NWK_MAX_ROUTES	128
+#define ZB_NWK_DEFAULT_RADIUS	10
+
+/* Broadcast transaction table, must be a power of two */
+#define ZB_NWK_BTT_SIZE		32
+#define ZB_NWK_BTT_VALID	(1 << 24)
+/* nwkNetworkBroadcastDeliveryTime */
+#define ZB_NWK_BTT_TIMEOUT	(9 * HZ)
+
+/* Neighbors we only heard from are forgotten after this */
+#define ZB_NWK_NEIGH_TIMEOUT	(300 * HZ)
+#define ZB_NWK_GC_INTERVAL	(30 * HZ)
+
+struct zb_neigh {
+	struct hlist_node	node;
+	struct rcu_head		rcu;
+	unsigned long		last_seen;
+	u16			addr;
+	u8			relationship;
+	u8			dev_type;
+	u8			lqi;
+	u8			is_static;
+};
+
+struct zb_route {
+	struct hlist_node	node;
+	struct rcu_head		rcu;
+	u16			dst;
+	u16			next_hop;
+};
+
+struct zb_nwk {
+	struct list_head	list;
+	struct rcu_head		rcu;
+	struct net_device	*dev;
+
+	/* protects the tables, the BTT and seq, readers use RCU */
+	spinlock_t		lock;
+	struct hlist_head	neigh[ZB_NWK_HASH_SIZE];
+	struct hlist_head	route[ZB_NWK_HASH_SIZE];
+	unsigned int		neigh_count;
+	unsigned int		route_count;
+
+	/* (src << 8 | seq) of recent broadcasts, oldest overwritten */
+	u32			btt_key[ZB_NWK_BTT_SIZE];
+	unsigned long		btt_stamp[ZB_NWK_BTT_SIZE];
+	unsigned int		btt_head;
+
+	struct timer_list	gc_timer;
+
+	u8			seq;
+	u8			router;
+	u8			radius;
+	u8			depth;
+	u8			max_depth;
+	u8			max_children;
+	u8			max_routers;
+	u16			parent;
+	u32			cskip;		/* Cskip(depth) */
+	u32			cskip_parent;	/* Cskip(depth - 1) */
+};
+
+/* Protected by RTNL for writers and by RCU for the data path */
+static LIST_HEAD(zb_nwk_list);
+
+static struct zb_nwk *zb_nwk_find(const struct net_device *dev)
+{
+	struct zb_nwk *nwk;
+
+	list_for_each_entry_rcu(nwk, &zb_nwk_list, list)
+		if (nwk->dev == dev)
+			return nwk;
+
+	return NULL;
+}
+
+static inline unsigned int zb_nwk_hash(u16 addr)
+{
+	return hash_long(addr, ZB_NWK_HASH_SHIFT);
+}
+
+static inline u16 zb_nwk_self(const struct zb_nwk *nwk)
+{
+	return ieee802154_mlme_ops(nwk->dev)->get_short_addr(nwk->dev);
+}
+
+/*
+ * Neighbor table
+ */
+static struct zb_neigh *__zb_nwk_neigh_find(struct zb_nwk *nwk, u16 addr)
+{
+	struct zb_neigh *n;
+	struct hlist_node *pos;
+
+	hlist_for_each_entry_rcu(n, pos, &nwk->neigh[zb_nwk_hash(addr)], node)
+		if (n->addr == addr)
+			return n;
+
+	return NULL;
+}
+
+static inline int zb_nwk_neigh_expired(const struct zb_neigh *n)
+{
+	return !n->is_static &&
+		time_after(jiffies, n->last_seen + ZB_NWK_NEIGH_TIMEOUT);
+}
+
+static struct zb_neigh *zb_nwk_neigh_lookup(struct zb_nwk *nwk, u16 addr)
+{
+	struct zb_neigh *n = __zb_nwk_neigh_find(nwk, addr);
+
+	if (n && zb_nwk_neigh_expired(n))
+		return NULL;
+
+	return n;
+}
+
+static void zb_nwk_neigh_free_rcu(struct rcu_head *head)
+{
+	kfree(container_of(head, struct zb_neigh, rcu));
+}
+
+/* called with nwk->lock held */
+static struct zb_neigh *zb_nwk_neigh_create(struct zb_nwk *nwk, u16 addr)
+{
+	struct zb_neigh *n;
+
+	if (nwk->neigh_count >= ZB_NWK_MAX_NEIGH)
+		return NULL;
+
+	n = kzalloc(sizeof(*n), GFP_ATOMIC);
+	if (!n)
+		return NULL;
+
+	n->addr = addr;
+	n->relationship = ZB_REL_NONE;
+	n->dev_type = ZB_DEV_ROUTER;
+	n->last_seen = jiffies;
+
+	hlist_add_head_rcu(&n->node, &nwk->neigh[zb_nwk_hash(addr)]);
+	nwk->neigh_count++;
+
+	return n;
+}
+
+/* called with nwk->lock held */
+static void zb_nwk_neigh_remove(struct zb_nwk *nwk, struct zb_neigh *n)
+{
+	hlist_del_rcu(&n->node);
+	nwk->neigh_count--;
+	call_rcu(&n->rcu, zb_nwk_neigh_free_rcu);
+}
+
+/* Refresh (or learn) the neighbor a frame was received from */
+static void zb_nwk_neigh_update(struct zb_nwk *nwk, u16 addr, u8 lqi)
+{
+	struct zb_neigh *n;
+
+	n = __zb_nwk_neigh_find(nwk, addr);
+	if (!n) {
+		spin_lock_bh(&nwk->lock);
+		n = __zb_nwk_neigh_find(nwk, addr);
+		if (!n)
+			n = zb_nwk_neigh_create(nwk, addr);
+		spin_unlock_bh(&nwk->lock);
+
+		if (!n)
+			return;
+	}
+
+	n->last_seen = jiffies;
+	n->lqi = lqi;
+}
+
+/*
+ * Routing table
+ */
+static struct zb_route *zb_nwk_route_lookup(struct zb_nwk *nwk, u16 dst)
+{
+	struct zb_route *rt;
+	struct hlist_node *pos;
+
+	hlist_for_each_entry_rcu(rt, pos, &nwk->route[zb_nwk_hash(dst)], node)
+		if (rt->dst == dst)
+			return rt;
+
+	return NULL;
+}
+
+static void zb_nwk_route_free_rcu(struct rcu_head *head)
+{
+	kfree(container_of(head, struct zb_route, rcu));
+}
+
+/* called with nwk->lock held */
+static void zb_nwk_route_remove(struct zb_nwk *nwk, struct zb_route *rt)
+{
+	hlist_del_rcu(&rt->node);
+	nwk->route_count--;
+	call_rcu(&rt->rcu, zb_nwk_route_free_rcu);
+}
+
+/*
+ * Tree routing, ZigBee-2007 section 3.6.1.6 and 3.6.3.3
+ */
+static u32 zb_nwk_cskip(const struct zb_nwk *nwk, int d)
+{
+	int cm = nwk->max_children, rm = nwk->max_routers;
+	int lm = nwk->max_depth;
+	long p = 1;
+	int i;
+
+	if (d < 0 || d >= lm)
+		return 0;
+
+	if (rm == 1)
+		return 1 + cm * (lm - d - 1);
+
+	for (i = 0; i < lm - d - 1; i++)
+		p *= rm;
+
+	return (1 + cm - rm - cm * p) / (1 - rm);
+}
+
+static int zb_nwk_tree_route(const struct zb_nwk *nwk, u16 self, u16 dst)
+{
+	u32 a = self, d = dst;
+
+	if (!nwk->max_depth)
+		return -1;
+
+	/* the coordinator is the root of the whole address space */
+	if (nwk->depth && !(d > a && d < a + nwk->cskip_parent))
+		return nwk->parent;
+
+	if (!nwk->cskip)
+		return -1;
+
+	/* end device children follow the router blocks */
+	if (d > a + nwk->max_routers * nwk->cskip)
+		return dst;
+
+	return a + 1 + ((d - (a + 1)) / nwk->cskip) * nwk->cskip;
+}
+
+/* Called under rcu_read_lock() */
+static int zb_nwk_next_hop(struct zb_nwk *nwk, u16 self, u16 dst)
+{
+	struct zb_route *rt;
+
+	if (zb_nwk_neigh_lookup(nwk, dst))
+		return dst;
+
+	rt = zb_nwk_route_lookup(nwk, dst);
+	if (rt)
+		return rt->next_hop;
+
+	return zb_nwk_tree_route(nwk, self, dst);
+}
+
+/*
+ * Broadcast transaction table. Returns 1 if (src, seq) was seen
+ * within nwkNetworkBroadcastDeliveryTime, records it otherwise.
+ */
+static int zb_nwk_btt_check(struct zb_nwk *nwk, u16 src, u8 seq)
+{
+	u32 key = ZB_NWK_BTT_VALID | (src << 8) | seq;
+	int i, seen = 0;
+
+	spin_lock_bh(&nwk->lock);
+
+	for (i = 0; i < ZB_NWK_BTT_SIZE; i++)
+		if (nwk->btt_key[i] == key &&
+		    time_before(jiffies,
+			    nwk->btt_stamp[i] + ZB_NWK_BTT_TIMEOUT)) {
+			seen = 1;
+			break;
+		}
+
+	if (!seen) {
+		nwk->btt_key[nwk->btt_head] = key;
+		nwk->btt_stamp[nwk->btt_head] = jiffies;
+		nwk->btt_head = (nwk->btt_head + 1) & (ZB_NWK_BTT_SIZE - 1);
+	}
+
+	spin_unlock_bh(&nwk->lock);
+
+	return seen;
+}
+
+static void zb_nwk_gc(unsigned long data)
+{
+	struct zb_nwk *nwk = (struct zb_nwk *)data;
+	struct zb_neigh *n;
+	struct hlist_node *pos, *tmp;
+	int i;
+
+	spin_lock_bh(&nwk->lock);
+	for (i = 0; i < ZB_NWK_HASH_SIZE; i++)
+		hlist_for_each_entry_safe(n, pos, tmp, &nwk->neigh[i], node)
+			if (zb_nwk_neigh_expired(n))
+				zb_nwk_neigh_remove(nwk, n);
+	spin_unlock_bh(&nwk->lock);
+
+	mod_timer(&nwk->gc_timer, jiffies + ZB_NWK_GC_INTERVAL);
+}
+
+/*
+ * Data path
+ */
+static int zb_nwk_xmit(struct net_device *dev, struct sk_buff *skb,
+		u16 next_hop)
+{
+	struct ieee802154_addr da;
+	int err;
+
+	da.addr_type = IEEE802154_ADDR_SHORT;
+	da.pan_id = ieee802154_mlme_ops(dev)->get_pan_id(dev);
+	da.short_addr = next_hop;
+
+	skb_reset_network_header(skb);
+
+	mac_cb(skb)->flags = IEEE802154_FC_TYPE_DATA;
+	if (next_hop != IEEE802154_ADDR_BROADCAST)
+		mac_cb(skb)->flags |= MAC_CB_FLAG_ACKREQ;
+	mac_cb(skb)->seq = ieee802154_mlme_ops(dev)->get_dsn(dev);
+
+	err = dev_hard_header(skb, dev, ETH_P_IEEE802154, &da, NULL, skb->len);
+	if (err < 0) {
+		kfree_skb(skb);
+		return err;
+	}
+
+	skb_reset_mac_header(skb);
+	skb->dev = dev;
+	skb->protocol = htons(ETH_P_IEEE802154);
+
+	return net_xmit_errno(dev_queue_xmit(skb));
+}
+
+static void zb_nwk_forward(struct zb_nwk *nwk, struct sk_buff *skb,
+		u16 next_hop)
+{
+	struct net_device *dev = nwk->dev;
+	struct sk_buff *fwd;
+	struct nwkhdr *nh;
+
+	fwd = skb_copy_expand(skb, LL_RESERVED_SPACE(dev),
+			dev->needed_tailroom, GFP_ATOMIC);
+	if (!fwd)
+		return;
+
+	nh = (struct nwkhdr *)fwd->data;
+	nh->radius--;
+
+	pr_debug("%s: relaying %04x -> %04x via %04x\n", dev->name,
+			le16_to_cpu(nh->saddr), le16_to_cpu(nh->daddr),
+			next_hop);
+
+	zb_nwk_xmit(dev, fwd, next_hop);
+}
+
+static int zb_nwk_local_deliver(struct net_device *dev, struct sk_buff *skb,
+		unsigned int hlen, u16 fc)
+{
+	if ((fc & ZB_NWK_FC_TYPE_MASK) != ZB_NWK_FC_TYPE_DATA) {
+		pr_debug("%s: NWK command frame, left to userspace\n",
+				dev->name);
+		kfree_skb(skb);
+		return NET_RX_DROP;
+	}
+
+	skb_pull(skb, hlen);
+	skb_reset_transport_header(skb);
+
+	return zb_dgram_deliver(dev, skb);
+}
+
+static int zb_nwk_rcv(struct sk_buff *skb, struct net_device *dev,
+		struct packet_type *pt, struct net_device *orig_dev)
+{
+	struct zb_nwk *nwk;
+	struct nwkhdr *nh;
+	unsigned int hlen;
+	u16 fc, daddr, saddr, self;
+	int next_hop;
+
+	if (dev->type != ARPHRD_IEEE802154 ||
+	    !net_eq(dev_net(dev), &init_net))
+		goto drop;
+
+	if (skb->pkt_type == PACKET_OTHERHOST)
+		goto drop;
+
+	nwk = zb_nwk_find(dev);
+	if (!nwk)
+		goto drop;
+
+	skb = skb_share_check(skb, GFP_ATOMIC);
+	if (!skb)
+		return NET_RX_DROP;
+
+	if (!pskb_may_pull(skb, sizeof(*nh)))
+		goto drop;
+
+	skb_reset_network_header(skb);
+	fc = le16_to_cpu(nwk_hdr(skb)->fc);
+
+	if ((fc & ZB_NWK_FC_VERSION_MASK) >> ZB_NWK_FC_VERSION_SHIFT !=
+			ZB_NWK_PROTOCOL_VERSION)
+		goto drop;
+
+	if (fc & (ZB_NWK_FC_MULTICAST | ZB_NWK_FC_SRC_ROUTE |
+				ZB_NWK_FC_SECURITY))
+		goto drop;
+
+	hlen = sizeof(*nh);
+	if (fc & ZB_NWK_FC_DST_IEEE)
+		hlen += IEEE802154_ADDR_LEN;
+	if (fc & ZB_NWK_FC_SRC_IEEE)
+		hlen += IEEE802154_ADDR_LEN;
+
+	if (!pskb_may_pull(skb, hlen))
+		goto drop;
+
+	nh = nwk_hdr(skb);
+	daddr = le16_to_cpu(nh->daddr);
+	saddr = le16_to_cpu(nh->saddr);
+	self = zb_nwk_self(nwk);
+
+	if (mac_cb(skb)->sa.addr_type == IEEE802154_ADDR_SHORT)
+		zb_nwk_neigh_update(nwk, mac_cb(skb)->sa.short_addr,
+				mac_cb(skb)->lqi);
+
+	/* our own broadcast relayed back to us */
+	if (saddr == self)
+		goto drop;
+
+	if (zb_nwk_addr_is_bcast(daddr)) {
+		if (zb_nwk_btt_check(nwk, saddr, nh->seqnum))
+			goto drop;
+
+		if (nwk->router && nh->radius > 1)
+			zb_nwk_forward(nwk, skb, IEEE802154_ADDR_BROADCAST);
+
+		if (daddr == ZB_NWK_ADDR_BCAST_ROUTERS && !nwk->router)
+			goto drop;
+
+		return zb_nwk_local_deliver(dev, skb, hlen, fc);
+	}
+
+	if (daddr == self)
+		return zb_nwk_local_deliver(dev, skb, hlen, fc);
+
+	if (!nwk->router || nh->radius <= 1)
+		goto drop;
+
+	next_hop = zb_nwk_next_hop(nwk, self, daddr);
+	if (next_hop < 0) {
+		pr_debug("%s: no route to %04x\n", dev->name, daddr);
+		goto drop;
+	}
+
+	zb_nwk_forward(nwk, skb, next_hop);
+	consume_skb(skb);
+	return NET_RX_SUCCESS;
+
+drop:
+	kfree_skb(skb);
+	return NET_RX_DROP;
+}
+
+/*
+ * Sends the payload at skb->data to @daddr. There has to be room for
+ * the NWK and MAC headers in front of it.
+ */
+int zb_nwk_output(struct net_device *dev, struct sk_buff *skb, u16 daddr)
+{
+	struct zb_nwk *nwk;
+	struct nwkhdr *nh;
+	int next_hop;
+	u16 self;
+
+	rcu_read_lock();
+
+	nwk = zb_nwk_find(dev);
+	if (!nwk) {
+		rcu_read_unlock();
+		kfree_skb(skb);
+		return -ENETDOWN;
+	}
+
+	self = zb_nwk_self(nwk);
+	if (daddr == self) {
+		rcu_read_unlock();
+		kfree_skb(skb);
+		return -EINVAL;
+	}
+
+	nh = (struct nwkhdr *)skb_push(skb, sizeof(*nh));
+	nh->fc = cpu_to_le16(ZB_NWK_FC_TYPE_DATA |
+			(ZB_NWK_PROTOCOL_VERSION << ZB_NWK_FC_VERSION_SHIFT));
+	nh->daddr = cpu_to_le16(daddr);
+	nh->saddr = cpu_to_le16(self);
+	nh->radius = nwk->radius;
+
+	spin_lock_bh(&nwk->lock);
+	nh->seqnum = nwk->seq++;
+	spin_unlock_bh(&nwk->lock);
+
+	if (zb_nwk_addr_is_bcast(daddr)) {
+		/* so that relayed copies are not delivered back to us */
+		zb_nwk_btt_check(nwk, self, nh->seqnum);
+		next_hop = IEEE802154_ADDR_BROADCAST;
+	} else
+		next_hop = zb_nwk_next_hop(nwk, self, daddr);
+
+	rcu_read_unlock();
+
+	if (next_hop < 0) {
+		kfree_skb(skb);
+		return -EHOSTUNREACH;
+	}
+
+	return zb_nwk_xmit(dev, skb, next_hop);
+}
+
+/*
+ * Returns a referenced NWK enabled device owning @addr, or the first
+ * one for ZB_NWK_ADDR_BCAST_ALL.
+ */
+struct net_device *zb_nwk_get_dev(struct net *net, u16 addr)
+{
+	struct net_device *dev = NULL;
+	struct zb_nwk *nwk;
+
+	rcu_read_lock();
+	list_for_each_entry_rcu(nwk, &zb_nwk_list, list) {
+		if (!net_eq(dev_net(nwk->dev), net))
+			continue;
+
+		if (addr == ZB_NWK_ADDR_BCAST_ALL ||
+		    zb_nwk_self(nwk) == addr) {
+			dev = nwk->dev;
+			dev_hold(dev);
+			break;
+		}
+	}
+	rcu_read_unlock();
+
+	return dev;
+}
+
+/*
+ * Instance management, all under RTNL
+ */
+static void zb_nwk_set_params(struct zb_nwk *nwk,
+		const struct zb_nwk_req *req)
+{
+	spin_lock_bh(&nwk->lock);
+
+	nwk->router = req->router;
+	nwk->depth = req->depth;
+	nwk->max_depth = req->max_depth;
+	nwk->max_children = req->max_children;
+	nwk->max_routers = req->max_routers;
+	nwk->parent = req->parent;
+
+	nwk->cskip = zb_nwk_cskip(nwk, nwk->depth);
+	nwk->cskip_parent = zb_nwk_cskip(nwk, nwk->depth - 1);
+
+	if (req->radius)
+		nwk->radius = req->radius;
+	else if (req->max_depth)
+		nwk->radius = 2 * req->max_depth;
+	else
+		nwk->radius = ZB_NWK_DEFAULT_RADIUS;
+
+	spin_unlock_bh(&nwk->lock);
+}
+
+static int zb_nwk_start(struct net_device *dev, const struct zb_nwk_req *req)
+{
+	struct zb_nwk *nwk;
+
+	ASSERT_RTNL();
+
+	nwk = zb_nwk_find(dev);
+	if (nwk) {
+		zb_nwk_set_params(nwk, req);
+		return 0;
+	}
+
+	nwk = kzalloc(sizeof(*nwk), GFP_KERNEL);
+	if (!nwk)
+		return -ENOMEM;
+
+	nwk->dev = dev;
+	spin_lock_init(&nwk->lock);
+	get_random_bytes(&nwk->seq, 1);
+	zb_nwk_set_params(nwk, req);
+
+	setup_timer(&nwk->gc_timer, zb_nwk_gc, (unsigned long)nwk);
+	mod_timer(&nwk->gc_timer, jiffies + ZB_NWK_GC_INTERVAL);
+
+	list_add_tail_rcu(&nwk->list, &zb_nwk_list);
+
+	dev_info(&dev->dev, "ZigBee NWK started, %s\n",
+			req->router ? "router" : "end device");
+
+	return 0;
+}
+
+static void zb_nwk_free_rcu(struct rcu_head *head)
+{
+	struct zb_nwk *nwk = container_of(head, struct zb_nwk, rcu);
+	struct hlist_node *pos, *tmp;
+	struct zb_neigh *n;
+	struct zb_route *rt;
+	int i;
+
+	for (i = 0; i < ZB_NWK_HASH_SIZE; i++) {
+		hlist_for_each_entry_safe(n, pos, tmp, &nwk->neigh[i], node)
+			kfree(n);
+		hlist_for_each_entry_safe(rt, pos, tmp, &nwk->route[i], node)
+			kfree(rt);
+	}
+
+	kfree(nwk);
+}
+
+static void zb_nwk_stop(struct zb_nwk *nwk)
+{
+	ASSERT_RTNL();
+
+	list_del_rcu(&nwk->list);
+	del_timer_sync(&nwk->gc_timer);
+
+	call_rcu(&nwk->rcu, zb_nwk_free_rcu);
+}
+
+static int zb_nwk_add_route(struct zb_nwk *nwk, const struct zb_route_req *req)
+{
+	struct zb_route *rt;
+	int err = 0;
+
+	if (zb_nwk_addr_is_bcast(req->dst) ||
+	    zb_nwk_addr_is_bcast(req->next_hop))
+		return -EINVAL;
+
+	spin_lock_bh(&nwk->lock);
+
+	rt = zb_nwk_route_lookup(nwk, req->dst);
+	if (rt) {
+		rt->next_hop = req->next_hop;
+		goto out;
+	}
+
+	if (nwk->route_count >= ZB_NWK_MAX_ROUTES) {
+		err = -ENOSPC;
+		goto out;
+	}
+
+	rt = kzalloc(sizeof(*rt), GFP_ATOMIC);
+	if (!rt) {
+		err = -ENOMEM;
+		goto out;
+	}
+
+	rt->dst = req->dst;
+	rt->next_hop = req->next_hop;
+	hlist_add_head_rcu(&rt->node, &nwk->route[zb_nwk_hash(rt->dst)]);
+	nwk->route_count++;
+
+out:
+	spin_unlock_bh(&nwk->lock);
+	return err;
+}
+
+static int zb_nwk_del_route(struct zb_nwk *nwk, const struct zb_route_req *req)
+{
+	struct zb_route *rt;
+	int err = -ENOENT;
+
+	spin_lock_bh(&nwk->lock);
+	rt = zb_nwk_route_lookup(nwk, req->dst);
+	if (rt) {
+		zb_nwk_route_remove(nwk, rt);
+		err = 0;
+	}
+	spin_unlock_bh(&nwk->lock);
+
+	return err;
+}
+
+static int zb_nwk_add_neigh(struct zb_nwk *nwk, const struct zb_neigh_req *req)
+{
+	struct zb_neigh *n;
+	int err = 0;
+
+	if (zb_nwk_addr_is_bcast(req->addr))
+		return -EINVAL;
+
+	spin_lock_bh(&nwk->lock);
+
+	n = __zb_nwk_neigh_find(nwk, req->addr);
+	if (!n)
+		n = zb_nwk_neigh_create(nwk, req->addr);
+	if (!n) {
+		err = -ENOSPC;
+		goto out;
+	}
+
+	n->relationship = req->relationship;
+	n->dev_type = req->dev_type;
+	n->is_static = 1;
+
+out:
+	spin_unlock_bh(&nwk->lock);
+	return err;
+}
+
+static int zb_nwk_del_neigh(struct zb_nwk *nwk, const struct zb_neigh_req *req)
+{
+	struct zb_neigh *n;
+	int err = -ENOENT;
+
+	spin_lock_bh(&nwk->lock);
+	n = __zb_nwk_neigh_find(nwk, req->addr);
+	if (n) {
+		zb_nwk_neigh_remove(nwk, n);
+		err = 0;
+	}
+	spin_unlock_bh(&nwk->lock);
+
+	return err;
+}
+
+int zb_nwk_ioctl(struct net *net, unsigned int cmd, void __user *arg)
+{
+	union {
+		struct zb_nwk_req nwk;
+		struct zb_route_req route;
+		struct zb_neigh_req neigh;
+	} req;
+	struct net_device *dev;
+	struct zb_nwk *nwk;
+	size_t size;
+	int err;
+
+	switch (cmd) {
+	case SIOCZBNWKSTART:
+	case SIOCZBNWKSTOP:
+		size = sizeof(req.nwk);
+		break;
+	case SIOCZBADDRT:
+	case SIOCZBDELRT:
+		size = sizeof(req.route);
+		break;
+	case SIOCZBADDNBR:
+	case SIOCZBDELNBR:
+		size = sizeof(req.neigh);
+		break;
+	default:
+		return -ENOIOCTLCMD;
+	}
+
+	if (!capable(CAP_NET_ADMIN))
+		return -EPERM;
+
+	if (copy_from_user(&req, arg, size))
+		return -EFAULT;
+
+	/* ifname is the first member of all requests */
+	req.nwk.ifname[IFNAMSIZ - 1] = '\0';
+
+	rtnl_lock();
+
+	dev = __dev_get_by_name(net, req.nwk.ifname);
+	if (!dev || dev->type != ARPHRD_IEEE802154) {
+		err = -ENODEV;
+		goto out;
+	}
+
+	if (cmd == SIOCZBNWKSTART) {
+		err = zb_nwk_start(dev, &req.nwk);
+		goto out;
+	}
+
+	nwk = zb_nwk_find(dev);
+	if (!nwk) {
+		err = -ENETDOWN;
+		goto out;
+	}
+
+	switch (cmd) {
+	case SIOCZBNWKSTOP:
+		zb_nwk_stop(nwk);
+		err = 0;
+		break;
+	case SIOCZBADDRT:
+		err = zb_nwk_add_route(nwk, &req.route);
+		break;
+	case SIOCZBDELRT:
+		err = zb_nwk_del_route(nwk, &req.route);
+		break;
+	case SIOCZBADDNBR:
+		err = zb_nwk_add_neigh(nwk, &req.neigh);
+		break;
+	default:
+		err = zb_nwk_del_neigh(nwk, &req.neigh);
+		break;
+	}
+
+out:
+	rtnl_unlock();
+	return err;
+}
+
+static int zb_nwk_device_event(struct notifier_block *unused,
+		unsigned long event, void *ptr)
+{
+	struct net_device *dev = ptr;
+	struct zb_nwk *nwk;
+
+	if (dev->type != ARPHRD_IEEE802154 || event != NETDEV_UNREGISTER)
+		return NOTIFY_DONE;
+
+	nwk = zb_nwk_find(dev);
+	if (nwk)
+		zb_nwk_stop(nwk);
+
+	return NOTIFY_DONE;
+}
+
+static struct notifier_block zb_nwk_notifier = {
+	.notifier_call = zb_nwk_device_event,
+};
+
+static struct packet_type zb_nwk_packet_type = {
+	.type = __constant_htons(ETH_P_IEEE802154),
+	.func = zb_nwk_rcv,
+};
+
+int __init zb_nwk_init(void)
+{
+	int rc;
+
+	rc = register_netdevice_notifier(&zb_nwk_notifier);
+	if (rc)
+		return rc;
+
+	dev_add_pack(&zb_nwk_packet_type);
+
+	return 0;
+}
+
+void zb_nwk_exit(void)
+{
+	struct zb_nwk *nwk, *tmp;
+
+	dev_remove_pack(&zb_nwk_packet_type);
+	unregister_netdevice_notifier(&zb_nwk_notifier);
+
+	rtnl_lock();
+	list_for_each_entry_safe(nwk, tmp, &zb_nwk_list, list)
+		zb_nwk_stop(nwk);
+	rtnl_unlock();
+
+	/* wait for the call_rcu() callbacks before the module goes away */
+	rcu_barrier();
+}
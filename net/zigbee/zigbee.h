@@ -0,0 +1,35 @@
+/*
+ * ZigBee NWK layer internals
+ *
+ * Copyright 2026 agent <agent@local>
+ *
+ * This program is free software; you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License version 2
+ * as published by the Free Software Foundation.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License along
+ * with this program; if not, write to the Free Software Foundation, Inc.,
+ * 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef ZIGBEE_H
+#define ZIGBEE_H
+
+struct sk_buff;
+struct net_device;
+
+extern struct proto zb_dgram_prot;
+int zb_dgram_deliver(struct net_device *dev, struct sk_buff *skb);
+
+int zb_nwk_init(void);
+void zb_nwk_exit(void);
+int zb_nwk_ioctl(struct net *net, unsigned int cmd, void __user *arg);
+struct net_device *zb_nwk_get_dev(struct net *net, u16 addr);
+int zb_nwk_output(struct net_device *dev, struct sk_buff *skb, u16 daddr);
+
+#endif
@@ -0,0 +1,522 @@
+/*
+ *
+ * net-ieee802154.c
+ *
+ * ieee802154: Benchmark for AF_IEEE802154 datagram and raw sockets
+ *
+ * Needs two IEEE 802.15.4 interfaces which can hear each other, e.g.
+ * a pair of fakelb devices, on the same PAN and channel with the short
+ * addresses given by --addr-a and --addr-b.
+ *
+ */
+
+#include "../perf.h"
+#include "../util/util.h"
+#include "../util/parse-options.h"
+#include "../builtin.h"
+#include "bench.h"
+
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <time.h>
+#include <sys/types.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+
+#ifndef AF_IEEE802154
+#define AF_IEEE802154	36
+#endif
+
+/* Mirrors include/net/af_ieee802154.h, which is not exported */
+#define IEEE802154_ADDR_SHORT	0x2
+#define IEEE802154_ADDR_LEN	8
+
+struct ieee802154_addr {
+	int addr_type;
+	u16 pan_id;
+	union {
+		u8 hwaddr[IEEE802154_ADDR_LEN];
+		u16 short_addr;
+	};
+};
+
+struct sockaddr_ieee802154 {
+	sa_family_t family;
+	struct ieee802154_addr addr;
+};
+
+/* Data frame, intra PAN, short destination and source addresses */
+#define FRAME_FC		0x8841
+#define FRAME_HDR_LEN		9
+#define FRAME_MAX_LEN		125
+
+/* Receivers give up after this much silence */
+#define RECV_TIMEOUT_MS		500
+
+static const char *type_str = "dgram";
+static const char *mode_str = "all";
+static const char *pan_str = "0x777";
+static const char *addr_a_str = "0x1";
+static const char *addr_b_str = "0x2";
+static int loops = 1000;
+static int size = 20;
+static int senders = 1;
+static int receivers = 1;
+static int sockets = 32;
+
+static const struct option options[] = {
+	OPT_STRING('t', "type", &type_str, "dgram",
+		    "Specify socket type: dgram or raw"),
+	OPT_STRING('m', "mode", &mode_str, "all",
+		    "Specify mode: pingpong, stream, fanin or all"),
+	OPT_STRING('p', "pan", &pan_str, "0x777",
+		    "Specify PAN id of both interfaces"),
+	OPT_STRING('a', "addr-a", &addr_a_str, "0x1",
+		    "Specify short address of the sending interface"),
+	OPT_STRING('b', "addr-b", &addr_b_str, "0x2",
+		    "Specify short address of the receiving interface"),
+	OPT_INTEGER('l', "loop", &loops,
+		    "Specify number of frames per sender"),
+	OPT_INTEGER('s', "size", &size,
+		    "Specify payload size in octets"),
+	OPT_INTEGER('S', "senders", &senders,
+		    "Specify number of senders for stream"),
+	OPT_INTEGER('R', "receivers", &receivers,
+		    "Specify number of receivers for stream"),
+	OPT_INTEGER('k', "sockets", &sockets,
+		    "Specify number of bound sockets for fanin"),
+	OPT_END()
+};
+
+static const char * const bench_net_ieee802154_usage[] = {
+	"perf bench net ieee802154 <options>",
+	NULL
+};
+
+static int sock_type;
+static u16 pan_id, addr_a, addr_b;
+
+struct worker {
+	pthread_t thread;
+	int fd;
+	u16 src, dst;
+	unsigned int frames;
+	unsigned int errors;
+	struct timespec last;
+};
+
+static volatile int stop;
+
+static u64 ts_to_ns(struct timespec *ts)
+{
+	return (u64)ts->tv_sec * 1000000000ULL + ts->tv_nsec;
+}
+
+static u64 now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return ts_to_ns(&ts);
+}
+
+static int open_sock(u16 src, u16 dst)
+{
+	struct sockaddr_ieee802154 sa;
+	struct timeval tv;
+	int fd;
+
+	fd = socket(AF_IEEE802154, sock_type, 0);
+	if (fd < 0) {
+		fprintf(stderr, "socket: %s\n", strerror(errno));
+		return -1;
+	}
+
+	memset(&sa, 0, sizeof(sa));
+	sa.family = AF_IEEE802154;
+	sa.addr.addr_type = IEEE802154_ADDR_SHORT;
+	sa.addr.pan_id = pan_id;
+	sa.addr.short_addr = src;
+
+	if (bind(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0) {
+		fprintf(stderr, "bind to %04x:%04x: %s\n",
+			pan_id, src, strerror(errno));
+		goto err;
+	}
+
+	/* Raw sockets send complete frames and cannot be connected */
+	sa.addr.short_addr = dst;
+	if (sock_type == SOCK_DGRAM &&
+	    connect(fd, (struct sockaddr *)&sa, sizeof(sa)) < 0) {
+		fprintf(stderr, "connect: %s\n", strerror(errno));
+		goto err;
+	}
+
+	tv.tv_sec = 0;
+	tv.tv_usec = RECV_TIMEOUT_MS * 1000;
+	if (setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv)) < 0) {
+		fprintf(stderr, "setsockopt: %s\n", strerror(errno));
+		goto err;
+	}
+
+	return fd;
+
+err:
+	close(fd);
+	return -1;
+}
+
+static int send_frame(int fd, u16 src, u16 dst, u8 seq)
+{
+	u8 buf[FRAME_HDR_LEN + FRAME_MAX_LEN];
+	u8 *p = buf;
+	int len = size;
+
+	if (sock_type == SOCK_RAW) {
+		*p++ = FRAME_FC & 0xff;
+		*p++ = FRAME_FC >> 8;
+		*p++ = seq;
+		*p++ = pan_id & 0xff;
+		*p++ = pan_id >> 8;
+		*p++ = dst & 0xff;
+		*p++ = dst >> 8;
+		*p++ = src & 0xff;
+		*p++ = src >> 8;
+		len += FRAME_HDR_LEN;
+	}
+	memset(p, 0xa5, size);
+
+	return send(fd, buf, len, 0) < 0 ? -1 : 0;
+}
+
+static int recv_frame(int fd)
+{
+	u8 buf[FRAME_HDR_LEN + FRAME_MAX_LEN + 2];
+
+	return recv(fd, buf, sizeof(buf), 0) < 0 ? -1 : 0;
+}
+
+static void print_time(const char *what, u64 ns)
+{
+	printf(" %14s: %llu.%03llu [sec]\n", what,
+	       ns / 1000000000ULL, (ns / 1000000ULL) % 1000);
+}
+
+static void print_rate(const char *what, unsigned long long count, u64 ns)
+{
+	printf(" %14.0lf %s/sec\n",
+	       ns ? (double)count * 1e9 / (double)ns : 0.0, what);
+}
+
+static int cmp_u64(const void *a, const void *b)
+{
+	u64 x = *(const u64 *)a, y = *(const u64 *)b;
+
+	return x < y ? -1 : x > y;
+}
+
+static void *pong_worker(void *arg)
+{
+	struct worker *w = arg;
+
+	while (!stop) {
+		if (recv_frame(w->fd) < 0)
+			continue;
+		if (send_frame(w->fd, w->src, w->dst, w->frames++) < 0)
+			w->errors++;
+	}
+
+	return NULL;
+}
+
+static int run_pingpong(void)
+{
+	struct worker pong;
+	u64 *rtt, start, t, total;
+	int fd, i, n = 0, lost = 0;
+	int err, ret = 1;
+
+	rtt = calloc(loops, sizeof(*rtt));
+	if (!rtt)
+		return 1;
+
+	fd = open_sock(addr_a, addr_b);
+	if (fd < 0)
+		goto out;
+
+	memset(&pong, 0, sizeof(pong));
+	pong.src = addr_b;
+	pong.dst = addr_a;
+	pong.fd = open_sock(addr_b, addr_a);
+	if (pong.fd < 0)
+		goto out_fd;
+
+	stop = 0;
+	err = pthread_create(&pong.thread, NULL, pong_worker, &pong);
+	if (err) {
+		fprintf(stderr, "pthread_create: %s\n", strerror(err));
+		goto out_pong;
+	}
+
+	start = now_ns();
+	for (i = 0; i < loops; i++) {
+		t = now_ns();
+		if (send_frame(fd, addr_a, addr_b, i) < 0 ||
+		    recv_frame(fd) < 0) {
+			lost++;
+			continue;
+		}
+		rtt[n++] = now_ns() - t;
+	}
+	total = now_ns() - start;
+
+	stop = 1;
+	pthread_join(pong.thread, NULL);
+
+	qsort(rtt, n, sizeof(*rtt), cmp_u64);
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# Executed %d ping-pong rounds of %d octet %s frames\n\n",
+		       loops, size, type_str);
+		print_time("Total time", total);
+		printf("\n");
+		if (n) {
+			printf(" %14lf usecs/op\n",
+			       (double)total / 1000.0 / (double)n);
+			printf(" %14llu usecs p50\n", rtt[n / 2] / 1000);
+			printf(" %14llu usecs p99\n",
+			       rtt[(u64)n * 99 / 100] / 1000);
+			printf(" %14llu usecs max\n", rtt[n - 1] / 1000);
+		}
+		print_rate("ops", n, total);
+		printf(" %14d lost\n", lost);
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%llu.%03llu\n", total / 1000000000ULL,
+		       (total / 1000000ULL) % 1000);
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	ret = 0;
+out_pong:
+	close(pong.fd);
+out_fd:
+	close(fd);
+out:
+	free(rtt);
+	return ret;
+}
+
+static void *send_worker(void *arg)
+{
+	struct worker *w = arg;
+	int i;
+
+	for (i = 0; i < loops; i++) {
+		if (send_frame(w->fd, w->src, w->dst, i) < 0)
+			w->errors++;
+		else
+			w->frames++;
+	}
+	clock_gettime(CLOCK_MONOTONIC, &w->last);
+
+	return NULL;
+}
+
+static void *recv_worker(void *arg)
+{
+	struct worker *w = arg;
+
+	for (;;) {
+		if (recv_frame(w->fd) < 0) {
+			if (stop)
+				break;
+			continue;
+		}
+		w->frames++;
+		clock_gettime(CLOCK_MONOTONIC, &w->last);
+	}
+
+	return NULL;
+}
+
+static int start_workers(struct worker *w, int n, u16 src, u16 dst,
+			 void *(*fn)(void *))
+{
+	int i, err;
+
+	for (i = 0; i < n; i++) {
+		w[i].src = src;
+		w[i].dst = dst;
+		w[i].fd = open_sock(src, dst);
+		if (w[i].fd < 0)
+			return -1;
+	}
+
+	for (i = 0; i < n; i++) {
+		err = pthread_create(&w[i].thread, NULL, fn, &w[i]);
+		if (err) {
+			fprintf(stderr, "pthread_create: %s\n",
+				strerror(err));
+			exit(1);
+		}
+	}
+
+	return 0;
+}
+
+static void close_workers(struct worker *w, int n)
+{
+	int i;
+
+	for (i = 0; i < n; i++)
+		if (w[i].fd > 0)
+			close(w[i].fd);
+}
+
+/*
+ * nsend senders on interface a spray frames at nrecv sockets bound on
+ * interface b. Every bound socket gets its own copy of each frame.
+ */
+static int run_stream(const char *name, int nsend, int nrecv)
+{
+	struct worker *tx, *rx;
+	unsigned long long sent = 0, errors = 0, delivered = 0;
+	u64 start, tx_end = 0, rx_end = 0, t;
+	int i, ret = 1;
+
+	if (nsend < 1 || nrecv < 1) {
+		fprintf(stderr, "Invalid number of senders or receivers\n");
+		return 1;
+	}
+
+	tx = calloc(nsend, sizeof(*tx));
+	rx = calloc(nrecv, sizeof(*rx));
+	if (!tx || !rx)
+		goto out;
+
+	stop = 0;
+	if (start_workers(rx, nrecv, addr_b, addr_a, recv_worker) < 0)
+		goto out_close;
+
+	start = now_ns();
+	if (start_workers(tx, nsend, addr_a, addr_b, send_worker) < 0) {
+		stop = 1;
+		for (i = 0; i < nrecv; i++)
+			pthread_join(rx[i].thread, NULL);
+		goto out_close;
+	}
+
+	for (i = 0; i < nsend; i++) {
+		pthread_join(tx[i].thread, NULL);
+		sent += tx[i].frames;
+		errors += tx[i].errors;
+		t = ts_to_ns(&tx[i].last);
+		if (t > tx_end)
+			tx_end = t;
+	}
+
+	stop = 1;
+	for (i = 0; i < nrecv; i++) {
+		pthread_join(rx[i].thread, NULL);
+		delivered += rx[i].frames;
+		t = ts_to_ns(&rx[i].last);
+		if (rx[i].frames && t > rx_end)
+			rx_end = t;
+	}
+
+	tx_end -= start;
+	rx_end = rx_end > start ? rx_end - start : 0;
+
+	switch (bench_format) {
+	case BENCH_FORMAT_DEFAULT:
+		printf("# %s: %d senders x %d frames of %d octets to %d %s sockets\n\n",
+		       name, nsend, loops, size, nrecv, type_str);
+		print_time("Send time", tx_end);
+		print_time("Receive time", rx_end);
+		printf("\n");
+		print_rate("frames sent", sent, tx_end);
+		print_rate("frames delivered", delivered, rx_end);
+		print_rate("frames per socket", delivered / nrecv, rx_end);
+		printf(" %14llu send errors\n", errors);
+		printf(" %14.2lf %% delivered\n", sent ?
+		       (double)delivered * 100.0 / (double)(sent * nrecv) :
+		       0.0);
+		break;
+
+	case BENCH_FORMAT_SIMPLE:
+		printf("%llu.%03llu\n", rx_end / 1000000000ULL,
+		       (rx_end / 1000000ULL) % 1000);
+		break;
+
+	default:
+		/* reaching here is something disaster */
+		fprintf(stderr, "Unknown format:%d\n", bench_format);
+		exit(1);
+		break;
+	}
+
+	ret = 0;
+out_close:
+	close_workers(tx, nsend);
+	close_workers(rx, nrecv);
+out:
+	free(tx);
+	free(rx);
+	return ret;
+}
+
+int bench_net_ieee802154(int argc, const char **argv,
+			 const char *prefix __used)
+{
+	int all, ret = 0;
+
+	argc = parse_options(argc, argv, options,
+			     bench_net_ieee802154_usage, 0);
+
+	if (!strcmp(type_str, "dgram"))
+		sock_type = SOCK_DGRAM;
+	else if (!strcmp(type_str, "raw"))
+		sock_type = SOCK_RAW;
+	else {
+		fprintf(stderr, "Unknown socket type:%s\n", type_str);
+		return 1;
+	}
+
+	if (size < 0 || size + (sock_type == SOCK_RAW ? FRAME_HDR_LEN : 0) >
+	    FRAME_MAX_LEN) {
+		fprintf(stderr, "Invalid frame size:%d\n", size);
+		return 1;
+	}
+
+	pan_id = strtoul(pan_str, NULL, 0);
+	addr_a = strtoul(addr_a_str, NULL, 0);
+	addr_b = strtoul(addr_b_str, NULL, 0);
+
+	all = !strcmp(mode_str, "all");
+	if (all || !strcmp(mode_str, "pingpong"))
+		ret |= run_pingpong();
+	if (all || !strcmp(mode_str, "stream"))
+		ret |= run_stream("stream", senders, receivers);
+	if (all || !strcmp(mode_str, "fanin"))
+		ret |= run_stream("fanin", 1, sockets);
+	if (!all && strcmp(mode_str, "pingpong") &&
+	    strcmp(mode_str, "stream") && strcmp(mode_str, "fanin")) {
+		fprintf(stderr, "Unknown mode:%s\n", mode_str);
+		return 1;
+	}
+
+	return ret;
+}
@@ -13,6 +13,7 @@
  * Available subsystem list:
  *  sched ... scheduler and IPC mechanism
  *  mem   ... memory access performance
+ *  net   ... network protocol families
  *
  */
 
@@ -58,6 +59,16 @@ static struct bench_suite mem_suites[] = {
 	  NULL             }
 };
 
+static struct bench_suite net_suites[] = {
+	{ "ieee802154",
+	  "AF_IEEE802154 socket latency and throughput",
+	  bench_net_ieee802154 },
+	suite_all,
+	{ NULL,
+	  NULL,
+	  NULL                 }
+};
+
 struct bench_subsys {
 	const char *name;
 	const char *summary;
@@ -71,6 +82,9 @@ static struct bench_subsys subsystems[] = {
 	{ "mem",
 	  "memory access performance",
 	  mem_suites },
+	{ "net",
+	  "network protocol families",
+	  net_suites },
 	{ "all",		/* sentinel: easy for help */
 	  "test all subsystem (pseudo subsystem)",
 	  NULL },